@@ -0,0 +1,137 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compare the datafeed callback paths of libsigrokcxx: one Packet object
+ * per packet (add_datafeed_callback()) versus packet views
+ * (add_datafeed_view_callback()). Runs the demo driver's logic channels
+ * and reports packets per second and C++ heap allocations per packet.
+ *
+ * Usage: bench_datafeed [samples [samplerate]]
+ */
+
+#include <libsigrokcxx/libsigrokcxx.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace sigrok;
+
+static atomic<unsigned long> allocations{0};
+
+void *operator new(size_t size)
+{
+	allocations++;
+	if (void *ptr = malloc(size ? size : 1))
+		return ptr;
+	throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+struct Result
+{
+	double seconds;
+	unsigned long packets;
+	unsigned long bytes;
+	unsigned long allocations;
+};
+
+static Result run(shared_ptr<Context> context, shared_ptr<HardwareDevice> device,
+	bool view)
+{
+	Result result {0, 0, 0, 0};
+	auto session = context->create_session();
+	session->add_device(device);
+
+	if (view) {
+		session->add_datafeed_view_callback(
+			[&result] (const shared_ptr<Device> &, const PacketView &packet) {
+				if (packet.type() != PacketType::LOGIC)
+					return;
+				result.packets++;
+				result.bytes += packet.logic_length();
+			});
+	} else {
+		session->add_datafeed_callback(
+			[&result] (shared_ptr<Device>, shared_ptr<Packet> packet) {
+				if (packet->type() != PacketType::LOGIC)
+					return;
+				auto logic = dynamic_pointer_cast<Logic>(packet->payload());
+				result.packets++;
+				result.bytes += logic->data_length();
+			});
+	}
+
+	auto start_allocations = allocations.load();
+	auto start = chrono::steady_clock::now();
+	session->start();
+	session->run();
+	auto end = chrono::steady_clock::now();
+	result.allocations = allocations.load() - start_allocations;
+	session->stop();
+
+	result.seconds = chrono::duration<double>(end - start).count();
+
+	return result;
+}
+
+static void report(const char *name, const Result &result)
+{
+	printf("%-8s %10.3f %10lu %12.0f %12.2f\n", name, result.seconds,
+		result.packets, result.packets / result.seconds,
+		result.packets ? (double)result.allocations / result.packets : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t samples = argc > 1 ? strtoull(argv[1], nullptr, 0) : 100000000;
+	uint64_t samplerate = argc > 2 ? strtoull(argv[2], nullptr, 0) : 200000000;
+
+	auto context = Context::create();
+	auto device = context->drivers()["demo"]->scan()[0];
+	device->open();
+	device->config_set(ConfigKey::SAMPLERATE,
+		Glib::Variant<guint64>::create(samplerate));
+	device->config_set(ConfigKey::LIMIT_SAMPLES,
+		Glib::Variant<guint64>::create(samples));
+	for (auto channel : device->channels())
+		channel->set_enabled(channel->type() == ChannelType::LOGIC);
+
+	printf("%-8s %10s %10s %12s %12s\n", "path", "time [s]", "packets",
+		"packets/s", "allocs/pkt");
+	report("packet", run(context, device, false));
+	report("view", run(context, device, true));
+
+	device->close();
+
+	return 0;
+}
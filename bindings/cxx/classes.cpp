@@ -898,16 +898,49 @@ float TriggerMatch::value() const
 DatafeedCallbackData::DatafeedCallbackData(Session *session,
 		DatafeedCallbackFunction callback) :
 	_callback(move(callback)),
-	_session(session)
+	_session(session),
+	_sdi(nullptr)
+{
+}
+
+DatafeedCallbackData::DatafeedCallbackData(Session *session,
+		DatafeedViewCallbackFunction callback) :
+	_view_callback(move(callback)),
+	_session(session),
+	_sdi(nullptr)
 {
 }
 
 void DatafeedCallbackData::run(const struct sr_dev_inst *sdi,
 	const struct sr_datafeed_packet *pkt)
 {
-	auto device = _session->get_device(sdi);
-	shared_ptr<Packet> packet {new Packet{device, pkt}, default_delete<Packet>{}};
-	_callback(move(device), move(packet));
+	if (!_view_callback) {
+		auto device = _session->get_device(sdi);
+		shared_ptr<Packet> packet {new Packet{device, pkt}, default_delete<Packet>{}};
+		_callback(move(device), move(packet));
+		return;
+	}
+
+	/*
+	 * Keep the device between packets, so that looking it up (and
+	 * creating a shared pointer to a session device) only happens
+	 * once per acquisition. Release it with the end packet, or when
+	 * the session stops without one, since session devices reference
+	 * the session, which owns this.
+	 */
+	if (sdi != _sdi || !_device) {
+		_device = _session->get_device(sdi);
+		_sdi = sdi;
+	}
+	_view_callback(_device, PacketView{_device, pkt});
+	if (pkt->type == SR_DF_END)
+		release_device();
+}
+
+void DatafeedCallbackData::release_device()
+{
+	_device.reset();
+	_sdi = nullptr;
 }
 
 SessionDevice::SessionDevice(struct sr_dev_inst *structure) :
@@ -998,7 +1031,9 @@ void Session::start()
 
 void Session::run()
 {
-	check(sr_session_run(_structure));
+	const int ret = sr_session_run(_structure);
+	release_devices();
+	check(ret);
 }
 
 void Session::stop()
@@ -1006,6 +1041,12 @@ void Session::stop()
 	check(sr_session_stop(_structure));
 }
 
+void Session::release_devices()
+{
+	for (auto &cb_data : _datafeed_callbacks)
+		cb_data->release_device();
+}
+
 bool Session::is_running() const
 {
 	const int ret = sr_session_is_running(_structure);
@@ -1014,10 +1055,11 @@ bool Session::is_running() const
 	return (ret != 0);
 }
 
-static void session_stopped_callback(void *data) noexcept
+void Session::stopped_callback(void *data) noexcept
 {
-	auto *const callback = static_cast<SessionStoppedCallback*>(data);
-	(*callback)();
+	auto *const session = static_cast<Session*>(data);
+	session->release_devices();
+	session->_stopped_callback();
 }
 
 void Session::set_stopped_callback(SessionStoppedCallback callback)
@@ -1025,7 +1067,7 @@ void Session::set_stopped_callback(SessionStoppedCallback callback)
 	_stopped_callback = move(callback);
 	if (_stopped_callback)
 		check(sr_session_stopped_callback_set(_structure,
-				&session_stopped_callback, &_stopped_callback));
+				&Session::stopped_callback, this));
 	else
 		check(sr_session_stopped_callback_set(_structure,
 				nullptr, nullptr));
@@ -1047,8 +1089,18 @@ void Session::add_datafeed_callback(DatafeedCallbackFunction callback)
 	_datafeed_callbacks.push_back(move(cb_data));
 }
 
+void Session::add_datafeed_view_callback(DatafeedViewCallbackFunction callback)
+{
+	unique_ptr<DatafeedCallbackData> cb_data
+		{new DatafeedCallbackData{this, move(callback)}};
+	check(sr_session_datafeed_callback_add(_structure,
+			&datafeed_callback, cb_data.get()));
+	_datafeed_callbacks.push_back(move(cb_data));
+}
+
 void Session::remove_datafeed_callbacks()
 {
+	release_devices();
 	check(sr_session_datafeed_callback_remove_all(_structure));
 	_datafeed_callbacks.clear();
 }
@@ -1073,6 +1125,39 @@ string Session::filename() const
 	return _filename;
 }
 
+static Stats stats_from(const struct sr_stats *stats)
+{
+	return Stats{valid_string(stats->name), stats->packets, stats->bytes,
+		stats->samples, stats->dropped, stats->frames, stats->time_us,
+		vector<uint64_t>(stats->latency,
+			stats->latency + SR_STATS_LATENCY_BUCKETS)};
+}
+
+static vector<Stats> stats_from(const GSList *list)
+{
+	vector<Stats> result;
+	for (const GSList *l = list; l; l = l->next)
+		result.push_back(stats_from(
+			static_cast<const struct sr_stats *>(l->data)));
+	return result;
+}
+
+SessionStats Session::stats()
+{
+	struct sr_session_stats *stats;
+	check(sr_session_stats_get(_structure, &stats));
+	SessionStats result{stats_from(&stats->datafeed),
+		stats_from(stats->devices), stats_from(stats->transforms),
+		stats_from(stats->callbacks)};
+	sr_session_stats_free(stats);
+	return result;
+}
+
+void Session::reset_stats()
+{
+	check(sr_session_stats_reset(_structure));
+}
+
 shared_ptr<Context> Session::context()
 {
 	return _context;
@@ -1081,7 +1166,8 @@ shared_ptr<Context> Session::context()
 Packet::Packet(shared_ptr<Device> device,
 	const struct sr_datafeed_packet *structure) :
 	_structure(structure),
-	_device(move(device))
+	_device(move(device)),
+	_owned(false)
 {
 	switch (structure->type)
 	{
@@ -1110,6 +1196,8 @@ Packet::Packet(shared_ptr<Device> device,
 
 Packet::~Packet()
 {
+	if (_owned)
+		sr_packet_free(const_cast<struct sr_datafeed_packet *>(_structure));
 }
 
 const PacketType *Packet::type() const
@@ -1125,6 +1213,93 @@ shared_ptr<PacketPayload> Packet::payload()
 		throw Error(SR_ERR_NA);
 }
 
+shared_ptr<Packet> Packet::copy() const
+{
+	return copy_of(_device, _structure);
+}
+
+shared_ptr<Packet> Packet::copy_of(shared_ptr<Device> device,
+	const struct sr_datafeed_packet *structure)
+{
+	struct sr_datafeed_packet *copy;
+	check(sr_packet_copy(structure, &copy));
+	shared_ptr<Packet> packet {new Packet{move(device), copy},
+		default_delete<Packet>{}};
+	packet->_owned = true;
+	return packet;
+}
+
+PacketView::PacketView(const shared_ptr<Device> &device,
+	const struct sr_datafeed_packet *structure) :
+	_device(device),
+	_structure(structure)
+{
+}
+
+const PacketType *PacketView::type() const
+{
+	return PacketType::get(_structure->type);
+}
+
+const struct sr_datafeed_logic *PacketView::logic() const
+{
+	if (_structure->type != SR_DF_LOGIC)
+		throw Error(SR_ERR_NA);
+	return static_cast<const struct sr_datafeed_logic *>(_structure->payload);
+}
+
+const struct sr_datafeed_analog *PacketView::analog() const
+{
+	if (_structure->type != SR_DF_ANALOG)
+		throw Error(SR_ERR_NA);
+	return static_cast<const struct sr_datafeed_analog *>(_structure->payload);
+}
+
+const void *PacketView::logic_data() const
+{
+	return logic()->data;
+}
+
+size_t PacketView::logic_length() const
+{
+	return logic()->length;
+}
+
+unsigned int PacketView::logic_unit_size() const
+{
+	return logic()->unitsize;
+}
+
+const void *PacketView::analog_data() const
+{
+	return analog()->data;
+}
+
+unsigned int PacketView::analog_num_samples() const
+{
+	return analog()->num_samples;
+}
+
+void PacketView::analog_data_as_float(float *dest) const
+{
+	check(sr_analog_to_float(analog(), dest));
+}
+
+const Quantity *PacketView::analog_mq() const
+{
+	return Quantity::get(analog()->meaning->mq);
+}
+
+const Unit *PacketView::analog_unit() const
+{
+	return Unit::get(analog()->meaning->unit);
+}
+
+shared_ptr<Packet> PacketView::copy() const
+{
+	return Packet::copy_of(_device, _structure);
+}
+
 PacketPayload::PacketPayload()
 {
 }
@@ -1472,10 +1647,12 @@ shared_ptr<InputDevice> Input::device()
 
 void Input::send(void *data, size_t length)
 {
-	auto gstr = g_string_new_len(static_cast<char *>(data), length);
-	auto ret = sr_input_send(_structure, gstr);
-	g_string_free(gstr, true);
-	check(ret);
+	/* Input modules only read from the buffer, lend them the data. */
+	GString gstr;
+	gstr.str = static_cast<char *>(data);
+	gstr.len = length;
+	gstr.allocated_len = length;
+	check(sr_input_send(_structure, &gstr));
 }
 
 void Input::end()
@@ -1681,6 +1858,40 @@ string Output::receive(shared_ptr<Packet> packet)
 	}
 }
 
+void Output::send(const struct sr_datafeed_packet *packet,
+	const OutputSinkFunction &sink)
+{
+	GString *out;
+	check(sr_output_send(_structure, packet, &out));
+	if (!out)
+		return;
+	try {
+		if (out->len)
+			sink(out->str, out->len);
+	} catch (...) {
+		g_string_free(out, true);
+		throw;
+	}
+	g_string_free(out, true);
+}
+
+void Output::receive(shared_ptr<Packet> packet, OutputSinkFunction sink)
+{
+	send(packet->_structure, sink);
+}
+
+void Output::receive(shared_ptr<Packet> packet, ostream &stream)
+{
+	send(packet->_structure, [&stream] (const char *data, size_t length) {
+		stream.write(data, length);
+	});
+}
+
+void Output::receive(const PacketView &packet, OutputSinkFunction sink)
+{
+	send(packet._structure, sink);
+}
+
 #include <enums.cpp>
 
 }
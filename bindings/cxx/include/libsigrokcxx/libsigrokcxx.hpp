@@ -79,6 +79,7 @@ G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 G_GNUC_END_IGNORE_DEPRECATIONS
 
 #include <functional>
+#include <ostream>
 #include <stdexcept>
 #include <memory>
 #include <vector>
@@ -109,6 +110,7 @@ class SR_API TriggerMatch;
 class SR_API TriggerMatchType;
 class SR_API ChannelType;
 class SR_API Packet;
+class SR_API PacketView;
 class SR_API PacketPayload;
 class SR_API PacketType;
 class SR_API Quantity;
@@ -578,6 +580,14 @@ typedef std::function<void()> SessionStoppedCallback;
 typedef std::function<void(std::shared_ptr<Device>, std::shared_ptr<Packet>)>
 	DatafeedCallbackFunction;
 
+/** Type of output data sink */
+typedef std::function<void(const char *data, size_t length)>
+	OutputSinkFunction;
+
+/** Type of allocation-free datafeed callback */
+typedef std::function<void(const std::shared_ptr<Device> &, const PacketView &)>
+	DatafeedViewCallbackFunction;
+
 /* Data required for C callback function to call a C++ datafeed callback */
 class SR_PRIV DatafeedCallbackData
 {
@@ -586,9 +596,17 @@ public:
 		const struct sr_datafeed_packet *pkt);
 private:
 	DatafeedCallbackFunction _callback;
+	DatafeedViewCallbackFunction _view_callback;
 	DatafeedCallbackData(Session *session,
 		DatafeedCallbackFunction callback);
+	DatafeedCallbackData(Session *session,
+		DatafeedViewCallbackFunction callback);
+	void release_device();
 	Session *_session;
+	/* Device of the previous packet, kept until the end packet
+	 * or until the session stops. */
+	const struct sr_dev_inst *_sdi;
+	std::shared_ptr<Device> _device;
 	friend class Session;
 };
 
@@ -606,6 +624,32 @@ private:
 	friend struct std::default_delete<SessionDevice>;
 };
 
+/** Performance counters of one stage of a session datafeed */
+struct SR_API Stats
+{
+	/** Device, transform module or callback the counters belong to. */
+	std::string name;
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t samples;
+	/** Dropped packets (transforms) or bytes (devices). */
+	uint64_t dropped;
+	/** Completed acquisition frames (devices). */
+	uint64_t frames;
+	uint64_t time_us;
+	/** Bucket n counts times of less than 2^n microseconds. */
+	std::vector<uint64_t> latency;
+};
+
+/** Performance counters of a session, see Session::stats() */
+struct SR_API SessionStats
+{
+	Stats datafeed;
+	std::vector<Stats> devices;
+	std::vector<Stats> transforms;
+	std::vector<Stats> callbacks;
+};
+
 /** A sigrok session */
 class SR_API Session : public UserOwned<Session>
 {
@@ -620,6 +664,10 @@ public:
 	/** Add a datafeed callback to this session.
 	 * @param callback Callback of the form callback(Device, Packet). */
 	void add_datafeed_callback(DatafeedCallbackFunction callback);
+	/** Add a datafeed callback which receives packet views. Unlike
+	 * add_datafeed_callback(), no objects get allocated per packet.
+	 * @param callback Callback of the form callback(Device, PacketView). */
+	void add_datafeed_view_callback(DatafeedViewCallbackFunction callback);
 	/** Remove all datafeed callbacks from this session. */
 	void remove_datafeed_callbacks();
 	/** Start the session. */
@@ -641,11 +689,18 @@ public:
 	void set_trigger(std::shared_ptr<Trigger> trigger);
 	/** Get filename this session was loaded from. */
 	std::string filename() const;
+	/** Get the performance counters of this session. Times are
+	 * measured from the first call on. */
+	SessionStats stats();
+	/** Reset the performance counters of this session. */
+	void reset_stats();
 private:
 	explicit Session(std::shared_ptr<Context> context);
 	Session(std::shared_ptr<Context> context, std::string filename);
 	~Session();
 	std::shared_ptr<Device> get_device(const struct sr_dev_inst *sdi);
+	void release_devices();
+	static void stopped_callback(void *data) noexcept;
 	struct sr_session *_structure;
 	const std::shared_ptr<Context> _context;
 	std::map<const struct sr_dev_inst *, std::unique_ptr<SessionDevice> > _owned_devices;
@@ -669,17 +724,25 @@ public:
 	const PacketType *type() const;
 	/** Payload of this packet. */
 	std::shared_ptr<PacketPayload> payload();
+	/** Copy of this packet which owns its payload. Unlike a packet
+	 * passed to a datafeed callback, the copy and its data remain
+	 * valid after the callback has returned. */
+	std::shared_ptr<Packet> copy() const;
 private:
 	Packet(std::shared_ptr<Device> device,
 		const struct sr_datafeed_packet *structure);
 	~Packet();
+	static std::shared_ptr<Packet> copy_of(std::shared_ptr<Device> device,
+		const struct sr_datafeed_packet *structure);
 	const struct sr_datafeed_packet *_structure;
 	std::shared_ptr<Device> _device;
 	std::unique_ptr<PacketPayload> _payload;
+	bool _owned;
 
 	friend class Session;
 	friend class Output;
 	friend class DatafeedCallbackData;
+	friend class PacketView;
 	friend class Header;
 	friend class Meta;
 	friend class Logic;
@@ -688,6 +751,48 @@ private:
 	friend struct std::default_delete<Packet>;
 };
 
+/** Non-owning view of a packet on the session datafeed
+ *
+ * Views are passed to callbacks added with
+ * Session::add_datafeed_view_callback(), and are only valid during the
+ * callback. Accessors for a payload type throw Error(SR_ERR_NA) when
+ * used on a packet of another type. */
+class SR_API PacketView
+{
+public:
+	/** Type of this packet. */
+	const PacketType *type() const;
+	/** Logic data. */
+	const void *logic_data() const;
+	/** Logic data length in bytes. */
+	size_t logic_length() const;
+	/** Size of each logic sample in bytes. */
+	unsigned int logic_unit_size() const;
+	/** Analog data. */
+	const void *analog_data() const;
+	/** Number of analog samples. */
+	unsigned int analog_num_samples() const;
+	/** Fills dest with the analog data converted to float.
+	 * The pointer must have space for analog_num_samples() floats. */
+	void analog_data_as_float(float *dest) const;
+	/** Measured quantity of the analog samples. */
+	const Quantity *analog_mq() const;
+	/** Unit of the analog samples. */
+	const Unit *analog_unit() const;
+	/** Copy of the viewed packet which owns its payload, see Packet::copy(). */
+	std::shared_ptr<Packet> copy() const;
+private:
+	PacketView(const std::shared_ptr<Device> &device,
+		const struct sr_datafeed_packet *structure);
+	const struct sr_datafeed_logic *logic() const;
+	const struct sr_datafeed_analog *analog() const;
+	const std::shared_ptr<Device> &_device;
+	const struct sr_datafeed_packet *_structure;
+
+	friend class DatafeedCallbackData;
+	friend class Output;
+};
+
 /** Abstract base class for datafeed packet payloads */
 class SR_API PacketPayload
 {
@@ -903,7 +1008,8 @@ class SR_API Input : public UserOwned<Input>
 public:
 	/** Virtual device associated with this input. */
 	std::shared_ptr<InputDevice> device();
-	/** Send next stream data.
+	/** Send next stream data. The data is not copied, and only
+	 * needs to remain valid during the call.
 	 * @param data Next stream data.
 	 * @param length Length of data. */
 	void send(void *data, size_t length);
@@ -1015,9 +1121,26 @@ public:
 	/** Update output with data from the given packet.
 	 * @param packet Packet to handle. */
 	std::string receive(std::shared_ptr<Packet> packet);
+	/** Update output with data from the given packet, passing the
+	 * output's data to a sink instead of returning it.
+	 * @param packet Packet to handle.
+	 * @param sink Callback of the form sink(data, length), called
+	 * when there is output data. The data is only valid during the call. */
+	void receive(std::shared_ptr<Packet> packet, OutputSinkFunction sink);
+	/** Update output with data from the given packet, writing the
+	 * output's data to a stream.
+	 * @param packet Packet to handle.
+	 * @param stream Stream to write output data to. */
+	void receive(std::shared_ptr<Packet> packet, std::ostream &stream);
+	/** Update output with data from the given packet view.
+	 * @param packet Packet to handle.
+	 * @param sink Callback of the form sink(data, length). */
+	void receive(const PacketView &packet, OutputSinkFunction sink);
 	/** Output format in use for this output */
 	std::shared_ptr<OutputFormat> format();
 private:
+	void send(const struct sr_datafeed_packet *packet,
+		const OutputSinkFunction &sink);
 	Output(std::shared_ptr<OutputFormat> format, std::shared_ptr<Device> device);
 	Output(std::shared_ptr<OutputFormat> format,
 		std::shared_ptr<Device> device, std::map<std::string, Glib::VariantBase> options);
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+##
+## This file is part of the libsigrok project.
+##
+## Copyright (C) 2026 The sigrok project
+##
+## This program is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program.  If not, see <http://www.gnu.org/licenses/>.
+##
+
+"""
+Measure the throughput of the Python datafeed.
+
+Runs the demo driver for a fixed number of samples, once per mode:
+
+  none    no datafeed callback, the rate of the C library by itself
+  packet  one callback per packet, touching packet.payload.data
+  retain  like 'packet', keeping packet.copy() beyond the callback
+  batch   add_datafeed_batch_callback(), one callback per batch
+"""
+
+import argparse
+import time
+
+from sigrok.core.classes import Context, ConfigKey, PacketType, ChannelType
+
+def setup(context, args):
+    driver = context.drivers['demo']
+    device = driver.scan()[0]
+    device.open()
+    device.config_set(ConfigKey.SAMPLERATE, args.samplerate)
+    device.config_set(ConfigKey.LIMIT_SAMPLES, args.samples)
+    for channel in device.channels:
+        if args.channels == 'logic':
+            channel.enabled = channel.type == ChannelType.LOGIC
+        elif args.channels == 'analog':
+            channel.enabled = channel.type == ChannelType.ANALOG
+    return device
+
+def handle(packet, stats):
+    if packet.type in (PacketType.LOGIC, PacketType.ANALOG):
+        data = packet.payload.data
+        stats['packets'] += 1
+        stats['bytes'] += data.nbytes
+        return data
+    return None
+
+def run(context, device, mode, args):
+    stats = {'packets': 0, 'bytes': 0}
+    kept = []
+
+    def packet_cb(device, packet):
+        handle(packet, stats)
+
+    def retain_cb(device, packet):
+        if handle(packet, stats) is not None:
+            kept.append(packet.copy().payload.data)
+            if len(kept) > args.keep:
+                del kept[0]
+
+    def batch_cb(batch):
+        for device, packet in batch:
+            handle(packet, stats)
+
+    session = context.create_session()
+    session.add_device(device)
+    if mode == 'packet':
+        session.add_datafeed_callback(packet_cb)
+    elif mode == 'retain':
+        session.add_datafeed_callback(retain_cb)
+    elif mode == 'batch':
+        session.add_datafeed_batch_callback(batch_cb, args.batch)
+
+    start = time.perf_counter()
+    session.start()
+    session.run()
+    elapsed = time.perf_counter() - start
+    session.stop()
+
+    return elapsed, stats
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--samples', type=int, default=10000000)
+    parser.add_argument('--samplerate', type=int, default=200000000)
+    parser.add_argument('--channels', choices=['logic', 'analog', 'all'],
+        default='logic')
+    parser.add_argument('--batch', type=int, default=64,
+        help='packets per batch callback')
+    parser.add_argument('--keep', type=int, default=16,
+        help='packets kept alive in retain mode')
+    parser.add_argument('modes', nargs='*',
+        default=['none', 'packet', 'retain', 'batch'])
+    args = parser.parse_args()
+
+    context = Context.create()
+    device = setup(context, args)
+
+    base = None
+    print('%-8s %10s %10s %12s %8s' % ('mode', 'time [s]', 'packets',
+        'samples/s', 'vs none'))
+    for mode in args.modes:
+        elapsed, stats = run(context, device, mode, args)
+        rate = args.samples / elapsed
+        if mode == 'none':
+            base = rate
+        ratio = '%7.2fx' % (rate / base) if base else '-'
+        print('%-8s %10.3f %10d %12.0f %8s' % (mode, elapsed,
+            stats['packets'], rate, ratio))
+
+    device.close()
+
+if __name__ == '__main__':
+    main()
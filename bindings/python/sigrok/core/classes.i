@@ -252,6 +252,20 @@ typedef guint pyg_flags_type;
     Py_XINCREF($input);
 }
 
+/*
+ * Let other Python threads run while a session runs. Callbacks into
+ * Python take the GIL for themselves.
+ */
+%exception sigrok::Session::run {
+    try {
+        GILRelease release;
+        $action
+    } catch (sigrok::Error &e) {
+        SWIG_exception(swig_exception_code(e.result),
+            const_cast<char*>(e.what()));
+    }
+}
+
 /* Cast PacketPayload pointers to correct subclass type. */
 %ignore sigrok::Packet::payload;
 
@@ -299,6 +313,62 @@ typedef guint pyg_flags_type;
 
 #include "libsigrokcxx/libsigrokcxx.hpp"
 
+/* Releases the GIL for the lifetime of the object. */
+class GILRelease
+{
+public:
+    GILRelease() : _state(PyEval_SaveThread()) {}
+    ~GILRelease() { PyEval_RestoreThread(_state); }
+private:
+    PyThreadState *_state;
+};
+
+typedef std::vector<std::pair<std::shared_ptr<sigrok::Device>,
+    std::shared_ptr<sigrok::Packet> > > DatafeedBatch;
+
+/* Pass a list of (device, packet) tuples to a Python callable, empty the batch. */
+void datafeed_batch_deliver(PyObject *callback, DatafeedBatch &batch)
+{
+    auto gstate = PyGILState_Ensure();
+
+    auto list = PyList_New(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        auto device_obj = SWIG_NewPointerObj(
+            SWIG_as_voidptr(new std::shared_ptr<sigrok::Device>(batch[i].first)),
+            SWIGTYPE_p_std__shared_ptrT_sigrok__Device_t, SWIG_POINTER_OWN);
+        auto packet_obj = SWIG_NewPointerObj(
+            SWIG_as_voidptr(new std::shared_ptr<sigrok::Packet>(batch[i].second)),
+            SWIGTYPE_p_std__shared_ptrT_sigrok__Packet_t, SWIG_POINTER_OWN);
+        PyList_SET_ITEM(list, i, Py_BuildValue("(NN)", device_obj, packet_obj));
+    }
+    batch.clear();
+
+    auto result = PyObject_CallFunctionObjArgs(callback, list, NULL);
+
+    Py_XDECREF(list);
+
+    bool completed = !PyErr_Occurred();
+
+    if (!completed)
+        PyErr_Print();
+
+    bool valid_result = (completed && result == Py_None);
+
+    Py_XDECREF(result);
+
+    if (completed && !valid_result)
+    {
+        PyErr_SetString(PyExc_TypeError,
+            "Datafeed callback did not return None");
+        PyErr_Print();
+    }
+
+    PyGILState_Release(gstate);
+
+    if (!valid_result)
+        throw sigrok::Error(SR_ERR);
+}
+
 /* Convert from a Python dict to a std::map<std::string, std::string> */
 std::map<std::string, std::string> dict_to_map_string(PyObject *dict)
 {
@@ -539,10 +609,33 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
     }
 }
 
+/*
+ * Create a NumPy array on a payload's data, without copying. The array
+ * references the payload object (and thus its packet), so it remains
+ * usable for as long as the packet's data is valid: until the datafeed
+ * callback returns, or for as long as the array lives for packets from
+ * Packet.copy() and from batch callbacks.
+ */
+%{
+PyObject *payload_array(PyObject *owner, int nd, npy_intp *dims,
+    int typenum, void *data)
+{
+    auto array = PyArray_SimpleNewFromData(nd, dims, typenum, data);
+    if (!array)
+        return nullptr;
+    Py_INCREF(owner);
+    if (PyArray_SetBaseObject((PyArrayObject *)array, owner) < 0) {
+        Py_DECREF(array);
+        return nullptr;
+    }
+    return array;
+}
+%}
+
 /* Return NumPy array from Analog::data(). */
 %extend sigrok::Analog
 {
-    PyObject * _data()
+    PyObject * _data(PyObject *owner)
     {
         int nd = 2;
         npy_intp dims[2];
@@ -550,32 +643,69 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
         dims[1] = $self->num_samples();
         int typenum = NPY_FLOAT;
         void *data = $self->data_pointer();
-        return PyArray_SimpleNewFromData(nd, dims, typenum, data);
+        return payload_array(owner, nd, dims, typenum, data);
     }
 
 %pythoncode
 {
-    data = property(_data)
+    data = property(lambda self: self._data(self))
 }
 }
 
 /* Return NumPy array from Logic::data(). */
 %extend sigrok::Logic
 {
-    PyObject * _data()
+    PyObject * _data(PyObject *owner)
     {
         npy_intp dims[2];
         dims[0] = $self->data_length() / $self->unit_size();
         dims[1] = $self->unit_size();
         int typenum = NPY_UINT8;
         void *data = $self->data_pointer();
-        return PyArray_SimpleNewFromData(2, dims, typenum, data);
+        return payload_array(owner, 2, dims, typenum, data);
     }
 
 %pythoncode
 {
-    data = property(_data)
+    data = property(lambda self: self._data(self))
+}
 }
+
+/*
+ * Deliver datafeed packets in batches, to take the GIL once per batch
+ * instead of once per packet. Logic and analog packets are queued as
+ * copies which own their data, up to max_packets of them. Any other
+ * packet (header, meta, trigger, end) is delivered immediately, along
+ * with the queued packets, so that the order of packets is kept and
+ * the last batch is delivered with the end packet.
+ */
+%extend sigrok::Session
+{
+    void add_datafeed_batch_callback(PyObject *callback,
+        unsigned int max_packets = 64)
+    {
+        if (!PyCallable_Check(callback))
+            throw sigrok::Error(SR_ERR_ARG);
+
+        auto batch = std::make_shared<DatafeedBatch>();
+        batch->reserve(max_packets);
+
+        $self->add_datafeed_callback([=] (std::shared_ptr<sigrok::Device> device,
+                std::shared_ptr<sigrok::Packet> packet) {
+            auto type = packet->type();
+            if (type == sigrok::PacketType::LOGIC ||
+                    type == sigrok::PacketType::ANALOG) {
+                batch->emplace_back(move(device), packet->copy());
+                if (batch->size() < max_packets)
+                    return;
+            } else {
+                batch->emplace_back(move(device), move(packet));
+            }
+            datafeed_batch_deliver(callback, *batch);
+        });
+
+        Py_XINCREF(callback);
+    }
 }
 
 /* Create logic packet from Python buffer. */
@@ -81,6 +81,13 @@ template< class T > class enable_shared_from_this;
 
 %ignore sigrok::DatafeedCallbackData;
 
+/* The allocation-free datafeed and output sinks are for C++ callers only. */
+%ignore sigrok::PacketView;
+%ignore sigrok::Session::add_datafeed_view_callback;
+%ignore sigrok::Output::receive(std::shared_ptr<sigrok::Packet>, sigrok::OutputSinkFunction);
+%ignore sigrok::Output::receive(std::shared_ptr<sigrok::Packet>, std::ostream &);
+%ignore sigrok::Output::receive(const sigrok::PacketView &, sigrok::OutputSinkFunction);
+
 #ifndef SWIGJAVA
 
 #define SWIG_ATTRIBUTE_TEMPLATE
@@ -175,6 +175,8 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_timestamp. */
+	SR_DF_TIMESTAMP,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -482,6 +484,22 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_aligner
+ * Opaque structure which aligns logic and analog packets into blocks.
+ *
+ * @see sr_aligner_new(), sr_aligner_free().
+ */
+struct sr_aligner;
+
+/**
+ * @struct sr_merger
+ * Opaque structure which orders the packets of several devices by time.
+ *
+ * @see sr_merger_new(), sr_merger_free().
+ */
+struct sr_merger;
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -501,6 +519,20 @@ struct sr_datafeed_header {
 	struct timeval starttime;
 };
 
+/**
+ * Datafeed payload for type SR_DF_TIMESTAMP: the time at which the device
+ * took a sample, as measured by the device.
+ *
+ * @since 0.6.0
+ */
+struct sr_datafeed_timestamp {
+	/** Number of the sample since SR_DF_HEADER, counted per logic
+	 * stream or analog channel. */
+	uint64_t sample_num;
+	/** Time in nanoseconds, relative to the header's starttime. */
+	int64_t time_ns;
+};
+
 /** Datafeed payload for type SR_DF_META. */
 struct sr_datafeed_meta {
 	GSList *config;
@@ -555,6 +587,82 @@ struct sr_analog_spec {
 	int8_t spec_digits;
 };
 
+/** Number of buckets of the latency histogram in struct sr_stats. */
+#define SR_STATS_LATENCY_BUCKETS 24
+
+/**
+ * Performance counters of one stage of a session datafeed.
+ *
+ * Bucket n of the latency histogram counts durations of less than 2^n
+ * microseconds (and at least 2^(n-1)), the last bucket also counts
+ * everything longer.
+ *
+ * @since 0.6.0
+ */
+struct sr_stats {
+	/** Device, transform module or callback the counters belong to. */
+	char *name;
+	/** Number of packets. */
+	uint64_t packets;
+	/** Number of logic and analog payload bytes. */
+	uint64_t bytes;
+	/** Number of logic and analog samples. */
+	uint64_t samples;
+	/** Dropped packets (transforms) or bytes (devices). */
+	uint64_t dropped;
+	/** Completed acquisition frames (devices). */
+	uint64_t frames;
+	/** Accumulated time in microseconds. */
+	uint64_t time_us;
+	/** Histogram of the individual times. */
+	uint64_t latency[SR_STATS_LATENCY_BUCKETS];
+};
+
+/**
+ * Performance counters of a session, see sr_session_stats_get().
+ *
+ * @since 0.6.0
+ */
+struct sr_session_stats {
+	/** All packets sent by devices, time spent delivering them. */
+	struct sr_stats datafeed;
+	/**
+	 * List of struct sr_stats per device: packets sent, data dropped,
+	 * frames and latencies reported by the driver (such as USB transfer
+	 * resubmission or the time an oscilloscope took for a frame).
+	 */
+	GSList *devices;
+	/** List of struct sr_stats per transform: packets received,
+	 * packets not passed on, time spent. */
+	GSList *transforms;
+	/** List of struct sr_stats per datafeed callback. */
+	GSList *callbacks;
+};
+
+/**
+ * Samples of all aligned streams for a range of sample numbers, see
+ * sr_aligner_new(). The data is only valid during the callback.
+ *
+ * @since 0.6.0
+ */
+struct sr_aligned_block {
+	/** Number of the first sample, counted from the start of the
+	 * acquisition or frame. */
+	uint64_t first_sample;
+	/** Number of samples in the block. */
+	size_t num_samples;
+	/** Logic samples of logic_unitsize bytes each, or NULL if no
+	 * logic channel is enabled. */
+	const uint8_t *logic;
+	size_t logic_unitsize;
+	/** Number of analog columns. */
+	size_t num_analog;
+	/** Channel of each analog column. */
+	struct sr_channel *const *analog_channels;
+	/** Samples of each analog column, num_samples values each. */
+	const float *const *analog;
+};
+
 /** Generic option struct used by various subsystems. */
 struct sr_option {
 	/* Short name suitable for commandline usage, [a-z0-9-]. */
@@ -26,6 +26,19 @@
  * Header file containing API function prototypes.
  */
 
+/*--- aligner.c -------------------------------------------------------------*/
+
+typedef int (*sr_aligner_callback)(const struct sr_aligned_block *block,
+		void *cb_data);
+
+SR_API int sr_aligner_new(struct sr_aligner **aligner,
+		const struct sr_dev_inst *sdi, size_t block_size, size_t max_lag,
+		sr_aligner_callback cb, void *cb_data);
+SR_API int sr_aligner_feed(struct sr_aligner *aligner,
+		const struct sr_datafeed_packet *packet);
+SR_API int sr_aligner_flush(struct sr_aligner *aligner);
+SR_API void sr_aligner_free(struct sr_aligner *aligner);
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
@@ -45,6 +58,7 @@ SR_API int sr_rational_div(struct sr_rational *res, const struct sr_rational *nu
 
 SR_API int sr_init(struct sr_context **ctx);
 SR_API int sr_exit(struct sr_context *ctx);
+SR_API int sr_usb_event_thread_set(struct sr_context *ctx, gboolean enable);
 
 SR_API GSList *sr_buildinfo_libs_get(void);
 SR_API char *sr_buildinfo_host_get(void);
@@ -105,10 +119,18 @@ SR_API int sr_driver_init(struct sr_context *ctx,
 		struct sr_dev_driver *driver);
 SR_API GArray *sr_driver_scan_options_list(const struct sr_dev_driver *driver);
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options);
+SR_API GSList *sr_driver_scan_multi(struct sr_context *ctx,
+		struct sr_dev_driver **drivers, GSList *options, GSList *conns,
+		int max_threads);
+SR_API void sr_driver_scan_cache_clear(struct sr_context *ctx);
 SR_API int sr_config_get(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
 		uint32_t key, GVariant **data);
+SR_API int sr_config_get_multi(const struct sr_dev_driver *driver,
+		const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		const uint32_t *keys, unsigned int num_keys, GVariant **data);
 SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
 		uint32_t key, GVariant *data);
@@ -140,6 +162,14 @@ SR_API int sr_session_dev_remove(struct sr_session *session,
 		struct sr_dev_inst *sdi);
 SR_API int sr_session_dev_list(struct sr_session *session, GSList **devlist);
 SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger *trig);
+SR_API int sr_session_threaded_set(struct sr_session *session, gboolean threaded);
+SR_API int sr_session_threaded_get(struct sr_session *session);
+
+/* Performance counters */
+SR_API int sr_session_stats_get(struct sr_session *session,
+		struct sr_session_stats **stats);
+SR_API void sr_session_stats_free(struct sr_session_stats *stats);
+SR_API int sr_session_stats_reset(struct sr_session *session);
 
 /* Datafeed setup */
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
@@ -180,6 +210,19 @@ SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
 
+/*--- merger.c --------------------------------------------------------------*/
+
+typedef void (*sr_merger_callback)(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, int64_t time_ns,
+		void *cb_data);
+
+SR_API int sr_merger_new(struct sr_merger **merger, struct sr_session *session,
+		uint64_t window_us, sr_merger_callback cb, void *cb_data);
+SR_API int sr_merger_feed(struct sr_merger *merger,
+		const struct sr_dev_inst *sdi, const struct sr_datafeed_packet *packet);
+SR_API int sr_merger_flush(struct sr_merger *merger);
+SR_API void sr_merger_free(struct sr_merger *merger);
+
 /*--- output/output.c -------------------------------------------------------*/
 
 SR_API const struct sr_output_module **sr_output_list(void);
@@ -198,6 +241,10 @@ SR_API gboolean sr_output_test_flag(const struct sr_output_module *omod,
 		uint64_t flag);
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
+SR_API int sr_output_send_append(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString *out);
+SR_API int sr_output_send_fd(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, int fd);
 SR_API int sr_output_free(const struct sr_output *o);
 
 /*--- transform/transform.c -------------------------------------------------*/
@@ -259,6 +306,9 @@ SR_API int sr_snprintf_ascii(char *buf, size_t buf_size,
 		const char *format, ...);
 SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 		const char *format, va_list args);
+SR_API double sr_strtod_ascii(const char *str, char **endptr);
+SR_API int sr_format_double_ascii(char *buf, size_t buf_size,
+		double value, int precision);
 SR_API int sr_parse_rational(const char *str, struct sr_rational *ret);
 
 /*--- version.c -------------------------------------------------------------*/
@@ -0,0 +1,514 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ *
+ * Alignment of logic and analog packets into sample-synchronous blocks.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "aligner"
+
+/** Default number of samples per block. */
+#define DEFAULT_BLOCK_SIZE 4096
+/** Default number of samples a stream may run ahead of the others. */
+#define DEFAULT_MAX_LAG (1024 * 1024)
+
+/**
+ * @defgroup grp_aligner Aligner
+ *
+ * Combine the logic and analog packets of a device into blocks of samples.
+ *
+ * Devices send logic and analog data in independent packets of unrelated
+ * lengths. An aligner queues the data of every stream (the logic channels,
+ * and each enabled analog channel) and hands out blocks which cover the
+ * same range of sample numbers for all of them, as soon as every stream
+ * has delivered the data.
+ *
+ * All streams are assumed to run at the same samplerate and to start at
+ * sample number 0 with the acquisition, or with each frame.
+ *
+ * @{
+ */
+
+/* Queued samples of one stream. */
+struct aligner_stream {
+	uint8_t *buf;
+	/* Size of a sample in bytes. */
+	size_t unitsize;
+	/* Samples queued, starting at sample 'start' of buf. */
+	size_t start;
+	size_t len;
+	/* Capacity of buf in samples. */
+	size_t alloc;
+	/*
+	 * Samples which were already handed out as gaps. The data which
+	 * arrives for them late is dropped.
+	 */
+	uint64_t skip;
+};
+
+struct sr_aligner {
+	sr_aligner_callback cb;
+	void *cb_data;
+	size_t block_size;
+	size_t max_lag;
+	/* Sample number of the next block. */
+	uint64_t sample_num;
+	gboolean have_logic;
+	struct aligner_stream logic;
+	size_t num_analog;
+	struct sr_channel **analog_channels;
+	struct aligner_stream *analog;
+	const float **analog_ptrs;
+	/* Conversion buffer for analog packets. */
+	float *fdata;
+	size_t fdata_alloc;
+};
+
+static void stream_reset(struct aligner_stream *s)
+{
+	s->start = 0;
+	s->len = 0;
+	s->skip = 0;
+}
+
+/* Make room for 'count' more samples at the end of the queue. */
+static void stream_reserve(struct aligner_stream *s, size_t count)
+{
+	if (s->start + s->len + count <= s->alloc)
+		return;
+
+	if (s->start) {
+		memmove(s->buf, s->buf + s->start * s->unitsize,
+			s->len * s->unitsize);
+		s->start = 0;
+	}
+	if (s->len + count > s->alloc) {
+		s->alloc = MAX(s->len + count, s->alloc * 2);
+		s->buf = g_realloc(s->buf, s->alloc * s->unitsize);
+	}
+}
+
+static uint8_t *stream_tail(struct aligner_stream *s)
+{
+	return s->buf + (s->start + s->len) * s->unitsize;
+}
+
+/* Returns the number of leading samples of a new chunk to drop. */
+static size_t stream_skip(struct aligner_stream *s, size_t count)
+{
+	size_t n;
+
+	n = MIN(s->skip, count);
+	s->skip -= n;
+
+	return n;
+}
+
+static void stream_consume(struct aligner_stream *s, size_t count)
+{
+	s->start += count;
+	s->len -= count;
+	if (!s->len)
+		s->start = 0;
+}
+
+static size_t stream_room(const struct sr_aligner *al,
+		const struct aligner_stream *s)
+{
+	return s->len < al->max_lag ? al->max_lag - s->len : 0;
+}
+
+/*
+ * Hand out blocks of all samples which every stream has. With 'force',
+ * hand out everything that any stream has, and fill the other streams:
+ * analog with NAN, logic with zeros.
+ */
+static int emit(struct sr_aligner *al, gboolean force)
+{
+	struct sr_aligned_block block;
+	struct aligner_stream *s;
+	size_t avail, n, i, gap;
+	float *f;
+	int ret;
+
+	avail = force ? 0 : SIZE_MAX;
+	if (al->have_logic)
+		avail = force ? MAX(avail, al->logic.len) : MIN(avail, al->logic.len);
+	for (i = 0; i < al->num_analog; i++) {
+		s = &al->analog[i];
+		avail = force ? MAX(avail, s->len) : MIN(avail, s->len);
+	}
+	if (!avail)
+		return SR_OK;
+
+	if (force) {
+		if (al->have_logic) {
+			s = &al->logic;
+			gap = avail - s->len;
+			stream_reserve(s, gap);
+			memset(stream_tail(s), 0, gap * s->unitsize);
+			s->len += gap;
+			s->skip += gap;
+		}
+		for (i = 0; i < al->num_analog; i++) {
+			s = &al->analog[i];
+			gap = avail - s->len;
+			stream_reserve(s, gap);
+			f = (float *)stream_tail(s);
+			for (n = 0; n < gap; n++)
+				f[n] = NAN;
+			s->len += gap;
+			s->skip += gap;
+		}
+	}
+
+	block.logic_unitsize = al->have_logic ? al->logic.unitsize : 0;
+	block.num_analog = al->num_analog;
+	block.analog_channels = al->analog_channels;
+	block.analog = al->analog_ptrs;
+	while (avail) {
+		n = MIN(avail, al->block_size);
+		block.first_sample = al->sample_num;
+		block.num_samples = n;
+		block.logic = NULL;
+		if (al->have_logic)
+			block.logic = al->logic.buf + al->logic.start * al->logic.unitsize;
+		for (i = 0; i < al->num_analog; i++) {
+			s = &al->analog[i];
+			al->analog_ptrs[i] = (const float *)s->buf + s->start;
+		}
+
+		ret = al->cb(&block, al->cb_data);
+
+		if (al->have_logic)
+			stream_consume(&al->logic, n);
+		for (i = 0; i < al->num_analog; i++)
+			stream_consume(&al->analog[i], n);
+		al->sample_num += n;
+		avail -= n;
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+static int feed_logic(struct sr_aligner *al,
+		const struct sr_datafeed_logic *logic)
+{
+	struct aligner_stream *s;
+	const uint8_t *data;
+	size_t count, n;
+	int ret;
+
+	s = &al->logic;
+	if (!al->have_logic || !logic->unitsize)
+		return SR_OK;
+	if (s->unitsize != logic->unitsize && !s->len) {
+		/* Nothing queued yet, or only gaps of an assumed size. */
+		s->alloc = s->alloc * s->unitsize / logic->unitsize;
+		s->start = 0;
+		s->unitsize = logic->unitsize;
+	} else if (s->unitsize != logic->unitsize) {
+		sr_err("Logic unitsize changed from %zu to %u.",
+			s->unitsize, logic->unitsize);
+		return SR_ERR_DATA;
+	}
+
+	data = logic->data;
+	count = logic->length / logic->unitsize;
+	n = stream_skip(s, count);
+	data += n * s->unitsize;
+	count -= n;
+	while (count) {
+		/* Streams which are too far behind turn into gaps. */
+		if (!(n = MIN(count, stream_room(al, s)))) {
+			if ((ret = emit(al, TRUE)) != SR_OK)
+				return ret;
+			continue;
+		}
+		stream_reserve(s, n);
+		memcpy(stream_tail(s), data, n * s->unitsize);
+		s->len += n;
+		data += n * s->unitsize;
+		count -= n;
+		if ((ret = emit(al, FALSE)) != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+static struct aligner_stream *find_stream(struct sr_aligner *al,
+		const struct sr_channel *ch)
+{
+	size_t i;
+
+	for (i = 0; i < al->num_analog; i++) {
+		if (al->analog_channels[i] == ch)
+			return &al->analog[i];
+	}
+
+	return NULL;
+}
+
+static int feed_analog(struct sr_aligner *al,
+		const struct sr_datafeed_analog *analog)
+{
+	struct aligner_stream *s;
+	const float *src;
+	float *dst;
+	GSList *l;
+	size_t num_channels, count, offset, skip, n, i, j;
+	int ret;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	count = analog->num_samples;
+	if (!num_channels || !count)
+		return SR_OK;
+
+	if (al->fdata_alloc < count * num_channels) {
+		al->fdata_alloc = count * num_channels;
+		g_free(al->fdata);
+		al->fdata = g_malloc(al->fdata_alloc * sizeof(float));
+	}
+	if ((ret = sr_analog_to_float(analog, al->fdata)) != SR_OK)
+		return ret;
+
+	/* All channels of the packet advance together. */
+	offset = 0;
+	while (offset < count) {
+		n = count - offset;
+		for (l = analog->meaning->channels; l; l = l->next) {
+			if ((s = find_stream(al, l->data)))
+				n = MIN(n, stream_room(al, s));
+		}
+		if (!n) {
+			if ((ret = emit(al, TRUE)) != SR_OK)
+				return ret;
+			continue;
+		}
+		for (l = analog->meaning->channels, i = 0; l; l = l->next, i++) {
+			if (!(s = find_stream(al, l->data)))
+				continue;
+			skip = stream_skip(s, n);
+			stream_reserve(s, n - skip);
+			src = al->fdata + (offset + skip) * num_channels + i;
+			dst = (float *)stream_tail(s);
+			for (j = 0; j < n - skip; j++)
+				dst[j] = src[j * num_channels];
+			s->len += n - skip;
+		}
+		offset += n;
+		if ((ret = emit(al, FALSE)) != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+static void reset(struct sr_aligner *al)
+{
+	size_t i;
+
+	al->sample_num = 0;
+	stream_reset(&al->logic);
+	for (i = 0; i < al->num_analog; i++)
+		stream_reset(&al->analog[i]);
+}
+
+/**
+ * Create an aligner for the enabled channels of a device.
+ *
+ * Blocks contain up to @p block_size samples. A stream may run at most
+ * @p max_lag samples ahead of the slowest stream. When it would run
+ * further ahead, the streams which lag behind get a gap: the samples
+ * missing so far are handed out as NAN (analog) or 0 (logic), and their
+ * data for those samples is dropped when it arrives. Memory usage is
+ * bounded by that limit.
+ *
+ * @param[out] aligner Pointer to store the new aligner in.
+ * @param[in] sdi The device whose channels to align. Must not be NULL.
+ * @param[in] block_size The maximum number of samples per block, or 0
+ *                       for the default.
+ * @param[in] max_lag The maximum number of samples a stream may run
+ *                    ahead, or 0 for the default. Should cover the
+ *                    largest packet the device sends.
+ * @param[in] cb Function to call with each block. Must not be NULL.
+ * @param[in] cb_data Opaque pointer passed to @p cb.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or no channel is enabled.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_aligner_new(struct sr_aligner **aligner,
+		const struct sr_dev_inst *sdi, size_t block_size, size_t max_lag,
+		sr_aligner_callback cb, void *cb_data)
+{
+	struct sr_aligner *al;
+	struct sr_channel *ch;
+	GSList *l, *analog;
+	size_t i;
+
+	if (!aligner || !sdi || !cb)
+		return SR_ERR_ARG;
+
+	al = g_malloc0(sizeof(*al));
+	al->cb = cb;
+	al->cb_data = cb_data;
+	al->block_size = block_size ? block_size : DEFAULT_BLOCK_SIZE;
+	al->max_lag = max_lag ? max_lag : DEFAULT_MAX_LAG;
+	al->max_lag = MAX(al->max_lag, al->block_size);
+
+	analog = NULL;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_LOGIC) {
+			al->have_logic = TRUE;
+			/* Until a logic packet tells otherwise. */
+			al->logic.unitsize = MAX(al->logic.unitsize,
+				(size_t)ch->index / 8 + 1);
+		}
+		else if (ch->type == SR_CHANNEL_ANALOG)
+			analog = g_slist_append(analog, ch);
+	}
+	if (!al->have_logic && !analog) {
+		sr_err("No enabled channels to align.");
+		g_free(al);
+		return SR_ERR_ARG;
+	}
+
+	al->num_analog = g_slist_length(analog);
+	al->analog_channels = g_malloc0(sizeof(*al->analog_channels) * (al->num_analog + 1));
+	al->analog = g_malloc0(sizeof(*al->analog) * (al->num_analog + 1));
+	al->analog_ptrs = g_malloc0(sizeof(*al->analog_ptrs) * (al->num_analog + 1));
+	for (l = analog, i = 0; l; l = l->next, i++) {
+		al->analog_channels[i] = l->data;
+		al->analog[i].unitsize = sizeof(float);
+	}
+	g_slist_free(analog);
+
+	*aligner = al;
+
+	return SR_OK;
+}
+
+/**
+ * Feed a packet to an aligner.
+ *
+ * Logic and analog packets are queued, and every block which all streams
+ * have data for is passed to the callback. SR_DF_FRAME_END and SR_DF_END
+ * flush the queued samples (see sr_aligner_flush()) and restart the
+ * sample numbers at 0. Other packets are ignored.
+ *
+ * @param[in] aligner The aligner. Must not be NULL.
+ * @param[in] packet The packet. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_DATA The logic unitsize changed.
+ * @retval other The first error returned by the callback.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_aligner_feed(struct sr_aligner *aligner,
+		const struct sr_datafeed_packet *packet)
+{
+	int ret;
+
+	if (!aligner || !packet)
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		reset(aligner);
+		return SR_OK;
+	case SR_DF_LOGIC:
+		return feed_logic(aligner, packet->payload);
+	case SR_DF_ANALOG:
+		return feed_analog(aligner, packet->payload);
+	case SR_DF_FRAME_END:
+	case SR_DF_END:
+		ret = emit(aligner, TRUE);
+		reset(aligner);
+		return ret;
+	default:
+		return SR_OK;
+	}
+}
+
+/**
+ * Pass all queued samples to the callback.
+ *
+ * Streams which have less data than others are filled up: analog
+ * samples with NAN, logic samples with 0. Data which arrives later for
+ * the filled samples is dropped.
+ *
+ * @param[in] aligner The aligner. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other The first error returned by the callback.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_aligner_flush(struct sr_aligner *aligner)
+{
+	if (!aligner)
+		return SR_ERR_ARG;
+
+	return emit(aligner, TRUE);
+}
+
+/**
+ * Free an aligner. Queued samples are discarded.
+ *
+ * @param[in] aligner The aligner. May be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_aligner_free(struct sr_aligner *aligner)
+{
+	size_t i;
+
+	if (!aligner)
+		return;
+
+	g_free(aligner->logic.buf);
+	for (i = 0; i < aligner->num_analog; i++)
+		g_free(aligner->analog[i].buf);
+	g_free(aligner->analog);
+	g_free(aligner->analog_channels);
+	g_free(aligner->analog_ptrs);
+	g_free(aligner->fdata);
+	g_free(aligner);
+}
+
+/** @} */
@@ -475,7 +475,7 @@ static int sanity_check_all_output_modules(void)
 			sr_err("No description in module '%s'.", d);
 			errors++;
 		}
-		if (!outputs[i]->receive) {
+		if (!outputs[i]->receive && !outputs[i]->receive_append) {
 			sr_err("No receive in module '%s'.", d);
 			errors++;
 		}
@@ -634,6 +634,7 @@ SR_API int sr_init(struct sr_context **ctx)
 	}
 #endif
 	sr_resource_set_hooks(context, NULL, NULL, NULL, NULL);
+	g_mutex_init(&context->scan_cache_mutex);
 
 	*ctx = context;
 	context = NULL;
@@ -674,10 +675,55 @@ SR_API int sr_exit(struct sr_context *ctx)
 	libusb_exit(ctx->libusb_ctx);
 #endif
 
+	if (ctx->scan_cache)
+		g_hash_table_destroy(ctx->scan_cache);
+	g_mutex_clear(&ctx->scan_cache_mutex);
+
 	g_free(sr_driver_list(ctx));
 	g_free(ctx);
 
 	return SR_OK;
 }
 
+/**
+ * Enable or disable the dedicated USB event thread.
+ *
+ * By default, USB transfer completions are handled when the session's
+ * main loop iterates, in between datafeed callbacks. With the event
+ * thread enabled, drivers which use the USB streaming engine (e.g.
+ * fx2lafw, dreamsourcelab-dslogic) resubmit their transfers from a
+ * separate thread, so a busy datafeed consumer cannot delay them. The
+ * data is still delivered in the session's context.
+ *
+ * Transfer completions of other USB drivers run on that thread as well
+ * while a stream is active. Only enable the thread when streaming
+ * drivers are the only USB drivers running in this context.
+ *
+ * The setting takes effect on the next acquisition start.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ * @param enable TRUE to enable the event thread, FALSE to disable it.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA libsigrok was built without USB support.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_usb_event_thread_set(struct sr_context *ctx, gboolean enable)
+{
+	if (!ctx)
+		return SR_ERR_ARG;
+
+#ifdef HAVE_LIBUSB_1_0
+	ctx->usb_thread_enabled = enable;
+
+	return SR_OK;
+#else
+	(void)enable;
+
+	return SR_ERR_NA;
+#endif
+}
+
 /** @} */
@@ -519,6 +519,8 @@ SR_PRIV void sr_dev_inst_free(struct sr_dev_inst *sdi)
 	if (sdi->session)
 		sr_session_dev_remove(sdi->session, sdi);
 
+	sr_config_caps_clear(sdi);
+	g_free(sdi->stats);
 	g_free(sdi->vendor);
 	g_free(sdi->model);
 	g_free(sdi->version);
@@ -624,6 +626,7 @@ SR_PRIV void sr_serial_dev_inst_free(struct sr_serial_dev_inst *serial)
 	if (!serial)
 		return;
 
+	serial_port_unlock(serial);
 	g_free(serial->port);
 	g_free(serial->serialcomm);
 	g_free(serial);
@@ -737,8 +740,10 @@ SR_API int sr_dev_open(struct sr_dev_inst *sdi)
 
 	ret = sdi->driver->dev_open(sdi);
 
-	if (ret == SR_OK)
+	if (ret == SR_OK) {
 		sdi->status = SR_ST_ACTIVE;
+		sr_config_caps_update(sdi);
+	}
 
 	return ret;
 }
@@ -774,6 +779,7 @@ SR_API int sr_dev_close(struct sr_dev_inst *sdi)
 	}
 
 	sdi->status = SR_ST_INACTIVE;
+	sr_config_caps_clear(sdi);
 
 	sr_dbg("%s: Closing device instance.", sdi->driver->name);
 
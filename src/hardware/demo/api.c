@@ -47,6 +47,15 @@ static const char *logic_pattern_str[] = {
 	"graycode",
 };
 
+/*
+ * "max-rate" generates data as fast as the session accepts it, which
+ * turns the demo device into a load generator for the datafeed.
+ */
+static const char *test_mode_str[] = {
+	"none",
+	"max-rate",
+};
+
 static const uint32_t scanopts[] = {
 	SR_CONF_NUM_LOGIC_CHANNELS,
 	SR_CONF_NUM_ANALOG_CHANNELS,
@@ -69,6 +78,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TEST_MODE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 };
 
 static const uint32_t devopts_cg_logic[] = {
@@ -78,6 +88,7 @@ static const uint32_t devopts_cg_logic[] = {
 static const uint32_t devopts_cg_analog_group[] = {
 	SR_CONF_AMPLITUDE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_OFFSET | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_OUTPUT_FREQUENCY | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint32_t devopts_cg_analog_channel[] = {
@@ -85,6 +96,7 @@ static const uint32_t devopts_cg_analog_channel[] = {
 	SR_CONF_PATTERN_MODE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_AMPLITUDE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_OFFSET | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_OUTPUT_FREQUENCY | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const int32_t trigger_matches[] = {
@@ -162,13 +174,6 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	/* Analog channels, channel groups and pattern generators. */
 	devc->ch_ag = g_hash_table_new(g_direct_hash, g_direct_equal);
 	if (num_analog_channels > 0) {
-		/*
-		 * Have the waveform for analog patterns pre-generated. It's
-		 * supposed to be periodic, so the generator just needs to
-		 * access the prepared sample data (DDS style).
-		 */
-		demo_generate_analog_pattern(devc);
-
 		pattern = 0;
 		/* An "Analog" channel group with all analog channels in it. */
 		acg = sr_channel_group_new(sdi, "Analog", NULL);
@@ -184,21 +189,17 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 			cg->channels = g_slist_append(NULL, ch);
 
 			/* Every channel gets a generator struct. */
-			ag = g_malloc(sizeof(struct analog_gen));
+			ag = g_malloc0(sizeof(struct analog_gen));
 			ag->ch = ch;
 			ag->mq = SR_MQ_VOLTAGE;
 			ag->mq_flags = SR_MQFLAG_DC;
-			ag->unit = SR_UNIT_VOLT;
 			ag->amplitude = DEFAULT_ANALOG_AMPLITUDE;
 			ag->offset = DEFAULT_ANALOG_OFFSET;
 			sr_analog_init(&ag->packet, &ag->encoding, &ag->meaning, &ag->spec, 2);
 			ag->packet.meaning->channels = cg->channels;
-			ag->packet.meaning->mq = ag->mq;
-			ag->packet.meaning->mqflags = ag->mq_flags;
-			ag->packet.meaning->unit = ag->unit;
+			demo_analog_update_meaning(ag);
 			ag->packet.encoding->digits = DEFAULT_ANALOG_ENCODING_DIGITS;
 			ag->packet.spec->spec_digits = DEFAULT_ANALOG_SPEC_DIGITS;
-			ag->packet.data = devc->analog_patterns[pattern];
 			ag->pattern = pattern;
 			ag->avg_val = 0.0f;
 			ag->num_avgs = 0;
@@ -219,6 +220,7 @@ static void clear_helper(struct dev_context *devc)
 	GHashTableIter iter;
 	void *value;
 
+	demo_free_logic_pattern(devc);
 	demo_free_analog_pattern(devc);
 
 	/* Analog generators. */
@@ -312,9 +314,26 @@ static int config_get(uint32_t key, GVariant **data,
 		ag = g_hash_table_lookup(devc->ch_ag, ch);
 		*data = g_variant_new_double(ag->offset);
 		break;
+	case SR_CONF_OUTPUT_FREQUENCY:
+		if (!cg)
+			return SR_ERR_CHANNEL_GROUP;
+		/* Any channel in the group will do. */
+		ch = cg->channels->data;
+		if (ch->type != SR_CHANNEL_ANALOG)
+			return SR_ERR_ARG;
+		ag = g_hash_table_lookup(devc->ch_ag, ch);
+		if (ag->frequency > 0)
+			*data = g_variant_new_double(ag->frequency);
+		else
+			*data = g_variant_new_double((double)devc->cur_samplerate /
+				ANALOG_SAMPLES_PER_PERIOD);
+		break;
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
+	case SR_CONF_TEST_MODE:
+		*data = g_variant_new_string(test_mode_str[devc->max_rate ? 1 : 0]);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -330,9 +349,10 @@ static int config_set(uint32_t key, GVariant *data,
 	struct sr_channel *ch;
 	GVariant *mq_tuple_child;
 	GSList *l;
-	int logic_pattern, analog_pattern;
+	int logic_pattern, analog_pattern, idx;
 
 	devc = sdi->priv;
+	ag = NULL;
 
 	switch (key) {
 	case SR_CONF_SAMPLERATE:
@@ -370,6 +390,7 @@ static int config_set(uint32_t key, GVariant *data,
 			mq_tuple_child = g_variant_get_child_value(data, 1);
 			ag->mq_flags = g_variant_get_uint64(mq_tuple_child);
 			g_variant_unref(mq_tuple_child);
+			demo_analog_update_meaning(ag);
 		}
 		break;
 	case SR_CONF_PATTERN_MODE:
@@ -392,6 +413,9 @@ static int config_set(uint32_t key, GVariant *data,
 					memset(devc->logic_data, 0x00, LOGIC_BUFSIZE);
 				else if (logic_pattern == PATTERN_ALL_HIGH)
 					memset(devc->logic_data, 0xff, LOGIC_BUFSIZE);
+				/* Replace a running acquisition's tile. */
+				if (devc->logic_tile)
+					demo_generate_logic_pattern(devc);
 			} else if (ch->type == SR_CHANNEL_ANALOG) {
 				if (analog_pattern == -1)
 					return SR_ERR_ARG;
@@ -425,13 +449,35 @@ static int config_set(uint32_t key, GVariant *data,
 			ag->offset = g_variant_get_double(data);
 		}
 		break;
+	case SR_CONF_OUTPUT_FREQUENCY:
+		if (!cg)
+			return SR_ERR_CHANNEL_GROUP;
+		if (g_variant_get_double(data) < 0)
+			return SR_ERR_ARG;
+		for (l = cg->channels; l; l = l->next) {
+			ch = l->data;
+			if (ch->type != SR_CHANNEL_ANALOG)
+				return SR_ERR_ARG;
+			ag = g_hash_table_lookup(devc->ch_ag, ch);
+			ag->frequency = g_variant_get_double(data);
+		}
+		break;
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_TEST_MODE:
+		if ((idx = std_str_idx(data, ARRAY_AND_SIZE(test_mode_str))) < 0)
+			return SR_ERR_ARG;
+		devc->max_rate = idx == 1;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
 
+	/* Re-render the waveforms of a running acquisition. */
+	if (ag && ag->buf)
+		demo_generate_analog_pattern(devc);
+
 	return SR_OK;
 }
 
@@ -451,6 +497,9 @@ static int config_list(uint32_t key, GVariant **data,
 		case SR_CONF_TRIGGER_MATCH:
 			*data = std_gvar_array_i32(ARRAY_AND_SIZE(trigger_matches));
 			break;
+		case SR_CONF_TEST_MODE:
+			*data = g_variant_new_strv(ARRAY_AND_SIZE(test_mode_str));
+			break;
 		default:
 			return SR_ERR_NA;
 		}
@@ -497,6 +546,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	int bitpos;
 	uint8_t mask;
 	struct sr_trigger *trigger;
+	int ret;
 
 	devc = sdi->priv;
 	devc->sent_samples = 0;
@@ -561,8 +611,15 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->first_partial_logic_index,
 		devc->first_partial_logic_mask);
 
-	sr_session_source_add(sdi->session, -1, 0, 100,
+	demo_generate_logic_pattern(devc);
+	demo_generate_analog_pattern(devc);
+
+	/* Without pacing, generate the next chunk as soon as possible. */
+	ret = sr_session_source_add(sdi->session, -1, 0,
+			devc->max_rate ? 0 : 100,
 			demo_prepare_data, (struct sr_dev_inst *)sdi);
+	if (ret != SR_OK)
+		return ret;
 
 	std_session_send_df_header(sdi);
 
@@ -572,6 +629,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	/* We use this timestamp to decide how many more samples to send. */
 	devc->start_us = g_get_monotonic_time();
 	devc->spent_us = 0;
+	devc->timestamp_us = -1;
 	devc->step = 0;
 
 	return SR_OK;
@@ -580,10 +638,19 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	int64_t elapsed_us;
 
 	sr_session_source_remove(sdi->session, -1);
 
 	devc = sdi->priv;
+	if (devc->max_rate) {
+		elapsed_us = MAX(1, g_get_monotonic_time() - devc->start_us);
+		sr_info("Generated %" PRIu64 " samples in %.3f s (%.3f MS/s).",
+			devc->sent_samples, elapsed_us / 1e6,
+			(double)devc->sent_samples / elapsed_us);
+	}
+	demo_free_logic_pattern(devc);
+	demo_free_analog_pattern(devc);
 	if (devc->limit_frames > 0)
 		std_session_send_df_frame_end(sdi);
 
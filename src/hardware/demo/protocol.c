@@ -22,15 +22,12 @@
  */
 
 #include <config.h>
-#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 #include "protocol.h"
 
-#define ANALOG_SAMPLES_PER_PERIOD 20
-
 static const uint8_t pattern_sigrok[] = {
 	0x4c, 0x92, 0x92, 0x92, 0x64, 0x00, 0x00, 0x00,
 	0x82, 0xfe, 0xfe, 0x82, 0x00, 0x00, 0x00, 0x00,
@@ -173,92 +170,253 @@ static const uint8_t pattern_squid[128][128 / 8] = {
 	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, },
 };
 
-SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc)
+/* xorshift64*, good enough for test data and much cheaper than rand(). */
+static uint64_t prng_next(uint64_t *state)
 {
-	double t, frequency;
-	float amplitude, offset;
-	struct analog_pattern *pattern;
-	unsigned int num_samples, i;
-	float value;
-	int last_end;
-
-	num_samples = ANALOG_BUFSIZE / sizeof(float);
-	frequency = (double) devc->cur_samplerate / ANALOG_SAMPLES_PER_PERIOD;
-	amplitude = DEFAULT_ANALOG_AMPLITUDE;
-	offset = DEFAULT_ANALOG_OFFSET;
+	uint64_t x;
 
-	/*
-	 * FIXME: We actually need only one period. A ringbuffer would be
-	 * useful here.
-	 * Make sure the number of samples we put out is an integer
-	 * multiple of our period size.
-	 */
+	x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+static const struct {
+	enum sr_mq mq;
+	enum sr_unit unit;
+} analog_mq_units[] = {
+	{ SR_MQ_VOLTAGE, SR_UNIT_VOLT },
+	{ SR_MQ_CURRENT, SR_UNIT_AMPERE },
+	{ SR_MQ_RESISTANCE, SR_UNIT_OHM },
+	{ SR_MQ_CAPACITANCE, SR_UNIT_FARAD },
+	{ SR_MQ_TEMPERATURE, SR_UNIT_CELSIUS },
+	{ SR_MQ_FREQUENCY, SR_UNIT_HERTZ },
+	{ SR_MQ_DUTY_CYCLE, SR_UNIT_PERCENTAGE },
+	{ SR_MQ_CONTINUITY, SR_UNIT_OHM },
+	{ SR_MQ_PULSE_WIDTH, SR_UNIT_PERCENTAGE },
+	{ SR_MQ_CONDUCTANCE, SR_UNIT_SIEMENS },
+	{ SR_MQ_POWER, SR_UNIT_WATT },
+	{ SR_MQ_GAIN, SR_UNIT_UNITLESS },
+	{ SR_MQ_SOUND_PRESSURE_LEVEL, SR_UNIT_DECIBEL_SPL },
+	{ SR_MQ_CARBON_MONOXIDE, SR_UNIT_CONCENTRATION },
+	{ SR_MQ_RELATIVE_HUMIDITY, SR_UNIT_HUMIDITY_293K },
+	{ SR_MQ_TIME, SR_UNIT_SECOND },
+	{ SR_MQ_WIND_SPEED, SR_UNIT_METER_SECOND },
+	{ SR_MQ_PRESSURE, SR_UNIT_HECTOPASCAL },
+	{ SR_MQ_PARALLEL_INDUCTANCE, SR_UNIT_HENRY },
+	{ SR_MQ_PARALLEL_CAPACITANCE, SR_UNIT_FARAD },
+	{ SR_MQ_PARALLEL_RESISTANCE, SR_UNIT_OHM },
+	{ SR_MQ_SERIES_INDUCTANCE, SR_UNIT_HENRY },
+	{ SR_MQ_SERIES_CAPACITANCE, SR_UNIT_FARAD },
+	{ SR_MQ_SERIES_RESISTANCE, SR_UNIT_OHM },
+	{ SR_MQ_DISSIPATION_FACTOR, SR_UNIT_UNITLESS },
+	{ SR_MQ_QUALITY_FACTOR, SR_UNIT_UNITLESS },
+	{ SR_MQ_PHASE_ANGLE, SR_UNIT_DEGREE },
+	{ SR_MQ_DIFFERENCE, SR_UNIT_UNITLESS },
+	{ SR_MQ_COUNT, SR_UNIT_PIECE },
+	{ SR_MQ_POWER_FACTOR, SR_UNIT_UNITLESS },
+	{ SR_MQ_APPARENT_POWER, SR_UNIT_VOLT_AMPERE },
+	{ SR_MQ_MASS, SR_UNIT_GRAM },
+	{ SR_MQ_HARMONIC_RATIO, SR_UNIT_UNITLESS },
+};
 
-	/* PATTERN_SQUARE: */
-	sr_dbg("Generating %s pattern.", analog_pattern_str[PATTERN_SQUARE]);
-	pattern = g_malloc(sizeof(struct analog_pattern));
-	value = amplitude;
-	last_end = 0;
-	for (i = 0; i < num_samples; i++) {
-		if (i % 5 == 0)
-			value = -value;
-		if (i % 10 == 0)
-			last_end = i;
-		pattern->data[i] = value + offset;
+/*
+ * Update the packet's meaning after the measured quantity changed. The
+ * packet is sent as is, so this is all the per channel setup there is.
+ */
+SR_PRIV void demo_analog_update_meaning(struct analog_gen *ag)
+{
+	unsigned int i;
+
+	ag->unit = SR_UNIT_UNITLESS;
+	for (i = 0; i < ARRAY_SIZE(analog_mq_units); i++) {
+		if (analog_mq_units[i].mq == ag->mq) {
+			ag->unit = analog_mq_units[i].unit;
+			break;
+		}
 	}
-	pattern->num_samples = last_end;
-	devc->analog_patterns[PATTERN_SQUARE] = pattern;
-
-	/* Readjusting num_samples for all other patterns. */
-	while (num_samples % ANALOG_SAMPLES_PER_PERIOD != 0)
-		num_samples--;
-
-	/* PATTERN_SINE: */
-	sr_dbg("Generating %s pattern.", analog_pattern_str[PATTERN_SINE]);
-	pattern = g_malloc(sizeof(struct analog_pattern));
-	for (i = 0; i < num_samples; i++) {
-		t = (double) i / (double) devc->cur_samplerate;
-		pattern->data[i] = sin(2 * G_PI * frequency * t) * amplitude + offset;
+
+	ag->packet.meaning->mq = ag->mq;
+	ag->packet.meaning->mqflags = ag->mq_flags;
+	ag->packet.meaning->unit = ag->unit;
+}
+
+/*
+ * Ideal waveform with amplitude 1 at phase x in [0, 1). The square wave
+ * starts low, all other waveforms start at zero and rise.
+ */
+static double analog_shape(enum analog_pattern_type pattern, double x)
+{
+	switch (pattern) {
+	case PATTERN_SQUARE:
+		return x < 0.5 ? -1 : 1;
+	case PATTERN_SINE:
+		return sin(2 * G_PI * x);
+	case PATTERN_TRIANGLE:
+		return (2 / G_PI) * asin(sin(2 * G_PI * x));
+	case PATTERN_SAWTOOTH:
+		return 2 * (x - floor(0.5 + x));
+	default:
+		return 0;
+	}
+}
+
+/* Coefficient of the k-th sine harmonic of analog_shape()'s waveform. */
+static double analog_harmonic(enum analog_pattern_type pattern, unsigned int k)
+{
+	switch (pattern) {
+	case PATTERN_SQUARE:
+		return (k & 1) ? -4 / (G_PI * k) : 0;
+	case PATTERN_SINE:
+		return k == 1 ? 1 : 0;
+	case PATTERN_TRIANGLE:
+		if (!(k & 1))
+			return 0;
+		return ((k & 2) ? -8 : 8) / (G_PI * G_PI * k * k);
+	case PATTERN_SAWTOOTH:
+		return ((k & 1) ? 2 : -2) / (G_PI * k);
+	default:
+		return 0;
 	}
-	pattern->num_samples = last_end;
-	devc->analog_patterns[PATTERN_SINE] = pattern;
-
-	/* PATTERN_TRIANGLE: */
-	sr_dbg("Generating %s pattern.", analog_pattern_str[PATTERN_TRIANGLE]);
-	pattern = g_malloc(sizeof(struct analog_pattern));
-	for (i = 0; i < num_samples; i++) {
-		t = (double) i / (double) devc->cur_samplerate;
-		pattern->data[i] = (2 / G_PI) * asin(sin(2 * G_PI * frequency * t)) *
-			amplitude + offset;
+}
+
+/*
+ * Render one period which is an integer number of samples. Sampling the
+ * ideal waveform is exact here, aliased harmonics fall onto harmonics.
+ * The period is repeated so that a chunk can be read from any start
+ * position within the first period without wrapping.
+ */
+static void analog_render_ring(struct analog_gen *ag, size_t period)
+{
+	size_t i;
+
+	ag->period = period;
+	ag->table_len = period * (1 + (ANALOG_CHUNK_SAMPLES + period - 1) / period);
+	ag->table = g_malloc(ag->table_len * sizeof(float));
+	for (i = 0; i < period; i++) {
+		ag->table[i] = analog_shape(ag->pattern, (double)i / period) *
+			ag->amplitude + ag->offset;
+	}
+	for (; i < ag->table_len; i += period)
+		memcpy(&ag->table[i], ag->table, period * sizeof(float));
+	ag->ring_pos = 0;
+}
+
+/*
+ * Render one period into a table of ANALOG_TABLE_SIZE entries (plus a
+ * guard entry for the interpolation), for phase accumulator indexing.
+ * Waveforms with edges are synthesized from the harmonics below the
+ * Nyquist frequency only, to not alias when the period is not an
+ * integer number of samples.
+ */
+static void analog_render_table(struct analog_gen *ag, double ratio)
+{
+	const size_t mask = ANALOG_TABLE_SIZE - 1;
+	float *sine;
+	double *sum, c, x;
+	unsigned int harmonics, k;
+	size_t i;
+
+	ag->period = 0;
+	ag->table_len = ANALOG_TABLE_SIZE;
+	ag->table = g_malloc((ag->table_len + 1) * sizeof(float));
+	ag->phase = 0;
+	ag->phase_inc = llround(ratio * ANALOG_TABLE_SIZE * 4294967296.0);
+
+	harmonics = MIN(0.5 / ratio, ANALOG_TABLE_SIZE / 2);
+	if (ag->pattern == PATTERN_SINE || harmonics >= ANALOG_TABLE_SIZE / 2) {
+		for (i = 0; i < ag->table_len; i++) {
+			ag->table[i] = analog_shape(ag->pattern,
+				(double)i / ag->table_len) * ag->amplitude + ag->offset;
+		}
+	} else {
+		sine = g_malloc(ANALOG_TABLE_SIZE * sizeof(float));
+		for (i = 0; i < ANALOG_TABLE_SIZE; i++)
+			sine[i] = sin(2 * G_PI * i / ANALOG_TABLE_SIZE);
+		sum = g_malloc0(ANALOG_TABLE_SIZE * sizeof(double));
+		for (k = 1; k <= harmonics; k++) {
+			if (!(c = analog_harmonic(ag->pattern, k)))
+				continue;
+			/* Lanczos sigma factor, tames the Gibbs ringing. */
+			x = G_PI * k / (harmonics + 1);
+			c *= sin(x) / x;
+			for (i = 0; i < ANALOG_TABLE_SIZE; i++)
+				sum[i] += c * sine[(k * i) & mask];
+		}
+		for (i = 0; i < ANALOG_TABLE_SIZE; i++)
+			ag->table[i] = sum[i] * ag->amplitude + ag->offset;
+		g_free(sum);
+		g_free(sine);
 	}
-	pattern->num_samples = last_end;
-	devc->analog_patterns[PATTERN_TRIANGLE] = pattern;
-
-	/* PATTERN_SAWTOOTH: */
-	sr_dbg("Generating %s pattern.", analog_pattern_str[PATTERN_SAWTOOTH]);
-	pattern = g_malloc(sizeof(struct analog_pattern));
-	for (i = 0; i < num_samples; i++) {
-		t = (double) i / (double) devc->cur_samplerate;
-		pattern->data[i] = 2 * ((t * frequency) - floor(0.5f + t * frequency)) *
-			amplitude + offset;
+	ag->table[ag->table_len] = ag->table[0];
+}
+
+/*
+ * Prepare the generators of all enabled analog channels for the
+ * acquisition's samplerate, amplitude, offset and signal frequency.
+ * Each generator gets a table of a single period, after that no more
+ * memory gets allocated and no trigonometry is done per sample.
+ */
+SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc)
+{
+	struct analog_gen *ag;
+	GHashTableIter iter;
+	void *value;
+	double rate, frequency, period;
+
+	demo_free_analog_pattern(devc);
+
+	rate = devc->cur_samplerate;
+	g_hash_table_iter_init(&iter, devc->ch_ag);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		ag = value;
+		if (!ag->ch || !ag->ch->enabled)
+			continue;
+
+		ag->buf = g_malloc(ANALOG_CHUNK_SAMPLES * sizeof(float));
+		ag->prng = PRNG_SEED ^ ((uint64_t)(ag->ch->index + 1) << 32);
+		if (ag->pattern == PATTERN_ANALOG_RANDOM)
+			continue;
+
+		frequency = ag->frequency;
+		if (frequency <= 0)
+			frequency = rate / ANALOG_SAMPLES_PER_PERIOD;
+		if (frequency > rate / 2) {
+			sr_warn("Channel %s: %g Hz is above the Nyquist frequency, "
+				"using %g Hz.", ag->ch->name, frequency, rate / 2);
+			frequency = rate / 2;
+		}
+
+		period = rate / frequency;
+		if (period <= ANALOG_RING_MAXPERIOD &&
+				fabs(period - round(period)) < 1e-9 * period)
+			analog_render_ring(ag, round(period));
+		else
+			analog_render_table(ag, frequency / rate);
+		sr_dbg("Channel %s: %s at %g Hz, %s table of %zu samples.",
+			ag->ch->name, analog_pattern_str[ag->pattern], frequency,
+			ag->period ? "ring" : "phase", ag->table_len);
 	}
-	pattern->num_samples = last_end;
-	devc->analog_patterns[PATTERN_SAWTOOTH] = pattern;
-
-	/* PATTERN_ANALOG_RANDOM */
-	/* Data not filled here, will be generated in send_analog_packet(). */
-	pattern = g_malloc(sizeof(struct analog_pattern));
-	pattern->num_samples = last_end;
-	devc->analog_patterns[PATTERN_ANALOG_RANDOM] = pattern;
 }
 
 SR_PRIV void demo_free_analog_pattern(struct dev_context *devc)
 {
-	g_free(devc->analog_patterns[PATTERN_SQUARE]);
-	g_free(devc->analog_patterns[PATTERN_SINE]);
-	g_free(devc->analog_patterns[PATTERN_TRIANGLE]);
-	g_free(devc->analog_patterns[PATTERN_SAWTOOTH]);
-	g_free(devc->analog_patterns[PATTERN_ANALOG_RANDOM]);
+	struct analog_gen *ag;
+	GHashTableIter iter;
+	void *value;
+
+	g_hash_table_iter_init(&iter, devc->ch_ag);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		ag = value;
+		g_free(ag->table);
+		ag->table = NULL;
+		ag->table_len = 0;
+		g_free(ag->buf);
+		ag->buf = NULL;
+	}
 }
 
 static uint64_t encode_number_to_gray(uint64_t nr)
@@ -274,45 +432,46 @@ static void set_logic_data(uint64_t bits, uint8_t *data, size_t len)
 	}
 }
 
-static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
+static void logic_pattern_fill(struct dev_context *devc,
+		uint8_t *data, uint64_t size)
 {
-	struct dev_context *devc;
-	uint64_t i, j;
+	uint64_t i, j, rnd;
 	uint8_t pat;
 	uint8_t *sample;
 	const uint8_t *image_col;
 	size_t col_count, col_height;
 	uint64_t gray;
 
-	devc = sdi->priv;
-
 	switch (devc->logic_pattern) {
 	case PATTERN_SIGROK:
-		memset(devc->logic_data, 0x00, size);
+		memset(data, 0x00, size);
 		for (i = 0; i < size; i += devc->logic_unitsize) {
 			for (j = 0; j < devc->logic_unitsize; j++) {
 				pat = pattern_sigrok[(devc->step + j) % sizeof(pattern_sigrok)] >> 1;
-				devc->logic_data[i + j] = ~pat;
+				data[i + j] = ~pat;
 			}
 			devc->step++;
 		}
 		break;
 	case PATTERN_RANDOM:
-		for (i = 0; i < size; i++)
-			devc->logic_data[i] = (uint8_t)(rand() & 0xff);
+		for (i = 0; i + sizeof(rnd) <= size; i += sizeof(rnd)) {
+			rnd = prng_next(&devc->logic_prng);
+			memcpy(&data[i], &rnd, sizeof(rnd));
+		}
+		if (i < size) {
+			rnd = prng_next(&devc->logic_prng);
+			memcpy(&data[i], &rnd, size - i);
+		}
 		break;
 	case PATTERN_INC:
-		for (i = 0; i < size; i++) {
-			for (j = 0; j < devc->logic_unitsize; j++)
-				devc->logic_data[i + j] = devc->step;
-			devc->step++;
-		}
+		for (i = 0; i < size; i++)
+			data[i] = devc->step++;
 		break;
 	case PATTERN_WALKING_ONE:
 		/* j contains the value of the highest bit */
 		j = 1 << (devc->num_logic_channels - 1);
 		for (i = 0; i < size; i++) {
-			devc->logic_data[i] = devc->step;
+			data[i] = devc->step;
 			if (devc->step == 0)
 				devc->step = 1;
 			else
@@ -327,7 +486,7 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 		/* j contains the value of the highest bit */
 		j = 1 << (devc->num_logic_channels - 1);
 		for (i = 0; i < size; i++) {
-			devc->logic_data[i] = ~devc->step;
+			data[i] = ~devc->step;
 			if (devc->step == 0)
 				devc->step = 1;
 			else
@@ -342,11 +501,11 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 		/* These were set when the pattern mode was selected. */
 		break;
 	case PATTERN_SQUID:
-		memset(devc->logic_data, 0x00, size);
+		memset(data, 0x00, size);
 		col_count = ARRAY_SIZE(pattern_squid);
 		col_height = ARRAY_SIZE(pattern_squid[0]);
 		for (i = 0; i < size; i += devc->logic_unitsize) {
-			sample = &devc->logic_data[i];
+			sample = &data[i];
 			image_col = pattern_squid[devc->step];
 			for (j = 0; j < devc->logic_unitsize; j++) {
 				pat = image_col[j % col_height];
@@ -362,7 +521,7 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 			devc->step &= devc->all_logic_channels_mask;
 			gray = encode_number_to_gray(devc->step);
 			gray &= devc->all_logic_channels_mask;
-			set_logic_data(gray, &devc->logic_data[i], devc->logic_unitsize);
+			set_logic_data(gray, &data[i], devc->logic_unitsize);
 		}
 		break;
 	default:
@@ -371,6 +530,97 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 	}
 }
 
+/*
+ * Returns the period in bytes after which the generated data repeats,
+ * or 0 for patterns which are not periodic (or need no generation).
+ */
+static size_t logic_pattern_period(const struct dev_context *devc)
+{
+	switch (devc->logic_pattern) {
+	case PATTERN_SIGROK:
+		return sizeof(pattern_sigrok) * devc->logic_unitsize;
+	case PATTERN_INC:
+		return 256;
+	case PATTERN_WALKING_ONE:
+	case PATTERN_WALKING_ZERO:
+		if (devc->num_logic_channels >= 32)
+			return 0;
+		return devc->num_logic_channels + 1;
+	case PATTERN_SQUID:
+		return ARRAY_SIZE(pattern_squid) * devc->logic_unitsize;
+	case PATTERN_GRAYCODE:
+		if (devc->num_logic_channels >= 32)
+			return 0;
+		return (devc->all_logic_channels_mask + 1) * devc->logic_unitsize;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Precompute a "tile" of a periodic logic pattern, which then gets
+ * copied into the datafeed buffers. The tile holds as many complete
+ * periods as are needed to cover one buffer, so that filling a buffer
+ * takes at most two memcpy() calls. Must be called with the pattern's
+ * initial state, as the tile replaces the sample by sample generator.
+ */
+SR_PRIV void demo_generate_logic_pattern(struct dev_context *devc)
+{
+	size_t period;
+
+	demo_free_logic_pattern(devc);
+	devc->logic_prng = PRNG_SEED;
+
+	if (devc->num_logic_channels <= 0)
+		return;
+	period = logic_pattern_period(devc);
+	if (!period || period > LOGIC_TILE_MAXSIZE)
+		return;
+
+	devc->logic_tile_len = period * ((LOGIC_BUFSIZE + period - 1) / period);
+	devc->logic_tile = g_malloc(devc->logic_tile_len);
+	logic_pattern_fill(devc, devc->logic_tile, devc->logic_tile_len);
+	devc->logic_tile_pos = 0;
+	devc->step = 0;
+	sr_dbg("Precomputed %zu bytes of logic pattern (period %zu).",
+		devc->logic_tile_len, period);
+}
+
+SR_PRIV void demo_free_logic_pattern(struct dev_context *devc)
+{
+	g_free(devc->logic_tile);
+	devc->logic_tile = NULL;
+	devc->logic_tile_len = 0;
+	devc->logic_tile_pos = 0;
+}
+
+static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
+{
+	struct dev_context *devc;
+	uint8_t *data;
+	size_t pos, len;
+
+	devc = sdi->priv;
+
+	if (!devc->logic_tile) {
+		logic_pattern_fill(devc, devc->logic_data, size);
+		return;
+	}
+
+	data = devc->logic_data;
+	pos = devc->logic_tile_pos;
+	while (size) {
+		len = MIN(size, devc->logic_tile_len - pos);
+		memcpy(data, devc->logic_tile + pos, len);
+		data += len;
+		size -= len;
+		pos += len;
+		if (pos == devc->logic_tile_len)
+			pos = 0;
+	}
+	devc->logic_tile_pos = pos;
+}
+
 /*
  * Fixup a memory image of generated logic data before it gets sent to
  * the session's datafeed. Mask out content from disabled channels.
@@ -399,18 +649,55 @@ static void logic_fixup_feed(struct dev_context *devc,
 	}
 }
 
+/*
+ * Produce the generator's next count samples (at most a chunk). The
+ * returned memory is only valid until the next call.
+ */
+static const float *analog_generator(struct analog_gen *ag, size_t count)
+{
+	const float *table;
+	float amplitude, offset, frac;
+	uint64_t phase, mask;
+	size_t i, idx;
+
+	if (ag->pattern == PATTERN_ANALOG_RANDOM) {
+		/* Uniformly distributed in [-amplitude, amplitude). */
+		amplitude = ag->amplitude / (1 << 23);
+		offset = ag->offset - DEFAULT_ANALOG_OFFSET - ag->amplitude;
+		for (i = 0; i < count; i++)
+			ag->buf[i] = (prng_next(&ag->prng) >> 40) * amplitude + offset;
+		return ag->buf;
+	}
+
+	if (ag->period) {
+		table = ag->table + ag->ring_pos;
+		ag->ring_pos = (ag->ring_pos + count) % ag->period;
+		return table;
+	}
+
+	table = ag->table;
+	phase = ag->phase;
+	mask = ((uint64_t)ag->table_len << 32) - 1;
+	for (i = 0; i < count; i++) {
+		idx = phase >> 32;
+		frac = (uint32_t)phase * (1.0f / 4294967296.0f);
+		ag->buf[i] = table[idx] + (table[idx + 1] - table[idx]) * frac;
+		phase = (phase + ag->phase_inc) & mask;
+	}
+	ag->phase = phase;
+
+	return ag->buf;
+}
+
 static void send_analog_packet(struct analog_gen *ag,
 		struct sr_dev_inst *sdi, uint64_t *analog_sent,
-		uint64_t analog_pos, uint64_t analog_todo)
+		uint64_t analog_todo)
 {
 	struct sr_datafeed_packet packet;
 	struct dev_context *devc;
-	struct analog_pattern *pattern;
-	uint64_t sending_now, to_avg;
-	int ag_pattern_pos;
+	const float *data;
+	uint64_t sending_now;
 	unsigned int i;
-	float amplitude, offset, value;
-	float *data;
 
 	if (!ag->ch || !ag->ch->enabled)
 		return;
@@ -419,157 +706,38 @@ static void send_analog_packet(struct analog_gen *ag,
 	packet.type = SR_DF_ANALOG;
 	packet.payload = &ag->packet;
 
-	pattern = devc->analog_patterns[ag->pattern];
-
-	ag->packet.meaning->channels = g_slist_append(NULL, ag->ch);
-	ag->packet.meaning->mq = ag->mq;
-	ag->packet.meaning->mqflags = ag->mq_flags;
+	sending_now = MIN(analog_todo, ANALOG_CHUNK_SAMPLES);
+	if (devc->avg && devc->avg_samples > 0)
+		sending_now = MIN(sending_now, devc->avg_samples - ag->num_avgs);
+	data = analog_generator(ag, sending_now);
 
-	/* Set a unit for the given quantity. */
-	if (ag->mq == SR_MQ_VOLTAGE)
-		ag->packet.meaning->unit = SR_UNIT_VOLT;
-	else if (ag->mq == SR_MQ_CURRENT)
-		ag->packet.meaning->unit = SR_UNIT_AMPERE;
-	else if (ag->mq == SR_MQ_RESISTANCE)
-		ag->packet.meaning->unit = SR_UNIT_OHM;
-	else if (ag->mq == SR_MQ_CAPACITANCE)
-		ag->packet.meaning->unit = SR_UNIT_FARAD;
-	else if (ag->mq == SR_MQ_TEMPERATURE)
-		ag->packet.meaning->unit = SR_UNIT_CELSIUS;
-	else if (ag->mq == SR_MQ_FREQUENCY)
-		ag->packet.meaning->unit = SR_UNIT_HERTZ;
-	else if (ag->mq == SR_MQ_DUTY_CYCLE)
-		ag->packet.meaning->unit = SR_UNIT_PERCENTAGE;
-	else if (ag->mq == SR_MQ_CONTINUITY)
-		ag->packet.meaning->unit = SR_UNIT_OHM;
-	else if (ag->mq == SR_MQ_PULSE_WIDTH)
-		ag->packet.meaning->unit = SR_UNIT_PERCENTAGE;
-	else if (ag->mq == SR_MQ_CONDUCTANCE)
-		ag->packet.meaning->unit = SR_UNIT_SIEMENS;
-	else if (ag->mq == SR_MQ_POWER)
-		ag->packet.meaning->unit = SR_UNIT_WATT;
-	else if (ag->mq == SR_MQ_GAIN)
-		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
-	else if (ag->mq == SR_MQ_SOUND_PRESSURE_LEVEL)
-		ag->packet.meaning->unit = SR_UNIT_DECIBEL_SPL;
-	else if (ag->mq == SR_MQ_CARBON_MONOXIDE)
-		ag->packet.meaning->unit = SR_UNIT_CONCENTRATION;
-	else if (ag->mq == SR_MQ_RELATIVE_HUMIDITY)
-		ag->packet.meaning->unit = SR_UNIT_HUMIDITY_293K;
-	else if (ag->mq == SR_MQ_TIME)
-		ag->packet.meaning->unit = SR_UNIT_SECOND;
-	else if (ag->mq == SR_MQ_WIND_SPEED)
-		ag->packet.meaning->unit = SR_UNIT_METER_SECOND;
-	else if (ag->mq == SR_MQ_PRESSURE)
-		ag->packet.meaning->unit = SR_UNIT_HECTOPASCAL;
-	else if (ag->mq == SR_MQ_PARALLEL_INDUCTANCE)
-		ag->packet.meaning->unit = SR_UNIT_HENRY;
-	else if (ag->mq == SR_MQ_PARALLEL_CAPACITANCE)
-		ag->packet.meaning->unit = SR_UNIT_FARAD;
-	else if (ag->mq == SR_MQ_PARALLEL_RESISTANCE)
-		ag->packet.meaning->unit = SR_UNIT_OHM;
-	else if (ag->mq == SR_MQ_SERIES_INDUCTANCE)
-		ag->packet.meaning->unit = SR_UNIT_HENRY;
-	else if (ag->mq == SR_MQ_SERIES_CAPACITANCE)
-		ag->packet.meaning->unit = SR_UNIT_FARAD;
-	else if (ag->mq == SR_MQ_SERIES_RESISTANCE)
-		ag->packet.meaning->unit = SR_UNIT_OHM;
-	else if (ag->mq == SR_MQ_DISSIPATION_FACTOR)
-		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
-	else if (ag->mq == SR_MQ_QUALITY_FACTOR)
-		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
-	else if (ag->mq == SR_MQ_PHASE_ANGLE)
-		ag->packet.meaning->unit = SR_UNIT_DEGREE;
-	else if (ag->mq == SR_MQ_DIFFERENCE)
-		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
-	else if (ag->mq == SR_MQ_COUNT)
-		ag->packet.meaning->unit = SR_UNIT_PIECE;
-	else if (ag->mq == SR_MQ_POWER_FACTOR)
-		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
-	else if (ag->mq == SR_MQ_APPARENT_POWER)
-		ag->packet.meaning->unit = SR_UNIT_VOLT_AMPERE;
-	else if (ag->mq == SR_MQ_MASS)
-		ag->packet.meaning->unit = SR_UNIT_GRAM;
-	else if (ag->mq == SR_MQ_HARMONIC_RATIO)
-		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
-	else
-		ag->packet.meaning->unit = SR_UNIT_UNITLESS;
+	/* Whichever channel group gets there first. */
+	*analog_sent = MAX(*analog_sent, sending_now);
 
 	if (!devc->avg) {
-		ag_pattern_pos = analog_pos % pattern->num_samples;
-		sending_now = MIN(analog_todo, pattern->num_samples - ag_pattern_pos);
-		if (ag->amplitude != DEFAULT_ANALOG_AMPLITUDE ||
-			ag->offset != DEFAULT_ANALOG_OFFSET ||
-			ag->pattern == PATTERN_ANALOG_RANDOM) {
-			/*
-			 * Amplitude or offset changed (or we are generating
-			 * random data), modify each sample.
-			 */
-			if (ag->pattern == PATTERN_ANALOG_RANDOM) {
-				amplitude = ag->amplitude / 500.0;
-				offset = ag->offset - DEFAULT_ANALOG_OFFSET - ag->amplitude;
-			} else {
-				amplitude = ag->amplitude / DEFAULT_ANALOG_AMPLITUDE;
-				offset = ag->offset - DEFAULT_ANALOG_OFFSET;
-			}
-			data = ag->packet.data;
-			for (i = 0; i < sending_now; i++) {
-				if (ag->pattern == PATTERN_ANALOG_RANDOM)
-					data[i] = (rand() % 1000) * amplitude + offset;
-				else
-					data[i] = pattern->data[ag_pattern_pos + i] * amplitude + offset;
-			}
-		} else {
-			/* Amplitude and offset unchanged, use the fast way. */
-			ag->packet.data = pattern->data + ag_pattern_pos;
-		}
+		ag->packet.data = (void *)data;
 		ag->packet.num_samples = sending_now;
 		sr_session_send(sdi, &packet);
+		return;
+	}
 
-		/* Whichever channel group gets there first. */
-		*analog_sent = MAX(*analog_sent, sending_now);
-	} else {
-		ag_pattern_pos = analog_pos % pattern->num_samples;
-		to_avg = MIN(analog_todo, pattern->num_samples - ag_pattern_pos);
-		if (ag->pattern == PATTERN_ANALOG_RANDOM) {
-			amplitude = ag->amplitude / 500.0;
-			offset = ag->offset - DEFAULT_ANALOG_OFFSET - ag->amplitude;
-		} else {
-			amplitude = ag->amplitude / DEFAULT_ANALOG_AMPLITUDE;
-			offset = ag->offset - DEFAULT_ANALOG_OFFSET;
-		}
-
-		for (i = 0; i < to_avg; i++) {
-			if (ag->pattern == PATTERN_ANALOG_RANDOM)
-				value = (rand() % 1000) * amplitude + offset;
-			else
-				value = *(pattern->data + ag_pattern_pos + i) * amplitude + offset;
-			ag->avg_val = (ag->avg_val + value) / 2;
-			ag->num_avgs++;
-			/* Time to send averaged data? */
-			if ((devc->avg_samples > 0) && (ag->num_avgs >= devc->avg_samples))
-				goto do_send;
-		}
-
-		if (devc->avg_samples == 0) {
-			/*
-			 * We're averaging all the samples, so wait with
-			 * sending until the very end.
-			 */
-			*analog_sent = ag->num_avgs;
-			return;
-		}
+	for (i = 0; i < sending_now; i++)
+		ag->avg_val = (ag->avg_val + data[i]) / 2;
+	ag->num_avgs += sending_now;
 
-do_send:
-		ag->packet.data = &ag->avg_val;
-		ag->packet.num_samples = 1;
+	/*
+	 * When averaging all the samples, wait with sending until
+	 * the very end.
+	 */
+	if (devc->avg_samples == 0 || ag->num_avgs < devc->avg_samples)
+		return;
 
-		sr_session_send(sdi, &packet);
-		*analog_sent = ag->num_avgs;
+	ag->packet.data = &ag->avg_val;
+	ag->packet.num_samples = 1;
+	sr_session_send(sdi, &packet);
 
-		ag->num_avgs = 0;
-		ag->avg_val = 0.0f;
-	}
+	ag->num_avgs = 0;
+	ag->avg_val = 0.0f;
 }
 
 /* Callback handling data */
@@ -610,8 +778,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		todo_us = MAX(0, elapsed_us - devc->spent_us);
 
 	/* How many samples are outstanding since the last round? */
-	samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
-			/ G_USEC_PER_SEC;
+	if (devc->max_rate)
+		samples_todo = MAX_RATE_CHUNK_SAMPLES;
+	else
+		samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
+				/ G_USEC_PER_SEC;
 
 	if (devc->limit_samples > 0) {
 		if (devc->limit_samples < devc->sent_samples)
@@ -631,6 +802,20 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			SAMPLES_PER_FRAME - devc->sent_frame_samples);
 	}
 
+	/*
+	 * Samples are taken by the host's clock. Say when, like devices
+	 * with a clock of their own do: at the start, at each frame, and
+	 * once per interval. Not when a trigger or averaging drops some
+	 * of the samples, their numbers would not be what was sent.
+	 */
+	if (!devc->stl && !devc->avg && (devc->timestamp_us < 0 ||
+			(devc->limit_frames && !devc->sent_frame_samples) ||
+			devc->spent_us - devc->timestamp_us >= TIMESTAMP_INTERVAL_US)) {
+		std_session_send_df_timestamp(sdi, devc->sent_samples,
+			devc->spent_us * 1000);
+		devc->timestamp_us = devc->spent_us;
+	}
+
 	/* Calculate the actual time covered by this run back from the sample
 	 * count, rounded towards zero. This avoids getting stuck on a too-low
 	 * time delta with no samples being sent due to round-off.
@@ -701,7 +886,6 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			g_hash_table_iter_init(&iter, devc->ch_ag);
 			while (g_hash_table_iter_next(&iter, NULL, &value)) {
 				send_analog_packet(value, sdi, &analog_sent,
-						devc->sent_samples + analog_done,
 						samples_todo - analog_done);
 			}
 			analog_done += analog_sent;
@@ -711,7 +895,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	uint64_t min = MIN(logic_done, analog_done);
 	devc->sent_samples += min;
 	devc->sent_frame_samples += min;
-	devc->spent_us += todo_us;
+	/* Without pacing, time limits apply to the wall clock. */
+	if (devc->max_rate)
+		devc->spent_us = elapsed_us;
+	else
+		devc->spent_us += todo_us;
 
 	if (devc->limit_frames && devc->sent_frame_samples >= SAMPLES_PER_FRAME) {
 		std_session_send_df_frame_end(sdi);
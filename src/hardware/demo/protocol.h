@@ -32,11 +32,25 @@
 
 /* The size in bytes of chunks to send through the session bus. */
 #define LOGIC_BUFSIZE			4096
-/* Size of the analog pattern space per channel. */
-#define ANALOG_BUFSIZE			4096
+/* Number of samples per analog packet. */
+#define ANALOG_CHUNK_SAMPLES		1024
+/* Table size for signal periods of a fractional number of samples. */
+#define ANALOG_TABLE_SIZE		1024
+/* Longest signal period (in samples) that is rendered sample exact. */
+#define ANALOG_RING_MAXPERIOD		16384
+/* Signal period in samples unless a frequency is set. */
+#define ANALOG_SAMPLES_PER_PERIOD	20
 /* This is a development feature: it starts a new frame every n samples. */
 #define SAMPLES_PER_FRAME		1000UL
 #define DEFAULT_LIMIT_FRAMES		0
+/* Samples generated per dispatch when not paced by the samplerate. */
+#define MAX_RATE_CHUNK_SAMPLES		(256 * 1024UL)
+
+#define TIMESTAMP_INTERVAL_US		(1000 * 1000)
+/* Longest logic pattern period (in bytes) which gets precomputed. */
+#define LOGIC_TILE_MAXSIZE		(256 * 1024UL)
+/* Seed of the PRNGs, fixed so that runs are reproducible. */
+#define PRNG_SEED			0x9e3779b97f4a7c15ULL
 
 #define DEFAULT_ANALOG_ENCODING_DIGITS	4
 #define DEFAULT_ANALOG_SPEC_DIGITS		4
@@ -106,13 +120,10 @@ static const char *analog_pattern_str[] = {
 	"random",
 };
 
-struct analog_pattern {
-	float data[ANALOG_BUFSIZE];
-	unsigned int num_samples;
-};
-
 struct dev_context {
 	uint64_t cur_samplerate;
+	/* Generate as fast as the session accepts, ignore the samplerate. */
+	gboolean max_rate;
 	uint64_t limit_samples;
 	uint64_t limit_msec;
 	uint64_t limit_frames;
@@ -120,6 +131,8 @@ struct dev_context {
 	uint64_t sent_frame_samples; /* Number of samples that were sent for current frame. */
 	int64_t start_us;
 	int64_t spent_us;
+	/* Time of the last SR_DF_TIMESTAMP packet, -1 if none was sent. */
+	int64_t timestamp_us;
 	uint64_t step;
 	/* Logic */
 	int32_t num_logic_channels;
@@ -128,8 +141,12 @@ struct dev_context {
 	/* There is only ever one logic channel group, so its pattern goes here. */
 	enum logic_pattern_type logic_pattern;
 	uint8_t logic_data[LOGIC_BUFSIZE];
+	/* Precomputed periodic pattern, NULL if generated per buffer. */
+	uint8_t *logic_tile;
+	size_t logic_tile_len;
+	size_t logic_tile_pos;
+	uint64_t logic_prng;
 	/* Analog */
-	struct analog_pattern *analog_patterns[ARRAY_SIZE(analog_pattern_str)];
 	int32_t num_analog_channels;
 	GHashTable *ch_ag;
 	gboolean avg; /* True if averaging is enabled */
@@ -152,6 +169,16 @@ struct analog_gen {
 	enum analog_pattern_type pattern;
 	float amplitude;
 	float offset;
+	double frequency; /* Signal frequency, 0 follows the samplerate. */
+	/* One period (or repeated periods for a ring), scaled and offset. */
+	float *table;
+	size_t table_len;
+	size_t period; /* Period of a ring in samples, 0 for phase indexing. */
+	size_t ring_pos;
+	uint64_t phase; /* Table index, 32.32 fixed point. */
+	uint64_t phase_inc;
+	float *buf; /* Output of ANALOG_CHUNK_SAMPLES samples. */
+	uint64_t prng;
 	struct sr_datafeed_analog packet;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
@@ -160,8 +187,11 @@ struct analog_gen {
 	unsigned int num_avgs; /* Number of samples averaged */
 };
 
+SR_PRIV void demo_generate_logic_pattern(struct dev_context *devc);
+SR_PRIV void demo_free_logic_pattern(struct dev_context *devc);
 SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc);
 SR_PRIV void demo_free_analog_pattern(struct dev_context *devc);
+SR_PRIV void demo_analog_update_meaning(struct analog_gen *ag);
 SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data);
 
 #endif
@@ -662,66 +662,33 @@ SR_PRIV struct dev_context *dslogic_dev_new(void)
 
 static void abort_acquisition(struct dev_context *devc)
 {
-	int i;
-
-	devc->acq_aborted = TRUE;
-
-	for (i = devc->num_transfers - 1; i >= 0; i--) {
-		if (devc->transfers[i])
-			libusb_cancel_transfer(devc->transfers[i]);
-	}
+	if (devc->trigger_transfer)
+		libusb_cancel_transfer(devc->trigger_transfer);
+	if (devc->stream)
+		sr_usb_stream_abort(devc->stream);
 }
 
-static void finish_acquisition(struct sr_dev_inst *sdi)
+static void free_acquisition(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 
 	devc = sdi->priv;
 
-	std_session_send_df_end(sdi);
-
-	usb_source_remove(sdi->session, devc->ctx);
-
-	devc->num_transfers = 0;
-	g_free(devc->transfers);
+	sr_usb_stream_source_remove(devc->stream);
+	sr_usb_stream_free(devc->stream);
+	devc->stream = NULL;
 	g_free(devc->deinterleave_buffer);
+	devc->deinterleave_buffer = NULL;
 }
 
-static void free_transfer(struct libusb_transfer *transfer)
+static void finish_acquisition(void *cb_data)
 {
 	struct sr_dev_inst *sdi;
-	struct dev_context *devc;
-	unsigned int i;
 
-	sdi = transfer->user_data;
-	devc = sdi->priv;
-
-	g_free(transfer->buffer);
-	transfer->buffer = NULL;
-	libusb_free_transfer(transfer);
-
-	for (i = 0; i < devc->num_transfers; i++) {
-		if (devc->transfers[i] == transfer) {
-			devc->transfers[i] = NULL;
-			break;
-		}
-	}
-
-	devc->submitted_transfers--;
-	if (devc->submitted_transfers == 0)
-		finish_acquisition(sdi);
-}
-
-static void resubmit_transfer(struct libusb_transfer *transfer)
-{
-	int ret;
-
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
-		return;
-
-	sr_err("%s: %s", __func__, libusb_error_name(ret));
-	free_transfer(transfer);
+	sdi = cb_data;
 
+	std_session_send_df_end(sdi);
+	free_acquisition(sdi);
 }
 
 static void deinterleave_buffer(const uint8_t *src, size_t length,
@@ -765,64 +732,19 @@ static void send_data(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
-static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+static gboolean receive_transfer(uint8_t *data, size_t length, void *cb_data)
 {
-	struct sr_dev_inst *const sdi = transfer->user_data;
+	struct sr_dev_inst *const sdi = cb_data;
 	struct dev_context *const devc = sdi->priv;
 	const size_t channel_count = enabled_channel_count(sdi);
 	const uint16_t channel_mask = enabled_channel_mask(sdi);
 	const unsigned int cur_sample_count = DSLOGIC_ATOMIC_SAMPLES *
-		transfer->actual_length /
+		length /
 		(DSLOGIC_ATOMIC_BYTES * channel_count);
 
-	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset;
 
-	/*
-	 * If acquisition has already ended, just free any queued up
-	 * transfer that come in.
-	 */
-	if (devc->acq_aborted) {
-		free_transfer(transfer);
-		return;
-	}
-
-	sr_dbg("receive_transfer(): status %s received %d bytes.",
-		libusb_error_name(transfer->status), transfer->actual_length);
-
-	/* Save incoming transfer before reusing the transfer struct. */
-
-	switch (transfer->status) {
-	case LIBUSB_TRANSFER_NO_DEVICE:
-		abort_acquisition(devc);
-		free_transfer(transfer);
-		return;
-	case LIBUSB_TRANSFER_COMPLETED:
-	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
-		break;
-	default:
-		packet_has_error = TRUE;
-		break;
-	}
-
-	if (transfer->actual_length == 0 || packet_has_error) {
-		devc->empty_transfer_count++;
-		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
-			/*
-			 * The FX2 gave up. End the acquisition, the frontend
-			 * will work out that the samplecount is short.
-			 */
-			abort_acquisition(devc);
-			free_transfer(transfer);
-		} else {
-			resubmit_transfer(transfer);
-		}
-		return;
-	} else {
-		devc->empty_transfer_count = 0;
-	}
-
 	if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
 		if (devc->limit_samples && devc->sent_samples + cur_sample_count > devc->limit_samples)
 			num_samples = devc->limit_samples - devc->sent_samples;
@@ -840,9 +762,9 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		 *
 		 * Hopefully in future it will be possible to pass the data on as-is.
 		 */
-		if (transfer->actual_length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
+		if (length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
 			sr_err("Invalid transfer length!");
-		deinterleave_buffer(transfer->buffer, transfer->actual_length,
+		deinterleave_buffer(data, length,
 			devc->deinterleave_buffer, channel_count, channel_mask);
 
 		/* Send the incoming transfer to the session bus. */
@@ -867,11 +789,7 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		}
 	}
 
-	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
-		abort_acquisition(devc);
-		free_transfer(transfer);
-	} else
-		resubmit_transfer(transfer);
+	return !devc->limit_samples || devc->sent_samples < devc->limit_samples;
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -890,78 +808,50 @@ static int receive_data(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
-static size_t to_bytes_per_ms(const struct sr_dev_inst *sdi)
+static uint64_t to_bytes_per_sec(const struct sr_dev_inst *sdi)
 {
 	const struct dev_context *const devc = sdi->priv;
 	const size_t ch_count = enabled_channel_count(sdi);
 
 	if (devc->continuous_mode)
-		return (devc->cur_samplerate * ch_count) / (1000 * 8);
+		return (devc->cur_samplerate * ch_count) / 8;
 
 
 	/* If we're in buffered mode, the transfer rate is not so important,
 	 * but we expect to get at least 10% of the high-speed USB bandwidth.
 	 */
-	return 35000000 / (1000 * 10);
-}
-
-static size_t get_buffer_size(const struct sr_dev_inst *sdi)
-{
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of the size of a data atom.
-	 */
-	const size_t block_size = enabled_channel_count(sdi) * 512;
-	const size_t s = 10 * to_bytes_per_ms(sdi);
-	if (!block_size)
-		return s;
-	return ((s + block_size - 1) / block_size) * block_size;
-}
-
-static unsigned int get_number_of_transfers(const struct sr_dev_inst *sdi)
-{
-	/* Total buffer size should be able to hold about 100ms of data. */
-	const unsigned int s = get_buffer_size(sdi);
-	const unsigned int n = (100 * to_bytes_per_ms(sdi) + s - 1) / s;
-	return (n > NUM_SIMUL_TRANSFERS) ? NUM_SIMUL_TRANSFERS : n;
+	return 35000000 / 10;
 }
 
-static unsigned int get_timeout(const struct sr_dev_inst *sdi)
+static struct sr_usb_stream *create_stream(const struct sr_dev_inst *sdi)
 {
-	const size_t total_size = get_buffer_size(sdi) *
-		get_number_of_transfers(sdi);
-	const unsigned int timeout = total_size / to_bytes_per_ms(sdi);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
+	struct sr_usb_stream_config cfg;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.endpoint = 6 | LIBUSB_ENDPOINT_IN;
+	cfg.bytes_per_sec = to_bytes_per_sec(sdi);
+	/* Buffers must hold whole data atoms of all enabled channels. */
+	cfg.atom_size = enabled_channel_count(sdi) * 512;
+	cfg.max_transfers = NUM_SIMUL_TRANSFERS;
+	cfg.max_empty_transfers = MAX_EMPTY_TRANSFERS;
+	cfg.receive_cb = receive_transfer;
+	cfg.finish_cb = finish_acquisition;
+
+	return sr_usb_stream_new(sdi, &cfg, (void *)sdi);
 }
 
 static int start_transfers(const struct sr_dev_inst *sdi)
 {
 	const size_t channel_count = enabled_channel_count(sdi);
-	const size_t size = get_buffer_size(sdi);
-	const unsigned int num_transfers = get_number_of_transfers(sdi);
-	const unsigned int timeout = get_timeout(sdi);
 
 	struct dev_context *devc;
-	struct sr_usb_dev_inst *usb;
-	struct libusb_transfer *transfer;
-	unsigned int i;
+	size_t size;
 	int ret;
-	unsigned char *buf;
 
 	devc = sdi->priv;
-	usb = sdi->conn;
+	size = sr_usb_stream_max_buffer_size(devc->stream);
 
 	devc->sent_samples = 0;
-	devc->acq_aborted = FALSE;
-	devc->empty_transfer_count = 0;
-	devc->submitted_transfers = 0;
-
-	g_free(devc->transfers);
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
-	if (!devc->transfers) {
-		sr_err("USB transfers malloc failed.");
-		return SR_ERR_MALLOC;
-	}
 
 	devc->deinterleave_buffer = g_try_malloc(DSLOGIC_ATOMIC_SAMPLES *
 		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t));
@@ -971,27 +861,9 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				6 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
-		sr_info("submitting transfer: %d", i);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
-			abort_acquisition(devc);
-			return SR_ERR;
-		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
+	if ((ret = sr_usb_stream_start(devc->stream)) != SR_OK) {
+		sr_err("Failed to submit transfers.");
+		return ret;
 	}
 
 	std_session_send_df_header(sdi);
@@ -999,21 +871,46 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/*
+ * Act upon the trigger transfer's outcome in the session's context,
+ * its completion may run on the USB event thread.
+ */
+static gboolean handle_trigger(void *data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	int ret;
+
+	sdi = data;
+	devc = sdi->priv;
+
+	if (devc->trigger_cancelled) {
+		sr_dbg("Trigger transfer canceled.");
+		/* Terminate session. */
+		finish_acquisition(sdi);
+	} else if ((ret = start_transfers(sdi)) != SR_OK) {
+		/* After SR_ERR_IO, the stream's finish callback ends it. */
+		if (ret != SR_ERR_IO)
+			finish_acquisition(sdi);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
 static void LIBUSB_CALL trigger_receive(struct libusb_transfer *transfer)
 {
-	const struct sr_dev_inst *sdi;
+	struct sr_dev_inst *sdi;
 	struct dslogic_trigger_pos *tpos;
 	struct dev_context *devc;
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
+	devc->trigger_transfer = NULL;
+	devc->trigger_cancelled = FALSE;
 	if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
-		sr_dbg("Trigger transfer canceled.");
-		/* Terminate session. */
-		std_session_send_df_end(sdi);
-		usb_source_remove(sdi->session, devc->ctx);
-		devc->num_transfers = 0;
-		g_free(devc->transfers);
+		devc->trigger_cancelled = TRUE;
+		g_main_context_invoke(sdi->session->main_context,
+			handle_trigger, sdi);
 	} else if (transfer->status == LIBUSB_TRANSFER_COMPLETED
 			&& transfer->actual_length == sizeof(struct dslogic_trigger_pos)) {
 		tpos = (struct dslogic_trigger_pos *)transfer->buffer;
@@ -1021,15 +918,14 @@ static void LIBUSB_CALL trigger_receive(struct libusb_transfer *transfer)
 			tpos->ram_saddr, tpos->remain_cnt_h, tpos->remain_cnt_l);
 		devc->trigger_pos = tpos->real_pos;
 		g_free(tpos);
-		start_transfers(sdi);
+		g_main_context_invoke(sdi->session->main_context,
+			handle_trigger, sdi);
 	}
 	libusb_free_transfer(transfer);
 }
 
 SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 {
-	const unsigned int timeout = get_timeout(sdi);
-
 	struct sr_dev_driver *di;
 	struct drv_context *drvc;
 	struct dev_context *devc;
@@ -1045,19 +941,18 @@ SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 
 	devc->ctx = drvc->sr_ctx;
 	devc->sent_samples = 0;
-	devc->empty_transfer_count = 0;
-	devc->acq_aborted = FALSE;
 
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
-
-	if ((ret = command_stop_acquisition(sdi)) != SR_OK)
-		return ret;
+	if (!(devc->stream = create_stream(sdi)))
+		return SR_ERR;
 
-	if ((ret = fpga_configure(sdi)) != SR_OK)
-		return ret;
+	sr_usb_stream_source_add(devc->stream, receive_data, drvc);
 
-	if ((ret = command_start_acquisition(sdi)) != SR_OK)
+	if ((ret = command_stop_acquisition(sdi)) != SR_OK ||
+			(ret = fpga_configure(sdi)) != SR_OK ||
+			(ret = command_start_acquisition(sdi)) != SR_OK) {
+		free_acquisition(sdi);
 		return ret;
+	}
 
 	sr_dbg("Getting trigger.");
 	tpos = g_malloc(sizeof(struct dslogic_trigger_pos));
@@ -1069,17 +964,11 @@ SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 		sr_err("Failed to request trigger: %s.", libusb_error_name(ret));
 		libusb_free_transfer(transfer);
 		g_free(tpos);
+		free_acquisition(sdi);
 		return SR_ERR;
 	}
 
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers));
-	if (!devc->transfers) {
-		sr_err("USB trigger_pos transfer malloc failed.");
-		return SR_ERR_MALLOC;
-	}
-	devc->num_transfers = 1;
-	devc->submitted_transfers++;
-	devc->transfers[0] = transfer;
+	devc->trigger_transfer = transfer;
 
 	return ret;
 }
@@ -107,17 +107,13 @@ struct dev_context {
 	uint64_t capture_ratio;
 
 	gboolean trigger_fired;
-	gboolean acq_aborted;
 	gboolean sample_wide;
 	struct soft_trigger_logic *stl;
 
 	uint64_t num_frames;
 	uint64_t sent_samples;
-	int submitted_transfers;
-	int empty_transfer_count;
 
-	unsigned int num_transfers;
-	struct libusb_transfer **transfers;
+	struct sr_usb_stream *stream;
 	struct sr_context *ctx;
 	void (*send_data_proc)(struct sr_dev_inst *sdi,
 		uint8_t *data, size_t length, size_t sample_width);
@@ -1369,7 +1369,7 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
-	size_t group;
+	size_t group, datalen;
 
 	(void)fd;
 	(void)revents;
@@ -1402,17 +1402,14 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	 */
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
-		data = NULL;
-		if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
-			if (data)
-				g_byte_array_free(data, TRUE);
+		if (sr_scpi_get_block_into(sdi->conn, NULL, &devc->block_buf,
+				&devc->block_bufsize, &datalen, NULL, NULL) != SR_OK)
 			return TRUE;
-		}
 
 		packet.type = SR_DF_ANALOG;
 
-		analog.data = data->data;
-		analog.num_samples = data->len / sizeof(float);
+		analog.data = devc->block_buf;
+		analog.num_samples = datalen / sizeof(float);
 		/* Truncate acquisition if a smaller number of samples has been requested. */
 		if (devc->samples_limit > 0 && analog.num_samples > devc->samples_limit)
 			analog.num_samples = devc->samples_limit;
@@ -1429,10 +1426,8 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		meaning.channels = g_slist_append(NULL, ch);
 		packet.payload = &analog;
 		sr_session_send(sdi, &packet);
-		devc->num_samples = data->len / sizeof(float);
+		devc->num_samples = datalen / sizeof(float);
 		g_slist_free(meaning.channels);
-		g_byte_array_free(data, TRUE);
-		data = NULL;
 		break;
 	case SR_CHANNEL_LOGIC:
 		data = NULL;
@@ -131,6 +131,10 @@ struct dev_context {
 
 	size_t pod_count;
 	GByteArray *logic_data;
+
+	/* Receive buffer for analog waveforms, reused across frames. */
+	uint8_t *block_buf;
+	size_t block_bufsize;
 };
 
 SR_PRIV int hmo_init_device(struct sr_dev_inst *sdi);
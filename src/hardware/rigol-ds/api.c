@@ -426,8 +426,27 @@ static struct sr_dev_inst *probe_device(struct sr_scpi_dev_inst *scpi)
 		}
 	}
 
-	devc->buffer = g_malloc(ACQ_BUFFER_SIZE);
-	devc->data = g_malloc(ACQ_BUFFER_SIZE * sizeof(float));
+	/*
+	 * Network and USB connections move large blocks efficiently, use
+	 * larger reads and :WAV:DATA? windows for them.
+	 */
+	switch (scpi->transport) {
+	case SCPI_TRANSPORT_RAW_TCP:
+	case SCPI_TRANSPORT_RIGOL_TCP:
+	case SCPI_TRANSPORT_USBTMC:
+	case SCPI_TRANSPORT_VISA:
+	case SCPI_TRANSPORT_VXI:
+	case SCPI_TRANSPORT_SIM:
+		devc->buffer_size = ACQ_BUFFER_SIZE_FAST;
+		devc->block_size = ACQ_BLOCK_SIZE_FAST;
+		break;
+	default:
+		devc->buffer_size = ACQ_BUFFER_SIZE;
+		devc->block_size = ACQ_BLOCK_SIZE;
+		break;
+	}
+	devc->buffer = g_malloc(devc->buffer_size);
+	devc->data = g_malloc(devc->buffer_size * sizeof(float));
 
 	devc->data_source = DATA_SOURCE_LIVE;
 
@@ -1040,6 +1059,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 
 	/* Start of first frame. */
+	std_frame_stats_reset(&devc->frame_stats);
+	std_frame_stats_begin(&devc->frame_stats);
 	std_session_send_df_frame_begin(sdi);
 
 	return SR_OK;
@@ -1053,6 +1074,7 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 
 	std_session_send_df_end(sdi);
+	std_frame_stats_log(sdi, &devc->frame_stats);
 
 	g_slist_free(devc->enabled_channels);
 	devc->enabled_channels = NULL;
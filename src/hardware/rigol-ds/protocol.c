@@ -453,6 +453,32 @@ SR_PRIV int rigol_ds_capture_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/* Get a channel's vertical increment, origin and reference. */
+static int rigol_ds_get_vert_scale(const struct sr_dev_inst *sdi,
+		struct sr_channel *ch)
+{
+	struct dev_context *devc;
+	const char *commands[] = { ":WAV:YINC?", ":WAV:YOR?", ":WAV:YREF?" };
+	char *responses[ARRAY_SIZE(commands)];
+	unsigned int i;
+	int ret;
+
+	devc = sdi->priv;
+
+	ret = sr_scpi_get_strings(sdi->conn, commands, ARRAY_SIZE(commands),
+		responses);
+	if (ret == SR_OK)
+		ret = sr_atof_ascii(responses[0], &devc->vert_inc[ch->index]);
+	if (ret == SR_OK)
+		ret = sr_atof_ascii(responses[1], &devc->vert_origin[ch->index]);
+	if (ret == SR_OK)
+		ret = sr_atoi(responses[2], &devc->vert_reference[ch->index]);
+	for (i = 0; i < ARRAY_SIZE(commands); i++)
+		g_free(responses[i]);
+
+	return ret;
+}
+
 /* Start reading data from the current channel */
 SR_PRIV int rigol_ds_channel_start(const struct sr_dev_inst *sdi)
 {
@@ -523,17 +549,8 @@ SR_PRIV int rigol_ds_channel_start(const struct sr_dev_inst *sdi)
 
 	if (devc->model->series->protocol >= PROTOCOL_V3 &&
 			ch->type == SR_CHANNEL_ANALOG) {
-		/* Vertical increment. */
-		if (first_frame && sr_scpi_get_float(sdi->conn, ":WAV:YINC?",
-				&devc->vert_inc[ch->index]) != SR_OK)
-			return SR_ERR;
-		/* Vertical origin. */
-		if (first_frame && sr_scpi_get_float(sdi->conn, ":WAV:YOR?",
-			&devc->vert_origin[ch->index]) != SR_OK)
-			return SR_ERR;
-		/* Vertical reference. */
-		if (first_frame && sr_scpi_get_int(sdi->conn, ":WAV:YREF?",
-				&devc->vert_reference[ch->index]) != SR_OK)
+		/* Vertical increment, origin and reference, in one round-trip. */
+		if (first_frame && rigol_ds_get_vert_scale(sdi, ch) != SR_OK)
 			return SR_ERR;
 	} else if (ch->type == SR_CHANNEL_ANALOG) {
 		devc->vert_inc[ch->index] = devc->vdiv[ch->index] / 25.6;
@@ -605,9 +622,10 @@ static int rigol_ds_read_header(struct sr_dev_inst *sdi)
 	return ret;
 }
 
-SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
+/* Read and send a chunk of block data, returns its length or -1. */
+static int rigol_ds_receive_chunk(const struct sr_dev_inst *sdi,
+		struct sr_channel *ch)
 {
-	struct sr_dev_inst *sdi;
 	struct sr_scpi_dev_inst *scpi;
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
@@ -618,8 +636,73 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 	struct sr_datafeed_logic logic;
 	double vdiv, offset, origin;
 	int len, i, vref;
+
+	scpi = sdi->conn;
+	devc = sdi->priv;
+
+	len = devc->num_block_bytes - devc->num_block_read;
+	if (len > (int)devc->buffer_size)
+		len = devc->buffer_size;
+	sr_dbg("Requesting read of %d bytes", len);
+
+	len = sr_scpi_read_data(scpi, (char *)devc->buffer, len);
+
+	if (len == -1)
+		return -1;
+
+	sr_dbg("Received %d bytes.", len);
+
+	devc->num_block_read += len;
+	devc->num_channel_bytes += len;
+
+	if (ch->type == SR_CHANNEL_ANALOG) {
+		vref = devc->vert_reference[ch->index];
+		vdiv = devc->vert_inc[ch->index];
+		origin = devc->vert_origin[ch->index];
+		offset = devc->vert_offset[ch->index];
+		if (devc->model->series->protocol >= PROTOCOL_V3)
+			for (i = 0; i < len; i++)
+				devc->data[i] = ((int)devc->buffer[i] - vref - origin) * vdiv;
+		else
+			for (i = 0; i < len; i++)
+				devc->data[i] = (128 - devc->buffer[i]) * vdiv - offset;
+		float vdivlog = log10f(vdiv);
+		int digits = -(int)vdivlog + (vdivlog < 0.0);
+		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+		analog.meaning->channels = g_slist_append(NULL, ch);
+		analog.num_samples = len;
+		analog.data = devc->data;
+		analog.meaning->mq = SR_MQ_VOLTAGE;
+		analog.meaning->unit = SR_UNIT_VOLT;
+		analog.meaning->mqflags = 0;
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		sr_session_send(sdi, &packet);
+		g_slist_free(analog.meaning->channels);
+	} else {
+		logic.length = len;
+		// TODO: For the MSO1000Z series, we need a way to express that
+		// this data is in fact just for a single channel, with the valid
+		// data for that channel in the LSB of each byte.
+		logic.unitsize = devc->model->series->protocol >= PROTOCOL_V4 ? 1 : 2;
+		logic.data = devc->buffer;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		sr_session_send(sdi, &packet);
+	}
+
+	return len;
+}
+
+SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_scpi_dev_inst *scpi;
+	struct dev_context *devc;
+	int len;
 	struct sr_channel *ch;
 	gsize expected_data_bytes;
+	gint64 start_us;
 
 	(void)fd;
 
@@ -673,7 +756,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 					devc->num_channel_bytes + 1) != SR_OK)
 				return TRUE;
 			if (first_frame && rigol_ds_config_set(sdi, ":WAV:STOP %d",
-					MIN(devc->num_channel_bytes + ACQ_BLOCK_SIZE,
+					MIN(devc->num_channel_bytes + devc->block_size,
 						devc->analog_frame_size)) != SR_OK)
 				return TRUE;
 		}
@@ -720,59 +803,22 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 		devc->num_block_read = 0;
 	}
 
-	len = devc->num_block_bytes - devc->num_block_read;
-	if (len > ACQ_BUFFER_SIZE)
-		len = ACQ_BUFFER_SIZE;
-	sr_dbg("Requesting read of %d bytes", len);
-
-	len = sr_scpi_read_data(scpi, (char *)devc->buffer, len);
-
-	if (len == -1) {
-		sr_err("Error while reading block data, aborting capture.");
-		std_session_send_df_frame_end(sdi);
-		sr_dev_acquisition_stop(sdi);
-		return TRUE;
-	}
-
-	sr_dbg("Received %d bytes.", len);
-
-	devc->num_block_read += len;
-
-	if (ch->type == SR_CHANNEL_ANALOG) {
-		vref = devc->vert_reference[ch->index];
-		vdiv = devc->vert_inc[ch->index];
-		origin = devc->vert_origin[ch->index];
-		offset = devc->vert_offset[ch->index];
-		if (devc->model->series->protocol >= PROTOCOL_V3)
-			for (i = 0; i < len; i++)
-				devc->data[i] = ((int)devc->buffer[i] - vref - origin) * vdiv;
-		else
-			for (i = 0; i < len; i++)
-				devc->data[i] = (128 - devc->buffer[i]) * vdiv - offset;
-		float vdivlog = log10f(vdiv);
-		int digits = -(int)vdivlog + (vdivlog < 0.0);
-		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
-		analog.meaning->channels = g_slist_append(NULL, ch);
-		analog.num_samples = len;
-		analog.data = devc->data;
-		analog.meaning->mq = SR_MQ_VOLTAGE;
-		analog.meaning->unit = SR_UNIT_VOLT;
-		analog.meaning->mqflags = 0;
-		packet.type = SR_DF_ANALOG;
-		packet.payload = &analog;
-		sr_session_send(sdi, &packet);
-		g_slist_free(analog.meaning->channels);
-	} else {
-		logic.length = len;
-		// TODO: For the MSO1000Z series, we need a way to express that
-		// this data is in fact just for a single channel, with the valid
-		// data for that channel in the LSB of each byte.
-		logic.unitsize = devc->model->series->protocol >= PROTOCOL_V4 ? 1 : 2;
-		logic.data = devc->buffer;
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		sr_session_send(sdi, &packet);
-	}
+	/*
+	 * Keep reading while the block's data keeps arriving, so that the
+	 * scope's output doesn't wait for a main loop iteration per chunk.
+	 */
+	start_us = g_get_monotonic_time();
+	do {
+		len = rigol_ds_receive_chunk(sdi, ch);
+		if (len == -1) {
+			sr_err("Error while reading block data, aborting capture.");
+			std_session_send_df_frame_end(sdi);
+			sr_dev_acquisition_stop(sdi);
+			return TRUE;
+		}
+	} while (len > 0 && devc->num_block_read < devc->num_block_bytes &&
+		devc->num_channel_bytes < expected_data_bytes &&
+		g_get_monotonic_time() - start_us < RECEIVE_TIME_BUDGET_US);
 
 	if (devc->num_block_read == devc->num_block_bytes) {
 		sr_dbg("Block has been completed");
@@ -796,8 +842,6 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 			devc->num_block_read, devc->num_block_bytes);
 	}
 
-	devc->num_channel_bytes += len;
-
 	if (devc->num_channel_bytes < expected_data_bytes)
 		/* Don't have the full data for this channel yet, re-run. */
 		return TRUE;
@@ -821,6 +865,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 	} else {
 		/* Done with this frame. */
 		std_session_send_df_frame_end(sdi);
+		std_frame_stats_end(sdi, &devc->frame_stats);
 
 		devc->num_frames++;
 
@@ -849,6 +894,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 			rigol_ds_capture_start(sdi);
 
 			/* Start of next frame. */
+			std_frame_stats_begin(&devc->frame_stats);
 			std_session_send_df_frame_begin(sdi);
 		}
 	}
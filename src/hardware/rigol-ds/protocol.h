@@ -30,9 +30,16 @@
 
 /* Size of acquisition buffers */
 #define ACQ_BUFFER_SIZE (32 * 1024)
+/* Size of acquisition buffers for network and USB connections. */
+#define ACQ_BUFFER_SIZE_FAST (256 * 1024)
 
 /* Maximum number of samples to retrieve at once. */
 #define ACQ_BLOCK_SIZE (30 * 1000)
+/* Largest :WAV:DATA? window for BYTE format, for fast connections. */
+#define ACQ_BLOCK_SIZE_FAST (250 * 1000)
+
+/* Time to keep reading block data before returning to the main loop. */
+#define RECEIVE_TIME_BUDGET_US (20 * 1000)
 
 #define MAX_ANALOG_CHANNELS 4
 #define MAX_DIGITAL_CHANNELS 16
@@ -163,6 +170,12 @@ struct dev_context {
 	/* Acq buffers used for reading from the scope and sending data to app */
 	unsigned char *buffer;
 	float *data;
+	/* Size of the acq buffers in samples, depends on the connection. */
+	size_t buffer_size;
+	/* Number of samples per :WAV:DATA? window (protocol V4 and up). */
+	size_t block_size;
+	/* Frame rate of the current acquisition. */
+	struct std_frame_stats frame_stats;
 };
 
 SR_PRIV int rigol_ds_config_set(const struct sr_dev_inst *sdi, const char *format, ...);
@@ -278,10 +278,18 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 	devc = sdi->priv;
 
+	/* Setpoints may have been changed while the device was closed. */
+	sr_scpi_cache_reset(scpi);
+	devc->remote = FALSE;
+
 	/* Don't send SCPI_CMD_REMOTE for HP 66xxB using SCPI over GPIB. */
 	if (!(devc->device->dialect == SCPI_DIALECT_HP_66XXB &&
-			scpi->transport == SCPI_TRANSPORT_LIBGPIB))
-		sr_scpi_cmd(sdi, devc->device->commands, 0, NULL, SCPI_CMD_REMOTE);
+			scpi->transport == SCPI_TRANSPORT_LIBGPIB) &&
+			sr_scpi_cmd_get(devc->device->commands, SCPI_CMD_REMOTE)) {
+		if (sr_scpi_cmd(sdi, devc->device->commands, 0, NULL,
+				SCPI_CMD_REMOTE) == SR_OK)
+			devc->remote = TRUE;
+	}
 
 	devc->beeper_was_set = FALSE;
 	if (sr_scpi_cmd_resp(sdi, devc->device->commands, 0, NULL,
@@ -312,6 +320,10 @@ static int dev_close(struct sr_dev_inst *sdi)
 		sr_scpi_cmd(sdi, devc->device->commands,
 			0, NULL, SCPI_CMD_BEEPER_ENABLE);
 
+	/* The front panel gets unlocked, forget the setpoints. */
+	sr_scpi_cache_reset(scpi);
+	devc->remote = FALSE;
+
 	/* Don't send SCPI_CMD_LOCAL for HP 66xxB using SCPI over GPIB. */
 	if (!(devc->device->dialect == SCPI_DIALECT_HP_66XXB &&
 			scpi->transport == SCPI_TRANSPORT_LIBGPIB))
@@ -616,6 +628,27 @@ static int config_get(uint32_t key, GVariant **data,
 	return ret;
 }
 
+/*
+ * Let the SCPI layer cache a setpoint after we wrote it. While the front
+ * panel is locked, only our own commands can change it. Channel groups
+ * share their queries (the channel is selected separately), so only
+ * device wide setpoints qualify.
+ */
+static void cache_setpoint(const struct sr_dev_inst *sdi,
+	const struct sr_channel_group *cg, int get_cmd)
+{
+	struct dev_context *devc;
+	const char *cmd;
+
+	devc = sdi->priv;
+	if (!devc->remote || cg)
+		return;
+
+	cmd = sr_scpi_cmd_get(devc->device->commands, get_cmd);
+	if (cmd && !strchr(cmd, '%'))
+		sr_scpi_cache_register(sdi->conn, cmd, FALSE);
+}
+
 static int config_set(uint32_t key, GVariant *data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
 {
@@ -653,6 +686,8 @@ static int config_set(uint32_t key, GVariant *data,
 		ret = sr_scpi_cmd(sdi, devc->device->commands,
 				channel_group_cmd, channel_group_name,
 				SCPI_CMD_SET_VOLTAGE_TARGET, d);
+		if (ret == SR_OK)
+			cache_setpoint(sdi, cg, SCPI_CMD_GET_VOLTAGE_TARGET);
 		break;
 	case SR_CONF_OUTPUT_FREQUENCY_TARGET:
 		d = g_variant_get_double(data);
@@ -665,6 +700,8 @@ static int config_set(uint32_t key, GVariant *data,
 		ret = sr_scpi_cmd(sdi, devc->device->commands,
 				channel_group_cmd, channel_group_name,
 				SCPI_CMD_SET_CURRENT_LIMIT, d);
+		if (ret == SR_OK)
+			cache_setpoint(sdi, cg, SCPI_CMD_GET_CURRENT_LIMIT);
 		break;
 	case SR_CONF_OVER_VOLTAGE_PROTECTION_ENABLED:
 		if (g_variant_get_boolean(data))
@@ -681,6 +718,9 @@ static int config_set(uint32_t key, GVariant *data,
 		ret = sr_scpi_cmd(sdi, devc->device->commands,
 				channel_group_cmd, channel_group_name,
 				SCPI_CMD_SET_OVER_VOLTAGE_PROTECTION_THRESHOLD, d);
+		if (ret == SR_OK)
+			cache_setpoint(sdi, cg,
+				SCPI_CMD_GET_OVER_VOLTAGE_PROTECTION_THRESHOLD);
 		break;
 	case SR_CONF_OVER_CURRENT_PROTECTION_ENABLED:
 		if (g_variant_get_boolean(data))
@@ -697,6 +737,9 @@ static int config_set(uint32_t key, GVariant *data,
 		ret = sr_scpi_cmd(sdi, devc->device->commands,
 				channel_group_cmd, channel_group_name,
 				SCPI_CMD_SET_OVER_CURRENT_PROTECTION_THRESHOLD, d);
+		if (ret == SR_OK)
+			cache_setpoint(sdi, cg,
+				SCPI_CMD_GET_OVER_CURRENT_PROTECTION_THRESHOLD);
 		break;
 	case SR_CONF_OVER_TEMPERATURE_PROTECTION:
 		if (g_variant_get_boolean(data))
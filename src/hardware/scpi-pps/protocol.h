@@ -159,6 +159,8 @@ struct dev_context {
 	const struct scpi_pps *device;
 
 	gboolean beeper_was_set;
+	/* Front panel locked by SCPI_CMD_REMOTE, see cache_setpoint(). */
+	gboolean remote;
 	struct channel_spec *channels;
 	struct channel_group_spec *channel_groups;
 
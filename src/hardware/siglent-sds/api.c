@@ -892,6 +892,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 
 	/* Start of first frame. */
+	std_frame_stats_reset(&devc->frame_stats);
+	std_frame_stats_begin(&devc->frame_stats);
 	std_session_send_df_frame_begin(sdi);
 
 	return SR_OK;
@@ -905,6 +907,7 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 
 	std_session_send_df_end(sdi);
+	std_frame_stats_log(sdi, &devc->frame_stats);
 
 	g_slist_free(devc->enabled_channels);
 	devc->enabled_channels = NULL;
@@ -469,6 +469,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
 	struct sr_channel *ch;
+	const unsigned char *samples;
 	int len, i;
 	float wait;
 	gboolean read_complete = FALSE;
@@ -562,10 +563,11 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 				if (devc->num_block_bytes > devc->num_samples) {
 					/* We received all data as one block. */
 					/* Offset the data block buffer past the IEEE header and description header. */
-					devc->buffer += devc->block_header_size;
+					samples = devc->buffer + devc->block_header_size;
 					len = devc->num_samples;
 				} else {
 					sr_dbg("Requesting: %" PRIu64 " bytes.", devc->num_samples - devc->num_block_bytes);
+					samples = devc->buffer;
 					len = sr_scpi_read_data(scpi, (char *)devc->buffer, devc->num_samples-devc->num_block_bytes);
 					if (len == -1) {
 						sr_err("Read error, aborting capture.");
@@ -580,25 +582,18 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 				if (ch->type == SR_CHANNEL_ANALOG) {
 					float vdiv = devc->vdiv[ch->index];
 					float offset = devc->vert_offset[ch->index];
-					GArray *float_data;
-					static GArray *data;
-					float voltage, vdivlog;
+					float vdivlog;
 					int digits;
 
-					data = g_array_sized_new(FALSE, FALSE, sizeof(uint8_t), len);
-					g_array_append_vals(data, devc->buffer, len);
-					float_data = g_array_new(FALSE, FALSE, sizeof(float));
-					for (i = 0; i < len; i++) {
-						voltage = (float)g_array_index(data, int8_t, i) / 25;
-						voltage = ((vdiv * voltage) - offset);
-						g_array_append_val(float_data, voltage);
-					}
+					/* Convert straight into the preallocated sample buffer. */
+					for (i = 0; i < len; i++)
+						devc->data[i] = vdiv * ((int8_t)samples[i] / 25.0f) - offset;
 					vdivlog = log10f(vdiv);
 					digits = -(int) vdivlog + (vdivlog < 0.0);
 					sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
 					analog.meaning->channels = g_slist_append(NULL, ch);
-					analog.num_samples = float_data->len;
-					analog.data = (float *)float_data->data;
+					analog.num_samples = len;
+					analog.data = devc->data;
 					analog.meaning->mq = SR_MQ_VOLTAGE;
 					analog.meaning->unit = SR_UNIT_VOLT;
 					analog.meaning->mqflags = 0;
@@ -606,7 +601,6 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 					packet.payload = &analog;
 					sr_session_send(sdi, &packet);
 					g_slist_free(analog.meaning->channels);
-					g_array_free(data, TRUE);
 				}
 				len = 0;
 				if (devc->num_samples == (devc->num_block_bytes - SIGLENT_HEADER_SIZE)) {
@@ -634,6 +628,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 			} else {
 				/* Done with this frame. */
 				std_session_send_df_frame_end(sdi);
+				std_frame_stats_end(sdi, &devc->frame_stats);
 				if (++devc->num_frames == devc->limit_frames) {
 					/* Last frame, stop capture. */
 					sdi->driver->dev_acquisition_stop(sdi);
@@ -643,6 +638,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 					siglent_sds_capture_start(sdi);
 
 					/* Start of next frame. */
+					std_frame_stats_begin(&devc->frame_stats);
 					std_session_send_df_frame_begin(sdi);
 				}
 			}
@@ -657,6 +653,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 		packet.payload = &logic;
 		sr_session_send(sdi, &packet);
 		std_session_send_df_frame_end(sdi);
+		std_frame_stats_end(sdi, &devc->frame_stats);
 		sdi->driver->dev_acquisition_stop(sdi);
 
 		if (++devc->num_frames == devc->limit_frames) {
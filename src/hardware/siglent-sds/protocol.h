@@ -153,6 +153,8 @@ struct dev_context {
 	unsigned char *buffer;
 	float *data;
 	GArray *dig_buffer;
+	/* Frame rate of the current acquisition. */
+	struct std_frame_stats frame_stats;
 };
 
 SR_PRIV int siglent_sds_config_set(const struct sr_dev_inst *sdi,
@@ -24,6 +24,7 @@
 #include <dirent.h>
 #include <string.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -570,6 +571,333 @@ SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 	return l;
 }
 
+/** @private */
+struct scan_task {
+	struct sr_context *ctx;
+	struct sr_dev_driver *driver;
+	/* Scan options the driver supports (borrowed from the caller). */
+	GSList *options;
+	/* Connection specs to probe one after another, or NULL. */
+	GSList *conns;
+	GSList *devices;
+};
+
+/*
+ * How long a probe which found nothing is remembered. Not every change
+ * of a resource is visible in its fingerprint (e.g. a device which gets
+ * powered on behind a USB/serial adapter), so don't trust it forever.
+ */
+#define SCAN_CACHE_TTL_US (30 * G_USEC_PER_SEC)
+
+/** @private */
+struct scan_cache_entry {
+	char *fingerprint;
+	gint64 expires;
+};
+
+static void scan_cache_entry_free(void *data)
+{
+	struct scan_cache_entry *entry;
+
+	entry = data;
+	g_free(entry->fingerprint);
+	g_free(entry);
+}
+
+/*
+ * Identify the resource a scan probes, so that a cached result can be
+ * dropped when the resource changes. Only connection specs which name
+ * a file (device nodes, e.g. /dev/ttyUSB0) can be tracked: a re-plugged
+ * device gets a fresh node. Without a fingerprint, nothing gets cached.
+ */
+static char *scan_fingerprint(GSList *options)
+{
+	struct sr_config *src;
+	GStatBuf st;
+	GSList *l;
+	const char *conn;
+
+	conn = NULL;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		if (src->key == SR_CONF_CONN)
+			conn = g_variant_get_string(src->data, NULL);
+	}
+	if (!conn || g_stat(conn, &st) != 0)
+		return NULL;
+
+	return g_strdup_printf("%llu:%llu:%lld",
+		(unsigned long long)st.st_rdev, (unsigned long long)st.st_ino,
+		(long long)st.st_ctime);
+}
+
+static char *scan_cache_key(const struct sr_dev_driver *driver,
+		GSList *options)
+{
+	struct sr_config *src;
+	GString *key;
+	GSList *l;
+	char *s;
+
+	key = g_string_new(driver->name);
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		s = g_variant_print(src->data, FALSE);
+		g_string_append_printf(key, "\n%u=%s", src->key, s);
+		g_free(s);
+	}
+
+	return g_string_free(key, FALSE);
+}
+
+/*
+ * Scans which don't probe a device node may enumerate and open USB
+ * devices. Drivers call into libusb directly, so there is no place to
+ * lock a single USB device. Such scans run one after another instead.
+ */
+static GMutex scan_usb_mutex;
+
+static GSList *scan_cached(struct sr_context *ctx,
+		struct sr_dev_driver *driver, GSList *options)
+{
+	GSList *devices;
+	char *key, *fingerprint;
+	struct scan_cache_entry *cached;
+
+	key = scan_cache_key(driver, options);
+	fingerprint = scan_fingerprint(options);
+
+	if (fingerprint) {
+		g_mutex_lock(&ctx->scan_cache_mutex);
+		cached = ctx->scan_cache ?
+			g_hash_table_lookup(ctx->scan_cache, key) : NULL;
+		if (cached && !strcmp(cached->fingerprint, fingerprint) &&
+				g_get_monotonic_time() < cached->expires) {
+			g_mutex_unlock(&ctx->scan_cache_mutex);
+			sr_spew("Skipping unchanged resource (%s).", driver->name);
+			g_free(fingerprint);
+			g_free(key);
+			return NULL;
+		}
+		g_mutex_unlock(&ctx->scan_cache_mutex);
+	}
+
+	if (!fingerprint)
+		g_mutex_lock(&scan_usb_mutex);
+	devices = sr_driver_scan(driver, options);
+	if (!fingerprint)
+		g_mutex_unlock(&scan_usb_mutex);
+#ifdef HAVE_SERIAL_COMM
+	/* Don't let ports the driver failed to close block other drivers. */
+	serial_port_locks_release();
+#endif
+
+	g_mutex_lock(&ctx->scan_cache_mutex);
+	if (!ctx->scan_cache)
+		ctx->scan_cache = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free, scan_cache_entry_free);
+	if (!devices && fingerprint) {
+		cached = g_malloc(sizeof(*cached));
+		cached->fingerprint = fingerprint;
+		cached->expires = g_get_monotonic_time() + SCAN_CACHE_TTL_US;
+		g_hash_table_replace(ctx->scan_cache, key, cached);
+		key = fingerprint = NULL;
+	} else {
+		g_hash_table_remove(ctx->scan_cache, key);
+	}
+	g_mutex_unlock(&ctx->scan_cache_mutex);
+
+	g_free(fingerprint);
+	g_free(key);
+
+	return devices;
+}
+
+static void scan_task_run(void *data, void *user_data)
+{
+	struct scan_task *task;
+	struct sr_config *src;
+	GSList *l, *options;
+
+	task = data;
+	(void)user_data;
+
+	if (!task->conns) {
+		task->devices = scan_cached(task->ctx, task->driver,
+			task->options);
+		return;
+	}
+
+	for (l = task->conns; l; l = l->next) {
+		src = sr_config_new(SR_CONF_CONN, g_variant_new_string(l->data));
+		options = g_slist_prepend(g_slist_copy(task->options), src);
+		task->devices = g_slist_concat(task->devices,
+			scan_cached(task->ctx, task->driver, options));
+		g_slist_free(options);
+		sr_config_free(src);
+	}
+}
+
+/* Keep the options a driver supports, so that a set of drivers can share them. */
+static GSList *scan_options_filter(struct sr_dev_driver *driver,
+		GSList *options, gboolean drop_conn, gboolean *has_conn)
+{
+	struct sr_config *src;
+	GArray *opts;
+	GSList *l, *filtered;
+	guint i;
+
+	*has_conn = FALSE;
+	if (!(opts = sr_driver_scan_options_list(driver)))
+		return NULL;
+
+	for (i = 0; i < opts->len; i++) {
+		if (g_array_index(opts, uint32_t, i) == SR_CONF_CONN)
+			*has_conn = TRUE;
+	}
+
+	filtered = NULL;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		if (drop_conn && src->key == SR_CONF_CONN)
+			continue;
+		for (i = 0; i < opts->len; i++) {
+			if (g_array_index(opts, uint32_t, i) == src->key)
+				break;
+		}
+		if (i < opts->len)
+			filtered = g_slist_append(filtered, src);
+	}
+	g_array_free(opts, TRUE);
+
+	return filtered;
+}
+
+/**
+ * Scan for devices with several drivers in parallel.
+ *
+ * Each driver scans in a thread of its own (up to @p max_threads at the
+ * same time), so slow probes of one driver don't delay the others. While
+ * the scan runs, a serial port is only ever opened by one driver at a
+ * time. Scans of one driver (e.g. for several @p conns) run sequentially.
+ * Probes which don't target a device node (e.g. USB devices, which get
+ * enumerated by the drivers themselves) run one after another as well,
+ * also across drivers.
+ *
+ * Each driver only receives those of the @p options it supports as scan
+ * options. When @p conns is not NULL, drivers which accept SR_CONF_CONN
+ * are asked to probe each connection in turn, and an SR_CONF_CONN entry
+ * in @p options is ignored.
+ *
+ * Probes which found nothing at a connection that names a device node
+ * are remembered in the context. Later calls skip them for up to 30
+ * seconds, unless the node gets re-created in the meantime (which
+ * happens when the device gets re-plugged). Use
+ * sr_driver_scan_cache_clear() to force a full scan. Other probes,
+ * including USB ones, are never skipped.
+ *
+ * Drivers and log callbacks get called from several threads at the
+ * same time.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ * @param drivers NULL-terminated array of drivers that should scan. All
+ *                of them must have been initialized by sr_driver_init().
+ * @param options A list of 'struct sr_config' options. Can be NULL/empty.
+ * @param conns A list of connection strings (char *). Can be NULL/empty.
+ * @param max_threads The maximum number of drivers scanning at the same
+ *                    time, or 0 to scan with all drivers at once.
+ *
+ * @return A GSList * of 'struct sr_dev_inst', in the order of @p drivers,
+ *         or NULL if no devices were found (or errors were encountered).
+ *         This list must be freed by the caller using g_slist_free(), but
+ *         without freeing the data pointed to in the list.
+ *
+ * @since 0.6.0
+ */
+SR_API GSList *sr_driver_scan_multi(struct sr_context *ctx,
+		struct sr_dev_driver **drivers, GSList *options, GSList *conns,
+		int max_threads)
+{
+	struct scan_task *tasks;
+	GThreadPool *pool;
+	GError *error;
+	GSList *devices;
+	gboolean has_conn;
+	int i, num_tasks;
+
+	if (!ctx || !drivers) {
+		sr_err("%s: Invalid argument.", __func__);
+		return NULL;
+	}
+
+	for (num_tasks = 0; drivers[num_tasks]; num_tasks++);
+	if (!num_tasks)
+		return NULL;
+	if (max_threads <= 0)
+		max_threads = num_tasks;
+
+	tasks = g_malloc0(num_tasks * sizeof(*tasks));
+	for (i = 0; i < num_tasks; i++) {
+		tasks[i].ctx = ctx;
+		tasks[i].driver = drivers[i];
+		tasks[i].options = scan_options_filter(drivers[i], options,
+			conns != NULL, &has_conn);
+		if (has_conn)
+			tasks[i].conns = conns;
+	}
+
+#ifdef HAVE_SERIAL_COMM
+	serial_port_locks_begin();
+#endif
+
+	error = NULL;
+	pool = g_thread_pool_new(scan_task_run, NULL, max_threads, FALSE, &error);
+	if (!pool) {
+		sr_err("Cannot create scan threads: %s.", error->message);
+		g_error_free(error);
+		for (i = 0; i < num_tasks; i++)
+			scan_task_run(&tasks[i], NULL);
+	} else {
+		for (i = 0; i < num_tasks; i++)
+			g_thread_pool_push(pool, &tasks[i], NULL);
+		/* Wait for all drivers to complete their scans. */
+		g_thread_pool_free(pool, FALSE, TRUE);
+	}
+
+#ifdef HAVE_SERIAL_COMM
+	serial_port_locks_end();
+#endif
+
+	devices = NULL;
+	for (i = 0; i < num_tasks; i++) {
+		devices = g_slist_concat(devices, tasks[i].devices);
+		g_slist_free(tasks[i].options);
+	}
+	g_free(tasks);
+
+	sr_dbg("Parallel scan found %d devices.", g_slist_length(devices));
+
+	return devices;
+}
+
+/**
+ * Forget the results sr_driver_scan_multi() remembered.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_driver_scan_cache_clear(struct sr_context *ctx)
+{
+	if (!ctx)
+		return;
+
+	g_mutex_lock(&ctx->scan_cache_mutex);
+	if (ctx->scan_cache)
+		g_hash_table_remove_all(ctx->scan_cache);
+	g_mutex_unlock(&ctx->scan_cache_mutex);
+}
+
 /**
  * Call driver cleanup function for all drivers.
  *
@@ -695,6 +1023,154 @@ static void log_key(const struct sr_dev_inst *sdi,
 	g_free(tmp_str);
 }
 
+/*
+ * Protects the capability tables of all device instances. Frontends may
+ * query a device from several threads, and the tables are filled in as
+ * the keys are checked. Never held while calling into a driver.
+ */
+static GMutex config_caps_mutex;
+
+static GHashTable *config_caps_new(const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg)
+{
+	GHashTable *caps;
+	GVariant *gvar_opts;
+	const uint32_t *opts;
+	gsize num_opts, i;
+	uint32_t key;
+
+	caps = g_hash_table_new(g_direct_hash, g_direct_equal);
+	sr_spew("Collected configuration capabilities (%s, %s).",
+		sdi->driver->name, cg ? cg->name : "device");
+	if (sr_config_list(sdi->driver, sdi, cg, SR_CONF_DEVICE_OPTIONS, &gvar_opts) != SR_OK)
+		return caps;
+
+	opts = g_variant_get_fixed_array(gvar_opts, &num_opts, sizeof(uint32_t));
+	for (i = 0; i < num_opts; i++) {
+		key = opts[i] & SR_CONF_MASK;
+		/* Like check_key(), the first entry for a key wins. */
+		if (!g_hash_table_contains(caps, GUINT_TO_POINTER(key)))
+			g_hash_table_insert(caps, GUINT_TO_POINTER(key),
+				GUINT_TO_POINTER(opts[i]));
+	}
+	g_variant_unref(gvar_opts);
+
+	return caps;
+}
+
+/**
+ * Collect the configuration capabilities of an open device instance.
+ *
+ * The options published via SR_CONF_DEVICE_OPTIONS for the device and
+ * each of its channel groups are stored in the device instance, so that
+ * sr_config_get(), sr_config_set() and sr_config_list() can validate
+ * keys without asking the driver for its option list on every call.
+ * Since a driver may publish other options after a change of its
+ * configuration, sr_config_set() and sr_config_commit() drop them, and
+ * the next check of a key collects those of its channel group again.
+ *
+ * @param sdi The device instance. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_config_caps_update(struct sr_dev_inst *sdi)
+{
+	GHashTable *config_caps;
+	GSList *l;
+
+	if (!sdi->driver || !sdi->driver->config_list)
+		return;
+
+	/* Keep the cache unset while it is being built. */
+	sr_config_caps_clear(sdi);
+	config_caps = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, (GDestroyNotify)g_hash_table_destroy);
+	g_hash_table_insert(config_caps, NULL, config_caps_new(sdi, NULL));
+	for (l = sdi->channel_groups; l; l = l->next)
+		g_hash_table_insert(config_caps, l->data,
+			config_caps_new(sdi, l->data));
+	g_mutex_lock(&config_caps_mutex);
+	sdi->config_caps = config_caps;
+	g_mutex_unlock(&config_caps_mutex);
+}
+
+/**
+ * Drop the configuration capabilities collected by sr_config_caps_update().
+ *
+ * @param sdi The device instance. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_config_caps_clear(struct sr_dev_inst *sdi)
+{
+	GHashTable *config_caps;
+
+	g_mutex_lock(&config_caps_mutex);
+	config_caps = sdi->config_caps;
+	sdi->config_caps = NULL;
+	g_mutex_unlock(&config_caps_mutex);
+
+	if (config_caps)
+		g_hash_table_destroy(config_caps);
+}
+
+/* Forget the options of all channel groups, they are collected on demand. */
+static void config_caps_invalidate(const struct sr_dev_inst *sdi)
+{
+	g_mutex_lock(&config_caps_mutex);
+	if (sdi->config_caps)
+		g_hash_table_remove_all(sdi->config_caps);
+	g_mutex_unlock(&config_caps_mutex);
+}
+
+/*
+ * Look up the capability bits of a key in the table of a channel group.
+ * Returns FALSE if the options of that group are not known.
+ */
+static gboolean config_caps_lookup(const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg, uint32_t key,
+		uint32_t *pub_opt, gboolean *empty)
+{
+	GHashTable *caps;
+
+	g_mutex_lock(&config_caps_mutex);
+	caps = sdi->config_caps ? g_hash_table_lookup(sdi->config_caps, cg) : NULL;
+	if (caps) {
+		*empty = g_hash_table_size(caps) == 0;
+		*pub_opt = GPOINTER_TO_UINT(g_hash_table_lookup(caps,
+			GUINT_TO_POINTER(key)));
+	}
+	g_mutex_unlock(&config_caps_mutex);
+
+	return caps != NULL;
+}
+
+/* Collect the options of one channel group again, after an invalidation. */
+static gboolean config_caps_refill(const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg)
+{
+	GHashTable *caps;
+	gboolean known;
+
+	if (sdi->status != SR_ST_ACTIVE || !sdi->config_caps)
+		return FALSE;
+	if (cg && !g_slist_find(sdi->channel_groups, cg))
+		return FALSE;
+
+	caps = config_caps_new(sdi, cg);
+	g_mutex_lock(&config_caps_mutex);
+	known = sdi->config_caps != NULL;
+	if (known && !g_hash_table_contains(sdi->config_caps, cg)) {
+		g_hash_table_insert(sdi->config_caps, (gpointer)cg, caps);
+		caps = NULL;
+	}
+	g_mutex_unlock(&config_caps_mutex);
+	if (caps)
+		g_hash_table_destroy(caps);
+
+	return known;
+}
+
 static int check_key(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi, const struct sr_channel_group *cg,
 		uint32_t key, unsigned int op, GVariant *data)
@@ -702,6 +1178,7 @@ static int check_key(const struct sr_dev_driver *driver,
 	const struct sr_key_info *srci;
 	gsize num_opts, i;
 	GVariant *gvar_opts;
+	gboolean known, empty;
 	const uint32_t *opts;
 	uint32_t pub_opt;
 	const char *suffix;
@@ -743,20 +1220,35 @@ static int check_key(const struct sr_dev_driver *driver,
 		break;
 	}
 
-	if (sr_config_list(driver, sdi, cg, SR_CONF_DEVICE_OPTIONS, &gvar_opts) != SR_OK) {
-		/* Driver publishes no options. */
-		sr_err("No options available%s.", suffix);
-		return SR_ERR_ARG;
-	}
-	opts = g_variant_get_fixed_array(gvar_opts, &num_opts, sizeof(uint32_t));
 	pub_opt = 0;
-	for (i = 0; i < num_opts; i++) {
-		if ((opts[i] & SR_CONF_MASK) == key) {
-			pub_opt = opts[i];
-			break;
+	known = FALSE;
+	if (sdi) {
+		known = config_caps_lookup(sdi, cg, key, &pub_opt, &empty);
+		/* Only this group's options after a change of the configuration. */
+		if (!known && config_caps_refill(sdi, cg))
+			known = config_caps_lookup(sdi, cg, key, &pub_opt, &empty);
+	}
+	if (known) {
+		if (empty) {
+			sr_err("No options available%s.", suffix);
+			return SR_ERR_ARG;
+		}
+	} else {
+		if (sr_config_list(driver, sdi, cg, SR_CONF_DEVICE_OPTIONS, &gvar_opts) != SR_OK) {
+			/* Driver publishes no options. */
+			sr_err("No options available%s.", suffix);
+			return SR_ERR_ARG;
+		}
+		opts = g_variant_get_fixed_array(gvar_opts, &num_opts, sizeof(uint32_t));
+		pub_opt = 0;
+		for (i = 0; i < num_opts; i++) {
+			if ((opts[i] & SR_CONF_MASK) == key) {
+				pub_opt = opts[i];
+				break;
+			}
 		}
+		g_variant_unref(gvar_opts);
 	}
-	g_variant_unref(gvar_opts);
 	if (!pub_opt) {
 		sr_err("Option '%s' not available%s.", srci->id, suffix);
 		return SR_ERR_ARG;
@@ -830,6 +1322,54 @@ SR_API int sr_config_get(const struct sr_dev_driver *driver,
 	return ret;
 }
 
+/**
+ * Query the values of several configuration keys.
+ *
+ * This calls sr_config_get() for each key in turn, drivers are not asked
+ * for several values in one go. It merely saves frontends which poll
+ * many values of a device the per-key calls and error handling.
+ *
+ * @param[in] driver The sr_dev_driver struct to query. Must not be NULL.
+ * @param[in] sdi (optional) The device instance, see sr_config_get().
+ * @param[in] cg The channel group on the device for which to get the
+ *               values, or NULL.
+ * @param[in] keys The configuration keys (SR_CONF_*). Must not be NULL.
+ * @param[in] num_keys The number of keys.
+ * @param[out] data Array of num_keys GVariant pointers. Must not be NULL.
+ *             On return, each element holds the value of the respective
+ *             key, or NULL if that key could not be retrieved. The caller
+ *             must unref all non-NULL values, whatever the return code.
+ *
+ * @retval SR_OK All values were retrieved.
+ * @retval SR_ERR Invalid arguments.
+ * @retval other The error code of the first key that failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_config_get_multi(const struct sr_dev_driver *driver,
+		const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		const uint32_t *keys, unsigned int num_keys, GVariant **data)
+{
+	unsigned int i;
+	int ret, first_err;
+
+	if (!driver || !keys || !data)
+		return SR_ERR;
+
+	first_err = SR_OK;
+	for (i = 0; i < num_keys; i++) {
+		data[i] = NULL;
+		if ((ret = sr_config_get(driver, sdi, cg, keys[i], &data[i])) != SR_OK) {
+			data[i] = NULL;
+			if (first_err == SR_OK)
+				first_err = ret;
+		}
+	}
+
+	return first_err;
+}
+
 /**
  * Set value of a configuration key in a device instance.
  *
@@ -871,6 +1411,8 @@ SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 	else if ((ret = sr_variant_type_check(key, data)) == SR_OK) {
 		log_key(sdi, cg, key, SR_CONF_SET, data);
 		ret = sdi->driver->config_set(key, data, sdi, cg);
+		/* The set may have changed which options are available. */
+		config_caps_invalidate(sdi);
 	}
 
 	g_variant_unref(data);
@@ -903,8 +1445,10 @@ SR_API int sr_config_commit(const struct sr_dev_inst *sdi)
 		sr_err("%s: Device instance not active, can't commit config.",
 			sdi->driver->name);
 		ret = SR_ERR_DEV_CLOSED;
-	} else
+	} else {
 		ret = sdi->driver->config_commit(sdi);
+		config_caps_invalidate(sdi);
+	}
 
 	return ret;
 }
@@ -1016,6 +1560,42 @@ static struct sr_key_info *get_keytable(int keytype)
 	return table;
 }
 
+/*
+ * Lookup tables for sr_key_info_get() and sr_key_info_name_get(), built
+ * on first use and kept for the lifetime of the process.
+ */
+static GHashTable *key_index[SR_KEY_MQFLAGS + 1];
+static GHashTable *key_id_index[SR_KEY_MQFLAGS + 1];
+
+static void key_index_init(void)
+{
+	static gsize initialized = 0;
+	struct sr_key_info *table;
+	int keytype, i;
+
+	if (!g_once_init_enter(&initialized))
+		return;
+
+	for (keytype = SR_KEY_CONFIG; keytype <= SR_KEY_MQFLAGS; keytype++) {
+		table = get_keytable(keytype);
+		key_index[keytype] = g_hash_table_new(g_direct_hash, g_direct_equal);
+		key_id_index[keytype] = g_hash_table_new(g_str_hash, g_str_equal);
+		/* On duplicates, the first table entry wins. */
+		for (i = 0; table[i].key; i++) {
+			if (!g_hash_table_contains(key_index[keytype],
+					GUINT_TO_POINTER(table[i].key)))
+				g_hash_table_insert(key_index[keytype],
+					GUINT_TO_POINTER(table[i].key), &table[i]);
+			if (table[i].id && !g_hash_table_contains(
+					key_id_index[keytype], table[i].id))
+				g_hash_table_insert(key_id_index[keytype],
+					(gpointer)table[i].id, &table[i]);
+		}
+	}
+
+	g_once_init_leave(&initialized, 1);
+}
+
 /**
  * Get information about a key, by key.
  *
@@ -1029,18 +1609,12 @@ static struct sr_key_info *get_keytable(int keytype)
  */
 SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key)
 {
-	struct sr_key_info *table;
-	int i;
-
-	if (!(table = get_keytable(keytype)))
+	if (!get_keytable(keytype))
 		return NULL;
 
-	for (i = 0; table[i].key; i++) {
-		if (table[i].key == key)
-			return &table[i];
-	}
+	key_index_init();
 
-	return NULL;
+	return g_hash_table_lookup(key_index[keytype], GUINT_TO_POINTER(key));
 }
 
 /**
@@ -1056,20 +1630,12 @@ SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key)
  */
 SR_API const struct sr_key_info *sr_key_info_name_get(int keytype, const char *keyid)
 {
-	struct sr_key_info *table;
-	int i;
-
-	if (!(table = get_keytable(keytype)))
+	if (!get_keytable(keytype) || !keyid)
 		return NULL;
 
-	for (i = 0; table[i].key; i++) {
-		if (!table[i].id)
-			continue;
-		if (!strcmp(table[i].id, keyid))
-			return &table[i];
-	}
+	key_index_init();
 
-	return NULL;
+	return g_hash_table_lookup(key_id_index[keytype], keyid);
 }
 
 /** @} */
@@ -1143,11 +1143,19 @@ struct sr_context {
 	struct sr_dev_driver **driver_list;
 #ifdef HAVE_LIBUSB_1_0
 	libusb_context *libusb_ctx;
+	/** Whether USB streams handle their events on a dedicated thread. */
+	gboolean usb_thread_enabled;
+	/** The USB event thread, while any stream uses it. */
+	struct sr_usb_event_thread *usb_thread;
 #endif
 	sr_resource_open_callback resource_open_cb;
 	sr_resource_close_callback resource_close_cb;
 	sr_resource_read_callback resource_read_cb;
 	void *resource_cb_data;
+	/** Protects scan_cache during sr_driver_scan_multi(). */
+	GMutex scan_cache_mutex;
+	/** Negative scan results, see sr_driver_scan_multi(). */
+	GHashTable *scan_cache;
 };
 
 /** Input module metadata keys. */
@@ -1331,6 +1339,12 @@ struct sr_output {
 	 * there, and only flush it when it reaches a certain size.
 	 */
 	void *priv;
+
+	/**
+	 * Buffer which sr_output_send_fd() reuses for every packet.
+	 * Allocated by sr_output_new() for modules with receive_append().
+	 */
+	GString *fd_buf;
 };
 
 /** Output module driver. */
@@ -1413,6 +1427,22 @@ struct sr_output_module {
 	int (*receive) (const struct sr_output *o,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * Like receive(), but the output is appended to the caller's
+	 * buffer <code>out</code>. This saves modules and callers from
+	 * allocating a GString for every packet. Modules provide either
+	 * receive() or receive_append(), the other one gets emulated.
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param packet The complete packet.
+	 * @param out The buffer to append the output to. Must not be NULL.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_append) (const struct sr_output *o,
+			const struct sr_datafeed_packet *packet, GString *out);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -1440,6 +1470,9 @@ struct sr_transform {
 	 * state between calls into its callback functions.
 	 */
 	void *priv;
+
+	/** Performance counters, maintained by the session. */
+	struct sr_stats stats;
 };
 
 struct sr_transform_module {
@@ -1545,6 +1578,8 @@ struct sr_serial_dev_inst {
 	GString *rcv_buffer;
 	serial_rx_chunk_callback rx_chunk_cb_func;
 	void *rx_chunk_cb_data;
+	/** Whether serial_open() holds the port's scan lock. */
+	gboolean port_locked;
 #ifdef HAVE_LIBSERIALPORT
 	/** libserialport port handle */
 	struct sp_port *sp_data;
@@ -1678,6 +1713,16 @@ struct sr_dev_inst {
 	void *priv;
 	/** Session to which this device is currently assigned. */
 	struct sr_session *session;
+	/**
+	 * Published options of the open device, keyed by channel group
+	 * (NULL for the device itself). Each value maps a key to its
+	 * SR_CONF_GET/SET/LIST capability bits, see sr_config_caps_update().
+	 * Groups are dropped on configuration changes and collected again
+	 * on demand, under a lock of hwdriver.c.
+	 */
+	GHashTable *config_caps;
+	/** Performance counters of the session the device is part of. */
+	struct sr_stats *stats;
 };
 
 /* Generic device instances */
@@ -1733,6 +1778,8 @@ SR_PRIV int sr_variant_type_check(uint32_t key, GVariant *data);
 SR_PRIV void sr_hw_cleanup_all(const struct sr_context *ctx);
 SR_PRIV struct sr_config *sr_config_new(uint32_t key, GVariant *data);
 SR_PRIV void sr_config_free(struct sr_config *src);
+SR_PRIV void sr_config_caps_update(struct sr_dev_inst *sdi);
+SR_PRIV void sr_config_caps_clear(struct sr_dev_inst *sdi);
 SR_PRIV int sr_dev_acquisition_start(struct sr_dev_inst *sdi);
 SR_PRIV int sr_dev_acquisition_stop(struct sr_dev_inst *sdi);
 
@@ -1760,7 +1807,7 @@ struct sr_session {
 	/** Context of the session main loop. */
 	GMainContext *main_context;
 
-	/** Registered event sources for this session. */
+	/** Registered event sources for this session, see session.c. */
 	GHashTable *event_sources;
 	/** Session main loop. */
 	GMainLoop *main_loop;
@@ -1768,6 +1815,25 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+
+	/** Run each device's event sources in a thread of its own. */
+	gboolean threaded;
+	/** Device threads of the current run (struct session_dev_thread). */
+	GSList *dev_threads;
+	/** Mutex protecting the event source table. */
+	GMutex sources_mutex;
+	/**
+	 * Serializes transforms and datafeed callbacks of threaded runs,
+	 * and their counters against sr_session_stats_get().
+	 */
+	GRecMutex datafeed_mutex;
+	/** Protects the devices' counters, drivers update them from any thread. */
+	GMutex stats_mutex;
+
+	/** Counters of all packets sent to the datafeed. */
+	struct sr_stats datafeed_stats;
+	/** Whether datafeed times are measured, see sr_session_stats_get(). */
+	int stats_timing;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -1798,6 +1864,12 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV void sr_session_stats_dropped(const struct sr_dev_inst *sdi,
+		uint64_t bytes);
+SR_PRIV void sr_session_stats_latency(const struct sr_dev_inst *sdi,
+		int64_t latency_us);
+SR_PRIV void sr_session_stats_frame(const struct sr_dev_inst *sdi,
+		int64_t frame_us);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
@@ -1821,11 +1893,33 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
                            struct sr_analog_spec *spec,
                            int digits);
 
+/*--- output/output.c -------------------------------------------------------*/
+
+SR_PRIV void sr_output_logic_planes(const uint8_t *data, size_t unitsize,
+		size_t count, size_t column, size_t skip,
+		uint8_t *planes, size_t stride);
+
 /*--- std.c -----------------------------------------------------------------*/
 
 typedef int (*dev_close_callback)(struct sr_dev_inst *sdi);
 typedef void (*std_dev_clear_callback)(void *priv);
 
+/** Frame rate statistics of a driver, see std_frame_stats_begin(). */
+struct std_frame_stats {
+	/** Number of completed frames. */
+	uint64_t frames;
+	/** Start of the first frame, in monotonic time. */
+	gint64 first_us;
+	/** Start of the current frame, 0 if none is in progress. */
+	gint64 begin_us;
+	/** End of the last completed frame. */
+	gint64 end_us;
+	/** Shortest, longest and total frame time in microseconds. */
+	uint64_t min_us;
+	uint64_t max_us;
+	uint64_t total_us;
+};
+
 SR_PRIV int std_init(struct sr_dev_driver *di, struct sr_context *sr_ctx);
 SR_PRIV int std_cleanup(const struct sr_dev_driver *di);
 SR_PRIV int std_dummy_dev_open(struct sr_dev_inst *sdi);
@@ -1841,6 +1935,14 @@ SR_PRIV int std_session_send_df_end(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_df_trigger(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_df_frame_begin(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_df_frame_end(const struct sr_dev_inst *sdi);
+SR_PRIV int std_session_send_df_timestamp(const struct sr_dev_inst *sdi,
+		uint64_t sample_num, int64_t time_ns);
+SR_PRIV void std_frame_stats_reset(struct std_frame_stats *stats);
+SR_PRIV void std_frame_stats_begin(struct std_frame_stats *stats);
+SR_PRIV void std_frame_stats_end(const struct sr_dev_inst *sdi,
+		struct std_frame_stats *stats);
+SR_PRIV void std_frame_stats_log(const struct sr_dev_inst *sdi,
+		const struct std_frame_stats *stats);
 SR_PRIV int std_dev_clear_with_callback(const struct sr_dev_driver *driver,
 		std_dev_clear_callback clear_private);
 SR_PRIV int std_dev_clear(const struct sr_dev_driver *driver);
@@ -1966,6 +2068,10 @@ typedef GSList *(*sr_ser_list_append_t)(GSList *devs, const char *name,
 		const char *desc);
 typedef GSList *(*sr_ser_find_append_t)(GSList *devs, const char *name);
 
+SR_PRIV void serial_port_locks_begin(void);
+SR_PRIV void serial_port_locks_end(void);
+SR_PRIV void serial_port_locks_release(void);
+SR_PRIV void serial_port_unlock(struct sr_serial_dev_inst *serial);
 SR_PRIV int serial_open(struct sr_serial_dev_inst *serial, int flags);
 SR_PRIV int serial_close(struct sr_serial_dev_inst *serial);
 SR_PRIV int serial_flush(struct sr_serial_dev_inst *serial);
@@ -2136,6 +2242,70 @@ SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
 SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 		const char *manufacturer, const char *product);
+
+/** Opaque USB bulk streaming engine, see sr_usb_stream_new(). */
+struct sr_usb_stream;
+
+/**
+ * Data callback of a USB stream, invoked in the session's context for
+ * every transfer which carried data. Return TRUE to continue streaming,
+ * FALSE to end the acquisition.
+ */
+typedef gboolean (*sr_usb_stream_receive_cb)(uint8_t *data, size_t length,
+		void *cb_data);
+/** Invoked after the last transfer of an aborted stream was released. */
+typedef void (*sr_usb_stream_finish_cb)(void *cb_data);
+
+/** Static parameters of a USB stream. Zero fields select defaults. */
+struct sr_usb_stream_config {
+	/** Bulk IN endpoint address, including LIBUSB_ENDPOINT_IN. */
+	unsigned char endpoint;
+	/** Nominal data rate, used until actual throughput is observed. */
+	uint64_t bytes_per_sec;
+	/** Buffer sizes are a multiple of this (default 512). */
+	size_t atom_size;
+	/** Upper limit for a single transfer's buffer size. */
+	size_t max_buffer_size;
+	/** Upper limit for the number of transfers in flight. */
+	unsigned int max_transfers;
+	/** Number of consecutive empty transfers which end the stream. */
+	unsigned int max_empty_transfers;
+	sr_usb_stream_receive_cb receive_cb;
+	sr_usb_stream_finish_cb finish_cb;
+};
+
+/** Counters of a USB stream, see sr_usb_stream_get_stats(). */
+struct sr_usb_stream_stats {
+	/** Total number of bytes received. */
+	uint64_t bytes;
+	/** Number of transfers which carried data. */
+	uint64_t transfers;
+	/** Number of transfers which completed without data or failed. */
+	uint64_t empty_transfers;
+	/** Number of transfers held back while the session fell behind. */
+	uint64_t stalled_transfers;
+	/** Average throughput since the stream was started. */
+	uint64_t bytes_per_sec;
+	/** Average and maximum time from completion to resubmission. */
+	uint64_t avg_resubmit_us;
+	uint64_t max_resubmit_us;
+	/** Current buffer size and number of transfers in flight. */
+	size_t buffer_size;
+	unsigned int num_transfers;
+};
+
+SR_PRIV struct sr_usb_stream *sr_usb_stream_new(const struct sr_dev_inst *sdi,
+		const struct sr_usb_stream_config *cfg, void *cb_data);
+SR_PRIV void sr_usb_stream_free(struct sr_usb_stream *stream);
+SR_PRIV int sr_usb_stream_source_add(struct sr_usb_stream *stream,
+		sr_receive_data_callback cb, void *cb_data);
+SR_PRIV int sr_usb_stream_source_remove(struct sr_usb_stream *stream);
+SR_PRIV int sr_usb_stream_start(struct sr_usb_stream *stream);
+SR_PRIV void sr_usb_stream_abort(struct sr_usb_stream *stream);
+SR_PRIV size_t sr_usb_stream_max_buffer_size(const struct sr_usb_stream *stream);
+SR_PRIV unsigned int sr_usb_stream_timeout(const struct sr_usb_stream *stream);
+SR_PRIV void sr_usb_stream_get_stats(const struct sr_usb_stream *stream,
+		struct sr_usb_stream_stats *stats);
 #endif
 
 /*--- binary_helpers.c ------------------------------------------------------*/
@@ -0,0 +1,483 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ *
+ * Merging the datafeeds of several devices on a common timeline.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "merger"
+
+/** Default time a packet may wait for packets of other devices. */
+#define DEFAULT_WINDOW_US (100 * 1000)
+/** Maximum number of packets queued over all devices. */
+#define MAX_QUEUED 4096
+
+/**
+ * @defgroup grp_merger Merger
+ *
+ * Order the packets of several devices by the time of their samples.
+ *
+ * Each device's packets are placed on a timeline which starts at the
+ * starttime of its SR_DF_HEADER packet. Data packets are placed by their
+ * sample number and the samplerate. SR_DF_TIMESTAMP packets from devices
+ * with a clock of their own re-anchor the timeline at a given sample, so
+ * the drift between devices does not accumulate. Packets of devices
+ * without a samplerate are placed at the time given by a timestamp for
+ * their sample, or else at the time they arrive. So are frames which
+ * begin without a timestamp.
+ *
+ * A packet is passed on once every other device has sent a packet at
+ * least as late, or has ended its acquisition. Packets wait at most for
+ * the reordering window (measured on the timeline), and no more than a
+ * fixed number of packets is queued.
+ *
+ * @{
+ */
+
+struct merger_entry {
+	struct merger_entry *next;
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+	int64_t time_ns;
+};
+
+struct merger_dev {
+	const struct sr_dev_inst *sdi;
+	/* Queued packets, oldest first. */
+	struct merger_entry *head;
+	struct merger_entry *tail;
+	gboolean started;
+	gboolean ended;
+	/* Time of the last packet received. Later packets are not earlier. */
+	int64_t last_ns;
+	uint64_t samplerate;
+	/* The header's starttime. */
+	int64_t start_ns;
+	/* Sample anchor_sample was taken at anchor_ns. */
+	uint64_t anchor_sample;
+	int64_t anchor_ns;
+	/* The anchor comes from an SR_DF_TIMESTAMP packet. */
+	gboolean stamped;
+	/* Number of the next sample: logic, per analog channel, overall. */
+	uint64_t logic_pos;
+	GHashTable *analog_pos;
+	uint64_t pos;
+};
+
+struct sr_merger {
+	sr_merger_callback cb;
+	void *cb_data;
+	int64_t window_ns;
+	GSList *devs;
+	/* Latest time of any packet received. */
+	int64_t newest_ns;
+	size_t queued;
+};
+
+static int64_t now_ns(void)
+{
+	return g_get_real_time() * 1000;
+}
+
+static struct merger_dev *dev_get(struct sr_merger *merger,
+		const struct sr_dev_inst *sdi)
+{
+	struct merger_dev *dev;
+	GSList *l;
+
+	for (l = merger->devs; l; l = l->next) {
+		dev = l->data;
+		if (dev->sdi == sdi)
+			return dev;
+	}
+
+	dev = g_malloc0(sizeof(*dev));
+	dev->sdi = sdi;
+	dev->analog_pos = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, g_free);
+	merger->devs = g_slist_append(merger->devs, dev);
+
+	return dev;
+}
+
+/* Time of a sample on the device's timeline. */
+static int64_t dev_time(const struct merger_dev *dev, uint64_t sample)
+{
+	int64_t t, diff;
+	uint64_t rate;
+
+	rate = dev->samplerate;
+	if (rate) {
+		diff = sample - dev->anchor_sample;
+		t = dev->anchor_ns + diff / (int64_t)rate * 1000000000 +
+			diff % (int64_t)rate * 1000000000 / (int64_t)rate;
+	} else if (dev->stamped && sample == dev->anchor_sample) {
+		t = dev->anchor_ns;
+	} else {
+		t = now_ns();
+	}
+
+	return MAX(t, dev->last_ns);
+}
+
+static void dev_anchor(struct merger_dev *dev, uint64_t sample, int64_t t)
+{
+	dev->anchor_sample = sample;
+	dev->anchor_ns = t;
+}
+
+static void dev_start(struct merger_dev *dev,
+		const struct sr_datafeed_header *header)
+{
+	GVariant *gvar;
+
+	dev->started = TRUE;
+	dev->ended = FALSE;
+	dev->stamped = FALSE;
+	dev->logic_pos = 0;
+	dev->pos = 0;
+	g_hash_table_remove_all(dev->analog_pos);
+	dev->last_ns = G_MININT64;
+	dev->start_ns = (int64_t)header->starttime.tv_sec * 1000000000 +
+		(int64_t)header->starttime.tv_usec * 1000;
+	dev_anchor(dev, 0, dev->start_ns);
+
+	dev->samplerate = 0;
+	if (dev->sdi->driver && sr_config_get(dev->sdi->driver, dev->sdi,
+			NULL, SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+		dev->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+}
+
+static void dev_meta(struct merger_dev *dev, const struct sr_datafeed_meta *meta)
+{
+	struct sr_config *src;
+	GSList *l;
+
+	for (l = meta->config; l; l = l->next) {
+		src = l->data;
+		if (src->key != SR_CONF_SAMPLERATE)
+			continue;
+		/* Keep the timeline of the samples so far. */
+		if (dev->samplerate)
+			dev_anchor(dev, dev->pos, dev_time(dev, dev->pos));
+		dev->samplerate = g_variant_get_uint64(src->data);
+	}
+}
+
+static uint64_t *analog_pos(struct merger_dev *dev, struct sr_channel *ch)
+{
+	uint64_t *pos;
+
+	if (!(pos = g_hash_table_lookup(dev->analog_pos, ch))) {
+		pos = g_malloc0(sizeof(*pos));
+		g_hash_table_insert(dev->analog_pos, ch, pos);
+	}
+
+	return pos;
+}
+
+/* Returns the time of the packet, and updates the device's timeline. */
+static int64_t packet_time(struct merger_dev *dev,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_timestamp *timestamp;
+	uint64_t *pos;
+	int64_t t;
+	GSList *l;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		dev_start(dev, packet->payload);
+		return dev->start_ns;
+	case SR_DF_META:
+		dev_meta(dev, packet->payload);
+		return dev_time(dev, dev->pos);
+	case SR_DF_END:
+		dev->ended = TRUE;
+		return dev_time(dev, dev->pos);
+	case SR_DF_TIMESTAMP:
+		timestamp = packet->payload;
+		dev_anchor(dev, timestamp->sample_num,
+			dev->start_ns + timestamp->time_ns);
+		dev->stamped = TRUE;
+		return dev_time(dev, timestamp->sample_num);
+	case SR_DF_FRAME_BEGIN:
+		if (!dev->stamped || dev->anchor_sample != dev->pos) {
+			dev_anchor(dev, dev->pos, MAX(now_ns(), dev->last_ns));
+			dev->stamped = FALSE;
+		}
+		return dev_time(dev, dev->pos);
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		t = dev_time(dev, dev->logic_pos);
+		if (logic->unitsize)
+			dev->logic_pos += logic->length / logic->unitsize;
+		dev->pos = MAX(dev->pos, dev->logic_pos);
+		return t;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (!(l = analog->meaning->channels))
+			return dev_time(dev, dev->pos);
+		t = dev_time(dev, *analog_pos(dev, l->data));
+		for (; l; l = l->next) {
+			pos = analog_pos(dev, l->data);
+			*pos += analog->num_samples;
+			dev->pos = MAX(dev->pos, *pos);
+		}
+		return t;
+	default:
+		return dev_time(dev, dev->pos);
+	}
+}
+
+/* Whether a packet at time t can be passed on without waiting for dev. */
+static gboolean dev_passed(const struct merger_dev *dev, int64_t t)
+{
+	if (dev->head)
+		return dev->head->time_ns >= t;
+	if (!dev->started)
+		return FALSE;
+
+	return dev->ended || dev->last_ns >= t;
+}
+
+/* Whether the packet at the head of min is due. */
+static gboolean due(const struct sr_merger *merger,
+		const struct merger_dev *min, gboolean force)
+{
+	const struct merger_dev *dev;
+	int64_t t;
+	GSList *l;
+
+	t = min->head->time_ns;
+	if (force || merger->queued > MAX_QUEUED ||
+			merger->newest_ns - t > merger->window_ns)
+		return TRUE;
+
+	for (l = merger->devs; l; l = l->next) {
+		dev = l->data;
+		if (dev != min && !dev_passed(dev, t))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void entry_free(struct merger_entry *entry)
+{
+	sr_packet_free(entry->packet);
+	g_free(entry);
+}
+
+/* Pass on all packets which are in order, or all queued ones with force. */
+static void drain(struct sr_merger *merger, gboolean force)
+{
+	struct merger_dev *dev, *min;
+	struct merger_entry *entry;
+	gboolean done;
+	GSList *l;
+
+	while (TRUE) {
+		min = NULL;
+		for (l = merger->devs; l; l = l->next) {
+			dev = l->data;
+			if (dev->head && (!min || dev->head->time_ns < min->head->time_ns))
+				min = dev;
+		}
+		if (!min || !due(merger, min, force))
+			return;
+
+		entry = min->head;
+		min->head = entry->next;
+		if (!min->head)
+			min->tail = NULL;
+		merger->queued--;
+		merger->cb(entry->sdi, entry->packet, entry->time_ns,
+			merger->cb_data);
+		entry_free(entry);
+
+		/* Once everything ended, wait for all devices to start again. */
+		done = TRUE;
+		for (l = merger->devs; l && done; l = l->next) {
+			dev = l->data;
+			done = dev->ended && !dev->head;
+		}
+		for (l = merger->devs; l && done; l = l->next) {
+			dev = l->data;
+			dev->started = dev->ended = FALSE;
+		}
+	}
+}
+
+/**
+ * Create a merger.
+ *
+ * @param[out] merger Pointer to store the new merger in.
+ * @param[in] session The session whose devices to wait for, or NULL to
+ *                    merge the devices as they send SR_DF_HEADER.
+ * @param[in] window_us The longest time in microseconds a packet waits
+ *                      for packets of other devices, or 0 for the default.
+ * @param[in] cb Function to call with each packet. Must not be NULL.
+ * @param[in] cb_data Opaque pointer passed to @p cb.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_merger_new(struct sr_merger **merger, struct sr_session *session,
+		uint64_t window_us, sr_merger_callback cb, void *cb_data)
+{
+	struct sr_merger *m;
+	GSList *devlist, *l;
+
+	if (!merger || !cb)
+		return SR_ERR_ARG;
+
+	m = g_malloc0(sizeof(*m));
+	m->cb = cb;
+	m->cb_data = cb_data;
+	m->window_ns = (int64_t)(window_us ? window_us : DEFAULT_WINDOW_US) * 1000;
+	m->newest_ns = G_MININT64;
+
+	if (session && sr_session_dev_list(session, &devlist) == SR_OK) {
+		for (l = devlist; l; l = l->next)
+			dev_get(m, l->data);
+		g_slist_free(devlist);
+	}
+
+	*merger = m;
+
+	return SR_OK;
+}
+
+/**
+ * Feed a packet of a device to a merger.
+ *
+ * The packet is copied, and passed to the callback along with its time
+ * in nanoseconds since the epoch, as soon as all packets before it on
+ * the timeline are through. This can be called from a datafeed callback
+ * (see sr_session_datafeed_callback_add()).
+ *
+ * @param[in] merger The merger. Must not be NULL.
+ * @param[in] sdi The device which sent the packet. Must not be NULL.
+ * @param[in] packet The packet. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other The packet could not be copied.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_merger_feed(struct sr_merger *merger,
+		const struct sr_dev_inst *sdi, const struct sr_datafeed_packet *packet)
+{
+	struct merger_dev *dev;
+	struct merger_entry *entry;
+	int ret;
+
+	if (!merger || !sdi || !packet)
+		return SR_ERR_ARG;
+
+	dev = dev_get(merger, sdi);
+	entry = g_malloc0(sizeof(*entry));
+	entry->sdi = sdi;
+	if ((ret = sr_packet_copy(packet, &entry->packet)) != SR_OK) {
+		g_free(entry->packet);
+		g_free(entry);
+		return ret;
+	}
+
+	entry->time_ns = packet_time(dev, packet);
+	dev->last_ns = entry->time_ns;
+	merger->newest_ns = MAX(merger->newest_ns, entry->time_ns);
+
+	if (dev->tail)
+		dev->tail->next = entry;
+	else
+		dev->head = entry;
+	dev->tail = entry;
+	merger->queued++;
+
+	drain(merger, FALSE);
+
+	return SR_OK;
+}
+
+/**
+ * Pass all queued packets to the callback, in order of time.
+ *
+ * @param[in] merger The merger. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_merger_flush(struct sr_merger *merger)
+{
+	if (!merger)
+		return SR_ERR_ARG;
+
+	drain(merger, TRUE);
+
+	return SR_OK;
+}
+
+/**
+ * Free a merger. Queued packets are discarded.
+ *
+ * @param[in] merger The merger. May be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_merger_free(struct sr_merger *merger)
+{
+	struct merger_dev *dev;
+	struct merger_entry *entry;
+	GSList *l;
+
+	if (!merger)
+		return;
+
+	for (l = merger->devs; l; l = l->next) {
+		dev = l->data;
+		while ((entry = dev->head)) {
+			dev->head = entry->next;
+			entry_free(entry);
+		}
+		g_hash_table_destroy(dev->analog_pos);
+		g_free(dev);
+	}
+	g_slist_free(merger->devs);
+	g_free(merger);
+}
+
+/** @} */
@@ -36,6 +36,10 @@
  */
 #define DEFAULT_ASCII_CHARS ".\"\\/"
 
+/* Samples which get transposed at once, and the resulting plane size. */
+#define RUN_SAMPLES 4096
+#define PLANE_STRIDE ((RUN_SAMPLES + 7 + 7) / 8)
+
 struct context {
 	size_t num_enabled_channels;
 	size_t spl;
@@ -51,6 +55,16 @@ struct context {
 	GString **lines;
 	const char *charset;
 	gboolean edges;
+	/* Bytes of a sample which hold enabled channels. */
+	size_t *columns;
+	size_t num_columns;
+	/* Per channel bits of the current run, see sr_output_logic_planes(). */
+	uint8_t *planes;
+	/*
+	 * The characters for four samples, indexed by their levels (upper
+	 * nibble) and whether they differ from the previous sample (lower).
+	 */
+	char lut[256][4];
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -58,7 +72,8 @@ static int init(struct sr_output *o, GHashTable *options)
 	struct context *ctx;
 	struct sr_channel *ch;
 	GSList *l;
-	size_t j, max_namelen, alloc_line_len;
+	size_t i, j, b, max_namelen, alloc_line_len;
+	int max_index;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
@@ -75,6 +90,15 @@ static int init(struct sr_output *o, GHashTable *options)
 	}
 	ctx->edges = (strlen(ctx->charset) >= 4) ? TRUE : FALSE;
 
+	for (i = 0; i < 256; i++) {
+		for (b = 0; b < 4; b++) {
+			j = (i & (0x80 >> b)) ? 1 : 0;
+			if (ctx->edges && (i & (0x08 >> b)))
+				j += 2;
+			ctx->lut[i][b] = ctx->charset[j];
+		}
+	}
+
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
 		if (ch->type != SR_CHANNEL_LOGIC)
@@ -101,6 +125,8 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->max_namelen = max_namelen;
 
 	alloc_line_len = ctx->max_namelen + 8 + ctx->spl;
+	ctx->columns = g_malloc0(sizeof(size_t) * ctx->num_enabled_channels);
+	max_index = 0;
 	j = 0;
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -115,17 +141,24 @@ static int init(struct sr_output *o, GHashTable *options)
 		ctx->lines[j] = g_string_sized_new(alloc_line_len);
 		g_string_printf(ctx->lines[j], "%s:", ctx->aligned_names[j]);
 
+		for (b = 0; b < ctx->num_columns; b++) {
+			if (ctx->columns[b] == (size_t)ch->index / 8)
+				break;
+		}
+		if (b == ctx->num_columns)
+			ctx->columns[ctx->num_columns++] = ch->index / 8;
+		max_index = MAX(max_index, ch->index);
 		j++;
 	}
+	ctx->planes = g_malloc0((max_index / 8 + 1) * 8 * PLANE_STRIDE);
 
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	GVariant *gvar;
-	GString *header;
 	size_t num_channels;
 	char *samplerate_s;
 
@@ -138,8 +171,7 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
-	g_string_printf(header, "%s %s\n", PACKAGE_NAME, sr_package_version_string_get());
+	g_string_append_printf(header, "%s %s\n", PACKAGE_NAME, sr_package_version_string_get());
 	num_channels = g_slist_length(o->sdi->channels);
 	g_string_append_printf(header, "Acquisition with %zu/%zu channels",
 			ctx->num_enabled_channels, num_channels);
@@ -149,8 +181,6 @@ static GString *gen_header(const struct sr_output *o)
 		g_free(samplerate_s);
 	}
 	g_string_append_printf(header, "\n");
-
-	return header;
 }
 
 static void maybe_add_trigger(struct context *ctx, GString *out)
@@ -172,8 +202,60 @@ static void maybe_add_trigger(struct context *ctx, GString *out)
 		offset + 1, "^", offset);
 }
 
+static void transpose(struct context *ctx, const uint8_t *data,
+		size_t unitsize, size_t count, size_t skip)
+{
+	uint8_t *planes;
+	size_t i, column;
+
+	for (i = 0; i < ctx->num_columns; i++) {
+		column = ctx->columns[i];
+		planes = ctx->planes + column * 8 * PLANE_STRIDE;
+		if (column < unitsize)
+			sr_output_logic_planes(data, unitsize, count, column,
+				skip, planes, PLANE_STRIDE);
+		else
+			memset(planes, 0, 8 * PLANE_STRIDE);
+	}
+}
+
+/*
+ * Append a run of one channel's samples to its line. The first sample
+ * on a line never shows an edge, later ones are compared to the sample
+ * before them.
+ */
+static void render(const struct context *ctx, GString *line,
+		const uint8_t *plane, size_t skip, size_t count,
+		uint8_t prevbit, gboolean line_start)
+{
+	size_t pos, end, len, off, line_len;
+	uint8_t bits, edges;
+	char chars[8], *p;
+
+	line_len = line->len;
+	g_string_set_size(line, line_len + count);
+	p = line->str + line_len;
+	end = skip + count;
+	for (pos = skip; pos < end; pos += len) {
+		off = pos & 7;
+		len = MIN(8 - off, end - pos);
+		bits = plane[pos / 8];
+		/* The previous sample's level, in front of the first one. */
+		if (off)
+			bits |= prevbit << (8 - off);
+		edges = bits ^ ((bits >> 1) | (prevbit << 7));
+		if (line_start && pos == skip)
+			edges &= 0x7f;
+		memcpy(chars, ctx->lut[(bits & 0xf0) | (edges >> 4)], 4);
+		memcpy(chars + 4, ctx->lut[((bits & 0x0f) << 4) | (edges & 0x0f)], 4);
+		memcpy(p, chars + off, len);
+		p += len;
+		prevbit = (bits >> (7 - ((pos + len - 1) & 7))) & 1;
+	}
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+		GString *out)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
@@ -181,14 +263,10 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	GSList *l;
 	struct context *ctx;
 	size_t idx, i, j;
-	size_t num_samples;
-	const uint8_t *curr_sample;
-	size_t bytepos;
-	uint8_t bitmask, curbit, prevbit;
-	char c;
-	size_t charidx;
-
-	*out = NULL;
+	size_t num_samples, count, skip;
+	const uint8_t *curr_sample, *prev_sample;
+	uint8_t prevbit;
+
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -209,57 +287,57 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_LOGIC:
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else {
-			*out = g_string_sized_new(512);
 		}
 
 		logic = packet->payload;
 		num_samples = logic->length / logic->unitsize;
 		curr_sample = logic->data;
-		while (num_samples--) {
-			ctx->spl_cnt++;
+		prev_sample = ctx->prev_sample;
+		while (num_samples) {
+			/* Runs end at the end of a line. */
+			count = MIN(num_samples, RUN_SAMPLES);
+			if (ctx->spl > 0)
+				count = MIN(count, ctx->spl - ctx->spl_cnt);
+			skip = ctx->spl_cnt & 7;
+			transpose(ctx, curr_sample, logic->unitsize, count, skip);
 			for (j = 0; j < ctx->num_enabled_channels; j++) {
 				idx = ctx->channel_index[j];
-				bytepos = idx / 8;
-				bitmask = 1U << (idx % 8);
-				curbit = curr_sample[bytepos] & bitmask;
-				prevbit = ctx->prev_sample[bytepos] & bitmask;
-
-				charidx = curbit ? 1 : 0;
-				if (ctx->edges && ctx->spl_cnt > 1) {
-					if (curbit != prevbit)
-						charidx += 2;
-				}
-				c = ctx->charset[charidx];
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j + 1 == ctx->num_enabled_channels)
-						maybe_add_trigger(ctx, *out);
-					g_string_printf(ctx->lines[j], "%s:", ctx->aligned_names[j]);
-				}
+				prevbit = (prev_sample[idx / 8] >> (idx % 8)) & 1;
+				render(ctx, ctx->lines[j],
+					ctx->planes + idx * PLANE_STRIDE,
+					skip, count, prevbit, ctx->spl_cnt == 0);
+			}
+			ctx->spl_cnt += count;
+			curr_sample += count * logic->unitsize;
+			prev_sample = curr_sample - logic->unitsize;
+			num_samples -= count;
+			if (ctx->spl_cnt != ctx->spl)
+				continue;
+
+			for (j = 0; j < ctx->num_enabled_channels; j++) {
+				/* Flush line buffers. */
+				g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+				g_string_append_c(out, '\n');
+				if (j + 1 == ctx->num_enabled_channels)
+					maybe_add_trigger(ctx, out);
+				g_string_printf(ctx->lines[j], "%s:", ctx->aligned_names[j]);
 			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
-				ctx->spl_cnt = 0;
-			memcpy(ctx->prev_sample, curr_sample, logic->unitsize);
-			curr_sample += logic->unitsize;
+			/* Line buffers were already flushed. */
+			ctx->spl_cnt = 0;
 		}
+		if (prev_sample != ctx->prev_sample)
+			memcpy(ctx->prev_sample, prev_sample, logic->unitsize);
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
 			/* Line buffers need flushing. */
-			*out = g_string_sized_new(512);
 			for (i = 0; i < ctx->num_enabled_channels; i++) {
-				g_string_append_len(*out, ctx->lines[i]->str, ctx->lines[i]->len);
-				g_string_append_c(*out, '\n');
+				g_string_append_len(out, ctx->lines[i]->str, ctx->lines[i]->len);
+				g_string_append_c(out, '\n');
 			}
-			maybe_add_trigger(ctx, *out);
+			maybe_add_trigger(ctx, out);
 		}
 		break;
 	}
@@ -280,6 +358,8 @@ static int cleanup(struct sr_output *o)
 
 	g_free(ctx->channel_index);
 	g_free(ctx->prev_sample);
+	g_free(ctx->columns);
+	g_free(ctx->planes);
 	for (i = 0; i < ctx->num_enabled_channels; i++) {
 		g_free(ctx->aligned_names[i]);
 		g_string_free(ctx->lines[i], TRUE);
@@ -319,6 +399,6 @@ SR_PRIV struct sr_output_module output_ascii = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
@@ -28,6 +28,10 @@
 
 #define DEFAULT_SAMPLES_PER_LINE 64
 
+/* Samples which get transposed at once, and the resulting plane size. */
+#define RUN_SAMPLES 4096
+#define PLANE_STRIDE ((RUN_SAMPLES + 7 + 7) / 8)
+
 struct context {
 	unsigned int num_enabled_channels;
 	int spl;
@@ -38,6 +42,13 @@ struct context {
 	char **channel_names;
 	gboolean header_done;
 	GString **lines;
+	/* Bytes of a sample which hold enabled channels. */
+	size_t *columns;
+	size_t num_columns;
+	/* Per channel bits of the current run, see sr_output_logic_planes(). */
+	uint8_t *planes;
+	/* The characters for the eight bits of a plane byte. */
+	char lut[256][8];
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -45,7 +56,9 @@ static int init(struct sr_output *o, GHashTable *options)
 	struct context *ctx;
 	struct sr_channel *ch;
 	GSList *l;
-	unsigned int i, j;
+	unsigned int i, j, b;
+	size_t line_len;
+	int max_index;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
@@ -54,6 +67,12 @@ static int init(struct sr_output *o, GHashTable *options)
 	o->priv = ctx;
 	ctx->trigger = -1;
 	ctx->spl = g_variant_get_uint32(g_hash_table_lookup(options, "width"));
+	line_len = ctx->spl > 0 ? ctx->spl + ctx->spl / 8 + 1 : 80;
+
+	for (i = 0; i < 256; i++) {
+		for (b = 0; b < 8; b++)
+			ctx->lut[i][b] = (i & (0x80 >> b)) ? '1' : '0';
+	}
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -67,7 +86,10 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->channel_names = g_malloc(sizeof(char *) * ctx->num_enabled_channels);
 	ctx->lines = g_malloc(sizeof(GString *) * ctx->num_enabled_channels);
 
+	ctx->columns = g_malloc0(sizeof(size_t) * ctx->num_enabled_channels);
+
 	j = 0;
+	max_index = 0;
 	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
 		ch = l->data;
 		if (ch->type != SR_CHANNEL_LOGIC)
@@ -76,19 +98,26 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
 		ctx->channel_index[j] = ch->index;
 		ctx->channel_names[j] = ch->name;
-		ctx->lines[j] = g_string_sized_new(80);
+		ctx->lines[j] = g_string_sized_new(strlen(ch->name) + 1 + line_len);
 		g_string_printf(ctx->lines[j], "%s:", ch->name);
+		for (b = 0; b < ctx->num_columns; b++) {
+			if (ctx->columns[b] == (size_t)ch->index / 8)
+				break;
+		}
+		if (b == ctx->num_columns)
+			ctx->columns[ctx->num_columns++] = ch->index / 8;
+		max_index = MAX(max_index, ch->index);
 		j++;
 	}
+	ctx->planes = g_malloc0((max_index / 8 + 1) * 8 * PLANE_STRIDE);
 
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	GVariant *gvar;
-	GString *header;
 	int num_channels;
 	char *samplerate_s;
 
@@ -101,8 +130,7 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
-	g_string_printf(header, "%s %s\n", PACKAGE_NAME, sr_package_version_string_get());
+	g_string_append_printf(header, "%s %s\n", PACKAGE_NAME, sr_package_version_string_get());
 	num_channels = g_slist_length(o->sdi->channels);
 	g_string_append_printf(header, "Acquisition with %d/%d channels",
 			ctx->num_enabled_channels, num_channels);
@@ -112,23 +140,64 @@ static GString *gen_header(const struct sr_output *o)
 		g_free(samplerate_s);
 	}
 	g_string_append_printf(header, "\n");
+}
 
-	return header;
+static void transpose(struct context *ctx, const uint8_t *data,
+		size_t unitsize, size_t count, size_t skip)
+{
+	uint8_t *planes;
+	size_t i, column;
+
+	for (i = 0; i < ctx->num_columns; i++) {
+		column = ctx->columns[i];
+		planes = ctx->planes + column * 8 * PLANE_STRIDE;
+		if (column < unitsize)
+			sr_output_logic_planes(data, unitsize, count, column,
+				skip, planes, PLANE_STRIDE);
+		else
+			memset(planes, 0, 8 * PLANE_STRIDE);
+	}
+}
+
+/*
+ * Append a run of one channel's samples to its line. The plane is
+ * aligned such that its bytes match the groups of eight characters
+ * on the line, which are separated by a space (except at the end).
+ */
+static void render(const struct context *ctx, GString *line,
+		const uint8_t *plane, size_t skip, size_t count, gboolean eol)
+{
+	size_t pos, end, len, line_len;
+	char *p;
+
+	line_len = line->len;
+	g_string_set_size(line, line_len + count + count / 8 + 2);
+	p = line->str + line_len;
+	end = skip + count;
+	for (pos = skip; pos < end; pos += len) {
+		len = MIN(8 - (pos & 7), end - pos);
+		memcpy(p, ctx->lut[plane[pos / 8]] + (pos & 7), len);
+		p += len;
+		if (((pos + len) & 7) == 0 && !(eol && pos + len == end))
+			*p++ = ' ';
+	}
+	g_string_set_size(line, p - line->str);
 }
 
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+		GString *out)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	struct context *ctx;
 	GSList *l;
-	int idx, offset;
-	uint64_t i, j;
-	gchar *p, c;
+	const uint8_t *data;
+	uint64_t i, j, num_samples, count;
+	size_t skip;
+	gboolean eol;
+	int offset;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -149,52 +218,58 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_LOGIC:
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else
-			*out = g_string_sized_new(512);
+		}
 
 		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
+		data = logic->data;
+		num_samples = logic->length / logic->unitsize;
+		while (num_samples) {
+			/* Runs end at the end of a line. */
+			count = MIN(num_samples, RUN_SAMPLES);
+			if (ctx->spl > 0)
+				count = MIN(count, (uint64_t)(ctx->spl - ctx->spl_cnt));
+			skip = ctx->spl_cnt & 7;
+			eol = ctx->spl_cnt + (int)count == ctx->spl;
+			transpose(ctx, data, logic->unitsize, count, skip);
+			for (j = 0; j < ctx->num_enabled_channels; j++) {
+				render(ctx, ctx->lines[j], ctx->planes +
+					ctx->channel_index[j] * PLANE_STRIDE,
+					skip, count, eol);
+			}
+			ctx->spl_cnt += count;
+			data += count * logic->unitsize;
+			num_samples -= count;
+			if (!eol)
+				continue;
+
 			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				c = (*p & (1 << (idx % 8))) ? '1' : '0';
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						/*
-						 * Sample data lines have one character per bit,
-						 * plus one separator per byte. Align trigger marker
-						 * to this layout.
-						 */
-						offset = ctx->trigger + ctx->trigger / 8;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
-					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
-				} else if ((ctx->spl_cnt & 7) == 0) {
-					/* Add a space every 8th bit. */
-					g_string_append_c(ctx->lines[j], ' ');
+				/* Flush line buffers. */
+				g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+				g_string_append_c(out, '\n');
+				if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
+					/*
+					 * Sample data lines have one character per bit,
+					 * plus one separator per byte. Align trigger marker
+					 * to this layout.
+					 */
+					offset = ctx->trigger + ctx->trigger / 8;
+					g_string_append_printf(out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+					ctx->trigger = -1;
 				}
+				g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
 			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
-				ctx->spl_cnt = 0;
+			/* Line buffers were already flushed. */
+			ctx->spl_cnt = 0;
 		}
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
 			/* Line buffers need flushing. */
-			*out = g_string_sized_new(512);
 			for (i = 0; i < ctx->num_enabled_channels; i++) {
-				g_string_append_len(*out, ctx->lines[i]->str, ctx->lines[i]->len);
-				g_string_append_c(*out, '\n');
+				g_string_append_len(out, ctx->lines[i]->str, ctx->lines[i]->len);
+				g_string_append_c(out, '\n');
 			}
 		}
 		break;
@@ -216,6 +291,8 @@ static int cleanup(struct sr_output *o)
 
 	g_free(ctx->channel_index);
 	g_free(ctx->channel_names);
+	g_free(ctx->columns);
+	g_free(ctx->planes);
 	for (i = 0; i < ctx->num_enabled_channels; i++)
 		g_string_free(ctx->lines[i], TRUE);
 	g_free(ctx->lines);
@@ -248,6 +325,6 @@ SR_PRIV struct sr_output_module output_bits = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
@@ -97,8 +97,16 @@ struct context {
 	uint64_t sample_scale;
 	uint64_t out_sample_count;
 	uint8_t *previous_sample;
+	/*
+	 * Samples of the current set, kept until all channels were seen.
+	 * The buffers are reused, sized for the largest packet so far.
+	 */
+	gboolean have_analog, have_logic;
 	float *analog_samples;
 	uint8_t *logic_samples;
+	uint32_t analog_alloc, logic_alloc;
+	float *fdata;
+	size_t fdata_alloc;
 	const char *xlabel;	/* Don't free: will point to a static string. */
 	const char *title;	/* Don't free: will point into the driver struct. */
 
@@ -187,8 +195,16 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->channels = g_malloc(sizeof(struct ctx_channel)
 		* (ctx->num_analog_channels + ctx->num_logic_channels));
 
+	/*
+	 * A set of samples is complete when all enabled analog channels
+	 * and a logic packet (which counts for all logic channels) were
+	 * seen. Disabled analog channels never show up.
+	 */
+	ctx->channel_count = ctx->num_analog_channels;
+	if (ctx->num_logic_channels)
+		ctx->channel_count += ctx->logic_channel_count;
+
 	/* Once more to map the enabled channels. */
-	ctx->channel_count = g_slist_length(o->sdi->channels);
 	for (i = 0, l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
 		if (ch->enabled) {
@@ -215,19 +231,17 @@ static const char *xlabels[] = {
 	"femtoseconds", "attoseconds",
 };
 
-static GString *gen_header(const struct sr_output *o,
-			   const struct sr_datafeed_header *hdr)
+static void gen_header(const struct sr_output *o,
+		       const struct sr_datafeed_header *hdr, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *channels, *l;
 	unsigned int num_channels, i;
 	char *samplerate_s;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 
 	if (ctx->sample_rate == 0) {
 		if (sr_config_get(o->sdi->driver, o->sdi, NULL,
@@ -286,8 +300,6 @@ static GString *gen_header(const struct sr_output *o,
 	/* Time column requested but samplerate unknown. Emit a warning. */
 	if (ctx->time && !ctx->sample_rate)
 		sr_warn("Samplerate unknown, cannot provide timestamps.");
-
-	return header;
 }
 
 /*
@@ -322,15 +334,19 @@ static void process_analog(struct context *ctx,
 	size_t idx_send;
 	struct sr_analog_meaning *meaning;
 	GSList *l;
-	float *fdata = NULL;
+	float *fdata;
 	struct sr_channel *ch;
 
-	if (!ctx->analog_samples) {
-		ctx->analog_samples = g_malloc(analog->num_samples
-			* sizeof(float) * ctx->num_analog_channels);
+	if (!ctx->have_analog) {
+		ctx->have_analog = TRUE;
 		if (!ctx->num_samples)
 			ctx->num_samples = analog->num_samples;
 	}
+	if (analog->num_samples > ctx->analog_alloc) {
+		ctx->analog_samples = g_realloc(ctx->analog_samples,
+			analog->num_samples * sizeof(float) * ctx->num_analog_channels);
+		ctx->analog_alloc = analog->num_samples;
+	}
 	if (ctx->num_samples != analog->num_samples)
 		sr_warn("Expecting %u analog samples, got %u.",
 			ctx->num_samples, analog->num_samples);
@@ -339,7 +355,11 @@ static void process_analog(struct context *ctx,
 	num_rcvd_ch = g_slist_length(meaning->channels);
 	ctx->channels_seen += num_rcvd_ch;
 	sr_dbg("Processing packet of %zu analog channels", num_rcvd_ch);
-	fdata = g_malloc(analog->num_samples * num_rcvd_ch * sizeof(float));
+	if (analog->num_samples * num_rcvd_ch > ctx->fdata_alloc) {
+		ctx->fdata_alloc = analog->num_samples * num_rcvd_ch;
+		ctx->fdata = g_realloc(ctx->fdata, ctx->fdata_alloc * sizeof(float));
+	}
+	fdata = ctx->fdata;
 	if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
 		sr_warn("Problems converting data to floating point values.");
 
@@ -365,7 +385,6 @@ static void process_analog(struct context *ctx,
 		}
 		idx_send++;
 	}
-	g_free(fdata);
 }
 
 /*
@@ -379,14 +398,22 @@ static void process_logic(struct context *ctx,
 	int idx;
 	uint8_t *sample;
 
+	if (!ctx->num_logic_channels)
+		return;
+
 	num_samples = logic->length / logic->unitsize;
 	ctx->channels_seen += ctx->logic_channel_count;
 	sr_dbg("Logic packet had %d channels", logic->unitsize * 8);
-	if (!ctx->logic_samples) {
-		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
+	if (!ctx->have_logic) {
+		ctx->have_logic = TRUE;
 		if (!ctx->num_samples)
 			ctx->num_samples = num_samples;
 	}
+	if (num_samples > ctx->logic_alloc) {
+		ctx->logic_samples = g_realloc(ctx->logic_samples,
+			num_samples * ctx->num_logic_channels);
+		ctx->logic_alloc = num_samples;
+	}
 	if (ctx->num_samples != num_samples)
 		sr_warn("Expecting %u samples, got %u",
 			ctx->num_samples, num_samples);
@@ -405,49 +432,54 @@ static void process_logic(struct context *ctx,
 	}
 }
 
-static void dump_saved_values(struct context *ctx, GString **out)
+static void dump_saved_values(struct context *ctx, GString *out)
 {
 	unsigned int i, j, analog_size, num_channels;
 	double sample_time_dbl;
 	uint64_t sample_time_u64;
 	float *analog_sample, value;
+	char numbuf[G_ASCII_DTOSTR_BUF_SIZE];
 	uint8_t *logic_sample;
 
 	/* If we haven't seen samples we're expecting, skip them. */
-	if ((ctx->num_analog_channels && !ctx->analog_samples) ||
-	    (ctx->num_logic_channels && !ctx->logic_samples)) {
+	if ((ctx->num_analog_channels && !ctx->have_analog) ||
+	    (ctx->num_logic_channels && !ctx->have_logic)) {
 		sr_warn("Discarding partial packet");
 	} else {
 		sr_info("Dumping %u samples", ctx->num_samples);
 
-		if (!*out)
-			*out = g_string_sized_new(512);
 		num_channels =
 		    ctx->num_logic_channels + ctx->num_analog_channels;
 
 		if (ctx->label_do) {
 			if (ctx->time)
-				g_string_append_printf(*out, "%s%s",
+				g_string_append_printf(out, "%s%s",
 					ctx->label_names ? "Time" : ctx->xlabel,
 					ctx->value);
 			for (i = 0; i < num_channels; i++) {
-				g_string_append_printf(*out, "%s%s",
+				g_string_append_printf(out, "%s%s",
 					ctx->channels[i].label, ctx->value);
 				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
-						&& ctx->label_names)
+						&& !ctx->label_names) {
 					g_free(ctx->channels[i].label);
+					ctx->channels[i].label = NULL;
+				}
 			}
 			if (ctx->do_trigger)
-				g_string_append_printf(*out, "Trigger%s",
+				g_string_append_printf(out, "Trigger%s",
 						       ctx->value);
 			/* Drop last separator. */
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+			g_string_truncate(out, out->len - 1);
+			g_string_append(out, ctx->record);
 
 			ctx->label_do = FALSE;
 		}
 
 		analog_size = ctx->num_analog_channels * sizeof(float);
+		/*
+		 * Needs no reset between sets: the first sample of a set is
+		 * always emitted, and refreshes it.
+		 */
 		if (ctx->dedup && !ctx->previous_sample)
 			ctx->previous_sample = g_malloc0(analog_size + ctx->num_logic_channels);
 
@@ -474,13 +506,13 @@ static void dump_saved_values(struct context *ctx, GString **out)
 			}
 
 			if (ctx->time && !ctx->sample_rate) {
-				g_string_append_printf(*out, "0%s", ctx->value);
+				g_string_append_printf(out, "0%s", ctx->value);
 			} else if (ctx->time) {
 				sample_time_dbl = ctx->out_sample_count++;
 				sample_time_dbl /= ctx->sample_rate;
 				sample_time_dbl *= ctx->sample_scale;
 				sample_time_u64 = sample_time_dbl;
-				g_string_append_printf(*out, "%" PRIu64 "%s",
+				g_string_append_printf(out, "%" PRIu64 "%s",
 					sample_time_u64, ctx->value);
 			}
 
@@ -491,11 +523,20 @@ static void dump_saved_values(struct context *ctx, GString **out)
 					    fmax(value, ctx->channels[j].max);
 					ctx->channels[j].min =
 					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
-						value, ctx->value);
+					/*
+					 * Always use '.' as the decimal separator,
+					 * unlike "%g" in e.g. a German locale. A
+					 * decimal comma would clash with the
+					 * default value separator.
+					 */
+					sr_format_double_ascii(numbuf,
+						sizeof(numbuf), value, 6);
+					g_string_append(out, numbuf);
+					g_string_append(out, ctx->value);
 				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
-							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
+					g_string_append_c(out,
+						ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0');
+					g_string_append(out, ctx->value);
 				} else {
 					sr_warn("Unexpected channel type: %d",
 						ctx->channels[i].ch->type);
@@ -503,24 +544,20 @@ static void dump_saved_values(struct context *ctx, GString **out)
 			}
 
 			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
+				g_string_append_printf(out, "%d%s",
 					ctx->trigger, ctx->value);
 				ctx->trigger = FALSE;
 			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+			g_string_truncate(out, out->len - 1);
+			g_string_append(out, ctx->record);
 		}
 	}
 
-	/* Discard all of the working space. */
-	g_free(ctx->previous_sample);
-	g_free(ctx->analog_samples);
-	g_free(ctx->logic_samples);
+	/* Start over with the next set, keeping the buffers. */
 	ctx->channels_seen = 0;
 	ctx->num_samples = 0;
-	ctx->previous_sample = NULL;
-	ctx->analog_samples = NULL;
-	ctx->logic_samples = NULL;
+	ctx->have_analog = FALSE;
+	ctx->have_logic = FALSE;
 }
 
 static void save_gnuplot(struct context *ctx)
@@ -655,13 +692,12 @@ static void check_input_constraints(struct context *ctx)
 }
 
 static int receive(const struct sr_output *o,
-		   const struct sr_datafeed_packet *packet, GString **out)
+		   const struct sr_datafeed_packet *packet, GString *out)
 {
 	struct context *ctx;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -673,13 +709,12 @@ static int receive(const struct sr_output *o,
 		ctx->have_checked = FALSE;
 		ctx->have_frames = FALSE;
 		ctx->pkt_snums = FALSE;
-		*out = gen_header(o, packet->payload);
+		gen_header(o, packet->payload, out);
 		break;
 	case SR_DF_TRIGGER:
 		ctx->trigger = TRUE;
 		break;
 	case SR_DF_LOGIC:
-		*out = g_string_sized_new(512);
 		logic = packet->payload;
 		ctx->pkt_snums = logic->length;
 		ctx->pkt_snums /= logic->length;
@@ -687,7 +722,6 @@ static int receive(const struct sr_output *o,
 		process_logic(ctx, logic);
 		break;
 	case SR_DF_ANALOG:
-		*out = g_string_sized_new(512);
 		analog = packet->payload;
 		ctx->pkt_snums = analog->num_samples;
 		ctx->pkt_snums /= g_slist_length(analog->meaning->channels);
@@ -696,7 +730,7 @@ static int receive(const struct sr_output *o,
 		break;
 	case SR_DF_FRAME_BEGIN:
 		ctx->have_frames = TRUE;
-		*out = g_string_new(ctx->frame);
+		g_string_append(out, ctx->frame);
 		/* Fallthrough */
 	case SR_DF_END:
 		/* Got to end of frame/session with part of the data. */
@@ -729,6 +763,9 @@ static int cleanup(struct sr_output *o)
 		g_free((gpointer)ctx->gnuplot);
 		g_free((gpointer)ctx->value);
 		g_free(ctx->previous_sample);
+		g_free(ctx->analog_samples);
+		g_free(ctx->logic_samples);
+		g_free(ctx->fdata);
 		g_free(ctx->channels);
 		g_free(o->priv);
 		o->priv = NULL;
@@ -785,6 +822,6 @@ SR_PRIV struct sr_output_module output_csv = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
@@ -28,6 +28,12 @@
 
 #define DEFAULT_SAMPLES_PER_LINE 192
 
+/* Samples which get transposed at once, and the resulting plane size. */
+#define RUN_SAMPLES 4096
+#define PLANE_STRIDE ((RUN_SAMPLES + 7 + 7) / 8)
+
+static const char hex_digits[] = "0123456789abcdef";
+
 struct context {
 	unsigned int num_enabled_channels;
 	int spl;
@@ -41,6 +47,13 @@ struct context {
 	uint8_t *sample_buf;
 	gboolean header_done;
 	GString **lines;
+	/* Bytes of a sample which hold enabled channels. */
+	size_t *columns;
+	size_t num_columns;
+	/* Per channel bits of the current run, see sr_output_logic_planes(). */
+	uint8_t *planes;
+	/* The two digits and separator for a plane byte. */
+	char lut[256][3];
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -48,7 +61,9 @@ static int init(struct sr_output *o, GHashTable *options)
 	struct context *ctx;
 	struct sr_channel *ch;
 	GSList *l;
-	unsigned int i, j;
+	unsigned int i, j, b;
+	size_t line_len;
+	int max_index;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
@@ -57,6 +72,13 @@ static int init(struct sr_output *o, GHashTable *options)
 	o->priv = ctx;
 	ctx->trigger = -1;
 	ctx->spl = g_variant_get_uint32(g_hash_table_lookup(options, "width"));
+	line_len = ctx->spl > 0 ? ctx->spl / 8 * 3 + 3 : 80;
+
+	for (i = 0; i < 256; i++) {
+		ctx->lut[i][0] = hex_digits[i >> 4];
+		ctx->lut[i][1] = hex_digits[i & 0xf];
+		ctx->lut[i][2] = ' ';
+	}
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -71,7 +93,10 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->lines = g_malloc(sizeof(GString *) * ctx->num_enabled_channels);
 	ctx->sample_buf = g_malloc(ctx->num_enabled_channels);
 
+	ctx->columns = g_malloc0(sizeof(size_t) * ctx->num_enabled_channels);
+
 	j = 0;
+	max_index = 0;
 	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
 		ch = l->data;
 		if (ch->type != SR_CHANNEL_LOGIC)
@@ -80,20 +105,27 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
 		ctx->channel_index[j] = ch->index;
 		ctx->channel_names[j] = ch->name;
-		ctx->lines[j] = g_string_sized_new(80);
+		ctx->lines[j] = g_string_sized_new(strlen(ch->name) + 1 + line_len);
 		ctx->sample_buf[j] = 0;
 		g_string_printf(ctx->lines[j], "%s:", ch->name);
+		for (b = 0; b < ctx->num_columns; b++) {
+			if (ctx->columns[b] == (size_t)ch->index / 8)
+				break;
+		}
+		if (b == ctx->num_columns)
+			ctx->columns[ctx->num_columns++] = ch->index / 8;
+		max_index = MAX(max_index, ch->index);
 		j++;
 	}
+	ctx->planes = g_malloc0((max_index / 8 + 1) * 8 * PLANE_STRIDE);
 
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	GVariant *gvar;
-	GString *header;
 	int num_channels;
 	char *samplerate_s;
 
@@ -106,8 +138,7 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
-	g_string_printf(header, "%s %s\n", PACKAGE_NAME, sr_package_version_string_get());
+	g_string_append_printf(header, "%s %s\n", PACKAGE_NAME, sr_package_version_string_get());
 	num_channels = g_slist_length(o->sdi->channels);
 	g_string_append_printf(header, "Acquisition with %d/%d channels",
 			ctx->num_enabled_channels, num_channels);
@@ -117,23 +148,76 @@ static GString *gen_header(const struct sr_output *o)
 		g_free(samplerate_s);
 	}
 	g_string_append_printf(header, "\n");
+}
+
+static void transpose(struct context *ctx, const uint8_t *data,
+		size_t unitsize, size_t count, size_t skip)
+{
+	uint8_t *planes;
+	size_t i, column;
+
+	for (i = 0; i < ctx->num_columns; i++) {
+		column = ctx->columns[i];
+		planes = ctx->planes + column * 8 * PLANE_STRIDE;
+		if (column < unitsize)
+			sr_output_logic_planes(data, unitsize, count, column,
+				skip, planes, PLANE_STRIDE);
+		else
+			memset(planes, 0, 8 * PLANE_STRIDE);
+	}
+}
 
-	return header;
+/*
+ * Append a run of one channel's samples to its line. Every eighth
+ * sample on the line completes a byte, which gets printed. Bits of an
+ * incomplete byte are kept in the channel's sample buffer, which is
+ * only cleared when a byte got printed.
+ */
+static void render(struct context *ctx, unsigned int ch,
+		const uint8_t *plane, size_t skip, size_t count)
+{
+	GString *line;
+	uint8_t sample_buf, byte;
+	size_t end, g, line_len, tail;
+	char *p;
+
+	line = ctx->lines[ch];
+	sample_buf = ctx->sample_buf[ch];
+	end = skip + count;
+
+	line_len = line->len;
+	g_string_set_size(line, line_len + end / 8 * 3);
+	p = line->str + line_len;
+	for (g = 0; g < end / 8; g++) {
+		byte = plane[g];
+		if (g == 0)
+			byte |= sample_buf << (8 - skip);
+		memcpy(p, ctx->lut[byte], 3);
+		p += 3;
+	}
+
+	tail = end & 7;
+	if (end >= 8)
+		sample_buf = tail ? plane[end / 8] >> (8 - tail) : 0;
+	else
+		sample_buf = (sample_buf << count) |
+			((plane[0] >> (8 - end)) & ((1 << count) - 1));
+	ctx->sample_buf[ch] = sample_buf;
 }
 
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+		GString *out)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	int idx, pos, offset;
-	uint64_t i, j;
-	gchar *p;
+	const uint8_t *data;
+	uint64_t i, j, num_samples, count;
+	size_t skip;
+	int offset;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -154,60 +238,60 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_LOGIC:
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else
-			*out = g_string_sized_new(512);
+		}
 
 		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
-			pos = ctx->spl_cnt & 7;
+		data = logic->data;
+		num_samples = logic->length / logic->unitsize;
+		while (num_samples) {
+			/* Runs end at the end of a line. */
+			count = MIN(num_samples, RUN_SAMPLES);
+			if (ctx->spl > 0)
+				count = MIN(count, (uint64_t)(ctx->spl - ctx->spl_cnt));
+			skip = ctx->spl_cnt & 7;
+			transpose(ctx, data, logic->unitsize, count, skip);
 			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				ctx->sample_buf[j] <<= 1;
-				if (*p & (1 << (idx % 8)))
-					ctx->sample_buf[j] |= 1;
-				if (ctx->spl_cnt && pos == 0) {
-					/* Buffered a byte's worth, output hex. */
-					g_string_append_printf(ctx->lines[j], "%.2x ",
-							ctx->sample_buf[j]);
-					ctx->sample_buf[j] = 0;
-				}
+				render(ctx, j, ctx->planes +
+					ctx->channel_index[j] * PLANE_STRIDE,
+					skip, count);
+			}
+			ctx->spl_cnt += count;
+			data += count * logic->unitsize;
+			num_samples -= count;
+			if (ctx->spl_cnt != ctx->spl)
+				continue;
 
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						/*
-						 * Sample data lines have one character per nibble,
-						 * plus one separator per byte. Align trigger marker
-						 * to this layout.
-						 */
-						offset = ctx->trigger / 4 + ctx->trigger / 8;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
-					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
+			for (j = 0; j < ctx->num_enabled_channels; j++) {
+				/* Flush line buffers. */
+				g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+				g_string_append_c(out, '\n');
+				if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
+					/*
+					 * Sample data lines have one character per nibble,
+					 * plus one separator per byte. Align trigger marker
+					 * to this layout.
+					 */
+					offset = ctx->trigger / 4 + ctx->trigger / 8;
+					g_string_append_printf(out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+					ctx->trigger = -1;
 				}
+				g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
 			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
-				ctx->spl_cnt = 0;
+			/* Line buffers were already flushed. */
+			ctx->spl_cnt = 0;
 		}
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
 			/* Line buffers need flushing. */
-			*out = g_string_sized_new(512);
 			for (i = 0; i < ctx->num_enabled_channels; i++) {
 				if (ctx->spl_cnt & 7)
 					g_string_append_printf(ctx->lines[i], "%.2x ",
 							ctx->sample_buf[i] << (8 - (ctx->spl_cnt & 7)));
-				g_string_append_len(*out, ctx->lines[i]->str, ctx->lines[i]->len);
-				g_string_append_c(*out, '\n');
+				g_string_append_len(out, ctx->lines[i]->str, ctx->lines[i]->len);
+				g_string_append_c(out, '\n');
 			}
 		}
 		break;
@@ -229,6 +313,8 @@ static int cleanup(struct sr_output *o)
 
 	g_free(ctx->channel_index);
 	g_free(ctx->sample_buf);
+	g_free(ctx->columns);
+	g_free(ctx->planes);
 	g_free(ctx->channel_names);
 	for (i = 0; i < ctx->num_enabled_channels; i++)
 		g_string_free(ctx->lines[i], TRUE);
@@ -262,6 +348,6 @@ SR_PRIV struct sr_output_module output_hex = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -275,6 +277,7 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	op->module = omod;
 	op->sdi = sdi;
 	op->filename = g_strdup(filename);
+	op->fd_buf = NULL;
 
 	new_opts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
 			(GDestroyNotify)g_variant_unref);
@@ -318,6 +321,8 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	if (op->module->init && op->module->init(op, new_opts) != SR_OK) {
 		g_free(op);
 		op = NULL;
+	} else if (op->module->receive_append) {
+		op->fd_buf = g_string_sized_new(4096);
 	}
 	if (new_opts)
 		g_hash_table_destroy(new_opts);
@@ -336,12 +341,198 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
-	return o->module->receive(o, packet, out);
+	int ret;
+
+	if (o->module->receive)
+		return o->module->receive(o, packet, out);
+
+	*out = g_string_new(NULL);
+	ret = o->module->receive_append(o, packet, *out);
+	if (ret != SR_OK || !(*out)->len) {
+		g_string_free(*out, TRUE);
+		*out = NULL;
+	}
+
+	return ret;
+}
+
+/**
+ * Send a packet to the specified output instance, appending the output
+ * to a caller provided buffer.
+ *
+ * Unlike sr_output_send(), this doesn't allocate a GString for every
+ * packet when the caller reuses the buffer (e.g. by truncating it after
+ * its content was written).
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param packet The packet to send. Must not be NULL.
+ * @param out The buffer to append the output to. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Other error.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_send_append(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString *out)
+{
+	GString *tmp;
+	int ret;
+
+	if (!o || !packet || !out)
+		return SR_ERR_ARG;
+
+	if (o->module->receive_append)
+		return o->module->receive_append(o, packet, out);
+
+	tmp = NULL;
+	ret = o->module->receive(o, packet, &tmp);
+	if (tmp) {
+		g_string_append_len(out, tmp->str, tmp->len);
+		g_string_free(tmp, TRUE);
+	}
+
+	return ret;
+}
+
+/*
+ * Each packet is rendered into one contiguous buffer, so a plain write()
+ * loop does all that writev() would do with a single element vector.
+ */
+static int write_all(int fd, const char *data, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, data, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			sr_err("Cannot write output: %s.", g_strerror(errno));
+			return SR_ERR_IO;
+		}
+		data += ret;
+		len -= ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Send a packet to the specified output instance, writing the output
+ * to a file descriptor.
+ *
+ * The output gets rendered into a buffer which the output instance
+ * keeps, so no memory is allocated per packet once the buffer has
+ * grown to the size of the largest output.
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param packet The packet to send. Must not be NULL.
+ * @param fd The file descriptor to write to.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Write error.
+ * @retval other Other error.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_send_fd(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, int fd)
+{
+	GString *out;
+	int ret;
+
+	if (!o || !packet || fd < 0)
+		return SR_ERR_ARG;
+
+	if (!o->module->receive_append) {
+		out = NULL;
+		ret = o->module->receive(o, packet, &out);
+		if (ret == SR_OK && out)
+			ret = write_all(fd, out->str, out->len);
+		if (out)
+			g_string_free(out, TRUE);
+		return ret;
+	}
+
+	/* The buffer was allocated along with the instance. */
+	out = o->fd_buf;
+	g_string_truncate(out, 0);
+	ret = o->module->receive_append(o, packet, out);
+	if (ret == SR_OK && out->len)
+		ret = write_all(fd, out->str, out->len);
+
+	return ret;
+}
+
+/**
+ * Transpose one byte column of logic samples into per channel bit planes.
+ *
+ * Plane m receives the bits of channel (column * 8 + m), packed eight
+ * samples per byte with the earliest sample in the most significant
+ * bit. Sample k goes to bit position (skip + k), so that callers can
+ * align the planes to their own grouping. Bits before skip and after
+ * the last sample are zero.
+ *
+ * @param data The logic samples.
+ * @param unitsize The size of a sample in bytes.
+ * @param count The number of samples.
+ * @param column The byte within a sample to transpose.
+ * @param skip The bit position of the first sample, 0 to 7.
+ * @param planes Receives eight planes of (skip + count + 7) / 8 bytes each.
+ * @param stride The distance between planes in bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_logic_planes(const uint8_t *data, size_t unitsize,
+		size_t count, size_t column, size_t skip,
+		uint8_t *planes, size_t stride)
+{
+	const uint8_t *p;
+	uint64_t x, t;
+	size_t groups, g, lane, m;
+	ptrdiff_t k;
+
+	data += column;
+	groups = (skip + count + 7) / 8;
+	for (g = 0; g < groups; g++) {
+		/* Earliest sample in the most significant byte. */
+		k = (ptrdiff_t)(g * 8) - (ptrdiff_t)skip;
+		x = 0;
+		if (k >= 0 && (size_t)k + 8 <= count) {
+			p = data + k * unitsize;
+			for (lane = 0; lane < 8; lane++, p += unitsize)
+				x = (x << 8) | *p;
+		} else {
+			for (lane = 0; lane < 8; lane++, k++) {
+				x <<= 8;
+				if (k >= 0 && (size_t)k < count)
+					x |= data[k * unitsize];
+			}
+		}
+
+		/* Transpose the 8x8 bit matrix, rows being bytes. */
+		t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+		x = x ^ t ^ (t << 7);
+		t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+		x = x ^ t ^ (t << 14);
+		t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+		x = x ^ t ^ (t << 28);
+
+		for (m = 0; m < 8; m++)
+			planes[m * stride + g] = x >> (8 * m);
+	}
 }
 
 /**
  * Free the specified output instance and all associated resources.
  *
+ * Some modules (e.g. WAV) patch up the file given to sr_output_new()
+ * at this point, so all output must have been written to that file,
+ * and flushed, before calling this.
+ *
  * @since 0.4.0
  */
 SR_API int sr_output_free(const struct sr_output *o)
@@ -354,6 +545,8 @@ SR_API int sr_output_free(const struct sr_output *o)
 	ret = SR_OK;
 	if (o->module->cleanup)
 		ret = o->module->cleanup((struct sr_output *)o);
+	if (o->fd_buf)
+		g_string_free(o->fd_buf, TRUE);
 	g_free((char *)o->filename);
 	g_free((gpointer)o);
 
@@ -195,9 +195,11 @@ static void format_vcd_value_bit(GString *s, uint8_t bit_value, GString *id)
 
 static void format_vcd_value_real(GString *s, double real_value, GString *id)
 {
+	char buf[G_ASCII_DTOSTR_BUF_SIZE];
 
 	g_string_append_c(s, 'r');
-	g_string_append_printf(s, "%.16g", real_value);
+	sr_format_double_ascii(buf, sizeof(buf), real_value, 16);
+	g_string_append(s, buf);
 	g_string_append_c(s, ' ');
 	g_string_append(s, id->str);
 }
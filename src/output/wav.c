@@ -18,101 +18,173 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/wav"
 
-/* Minimum/maximum number of samples per channel to put in a data chunk */
-#define MIN_DATA_CHUNK_SAMPLES 10
+/* RIFF header, "fmt " chunk and "data" chunk header. */
+#define HEADER_SIZE 46
+#define RIFF_SIZE_OFFSET 4
+#define DATA_SIZE_OFFSET 42
 
-struct out_context {
-	double scale;
-	gboolean header_done;
-	uint64_t samplerate;
-	int num_channels;
-	GSList *channels;
-	int chanbuf_size;
-	int *chanbuf_used;
-	uint8_t **chanbuf;
-	float *fdata;
-};
+typedef double (*read_func)(const uint8_t **p);
+typedef void (*write_func)(uint8_t *p, double value);
 
-static int realloc_chanbufs(const struct sr_output *o, int size)
+static void write_float(uint8_t *p, double value)
 {
-	struct out_context *outc;
-	int i;
-
-	outc = o->priv;
-	for (i = 0; i < outc->num_channels; i++) {
-		if (!(outc->chanbuf[i] = g_try_realloc(outc->chanbuf[i], sizeof(float) * size))) {
-			sr_err("Unable to allocate enough output buffer memory.");
-			return SR_ERR;
-		}
-		outc->chanbuf_used[i] = 0;
-	}
-	outc->chanbuf_size = size;
-
-	return SR_OK;
+	write_fltle(p, value);
 }
 
-static int flush_chanbufs(const struct sr_output *o, GString *out)
+static void write_pcm16(uint8_t *p, double value)
 {
-	struct out_context *outc;
-	int num_samples, i, j;
-	char *buf, *bufp;
+	value = isnan(value) ? 0 : CLAMP(value, -1.0, 1.0);
+	WL16(p, lround(value * 32767));
+}
 
-	outc = o->priv;
+static void write_pcm24(uint8_t *p, double value)
+{
+	value = isnan(value) ? 0 : CLAMP(value, -1.0, 1.0);
+	WL24(p, lround(value * 8388607));
+}
 
-	/* Any one of them will do. */
-	num_samples = outc->chanbuf_used[0];
-	if (!(buf = g_try_malloc(4 * num_samples * outc->num_channels))) {
-		sr_err("Unable to allocate enough interleaved output buffer memory.");
-		return SR_ERR;
-	}
+static const struct wav_format {
+	const char *name;
+	uint16_t code;
+	size_t sample_size;
+	write_func write;
+} wav_formats[] = {
+	/* Format code 3 = IEEE float, 1 = PCM */
+	{ "float", 0x0003, 4, write_float },
+	{ "pcm16", 0x0001, 2, write_pcm16 },
+	{ "pcm24", 0x0001, 3, write_pcm24 },
+};
 
-	bufp = buf;
-	for (i = 0; i < num_samples; i++) {
-		for (j = 0; j < outc->num_channels; j++) {
-			memcpy(bufp, outc->chanbuf[j] + i * 4, 4);
-			bufp += 4;
-		}
-	}
-	g_string_append_len(out, buf, 4 * num_samples * outc->num_channels);
-	g_free(buf);
+static double get_u8(const uint8_t **p) { return read_u8_inc(p); }
+static double get_i8(const uint8_t **p) { return read_i8_inc(p); }
+static double get_u16le(const uint8_t **p) { return read_u16le_inc(p); }
+static double get_u16be(const uint8_t **p) { return read_u16be_inc(p); }
+static double get_i16le(const uint8_t **p) { return read_i16le_inc(p); }
+static double get_i16be(const uint8_t **p) { return read_i16be_inc(p); }
+static double get_u32le(const uint8_t **p) { return read_u32le_inc(p); }
+static double get_u32be(const uint8_t **p) { return read_u32be_inc(p); }
+static double get_i32le(const uint8_t **p) { return read_i32le_inc(p); }
+static double get_i32be(const uint8_t **p) { return read_i32be_inc(p); }
+static double get_fltle(const uint8_t **p) { return read_fltle_inc(p); }
+static double get_fltbe(const uint8_t **p) { return read_fltbe_inc(p); }
+static double get_dblle(const uint8_t **p) { return read_dblle_inc(p); }
+static double get_dblbe(const uint8_t **p) { return read_dblbe_inc(p); }
+
+static const struct {
+	gboolean is_float;
+	gboolean is_signed;
+	gboolean is_bigendian;
+	uint8_t unitsize;
+	read_func read;
+} readers[] = {
+	{ FALSE, FALSE, FALSE, 1, get_u8 },
+	{ FALSE, TRUE, FALSE, 1, get_i8 },
+	{ FALSE, FALSE, FALSE, 2, get_u16le },
+	{ FALSE, FALSE, TRUE, 2, get_u16be },
+	{ FALSE, TRUE, FALSE, 2, get_i16le },
+	{ FALSE, TRUE, TRUE, 2, get_i16be },
+	{ FALSE, FALSE, FALSE, 4, get_u32le },
+	{ FALSE, FALSE, TRUE, 4, get_u32be },
+	{ FALSE, TRUE, FALSE, 4, get_i32le },
+	{ FALSE, TRUE, TRUE, 4, get_i32be },
+	{ TRUE, TRUE, FALSE, 4, get_fltle },
+	{ TRUE, TRUE, TRUE, 4, get_fltbe },
+	{ TRUE, TRUE, FALSE, 8, get_dblle },
+	{ TRUE, TRUE, TRUE, 8, get_dblbe },
+};
 
-	for (i = 0; i < outc->num_channels; i++)
-		outc->chanbuf_used[i] = 0;
+struct out_context {
+	double scale;
+	gboolean header_done;
+	uint64_t samplerate;
+	int num_channels;
+	GSList *channels;
+	const struct wav_format *format;
+	/*
+	 * Lines up channels which arrive in separate packets, and logic
+	 * packets, if logic channels are enabled.
+	 */
+	struct sr_aligner *aligner;
+	gboolean have_logic;
+	/* Samples fed to the aligner per channel, and handed out by it. */
+	uint64_t *fed;
+	uint64_t aligned;
+	GString *aligner_out;
+	/* Per packet channel: index in the WAV frame and destination. */
+	int *chan_idx;
+	uint8_t **dest;
+	float *fdata;
+	/* Bytes emitted so far, and the size of the data chunk. */
+	uint64_t total_size;
+	uint64_t data_size;
+};
 
-	return SR_OK;
-}
+static int write_block(const struct sr_aligned_block *block, void *cb_data);
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 	struct sr_channel *ch;
 	GSList *l;
+	const char *s;
+	unsigned int i;
+	int ret;
 
 	outc = g_malloc0(sizeof(struct out_context));
 	o->priv = outc;
 	outc->scale = g_variant_get_double(g_hash_table_lookup(options, "scale"));
+	s = g_variant_get_string(g_hash_table_lookup(options, "format"), NULL);
+	for (i = 0; i < G_N_ELEMENTS(wav_formats); i++) {
+		if (!strcmp(s, wav_formats[i].name))
+			outc->format = &wav_formats[i];
+	}
+	if (!outc->format) {
+		sr_err("Unsupported sample format '%s'.", s);
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
-		if (ch->type != SR_CHANNEL_ANALOG)
-			continue;
 		if (!ch->enabled)
 			continue;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			outc->have_logic = TRUE;
+		if (ch->type != SR_CHANNEL_ANALOG)
+			continue;
 		outc->channels = g_slist_append(outc->channels, ch);
 		outc->num_channels++;
 	}
 
-	outc->chanbuf = g_malloc0(sizeof(float *) * outc->num_channels);
-	outc->chanbuf_used = g_malloc0(sizeof(int) * outc->num_channels);
-
-	/* Start off the interleaved buffer with 100 samples/channel. */
-	realloc_chanbufs(o, 100);
+	outc->fed = g_malloc0(sizeof(uint64_t) * outc->num_channels);
+	outc->chan_idx = g_malloc0(sizeof(int) * outc->num_channels);
+	outc->dest = g_malloc0(sizeof(uint8_t *) * outc->num_channels);
+
+	if (outc->num_channels) {
+		ret = sr_aligner_new(&outc->aligner, o->sdi, 0, 0,
+			write_block, outc);
+		if (ret != SR_OK) {
+			g_slist_free(outc->channels);
+			g_free(outc->fed);
+			g_free(outc->chan_idx);
+			g_free(outc->dest);
+			g_free(outc);
+			o->priv = NULL;
+			return ret;
+		}
+	}
 
 	return SR_OK;
 }
@@ -120,15 +192,16 @@ static int init(struct sr_output *o, GHashTable *options)
 static void add_data_chunk(const struct sr_output *o, GString *gs)
 {
 	struct out_context *outc;
+	size_t frame_size;
 	char tmp[4];
 
 	outc = o->priv;
+	frame_size = outc->num_channels * outc->format->sample_size;
 	g_string_append(gs, "fmt ");
 	/* Remaining chunk size */
 	WL32(tmp, 0x12);
 	g_string_append_len(gs, tmp, 4);
-	/* Format code 3 = IEEE float */
-	WL16(tmp, 0x0003);
+	WL16(tmp, outc->format->code);
 	g_string_append_len(gs, tmp, 2);
 	/* Number of channels */
 	WL16(tmp, outc->num_channels);
@@ -136,29 +209,28 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	/* Samplerate */
 	WL32(tmp, outc->samplerate);
 	g_string_append_len(gs, tmp, 4);
-	/* Byterate, using 32-bit floats. */
-	WL32(tmp, outc->samplerate * outc->num_channels * 4);
+	/* Byterate */
+	WL32(tmp, outc->samplerate * frame_size);
 	g_string_append_len(gs, tmp, 4);
 	/* Blockalign */
-	WL16(tmp, outc->num_channels * 4);
+	WL16(tmp, frame_size);
 	g_string_append_len(gs, tmp, 2);
 	/* Bits per sample */
-	WL16(tmp, 32);
+	WL16(tmp, outc->format->sample_size * 8);
 	g_string_append_len(gs, tmp, 2);
 	WL16(tmp, 0);
 	g_string_append_len(gs, tmp, 2);
 
 	g_string_append(gs, "data");
-	/* Data chunk size, max it out. */
+	/* Data chunk size, max it out. Fixed up at the end for files. */
 	WL32(tmp, 0xffffffff);
 	g_string_append_len(gs, tmp, 4);
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct out_context *outc;
 	GVariant *gvar;
-	GString *header;
 	char tmp[4];
 
 	outc = o->priv;
@@ -170,85 +242,170 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
 	g_string_append(header, "RIFF");
 	/* Total size. Max out the field. */
 	WL32(tmp, 0xffffffff);
 	g_string_append_len(header, tmp, 4);
 	g_string_append(header, "WAVE");
 	add_data_chunk(o, header);
+	outc->total_size += HEADER_SIZE;
+}
+
+static read_func find_reader(const struct sr_analog_encoding *encoding)
+{
+	unsigned int i;
 
-	return header;
+	for (i = 0; i < G_N_ELEMENTS(readers); i++) {
+		if (readers[i].unitsize != encoding->unitsize)
+			continue;
+		if (readers[i].is_float != encoding->is_float)
+			continue;
+		if (!encoding->is_float && readers[i].is_signed != encoding->is_signed)
+			continue;
+		if (encoding->unitsize > 1 &&
+				readers[i].is_bigendian != encoding->is_bigendian)
+			continue;
+		return readers[i].read;
+	}
+
+	return NULL;
 }
 
 /*
- * Stores the float in little-endian BINARY32 IEEE-754 2008 format.
+ * Convert the samples of a packet and store channel j's values at
+ * outc->dest[j], stride bytes apart.
  */
-static void float_to_le(uint8_t *buf, float value)
+static int convert(struct out_context *outc,
+		const struct sr_datafeed_analog *analog, int num_channels,
+		size_t stride)
 {
-	uint8_t *old;
-
-	old = (uint8_t *)&value;
+	const struct sr_analog_encoding *encoding;
+	const uint8_t *src;
+	read_func reader;
+	write_func writer;
+	double scale, offset, value;
+	uint32_t i;
+	int j, ret;
+
+	encoding = analog->encoding;
+	reader = find_reader(encoding);
+	if (reader) {
+		src = analog->data;
+		scale = (double)encoding->scale.p / encoding->scale.q;
+		offset = (double)encoding->offset.p / encoding->offset.q;
+	} else {
+		/* Let the generic code handle uncommon encodings. */
+		src = g_try_realloc(outc->fdata,
+			sizeof(float) * analog->num_samples * num_channels);
+		if (!src)
+			return SR_ERR_MALLOC;
+		outc->fdata = (float *)src;
+		if ((ret = sr_analog_to_float(analog, outc->fdata)) != SR_OK)
+			return ret;
 #ifdef WORDS_BIGENDIAN
-	buf[0] = old[3];
-	buf[1] = old[2];
-	buf[2] = old[1];
-	buf[3] = old[0];
+		reader = get_fltbe;
 #else
-	buf[0] = old[0];
-	buf[1] = old[1];
-	buf[2] = old[2];
-	buf[3] = old[3];
+		reader = get_fltle;
 #endif
+		scale = 1.0;
+		offset = 0.0;
+	}
+	scale /= outc->scale;
+	offset /= outc->scale;
+
+	writer = outc->format->write;
+	for (i = 0; i < analog->num_samples; i++) {
+		for (j = 0; j < num_channels; j++) {
+			value = reader(&src) * scale + offset;
+			writer(outc->dest[j] + i * stride, value);
+		}
+	}
+
+	return SR_OK;
 }
 
 /*
- * Returns the number of samples used in the current channel buffers,
- * or -1 if they're not all the same.
+ * Write the frames of an aligned block. The analog columns come in
+ * the order of the enabled channels, just like the WAV channels.
  */
-static int check_chanbuf_size(const struct sr_output *o)
+static int write_block(const struct sr_aligned_block *block, void *cb_data)
 {
 	struct out_context *outc;
-	int size, i;
+	GString *out;
+	size_t sample_size, frame_size, size, i, j;
+	write_func writer;
+	uint8_t *dest;
+
+	outc = cb_data;
+	out = outc->aligner_out;
+	sample_size = outc->format->sample_size;
+	frame_size = block->num_analog * sample_size;
+	size = block->num_samples * frame_size;
+	writer = outc->format->write;
+
+	g_string_set_size(out, out->len + size);
+	dest = (uint8_t *)out->str + out->len - size;
+	for (i = 0; i < block->num_samples; i++) {
+		for (j = 0; j < block->num_analog; j++)
+			writer(dest + i * frame_size + j * sample_size,
+				block->analog[j][i] / outc->scale);
+	}
+	outc->aligned += block->num_samples;
+	outc->data_size += size;
+	outc->total_size += size;
 
-	outc = o->priv;
-	size = 0;
-	for (i = 0; i < outc->num_channels; i++) {
-		if (size == 0) {
-			if (outc->chanbuf_used[i] == 0) {
-				/* Nothing in all the buffers yet. */
-				size = -1;
-				break;
-			} else {
-				/* New high water mark. */
-				size = outc->chanbuf_used[i];
-			}
-		} else if (outc->chanbuf_used[i] != size) {
-			/* All channel buffers are not equally full yet. */
-			size = -1;
-			break;
-		}
+	return SR_OK;
+}
+
+/* Check whether the aligner holds samples which were not written yet. */
+static gboolean aligner_pending(const struct out_context *outc)
+{
+	int j;
+
+	/* Analog data must line up with logic data in the aligner. */
+	if (outc->have_logic)
+		return TRUE;
+	for (j = 0; j < outc->num_channels; j++) {
+		if (outc->fed[j] != outc->aligned)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static int feed_aligner(struct out_context *outc,
+		const struct sr_datafeed_packet *packet, GString *out)
+{
+	int ret;
+
+	if (!outc->aligner)
+		return SR_OK;
+
+	outc->aligner_out = out;
+	ret = sr_aligner_feed(outc->aligner, packet);
+	outc->aligner_out = NULL;
+
+	/* These restart the aligner's sample numbers. */
+	if (packet->type == SR_DF_HEADER || packet->type == SR_DF_END) {
+		memset(outc->fed, 0, sizeof(uint64_t) * outc->num_channels);
+		outc->aligned = 0;
 	}
 
-	return size;
+	return ret;
 }
 
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+		GString *out)
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
-	struct sr_channel *ch;
 	GSList *l;
-	const GSList *channels;
-	float f;
-	int num_channels, num_samples, size, *chan_idx, idx, i, j, ret;
-	float *data;
-	uint8_t *buf;
+	size_t sample_size, frame_size, size, len;
+	gboolean direct;
+	int num_channels, idx, i, ret;
 
-	*out = NULL;
 	if (!o || !o->sdi || !(outc = o->priv))
 		return SR_ERR_ARG;
 
@@ -264,24 +421,13 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_ANALOG:
 		if (!outc->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			outc->header_done = TRUE;
-		} else {
-			*out = g_string_sized_new(512);
 		}
 
 		analog = packet->payload;
-		num_samples = analog->num_samples;
-		channels = analog->meaning->channels;
 		num_channels = g_slist_length(analog->meaning->channels);
-		if (!(data = g_try_realloc(outc->fdata, sizeof(float) * num_samples * num_channels)))
-			return SR_ERR_MALLOC;
-		outc->fdata = data;
-		ret = sr_analog_to_float(analog, data);
-		if (ret != SR_OK)
-			return ret;
-
-		if (num_samples == 0)
+		if (analog->num_samples == 0)
 			return SR_OK;
 
 		if (num_channels > outc->num_channels) {
@@ -290,41 +436,70 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			return SR_ERR;
 		}
 
-		if (num_samples > outc->chanbuf_size) {
-			if (realloc_chanbufs(o, analog->num_samples) != SR_OK)
-				return SR_ERR_MALLOC;
-		}
-
-		/* Index the channels in this packet, so we can interleave quicker. */
-		chan_idx = g_malloc(sizeof(int) * outc->num_channels);
-		for (i = 0; i < num_channels; i++) {
-			ch = g_slist_nth_data((GSList *) channels, i);
-			chan_idx[i] = g_slist_index(outc->channels, ch);
+		/*
+		 * Index the channels in this packet, so we can interleave
+		 * quicker. Packets with all channels go right into the
+		 * frames, unless the aligner holds samples of their own.
+		 */
+		direct = num_channels == outc->num_channels &&
+			!aligner_pending(outc);
+		for (i = 0, l = analog->meaning->channels; l; i++, l = l->next) {
+			idx = g_slist_index(outc->channels, l->data);
+			if (idx < 0) {
+				sr_err("Packet has a channel which is not enabled.");
+				return SR_ERR;
+			}
+			outc->chan_idx[i] = idx;
 		}
 
-		for (i = 0; i < num_samples; i++) {
-			for (j = 0; j < num_channels; j++) {
-				idx = chan_idx[j];
-				buf = outc->chanbuf[idx] + outc->chanbuf_used[idx]++ * 4;
-				f = data[i * num_channels + j];
-				if (outc->scale != 1.0)
-					f /= outc->scale;
-				float_to_le(buf, f);
+		sample_size = outc->format->sample_size;
+		frame_size = outc->num_channels * sample_size;
+		if (direct) {
+			/* All channels at once: convert right into the frames. */
+			size = analog->num_samples * frame_size;
+			len = out->len;
+			g_string_set_size(out, len + size);
+			for (i = 0; i < num_channels; i++)
+				outc->dest[i] = (uint8_t *)out->str + len +
+					outc->chan_idx[i] * sample_size;
+			if ((ret = convert(outc, analog, num_channels, frame_size)) != SR_OK) {
+				g_string_truncate(out, len);
+				return ret;
 			}
+			outc->data_size += size;
+			outc->total_size += size;
+			break;
 		}
-		g_free(chan_idx);
 
-		size = check_chanbuf_size(o);
-		if (size > MIN_DATA_CHUNK_SAMPLES)
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
+		if ((ret = feed_aligner(outc, packet, out)) != SR_OK)
+			return ret;
+		for (i = 0; i < num_channels; i++)
+			outc->fed[outc->chan_idx[i]] += analog->num_samples;
 		break;
+	case SR_DF_HEADER:
+		return feed_aligner(outc, packet, out);
+	case SR_DF_LOGIC:
+		/* Only needed to line up the analog data. */
+		if (!outc->aligner)
+			break;
+		if (!outc->header_done) {
+			gen_header(o, out);
+			outc->header_done = TRUE;
+		}
+		return feed_aligner(outc, packet, out);
 	case SR_DF_END:
-		size = check_chanbuf_size(o);
-		if (size > 0) {
-			*out = g_string_sized_new(4 * size * outc->num_channels);
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
+		/*
+		 * Write what the aligner holds. Samples which some channels
+		 * did not deliver come out as silence, or NaN for floats.
+		 */
+		if ((ret = feed_aligner(outc, packet, out)) != SR_OK)
+			return ret;
+		if (!outc->header_done)
+			break;
+		/* Chunks of odd size get a pad byte. */
+		if (outc->data_size & 1) {
+			g_string_append_c(out, 0);
+			outc->total_size++;
 		}
 		break;
 	}
@@ -334,29 +509,86 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 
 static struct sr_option options[] = {
 	{ "scale", "Scale", "Scale values by factor", NULL, NULL },
+	{ "format", "Format", "Sample format (float, pcm16, pcm24)", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	unsigned int i;
+
 	if (!options[0].def)
 		options[0].def = g_variant_ref_sink(g_variant_new_double(1.0));
+	if (!options[1].def) {
+		options[1].def = g_variant_ref_sink(g_variant_new_string("float"));
+		for (i = 0; i < G_N_ELEMENTS(wav_formats); i++)
+			options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string(wav_formats[i].name)));
+	}
 
 	return options;
 }
 
+/*
+ * The header was written before the sizes were known. Fill them in
+ * when the output went to a file, and that file holds exactly what
+ * this module emitted. Output written through sr_output_send_fd()
+ * is unbuffered; callers which write the output themselves must
+ * flush it before sr_output_free(), else the sizes stay maxed out.
+ */
+static void update_sizes(const struct sr_output *o)
+{
+	struct out_context *outc;
+	GStatBuf st;
+	FILE *file;
+	uint8_t tmp[4];
+
+	outc = o->priv;
+	if (!o->filename || !o->filename[0] || !outc->header_done)
+		return;
+	if (outc->total_size > 0xffffffff)
+		return;
+	if (g_stat(o->filename, &st) != 0 ||
+			(uint64_t)st.st_size != outc->total_size) {
+		sr_dbg("Not updating sizes in '%s'.", o->filename);
+		return;
+	}
+	if (!(file = g_fopen(o->filename, "r+b"))) {
+		sr_warn("Cannot update sizes in '%s': %s.", o->filename,
+			g_strerror(errno));
+		return;
+	}
+	WL32(tmp, outc->total_size - 8);
+	if (fseek(file, RIFF_SIZE_OFFSET, SEEK_SET) != 0 ||
+			fwrite(tmp, 1, 4, file) != 4)
+		sr_warn("Cannot update sizes in '%s'.", o->filename);
+	WL32(tmp, outc->data_size);
+	if (fseek(file, DATA_SIZE_OFFSET, SEEK_SET) != 0 ||
+			fwrite(tmp, 1, 4, file) != 4)
+		sr_warn("Cannot update sizes in '%s'.", o->filename);
+	fclose(file);
+}
+
 static int cleanup(struct sr_output *o)
 {
 	struct out_context *outc;
-	int i;
+	unsigned int i;
 
 	outc = o->priv;
+	update_sizes(o);
 	g_slist_free(outc->channels);
-	g_variant_unref(options[0].def);
-	for (i = 0; i < outc->num_channels; i++)
-		g_free(outc->chanbuf[i]);
-	g_free(outc->chanbuf_used);
-	g_free(outc->chanbuf);
+	for (i = 0; i < G_N_ELEMENTS(options) - 1; i++) {
+		if (options[i].def) {
+			g_variant_unref(options[i].def);
+			options[i].def = NULL;
+		}
+		g_slist_free_full(options[i].values, (GDestroyNotify)g_variant_unref);
+		options[i].values = NULL;
+	}
+	sr_aligner_free(outc->aligner);
+	g_free(outc->fed);
+	g_free(outc->chan_idx);
+	g_free(outc->dest);
 	g_free(outc->fdata);
 	g_free(outc);
 	o->priv = NULL;
@@ -372,6 +604,6 @@ SR_PRIV struct sr_output_module output_wav = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
@@ -24,38 +24,88 @@
 
 #define LOG_PREFIX "output/wavedrom"
 
+/*
+ * WaveDrom takes one character per sample and channel, within a single
+ * JSON document, so nothing can be emitted before SR_DF_END. Memory use
+ * during the acquisition only grows with the number of level changes,
+ * but rendering at the end still peaks at O(samples * channels) for
+ * the output string.
+ */
 struct context {
 	uint32_t channel_count;
 	struct sr_channel **channels;
-	GString **channel_outputs; /* output strings */
+	/*
+	 * Per channel waves, folded into run lengths as the data arrives:
+	 * the level of the first sample, and the LEB128 encoded lengths
+	 * of all completed runs. The current run began at run_start.
+	 */
+	GByteArray **runs;
+	uint8_t *first_level;
+	uint64_t *run_start;
+	uint64_t sample_count;
+	/* The previous sample, bytes which hold the channels. */
+	uint8_t *prev_sample;
+	size_t sample_bytes;
 };
 
+static void append_run(GByteArray *runs, uint64_t length)
+{
+	uint8_t byte;
+
+	while (length >= 0x80) {
+		byte = (length & 0x7f) | 0x80;
+		g_byte_array_append(runs, &byte, 1);
+		length >>= 7;
+	}
+	byte = length;
+	g_byte_array_append(runs, &byte, 1);
+}
+
+/* Appends the first sample of a run and the dots for the others. */
+static void render_run(GString *output, char c, uint64_t length)
+{
+	size_t len;
+
+	g_string_append_c(output, c);
+	len = output->len;
+	g_string_set_size(output, len + length - 1);
+	memset(output->str + len, '.', length - 1);
+}
+
 /* Converts accumulated output data to a JSON string. */
-static GString *wavedrom_render(const struct context *ctx)
+static void wavedrom_render(const struct context *ctx, GString *output)
 {
-	GString *output;
-	size_t ch, i;
-	char last_char, curr_char;
+	const uint8_t *p, *end;
+	uint64_t length;
+	size_t ch;
+	unsigned int shift;
+	char level;
 
-	output = g_string_new("{ \"signal\": [");
+	g_string_append(output, "{ \"signal\": [");
 	for (ch = 0; ch < ctx->channel_count; ch++) {
-		if (!ctx->channel_outputs[ch])
+		if (!ctx->runs[ch])
 			continue;
 
 		/* Channel strip. */
 		g_string_append_printf(output,
 			"{ \"name\": \"%s\", \"wave\": \"", ctx->channels[ch]->name);
 
-		last_char = 0;
-		for (i = 0; i < ctx->channel_outputs[ch]->len; i++) {
-			curr_char = ctx->channel_outputs[ch]->str[i];
-			/* Data point. */
-			if (curr_char == last_char) {
-				g_string_append_c(output, '.');
-			} else {
-				g_string_append_c(output, curr_char);
-				last_char = curr_char;
+		if (ctx->sample_count) {
+			level = ctx->first_level[ch] ? '1' : '0';
+			p = ctx->runs[ch]->data;
+			end = p + ctx->runs[ch]->len;
+			while (p < end) {
+				length = 0;
+				shift = 0;
+				do {
+					length |= (uint64_t)(*p & 0x7f) << shift;
+					shift += 7;
+				} while (*p++ & 0x80);
+				render_run(output, level, length);
+				level ^= '0' ^ '1';
 			}
+			render_run(output, level,
+				ctx->sample_count - ctx->run_start[ch]);
 		}
 		if (ch < ctx->channel_count - 1) {
 			g_string_append(output, "\" },");
@@ -65,66 +115,68 @@ static GString *wavedrom_render(const struct context *ctx)
 		}
 	}
 	g_string_append(output, "], \"config\": { \"skin\": \"narrow\" }}");
-
-	return output;
 }
 
-static void process_logic(const struct context *ctx,
+static void process_logic(struct context *ctx,
 	const struct sr_datafeed_logic *logic)
 {
-	size_t sample_count, ch, i;
-	uint8_t *sample, bit;
-	GString *accu;
+	size_t sample_count, num_bytes, ch, i, b;
+	const uint8_t *sample, *prev;
+	uint8_t diff;
 
 	if (!ctx->channel_count)
 		return;
 
 	/*
-	 * Extract the logic bits for each channel and store them
-	 * as wavedrom letters (1/0) in each channel's text string.
-	 * This transforms the input which consists of sample sets
-	 * that span multiple channels into output stripes per logic
-	 * channel which consist of bits for that individual channel.
-	 *
-	 * TODO Reduce memory consumption during accumulation of
-	 * output data.
-	 *
-	 * Ideally we'd accumulate binary chunks, and defer conversion
-	 * to the text format. Analog data already won't get here, only
-	 * logic data does. When the per-channel transformation also
-	 * gets deferred until later, then the only overhead would be
-	 * for disabled logic channels. Which may be acceptable or even
-	 * negligable.
-	 *
-	 * An optional addition to the above mentioned accumulation of
-	 * binary data is RLE compression. Mark both the position in the
-	 * accumulated data as well as a repetition counter, instead of
-	 * repeatedly storing the same sample set. The efficiency of
-	 * this approach of course depends on the change rate of input
-	 * data. But the approach perfectly matches the WaveDrom syntax
-	 * for repeated bit patterns, and thus is easily handled in the
-	 * text rendering stage of the output module.
+	 * Only keep track of where each channel's level changes. Runs of
+	 * samples which match their predecessor need no per channel work,
+	 * and the WaveDrom syntax for repeated levels is easily rendered
+	 * from the run lengths at the end.
 	 */
 	sample_count = logic->length / logic->unitsize;
-	for (i = 0; i < sample_count; i++) {
-		sample = logic->data + i * logic->unitsize;
+	if (!sample_count)
+		return;
+	num_bytes = MIN(ctx->sample_bytes, logic->unitsize);
+	sample = logic->data;
+	if (!ctx->sample_count) {
 		for (ch = 0; ch < ctx->channel_count; ch++) {
-			accu = ctx->channel_outputs[ch];
-			if (!accu)
+			if (ctx->runs[ch] && ch / 8 < num_bytes)
+				ctx->first_level[ch] = sample[ch / 8] & (1 << (ch % 8));
+		}
+		memcpy(ctx->prev_sample, sample, num_bytes);
+	}
+
+	prev = ctx->prev_sample;
+	for (i = 0; i < sample_count; i++, sample += logic->unitsize) {
+		if (!memcmp(sample, prev, num_bytes)) {
+			ctx->sample_count++;
+			prev = sample;
+			continue;
+		}
+		for (b = 0; b < num_bytes; b++) {
+			if (!(diff = sample[b] ^ prev[b]))
 				continue;
-			bit = sample[ch / 8] & (1 << (ch % 8));
-			g_string_append_c(accu, bit ? '1' : '0');
+			for (ch = b * 8; diff; ch++, diff >>= 1) {
+				if (!(diff & 1) || ch >= ctx->channel_count)
+					continue;
+				if (!ctx->runs[ch])
+					continue;
+				append_run(ctx->runs[ch],
+					ctx->sample_count - ctx->run_start[ch]);
+				ctx->run_start[ch] = ctx->sample_count;
+			}
 		}
+		ctx->sample_count++;
+		prev = sample;
 	}
+	memcpy(ctx->prev_sample, prev, num_bytes);
 }
 
 static int receive(const struct sr_output *o,
-	const struct sr_datafeed_packet *packet, GString **out)
+	const struct sr_datafeed_packet *packet, GString *out)
 {
 	struct context *ctx;
 
-	*out = NULL;
-
 	if (!o || !o->sdi || !o->priv)
 		return SR_ERR_ARG;
 
@@ -135,7 +187,7 @@ static int receive(const struct sr_output *o,
 		process_logic(ctx, packet->payload);
 		break;
 	case SR_DF_END:
-		*out = wavedrom_render(ctx);
+		wavedrom_render(ctx, out);
 		break;
 	}
 
@@ -159,14 +211,18 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->channel_count = g_slist_length(o->sdi->channels);
 	ctx->channels = g_malloc0(
 		sizeof(ctx->channels[0]) * ctx->channel_count);
-	ctx->channel_outputs = g_malloc0(
-		sizeof(ctx->channel_outputs[0]) * ctx->channel_count);
+	ctx->runs = g_malloc0(sizeof(ctx->runs[0]) * ctx->channel_count);
+	ctx->first_level = g_malloc0(ctx->channel_count);
+	ctx->run_start = g_malloc0(
+		sizeof(ctx->run_start[0]) * ctx->channel_count);
+	ctx->sample_bytes = (ctx->channel_count + 7) / 8;
+	ctx->prev_sample = g_malloc0(ctx->sample_bytes);
 
 	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
 		channel = l->data;
 		if (channel->enabled && channel->type == SR_CHANNEL_LOGIC) {
 			ctx->channels[i] = channel;
-			ctx->channel_outputs[i] = g_string_new(NULL);
+			ctx->runs[i] = g_byte_array_new();
 		}
 	}
 
@@ -176,7 +232,7 @@ static int init(struct sr_output *o, GHashTable *options)
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
-	GString *s;
+	uint32_t i;
 
 	if (!o)
 		return SR_ERR_ARG;
@@ -185,12 +241,14 @@ static int cleanup(struct sr_output *o)
 	o->priv = NULL;
 
 	if (ctx) {
-		while (--ctx->channel_count) {
-			s = ctx->channel_outputs[ctx->channel_count];
-			if (s)
-				g_string_free(s, TRUE);
+		for (i = 0; i < ctx->channel_count; i++) {
+			if (ctx->runs[i])
+				g_byte_array_free(ctx->runs[i], TRUE);
 		}
-		g_free(ctx->channel_outputs);
+		g_free(ctx->runs);
+		g_free(ctx->first_level);
+		g_free(ctx->run_start);
+		g_free(ctx->prev_sample);
 		g_free(ctx->channels);
 		g_free(ctx);
 	}
@@ -206,6 +264,6 @@ SR_PRIV struct sr_output_module output_wavedrom = {
 	.flags = 0,
 	.options = NULL,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
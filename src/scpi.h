@@ -73,6 +73,7 @@ enum scpi_transport_layer {
 	SCPI_TRANSPORT_USBTMC,
 	SCPI_TRANSPORT_VISA,
 	SCPI_TRANSPORT_VXI,
+	SCPI_TRANSPORT_SIM,
 };
 
 struct scpi_command {
@@ -87,6 +88,42 @@ struct sr_scpi_hw_info {
 	char *firmware_version;
 };
 
+/** Round-trip statistics of one SCPI command, see sr_scpi_stats_get(). */
+struct sr_scpi_cmd_stats {
+	/** Number of times the command was issued. */
+	uint64_t count;
+	/** Sum of the round-trip times in microseconds. */
+	uint64_t total_us;
+	/** Shortest round-trip time in microseconds. */
+	uint64_t min_us;
+	/** Longest round-trip time in microseconds. */
+	uint64_t max_us;
+};
+
+/**
+ * Callback for the data of a definite length block, see
+ * sr_scpi_get_block_into(). Gets the block buffer and the number of
+ * bytes received so far.
+ */
+typedef int (*sr_scpi_block_cb)(const uint8_t *buf, size_t len,
+		void *cb_data);
+
+/** Conversion state for sr_scpi_block_to_float(). */
+struct sr_scpi_block_float {
+	/** Output buffer for num_samples values. */
+	float *data;
+	/** Number of samples to convert. */
+	size_t num_samples;
+	/** Bytes per sample, 1 or 2 (little endian). */
+	unsigned int unitsize;
+	gboolean is_signed;
+	/** Values are raw * scale + offset. */
+	float scale;
+	float offset;
+	/** Number of samples converted so far, start at 0. */
+	size_t converted;
+};
+
 struct sr_scpi_dev_inst {
 	const char *name;
 	const char *prefix;
@@ -114,6 +151,10 @@ struct sr_scpi_dev_inst {
 	GMutex scpi_mutex;
 	char *actual_channel_name;
 	gboolean no_opc_command;
+	/* Cacheable queries and their responses, see sr_scpi_cache_register(). */
+	GHashTable *cache;
+	/* Per-command round-trip statistics, see sr_scpi_stats_get(). */
+	GHashTable *stats;
 };
 
 SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
@@ -160,12 +201,28 @@ SR_PRIV int sr_scpi_get_data(struct sr_scpi_dev_inst *scpi,
 			const char *command, GString **scpi_response);
 SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
 			const char *command, GByteArray **scpi_response);
+SR_PRIV int sr_scpi_get_block_into(struct sr_scpi_dev_inst *scpi,
+			const char *command, uint8_t **buf, size_t *bufsize,
+			size_t *datalen, sr_scpi_block_cb cb, void *cb_data);
+SR_PRIV int sr_scpi_block_to_float(const uint8_t *buf, size_t len,
+			void *cb_data);
+SR_PRIV int sr_scpi_get_strings(struct sr_scpi_dev_inst *scpi,
+			const char **commands, size_t count, char **responses);
 SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 			struct sr_scpi_hw_info **scpi_response);
 SR_PRIV void sr_scpi_hw_info_free(struct sr_scpi_hw_info *hw_info);
 
 SR_PRIV const char *sr_scpi_unquote_string(char *s);
 
+SR_PRIV void sr_scpi_cache_register(struct sr_scpi_dev_inst *scpi,
+		const char *command, gboolean constant);
+SR_PRIV void sr_scpi_cache_invalidate(struct sr_scpi_dev_inst *scpi);
+SR_PRIV void sr_scpi_cache_reset(struct sr_scpi_dev_inst *scpi);
+SR_PRIV int sr_scpi_stats_get(struct sr_scpi_dev_inst *scpi,
+		const char *command, struct sr_scpi_cmd_stats *stats);
+SR_PRIV void sr_scpi_stats_reset(struct sr_scpi_dev_inst *scpi);
+SR_PRIV void sr_scpi_stats_log(struct sr_scpi_dev_inst *scpi);
+
 SR_PRIV const char *sr_vendor_alias(const char *raw_vendor);
 SR_PRIV const char *sr_scpi_cmd_get(const struct scpi_command *cmdtable,
 		int command);
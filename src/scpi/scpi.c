@@ -19,6 +19,7 @@
  */
 
 #include <config.h>
+#include <errno.h>
 #include <glib.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
@@ -29,6 +30,10 @@
 
 #define SCPI_READ_RETRIES 100
 #define SCPI_READ_RETRY_TIMEOUT_US (10 * 1000)
+/* Longest compound query sent by sr_scpi_get_strings(). */
+#define SCPI_PIPELINE_MAX_LEN 256
+/* Granularity of block reads, for callers processing data on the fly. */
+#define SCPI_BLOCK_CHUNK_SIZE (256 * 1024)
 
 static const char *scpi_vendors[][2] = {
 	{ "Agilent Technologies", "Agilent" },
@@ -84,6 +89,7 @@ SR_PRIV extern const struct sr_scpi_dev_inst scpi_usbtmc_libusb_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_vxi_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_visa_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_libgpib_dev;
+SR_PRIV extern const struct sr_scpi_dev_inst scpi_sim_dev;
 
 static const struct sr_scpi_dev_inst *scpi_devs[] = {
 	&scpi_tcp_raw_dev,
@@ -100,6 +106,7 @@ static const struct sr_scpi_dev_inst *scpi_devs[] = {
 #ifdef HAVE_LIBGPIB
 	&scpi_libgpib_dev,
 #endif
+	&scpi_sim_dev,
 #ifdef HAVE_SERIAL_COMM
 	&scpi_serial_dev, /* Must be last as it matches any resource. */
 #endif
@@ -133,33 +140,154 @@ static struct sr_dev_inst *sr_scpi_scan_resource(struct drv_context *drvc,
 	return sdi;
 }
 
+/* A cacheable query, see sr_scpi_cache_register(). */
+struct scpi_cache_entry {
+	/* Response is kept across commands which change the device state. */
+	gboolean constant;
+	/* Last raw response, or NULL if not known. */
+	char *response;
+};
+
+static void scpi_cache_entry_free(void *data)
+{
+	struct scpi_cache_entry *entry;
+
+	entry = data;
+	g_free(entry->response);
+	g_free(entry);
+}
+
+/* Drop cached responses, keeping those of constant queries if requested. */
+static void scpi_cache_clear(struct sr_scpi_dev_inst *scpi, gboolean all)
+{
+	GHashTableIter iter;
+	struct scpi_cache_entry *entry;
+
+	if (!scpi->cache)
+		return;
+
+	g_hash_table_iter_init(&iter, scpi->cache);
+	while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+		if (entry->constant && !all)
+			continue;
+		g_free(entry->response);
+		entry->response = NULL;
+	}
+}
+
+/* Check whether each ';' separated part of a command is a query. */
+static gboolean scpi_is_query(const char *command)
+{
+	const char *p;
+	gboolean query, empty;
+
+	query = FALSE;
+	empty = TRUE;
+	for (p = command; ; p++) {
+		if (*p == ';' || *p == '\0') {
+			if (!empty && !query)
+				return FALSE;
+			if (*p == '\0')
+				return TRUE;
+			query = FALSE;
+			empty = TRUE;
+		} else if (*p == '?') {
+			query = TRUE;
+		} else if (!g_ascii_isspace(*p)) {
+			empty = FALSE;
+		}
+	}
+}
+
+static struct scpi_cache_entry *scpi_cache_lookup(struct sr_scpi_dev_inst *scpi,
+		const char *command)
+{
+	if (!scpi->cache || !command)
+		return NULL;
+
+	return g_hash_table_lookup(scpi->cache, command);
+}
+
+/* Account the round-trip time of a command which was issued at start_us. */
+static void scpi_stats_add(struct sr_scpi_dev_inst *scpi,
+		const char *command, gint64 start_us)
+{
+	struct sr_scpi_cmd_stats *stats;
+	uint64_t elapsed_us;
+
+	if (!command)
+		return;
+
+	if (!scpi->stats)
+		scpi->stats = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	if (!(stats = g_hash_table_lookup(scpi->stats, command))) {
+		stats = g_malloc0(sizeof(*stats));
+		stats->min_us = G_MAXUINT64;
+		g_hash_table_insert(scpi->stats, g_strdup(command), stats);
+	}
+
+	elapsed_us = g_get_monotonic_time() - start_us;
+	stats->count++;
+	stats->total_us += elapsed_us;
+	stats->min_us = MIN(stats->min_us, elapsed_us);
+	stats->max_us = MAX(stats->max_us, elapsed_us);
+}
+
 /**
- * Send a SCPI command with a variadic argument list without mutex.
+ * Format a SCPI command, locale independently. The returned buffer has
+ * room for one more character after the terminating NUL.
  *
- * @param scpi Previously initialized SCPI device structure.
  * @param format Format string.
  * @param args Argument list.
  *
- * @return SR_OK on success, SR_ERR on failure.
+ * @return The command, to be freed with g_free().
  */
-static int scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
-			 const char *format, va_list args)
+static char *scpi_vformat(const char *format, va_list args)
 {
 	va_list args_copy;
 	char *buf;
-	int len, ret;
+	int len;
 
 	/* Get length of buffer required. */
 	va_copy(args_copy, args);
 	len = sr_vsnprintf_ascii(NULL, 0, format, args_copy);
 	va_end(args_copy);
 
-	/* Allocate buffer and write out command. */
 	buf = g_malloc0(len + 2);
 	sr_vsprintf_ascii(buf, format, args);
+
+	return buf;
+}
+
+/**
+ * Send a SCPI command with a variadic argument list without mutex.
+ *
+ * @param scpi Previously initialized SCPI device structure.
+ * @param format Format string.
+ * @param args Argument list.
+ *
+ * @return SR_OK on success, SR_ERR on failure.
+ */
+static int scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
+			 const char *format, va_list args)
+{
+	char *buf;
+	int len, ret;
+
+	/* Write out command, with room for a trailing newline. */
+	buf = scpi_vformat(format, args);
+	len = strlen(buf);
 	if (buf[len - 1] != '\n')
 		buf[len] = '\n';
 
+	/*
+	 * Anything but a query may change what cached queries return,
+	 * also when it is combined with queries, as in "CMD 1;CMD?".
+	 */
+	if (!scpi_is_query(buf))
+		scpi_cache_clear(scpi, FALSE);
+
 	/* Send command. */
 	ret = scpi->send(scpi->priv, buf);
 
@@ -203,6 +331,8 @@ static int scpi_send(struct sr_scpi_dev_inst *scpi, const char *format, ...)
  */
 static int scpi_write_data(struct sr_scpi_dev_inst *scpi, char *buf, int maxlen)
 {
+	scpi_cache_clear(scpi, FALSE);
+
 	return scpi->write_data(scpi->priv, buf, maxlen);
 }
 
@@ -271,12 +401,27 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 {
 	int ret;
 	GString *response;
+	struct scpi_cache_entry *entry;
 	int space;
-	gint64 timeout;
+	gsize start_len;
+	gint64 timeout, start_us;
+
+	response = *scpi_response;
+
+	/* Serve registered queries from the cache when possible. */
+	entry = scpi_cache_lookup(scpi, command);
+	if (entry && entry->response) {
+		sr_spew("Cached response for '%s'.", command);
+		g_string_append(response, entry->response);
+		return SR_OK;
+	}
+
+	start_us = g_get_monotonic_time();
+	start_len = response->len;
 
 	/* Optionally send caller provided command. */
 	if (command) {
-		if (scpi_send(scpi, command) != SR_OK)
+		if (scpi_send(scpi, "%s", command) != SR_OK)
 			return SR_ERR;
 	}
 
@@ -287,8 +432,6 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 	/* Keep reading until completion or until timeout. */
 	timeout = g_get_monotonic_time() + scpi->read_timeout_us;
 
-	response = *scpi_response;
-
 	while (!sr_scpi_read_complete(scpi)) {
 		/* Resize the buffer when free space drops below a threshold. */
 		space = response->allocated_len - response->len;
@@ -307,6 +450,11 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 			timeout = g_get_monotonic_time() + scpi->read_timeout_us;
 	}
 
+	scpi_stats_add(scpi, command, start_us);
+	if (entry)
+		entry->response = g_strndup(response->str + start_len,
+			response->len - start_len);
+
 	return SR_OK;
 }
 
@@ -474,9 +622,7 @@ SR_PRIV int sr_scpi_send(struct sr_scpi_dev_inst *scpi,
 	int ret;
 
 	va_start(args, format);
-	g_mutex_lock(&scpi->scpi_mutex);
-	ret = scpi_send_variadic(scpi, format, args);
-	g_mutex_unlock(&scpi->scpi_mutex);
+	ret = sr_scpi_send_variadic(scpi, format, args);
 	va_end(args);
 
 	return ret;
@@ -494,10 +640,14 @@ SR_PRIV int sr_scpi_send(struct sr_scpi_dev_inst *scpi,
 SR_PRIV int sr_scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
 			 const char *format, va_list args)
 {
+	gint64 start_us;
 	int ret;
 
 	g_mutex_lock(&scpi->scpi_mutex);
+	start_us = g_get_monotonic_time();
 	ret = scpi_send_variadic(scpi, format, args);
+	if (ret == SR_OK)
+		scpi_stats_add(scpi, format, start_us);
 	g_mutex_unlock(&scpi->scpi_mutex);
 
 	return ret;
@@ -585,7 +735,13 @@ SR_PRIV int sr_scpi_close(struct sr_scpi_dev_inst *scpi)
 
 	g_mutex_lock(&scpi->scpi_mutex);
 	ret = scpi->close(scpi);
+	/*
+	 * The device may be changed or even swapped while it is closed,
+	 * so not even responses to constant queries are kept.
+	 */
+	scpi_cache_clear(scpi, TRUE);
 	g_mutex_unlock(&scpi->scpi_mutex);
+	sr_scpi_stats_log(scpi);
 	g_mutex_clear(&scpi->scpi_mutex);
 
 	return ret;
@@ -605,6 +761,10 @@ SR_PRIV void sr_scpi_free(struct sr_scpi_dev_inst *scpi)
 	scpi->free(scpi->priv);
 	g_free(scpi->priv);
 	g_free(scpi->actual_channel_name);
+	if (scpi->cache)
+		g_hash_table_destroy(scpi->cache);
+	if (scpi->stats)
+		g_hash_table_destroy(scpi->stats);
 	g_free(scpi);
 }
 
@@ -860,8 +1020,7 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 {
 	int ret;
 	float tmp;
-	char *response;
-	gchar **ptr, **tokens;
+	char *response, *p, *end;
 	size_t token_count;
 	GArray *response_array;
 
@@ -872,23 +1031,30 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 	if (ret != SR_OK && !response)
 		return ret;
 
-	tokens = g_strsplit(response, ",", 0);
-	token_count = g_strv_length(tokens);
+	token_count = 1;
+	for (p = response; (p = strchr(p, ',')); p++)
+		token_count++;
 
 	response_array = g_array_sized_new(TRUE, FALSE,
 		sizeof(float), token_count + 1);
 
-	ptr = tokens;
-	while (*ptr) {
-		ret = sr_atof_ascii(*ptr, &tmp);
-		if (ret != SR_OK) {
+	/*
+	 * Convert the values in place instead of splitting the response
+	 * into a string vector first. Every value must extend up to the
+	 * next separator, as with sr_atof_ascii() on the split tokens.
+	 */
+	for (p = response; *response; p = end + 1) {
+		errno = 0;
+		tmp = sr_strtod_ascii(p, &end);
+		if (errno || (*end && *end != ',')) {
 			ret = SR_ERR_DATA;
 			break;
 		}
-		response_array = g_array_append_val(response_array, tmp);
-		ptr++;
+		ret = SR_OK;
+		g_array_append_val(response_array, tmp);
+		if (!*end)
+			break;
 	}
-	g_strfreev(tokens);
 	g_free(response);
 
 	if (ret != SR_OK && response_array->len == 0) {
@@ -960,147 +1126,455 @@ SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 	return ret;
 }
 
+/* Read exactly len bytes of a response, without mutex. */
+static int scpi_read_exact(struct sr_scpi_dev_inst *scpi,
+		uint8_t *buf, size_t len, gint64 *timeout)
+{
+	size_t pos;
+	int ret;
+
+	pos = 0;
+	while (pos < len) {
+		ret = scpi->read_data(scpi->priv, (char *)&buf[pos],
+			MIN(len - pos, G_MAXINT));
+		if (ret < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		}
+		if (ret > 0) {
+			pos += ret;
+			*timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+		} else if (g_get_monotonic_time() > *timeout) {
+			sr_err("Timed out waiting for SCPI response.");
+			return SR_ERR_TIMEOUT;
+		}
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Discard the rest of a response, i.e. the terminator after a block, so
+ * that it does not precede the next response. Without mutex.
+ */
+static int scpi_read_discard(struct sr_scpi_dev_inst *scpi, gint64 *timeout)
+{
+	char buf[16];
+	int ret;
+
+	while (!sr_scpi_read_complete(scpi)) {
+		ret = scpi->read_data(scpi->priv, buf, sizeof(buf));
+		if (ret < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		}
+		if (ret > 0) {
+			*timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+		} else if (g_get_monotonic_time() > *timeout) {
+			sr_dbg("No terminator after SCPI block.");
+			break;
+		}
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Read the data of an indefinite length ("#0") block, which extends up
+ * to the end of the response. Without mutex.
+ */
+static int scpi_read_indefinite_block(struct sr_scpi_dev_inst *scpi,
+		uint8_t **buf, size_t *bufsize, size_t *datalen, gint64 *timeout)
+{
+	size_t pos;
+	int ret;
+
+	if (!*buf)
+		*bufsize = 0;
+	pos = 0;
+	while (!sr_scpi_read_complete(scpi)) {
+		if (*bufsize - pos < 1024) {
+			*bufsize = MAX(2 * *bufsize, 1024);
+			*buf = g_realloc(*buf, *bufsize);
+		}
+		ret = scpi->read_data(scpi->priv, (char *)&(*buf)[pos],
+			MIN(*bufsize - pos, SCPI_BLOCK_CHUNK_SIZE));
+		if (ret < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		}
+		if (ret > 0) {
+			pos += ret;
+			*timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+		} else if (g_get_monotonic_time() > *timeout) {
+			sr_err("Timed out waiting for SCPI response.");
+			return SR_ERR_TIMEOUT;
+		}
+	}
+
+	/* The terminator is not part of the data. */
+	if (pos > 0 && (*buf)[pos - 1] == '\n')
+		pos--;
+	*datalen = pos;
+
+	return SR_OK;
+}
+
 /**
  * Send a SCPI command, read the reply, parse it as binary data with a
- * "definite length block" header and store the as an result in scpi_response.
+ * "definite length block" header and store the data bytes in a caller
+ * provided buffer.
  *
- * Callers must free the allocated memory (unless it's NULL) regardless of
- * the routine's return code. See @ref g_byte_array_free().
+ * The "#<n><length>" header gets parsed first, then the data bytes are
+ * read straight into the buffer, without intermediate copies. When the
+ * buffer is smaller than the announced length, it gets reallocated, so
+ * a caller which keeps its buffer across calls allocates memory only
+ * when the block size grows.
+ *
+ * The optional callback is invoked whenever more data has arrived, and
+ * can process (e.g. convert) the data while the transfer continues. It
+ * runs with the SCPI mutex held and must not access the device.
+ *
+ * The terminator after the block gets consumed. Indefinite length blocks
+ * ("#0") are accepted as well, their data extends up to the terminator
+ * and is passed to the callback once complete.
  *
  * @param[in] scpi Previously initialised SCPI device structure.
  * @param[in] command The SCPI command to send to the device (can be NULL).
- * @param[out] scpi_response Pointer where to store the parsed result.
- *
- * @return SR_OK upon successfully parsing all values, SR_ERR* upon a parsing
- *         error or upon no response.
+ * @param[in,out] buf The buffer (can point to NULL). Free with g_free().
+ * @param[in,out] bufsize The size of the buffer.
+ * @param[out] datalen The number of data bytes received.
+ * @param[in] cb Callback for received data, or NULL.
+ * @param[in] cb_data Data for the callback.
+ *
+ * @return SR_OK upon success, SR_ERR* upon a parsing error, upon no
+ *         response, or when the callback failed.
  */
-SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
-			       const char *command, GByteArray **scpi_response)
+SR_PRIV int sr_scpi_get_block_into(struct sr_scpi_dev_inst *scpi,
+		const char *command, uint8_t **buf, size_t *bufsize,
+		size_t *datalen, sr_scpi_block_cb cb, void *cb_data)
 {
-	int ret;
-	GString* response;
-	gsize oldlen;
-	char buf[10];
-	long llen;
-	long datalen;
+	uint8_t header[12];
+	size_t len, pos, chunk;
+	long llen, blocklen;
 	gint64 timeout;
+	int ret;
 
-	*scpi_response = NULL;
+	*datalen = 0;
 
 	g_mutex_lock(&scpi->scpi_mutex);
 
-	if (command)
-		if (scpi_send(scpi, command) != SR_OK) {
+	if (command) {
+		if (scpi_send(scpi, "%s", command) != SR_OK) {
 			g_mutex_unlock(&scpi->scpi_mutex);
 			return SR_ERR;
 		}
+	}
 
 	if (sr_scpi_read_begin(scpi) != SR_OK) {
 		g_mutex_unlock(&scpi->scpi_mutex);
 		return SR_ERR;
 	}
 
-	/*
-	 * Assume an initial maximum length, optionally gets adjusted below.
-	 * Prepare a NULL return value for when error paths will be taken.
-	 */
-	response = g_string_sized_new(1024);
-
 	timeout = g_get_monotonic_time() + scpi->read_timeout_us;
 
-	/* Get (the first chunk of) the response. */
-	do {
-		ret = scpi_read_response(scpi, response, timeout);
-		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
-			return ret;
-		}
-	} while (response->len < 2);
-
 	/*
 	 * SCPI protocol data blocks are preceeded with a length spec.
 	 * The length spec consists of a '#' marker, one digit which
 	 * specifies the character count of the length spec, and the
 	 * respective number of characters which specify the data block's
-	 * length. Raw data bytes follow (thus one must no longer assume
-	 * that the received input stream would be an ASCIIZ string).
-	 *
-	 * Get the data block length, and strip off the length spec from
-	 * the input buffer, leaving just the data bytes.
+	 * length. Raw data bytes follow.
 	 */
-	if (response->str[0] != '#') {
+	if ((ret = scpi_read_exact(scpi, header, 2, &timeout)) != SR_OK) {
+		g_mutex_unlock(&scpi->scpi_mutex);
+		return ret;
+	}
+	if (header[0] != '#' || !g_ascii_isdigit(header[1])) {
+		sr_err("Invalid SCPI block header.");
 		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
 		return SR_ERR_DATA;
 	}
-	buf[0] = response->str[1];
-	buf[1] = '\0';
-	ret = sr_atol(buf, &llen);
-	if ((ret != SR_OK) || (llen == 0)) {
+	if (header[1] == '0') {
+		ret = scpi_read_indefinite_block(scpi, buf, bufsize, datalen,
+			&timeout);
+		if (ret == SR_OK && cb && *datalen > 0)
+			ret = cb(*buf, *datalen, cb_data);
 		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
 		return ret;
 	}
-
-	while (response->len < (unsigned long)(2 + llen)) {
-		ret = scpi_read_response(scpi, response, timeout);
-		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
-			return ret;
-		}
-	}
-
-	memcpy(buf, &response->str[2], llen);
-	buf[llen] = '\0';
-	ret = sr_atol(buf, &datalen);
-	if ((ret != SR_OK) || (datalen == 0)) {
+	llen = header[1] - '0';
+	if ((ret = scpi_read_exact(scpi, header, llen, &timeout)) != SR_OK) {
 		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
 		return ret;
 	}
-	g_string_erase(response, 0, 2 + llen);
+	header[llen] = '\0';
+	if (sr_atol((const char *)header, &blocklen) != SR_OK || blocklen < 0) {
+		sr_err("Invalid SCPI block length '%s'.", header);
+		g_mutex_unlock(&scpi->scpi_mutex);
+		return SR_ERR_DATA;
+	}
+	len = blocklen;
+
+	if (!*buf || *bufsize < len) {
+		g_free(*buf);
+		*buf = g_malloc(MAX(len, 1));
+		*bufsize = MAX(len, 1);
+	}
 
 	/*
-	 * Re-allocate the buffer size to the now known length
-	 * and keep reading more chunks of response data.
+	 * Read in chunks, so that the callback can work on the data while
+	 * the transfer continues. On timeout pass on the partial response
+	 * instead of getting stuck.
 	 */
-	oldlen = response->len;
-	g_string_set_size(response, datalen);
-	g_string_set_size(response, oldlen);
-
-	if (oldlen < (unsigned long)(datalen)) {
-		do {
-			oldlen = response->len;
-			ret = scpi_read_response(scpi, response, timeout);
-
-			/* On timeout truncate the buffer and send the partial response
-			 * instead of getting stuck on timeouts...
-			 */
-			if (ret == SR_ERR_TIMEOUT) {
-				datalen = oldlen;
+	pos = 0;
+	ret = SR_OK;
+	while (pos < len) {
+		chunk = MIN(len - pos, SCPI_BLOCK_CHUNK_SIZE);
+		ret = scpi->read_data(scpi->priv, (char *)&(*buf)[pos],
+			MIN(chunk, G_MAXINT));
+		if (ret < 0) {
+			sr_err("Incompletely read SCPI response.");
+			ret = SR_ERR;
+			break;
+		}
+		if (ret == 0) {
+			if (g_get_monotonic_time() > timeout) {
+				sr_warn("Timed out, got %" G_GSIZE_FORMAT " of %"
+					G_GSIZE_FORMAT " block bytes.", pos, len);
+				ret = SR_OK;
 				break;
 			}
-			if (ret < 0) {
-				g_mutex_unlock(&scpi->scpi_mutex);
-				g_string_free(response, TRUE);
-				return ret;
-			}
-			if (ret > 0)
-				timeout = g_get_monotonic_time() + scpi->read_timeout_us;
-		} while (response->len < (unsigned long)(datalen));
+			continue;
+		}
+		pos += ret;
+		timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+		ret = SR_OK;
+		if (cb && (ret = cb(*buf, pos, cb_data)) != SR_OK)
+			break;
 	}
+	if (ret == SR_OK && pos == len)
+		ret = scpi_read_discard(scpi, &timeout);
 
 	g_mutex_unlock(&scpi->scpi_mutex);
 
-	/* Convert received data to byte array. */
-	*scpi_response = g_byte_array_new_take(
-		(guint8*)g_string_free(response, FALSE), datalen);
+	*datalen = pos;
+
+	return ret;
+}
+
+/**
+ * Convert the data of a definite length block to float as it arrives.
+ *
+ * Use as the callback of sr_scpi_get_block_into(), with a
+ * struct sr_scpi_block_float as callback data. The conversion picks
+ * up where the previous invocation stopped, samples which are split
+ * across chunks get converted once they are complete.
+ *
+ * @param[in] buf The block data received so far.
+ * @param[in] len The number of bytes received so far.
+ * @param[in,out] cb_data The conversion state.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG for unsupported sample sizes.
+ */
+SR_PRIV int sr_scpi_block_to_float(const uint8_t *buf, size_t len,
+		void *cb_data)
+{
+	struct sr_scpi_block_float *conv;
+	size_t count, i;
+
+	conv = cb_data;
+	count = MIN(len / conv->unitsize, conv->num_samples);
+
+	for (i = conv->converted; i < count; i++) {
+		switch (conv->unitsize) {
+		case 1:
+			conv->data[i] = conv->is_signed ?
+				(int8_t)buf[i] : buf[i];
+			break;
+		case 2:
+			conv->data[i] = conv->is_signed ?
+				(int16_t)RL16(&buf[2 * i]) : RL16(&buf[2 * i]);
+			break;
+		default:
+			return SR_ERR_ARG;
+		}
+		conv->data[i] = conv->data[i] * conv->scale + conv->offset;
+	}
+	conv->converted = MAX(conv->converted, count);
 
 	return SR_OK;
 }
 
+/**
+ * Send a SCPI command, read the reply, parse it as binary data with a
+ * "definite length block" header and store the as an result in scpi_response.
+ *
+ * Callers must free the allocated memory (unless it's NULL) regardless of
+ * the routine's return code. See @ref g_byte_array_free().
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] command The SCPI command to send to the device (can be NULL).
+ * @param[out] scpi_response Pointer where to store the parsed result.
+ *
+ * @return SR_OK upon successfully parsing all values, SR_ERR* upon a parsing
+ *         error or upon no response.
+ */
+SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			       const char *command, GByteArray **scpi_response)
+{
+	uint8_t *buf;
+	size_t bufsize, datalen;
+	int ret;
+
+	*scpi_response = NULL;
+
+	/* The buffer gets allocated at the announced size. */
+	buf = NULL;
+	bufsize = 0;
+	ret = sr_scpi_get_block_into(scpi, command, &buf, &bufsize,
+		&datalen, NULL, NULL);
+	if (ret != SR_OK) {
+		g_free(buf);
+		return ret;
+	}
+
+	*scpi_response = g_byte_array_new_take(buf, datalen);
+
+	return SR_OK;
+}
+
+/* Split a compound response at the semicolons which are not quoted. */
+static char **scpi_split_responses(const char *str)
+{
+	GPtrArray *parts;
+	const char *start, *p;
+	char quote;
+
+	parts = g_ptr_array_new();
+	quote = '\0';
+	for (start = p = str; *p; p++) {
+		if (quote) {
+			if (*p == quote)
+				quote = '\0';
+		} else if (*p == '"' || *p == '\'') {
+			quote = *p;
+		} else if (*p == ';') {
+			g_ptr_array_add(parts, g_strndup(start, p - start));
+			start = p + 1;
+		}
+	}
+	g_ptr_array_add(parts, g_strdup(start));
+	g_ptr_array_add(parts, NULL);
+
+	return (char **)g_ptr_array_free(parts, FALSE);
+}
+
+/**
+ * Send several SCPI queries and receive their replies in as few
+ * round-trips as possible.
+ *
+ * Queries which are not answered from the cache (see
+ * sr_scpi_cache_register()) are joined with ';' into compound queries
+ * of up to SCPI_PIPELINE_MAX_LEN characters, and the device's compound
+ * responses get split again. Only pass queries, and no queries which
+ * return definite length blocks.
+ *
+ * Callers must free the responses regardless of the routine's return
+ * code. See @ref g_free().
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] commands The SCPI queries to send to the device.
+ * @param[in] count The number of queries.
+ * @param[out] responses Array of count string pointers, where to store
+ *                       the responses without leading or trailing
+ *                       whitespace. All are NULL upon failure.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_get_strings(struct sr_scpi_dev_inst *scpi,
+			const char **commands, size_t count, char **responses)
+{
+	struct scpi_cache_entry *entry;
+	GString *compound, *response;
+	size_t *pending, num, i, n;
+	char **parts;
+	gint64 start_us;
+	int ret;
+
+	for (i = 0; i < count; i++)
+		responses[i] = NULL;
+
+	pending = g_malloc(count * sizeof(*pending));
+	compound = g_string_sized_new(SCPI_PIPELINE_MAX_LEN);
+	response = g_string_sized_new(1024);
+	ret = SR_OK;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	i = 0;
+	while (i < count) {
+		/* Collect as many uncached queries as fit into one line. */
+		g_string_truncate(compound, 0);
+		for (num = 0; i < count; i++) {
+			entry = scpi_cache_lookup(scpi, commands[i]);
+			if (entry && entry->response) {
+				responses[i] = g_strstrip(g_strdup(entry->response));
+				continue;
+			}
+			if (num && compound->len + strlen(commands[i]) + 2 > SCPI_PIPELINE_MAX_LEN)
+				break;
+			if (num) {
+				g_string_append_c(compound, ';');
+				/* Start over at the root of the command tree. */
+				if (commands[i][0] != ':' && commands[i][0] != '*')
+					g_string_append_c(compound, ':');
+			}
+			g_string_append(compound, commands[i]);
+			pending[num++] = i;
+		}
+		if (!num)
+			break;
+
+		start_us = g_get_monotonic_time();
+		g_string_truncate(response, 0);
+		if ((ret = scpi_send(scpi, "%s", compound->str)) != SR_OK)
+			break;
+		if ((ret = scpi_get_data(scpi, NULL, &response)) != SR_OK)
+			break;
+		scpi_stats_add(scpi, compound->str, start_us);
+
+		parts = scpi_split_responses(response->str);
+		if (g_strv_length(parts) != num) {
+			sr_err("Expected %" G_GSIZE_FORMAT " responses to '%s', got %u.",
+				num, compound->str, g_strv_length(parts));
+			g_strfreev(parts);
+			ret = SR_ERR_DATA;
+			break;
+		}
+		for (n = 0; n < num; n++) {
+			g_strstrip(parts[n]);
+			responses[pending[n]] = g_strdup(parts[n]);
+			entry = scpi_cache_lookup(scpi, commands[pending[n]]);
+			if (entry && !entry->response)
+				entry->response = g_strdup(parts[n]);
+		}
+		g_strfreev(parts);
+	}
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	if (ret != SR_OK) {
+		for (i = 0; i < count; i++) {
+			g_free(responses[i]);
+			responses[i] = NULL;
+		}
+	}
+
+	g_string_free(response, TRUE);
+	g_string_free(compound, TRUE);
+	g_free(pending);
+
+	return ret;
+}
+
 /**
  * Send the *IDN? SCPI command, receive the reply, parse it and store the
  * reply as a sr_scpi_hw_info structure in the supplied scpi_response pointer.
@@ -1196,6 +1670,140 @@ SR_PRIV void sr_scpi_hw_info_free(struct sr_scpi_hw_info *hw_info)
 	g_free(hw_info);
 }
 
+/**
+ * Mark a query as cacheable.
+ *
+ * The response to a registered query is remembered and returned by
+ * subsequent sr_scpi_get_*() calls for the very same command string,
+ * without talking to the device. The response is forgotten when the
+ * device is closed, when sr_scpi_cache_invalidate() is called, and,
+ * unless the query is constant, when any command other than a query
+ * is sent to the device.
+ *
+ * Only register queries for settings which the device doesn't change by
+ * itself, or for constant properties like identification and options.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The query, exactly as passed to sr_scpi_get_*().
+ * @param constant TRUE if the response never changes while the device
+ *                 is open.
+ */
+SR_PRIV void sr_scpi_cache_register(struct sr_scpi_dev_inst *scpi,
+		const char *command, gboolean constant)
+{
+	struct scpi_cache_entry *entry;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	if (!scpi->cache)
+		scpi->cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, scpi_cache_entry_free);
+	if (!(entry = g_hash_table_lookup(scpi->cache, command))) {
+		entry = g_malloc0(sizeof(*entry));
+		g_hash_table_insert(scpi->cache, g_strdup(command), entry);
+	}
+	entry->constant = constant;
+	g_mutex_unlock(&scpi->scpi_mutex);
+}
+
+/**
+ * Forget all cached responses, including those of constant queries.
+ *
+ * Drivers call this when the device state may have changed behind
+ * their back, e.g. after a reset or a front panel interaction.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ */
+SR_PRIV void sr_scpi_cache_invalidate(struct sr_scpi_dev_inst *scpi)
+{
+	g_mutex_lock(&scpi->scpi_mutex);
+	scpi_cache_clear(scpi, TRUE);
+	g_mutex_unlock(&scpi->scpi_mutex);
+}
+
+/**
+ * Forget all registered queries and their responses.
+ *
+ * Drivers call this when the conditions under which they registered
+ * queries no longer hold, e.g. when the front panel gets unlocked.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ */
+SR_PRIV void sr_scpi_cache_reset(struct sr_scpi_dev_inst *scpi)
+{
+	g_mutex_lock(&scpi->scpi_mutex);
+	if (scpi->cache)
+		g_hash_table_remove_all(scpi->cache);
+	g_mutex_unlock(&scpi->scpi_mutex);
+}
+
+/**
+ * Get the round-trip statistics of a command.
+ *
+ * Queries are accounted by their command string, commands sent with
+ * sr_scpi_send() by their format string, and compound queries of
+ * sr_scpi_get_strings() by the joined command line.
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] command The command to get the statistics of.
+ * @param[out] stats Where to store the statistics.
+ *
+ * @return SR_OK on success, SR_ERR_NA if the command wasn't issued.
+ */
+SR_PRIV int sr_scpi_stats_get(struct sr_scpi_dev_inst *scpi,
+		const char *command, struct sr_scpi_cmd_stats *stats)
+{
+	struct sr_scpi_cmd_stats *found;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	found = scpi->stats ? g_hash_table_lookup(scpi->stats, command) : NULL;
+	if (found)
+		*stats = *found;
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return found ? SR_OK : SR_ERR_NA;
+}
+
+/**
+ * Reset the round-trip statistics of all commands.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ */
+SR_PRIV void sr_scpi_stats_reset(struct sr_scpi_dev_inst *scpi)
+{
+	g_mutex_lock(&scpi->scpi_mutex);
+	if (scpi->stats)
+		g_hash_table_remove_all(scpi->stats);
+	g_mutex_unlock(&scpi->scpi_mutex);
+}
+
+/**
+ * Log the round-trip statistics of all commands.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ */
+SR_PRIV void sr_scpi_stats_log(struct sr_scpi_dev_inst *scpi)
+{
+	GHashTableIter iter;
+	const char *command;
+	struct sr_scpi_cmd_stats *stats;
+
+	if (sr_log_loglevel_get() < SR_LOG_DBG)
+		return;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	if (scpi->stats) {
+		g_hash_table_iter_init(&iter, scpi->stats);
+		while (g_hash_table_iter_next(&iter, (void **)&command,
+				(void **)&stats)) {
+			sr_dbg("'%s': %" PRIu64 " times, round-trip avg %" PRIu64
+				" us, min %" PRIu64 " us, max %" PRIu64 " us.",
+				command, stats->count, stats->total_us / stats->count,
+				stats->min_us, stats->max_us);
+		}
+	}
+	g_mutex_unlock(&scpi->scpi_mutex);
+}
+
 /**
  * Remove potentially enclosing pairs of quotes, un-escape content.
  * This implementation modifies the caller's buffer when quotes are found
@@ -1320,6 +1928,7 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 	va_list args;
 	const char *channel_cmd;
 	const char *cmd;
+	char *cmdstr;
 	GString *response;
 	char *s;
 	gboolean b;
@@ -1348,15 +1957,12 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 	}
 
 	va_start(args, command);
-	ret = scpi_send_variadic(scpi, cmd, args);
+	cmdstr = scpi_vformat(cmd, args);
 	va_end(args);
-	if (ret != SR_OK) {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		return ret;
-	}
 
 	response = g_string_sized_new(1024);
-	ret = scpi_get_data(scpi, NULL, &response);
+	ret = scpi_get_data(scpi, cmdstr, &response);
+	g_free(cmdstr);
 	if (ret != SR_OK) {
 		g_mutex_unlock(&scpi->scpi_mutex);
 		if (response)
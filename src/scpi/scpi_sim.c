@@ -0,0 +1,459 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Simulated SCPI instrument, answering queries from a transcript file.
+ * Selected with conn=sim/<transcript>, it lets SCPI drivers run without
+ * hardware, e.g. for benchmarks and regression tests.
+ *
+ * The transcript has one rule per line, "<query><TAB><response>":
+ *
+ *   # Comments start with '#'.
+ *   !latency 200          round-trip time of a query in microseconds
+ *   !bandwidth 10000000   response transfer rate in bytes per second
+ *   !default 0            response to queries without a rule
+ *   *IDN?	RIGOL TECHNOLOGIES,DS1054Z,DS1ZA000000001,00.04.04
+ *   :TRIG:STAT?	WAIT
+ *   :TRIG:STAT?	TD
+ *   !match :CHAN?:SCAL?	1.0
+ *   :WAV:DATA?	@block 1200
+ *
+ * Queries are compared case-insensitively and without a leading ':'.
+ * Several rules for the same query return their responses in turn,
+ * "!match" rules are glob patterns tried after the exact rules, and
+ * "@block <n>" answers with an IEEE 488.2 definite length block of n
+ * generated bytes. Commands without a '?' are accepted and ignored.
+ * Compound queries get their responses joined by ';'. As on a raw
+ * socket, output which a driver leaves unread precedes the response
+ * to its next query.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+
+#define LOG_PREFIX "scpi_sim"
+
+#define SIM_PREFIX "sim/"
+
+struct sim_rule {
+	char *pattern;
+	GPtrArray *responses;
+	guint next;
+};
+
+struct scpi_sim {
+	char *path;
+	/* Normalized query -> struct sim_rule. */
+	GHashTable *rules;
+	/* Glob rules, in transcript order. */
+	GSList *match_rules;
+	char *default_response;
+	uint64_t latency_us;
+	uint64_t bandwidth;
+	/* Pending response and read position. */
+	GByteArray *response;
+	size_t read_pos;
+	gint64 ready_us;
+	uint64_t num_queries;
+	uint64_t num_bytes;
+};
+
+static void sim_rule_free(void *data)
+{
+	struct sim_rule *rule = data;
+
+	g_free(rule->pattern);
+	g_ptr_array_free(rule->responses, TRUE);
+	g_free(rule);
+}
+
+/* Takes ownership of the (normalized) pattern. */
+static struct sim_rule *sim_rule_new(char *pattern)
+{
+	struct sim_rule *rule;
+
+	rule = g_malloc0(sizeof(*rule));
+	rule->pattern = pattern;
+	rule->responses = g_ptr_array_new_with_free_func(g_free);
+
+	return rule;
+}
+
+/* Canonical form of a query: no leading ':', upper case. */
+static char *sim_normalize(const char *query)
+{
+	while (g_ascii_isspace(*query))
+		query++;
+	if (*query == ':')
+		query++;
+
+	return g_strstrip(g_ascii_strup(query, -1));
+}
+
+static void sim_clear(struct scpi_sim *sim)
+{
+	if (sim->rules)
+		g_hash_table_destroy(sim->rules);
+	sim->rules = NULL;
+	g_slist_free_full(sim->match_rules, sim_rule_free);
+	sim->match_rules = NULL;
+	g_free(sim->default_response);
+	sim->default_response = NULL;
+	if (sim->response)
+		g_byte_array_free(sim->response, TRUE);
+	sim->response = NULL;
+}
+
+static int sim_parse_directive(struct scpi_sim *sim, char *line,
+		const char *response, unsigned int lineno)
+{
+	struct sim_rule *rule;
+	char **tokens;
+	int ret;
+
+	tokens = g_strsplit_set(line, " \t", 2);
+	ret = SR_OK;
+	if (!strcmp(tokens[0], "!latency") && tokens[1]) {
+		sim->latency_us = g_ascii_strtoull(tokens[1], NULL, 10);
+	} else if (!strcmp(tokens[0], "!bandwidth") && tokens[1]) {
+		sim->bandwidth = g_ascii_strtoull(tokens[1], NULL, 10);
+	} else if (!strcmp(tokens[0], "!default") && tokens[1]) {
+		g_free(sim->default_response);
+		sim->default_response = g_strdup(g_strstrip(tokens[1]));
+	} else if (!strcmp(tokens[0], "!match") && tokens[1] && response) {
+		rule = sim_rule_new(sim_normalize(tokens[1]));
+		g_ptr_array_add(rule->responses, g_strdup(response));
+		sim->match_rules = g_slist_append(sim->match_rules, rule);
+	} else {
+		sr_err("%s:%u: Invalid directive '%s'.", sim->path, lineno, line);
+		ret = SR_ERR_ARG;
+	}
+	g_strfreev(tokens);
+
+	return ret;
+}
+
+static int sim_load(struct scpi_sim *sim)
+{
+	struct sim_rule *rule;
+	GError *error;
+	char *contents, **lines, *line, *tab, *query;
+	unsigned int i;
+	int ret;
+
+	error = NULL;
+	if (!g_file_get_contents(sim->path, &contents, NULL, &error)) {
+		sr_err("Cannot read transcript: %s.", error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+
+	sim->latency_us = 0;
+	sim->bandwidth = 0;
+	sim->rules = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, sim_rule_free);
+	sim->response = g_byte_array_new();
+
+	lines = g_strsplit(contents, "\n", 0);
+	g_free(contents);
+	ret = SR_OK;
+	for (i = 0; lines[i] && ret == SR_OK; i++) {
+		line = lines[i];
+		g_strchomp(line);
+		if (!*line || *line == '#')
+			continue;
+		if ((tab = strchr(line, '\t')))
+			*tab++ = '\0';
+		if (*line == '!') {
+			ret = sim_parse_directive(sim, line, tab, i + 1);
+			continue;
+		}
+		if (!tab) {
+			sr_err("%s:%u: Missing response for '%s'.",
+				sim->path, i + 1, line);
+			ret = SR_ERR_ARG;
+			continue;
+		}
+		query = sim_normalize(line);
+		if (!(rule = g_hash_table_lookup(sim->rules, query))) {
+			rule = sim_rule_new(query);
+			g_hash_table_insert(sim->rules, rule->pattern, rule);
+		} else {
+			g_free(query);
+		}
+		g_ptr_array_add(rule->responses, g_strdup(tab));
+	}
+	g_strfreev(lines);
+
+	if (ret != SR_OK) {
+		sim_clear(sim);
+		return ret;
+	}
+
+	sr_dbg("Loaded %u rules from '%s', latency %" PRIu64 " us, "
+		"bandwidth %" PRIu64 " B/s.", g_hash_table_size(sim->rules) +
+		g_slist_length(sim->match_rules), sim->path,
+		sim->latency_us, sim->bandwidth);
+
+	return SR_OK;
+}
+
+static const char *sim_lookup(struct scpi_sim *sim, const char *query)
+{
+	struct sim_rule *rule;
+	const char *response;
+	GSList *l;
+
+	rule = g_hash_table_lookup(sim->rules, query);
+	for (l = sim->match_rules; !rule && l; l = l->next) {
+		if (g_pattern_match_simple(((struct sim_rule *)l->data)->pattern,
+				query))
+			rule = l->data;
+	}
+	if (!rule)
+		return sim->default_response;
+
+	response = g_ptr_array_index(rule->responses, rule->next);
+	rule->next = (rule->next + 1) % rule->responses->len;
+
+	return response;
+}
+
+/* Append a response, expanding "@block <n>" into a data block. */
+static void sim_append_response(struct scpi_sim *sim, const char *response)
+{
+	char header[16];
+	size_t len, i, offset;
+	uint8_t *data;
+
+	if (strncmp(response, "@block ", 7)) {
+		g_byte_array_append(sim->response,
+			(const guint8 *)response, strlen(response));
+		return;
+	}
+
+	len = g_ascii_strtoull(response + 7, NULL, 10);
+	snprintf(header, sizeof(header), "#9%09" G_GSIZE_FORMAT, len);
+	g_byte_array_append(sim->response, (const guint8 *)header,
+		strlen(header));
+
+	offset = sim->response->len;
+	g_byte_array_set_size(sim->response, offset + len);
+	data = sim->response->data + offset;
+	/* A triangle wave around mid-scale. */
+	for (i = 0; i < len; i++)
+		data[i] = 64 + ((i & 0x80) ? 0x7f - (i & 0x7f) : (i & 0x7f));
+}
+
+static int scpi_sim_dev_inst_new(void *priv, struct drv_context *drvc,
+		const char *resource, char **params, const char *serialcomm)
+{
+	struct scpi_sim *sim = priv;
+
+	(void)drvc;
+	(void)serialcomm;
+
+	if (!params || !params[1]) {
+		sr_err("Invalid parameters.");
+		return SR_ERR;
+	}
+
+	/* The transcript path may contain '/', don't use params[1]. */
+	sim->path = g_strdup(resource + strlen(SIM_PREFIX));
+
+	return SR_OK;
+}
+
+static int scpi_sim_open(struct sr_scpi_dev_inst *scpi)
+{
+	struct scpi_sim *sim = scpi->priv;
+
+	sim->read_pos = 0;
+	sim->num_queries = 0;
+	sim->num_bytes = 0;
+
+	return sim_load(sim);
+}
+
+static int scpi_sim_connection_id(struct sr_scpi_dev_inst *scpi,
+		char **connection_id)
+{
+	struct scpi_sim *sim = scpi->priv;
+
+	*connection_id = g_strdup_printf("%s/%s", scpi->prefix, sim->path);
+
+	return SR_OK;
+}
+
+static int scpi_sim_source_add(struct sr_session *session, void *priv,
+		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
+{
+	(void)timeout;
+
+	/*
+	 * The simulated instrument is always ready, poll continuously.
+	 * There is no file descriptor, key the source by the instance,
+	 * so that several simulated devices can share a session.
+	 */
+	return sr_session_fd_source_add(session, priv, -1, events, 0,
+			cb, cb_data);
+}
+
+static int scpi_sim_source_remove(struct sr_session *session, void *priv)
+{
+	return sr_session_source_remove_internal(session, priv);
+}
+
+static int scpi_sim_send(void *priv, const char *command)
+{
+	struct scpi_sim *sim = priv;
+	const char *response;
+	char **parts, *query;
+	gboolean got_query;
+	unsigned int i;
+
+	if (!sim->response)
+		return SR_ERR;
+
+	parts = g_strsplit(command, ";", 0);
+	got_query = FALSE;
+	for (i = 0; parts[i]; i++) {
+		if (!strchr(parts[i], '?'))
+			continue;
+		if (!got_query) {
+			/*
+			 * Like on a byte stream, unread output of a previous
+			 * query (e.g. a terminator) precedes the new response.
+			 */
+			g_byte_array_remove_range(sim->response, 0,
+				sim->read_pos);
+			sim->read_pos = 0;
+			got_query = TRUE;
+		} else {
+			g_byte_array_append(sim->response, (const guint8 *)";", 1);
+		}
+		query = sim_normalize(parts[i]);
+		if ((response = sim_lookup(sim, query)))
+			sim_append_response(sim, response);
+		else
+			sr_err("No response to '%s' in transcript.", query);
+		g_free(query);
+		sim->num_queries++;
+	}
+	g_strfreev(parts);
+
+	if (got_query) {
+		g_byte_array_append(sim->response, (const guint8 *)"\n", 1);
+		sim->ready_us = g_get_monotonic_time() + sim->latency_us;
+	}
+
+	sr_spew("Successfully sent SCPI command: '%s'.", command);
+
+	return SR_OK;
+}
+
+static int scpi_sim_read_begin(void *priv)
+{
+	(void)priv;
+
+	return SR_OK;
+}
+
+static int scpi_sim_read_data(void *priv, char *buf, int maxlen)
+{
+	struct scpi_sim *sim = priv;
+	gint64 now;
+	size_t len;
+
+	if (!sim->response || sim->read_pos >= sim->response->len) {
+		sr_err("Read without a pending response.");
+		return SR_ERR;
+	}
+
+	len = MIN((size_t)maxlen, sim->response->len - sim->read_pos);
+	if (sim->bandwidth)
+		sim->ready_us += len * G_USEC_PER_SEC / sim->bandwidth;
+	now = g_get_monotonic_time();
+	if (sim->ready_us > now)
+		g_usleep(sim->ready_us - now);
+
+	memcpy(buf, sim->response->data + sim->read_pos, len);
+	sim->read_pos += len;
+	sim->num_bytes += len;
+
+	return len;
+}
+
+static int scpi_sim_write_data(void *priv, char *buf, int len)
+{
+	(void)priv;
+	(void)buf;
+
+	return len;
+}
+
+static int scpi_sim_read_complete(void *priv)
+{
+	struct scpi_sim *sim = priv;
+
+	return !sim->response || sim->read_pos >= sim->response->len;
+}
+
+static int scpi_sim_close(struct sr_scpi_dev_inst *scpi)
+{
+	struct scpi_sim *sim = scpi->priv;
+
+	sr_dbg("%" PRIu64 " queries answered, %" PRIu64 " bytes read.",
+		sim->num_queries, sim->num_bytes);
+	sim_clear(sim);
+
+	return SR_OK;
+}
+
+static void scpi_sim_free(void *priv)
+{
+	struct scpi_sim *sim = priv;
+
+	sim_clear(sim);
+	g_free(sim->path);
+}
+
+SR_PRIV const struct sr_scpi_dev_inst scpi_sim_dev = {
+	.name          = "Simulator",
+	.prefix        = "sim",
+	.transport     = SCPI_TRANSPORT_SIM,
+	.priv_size     = sizeof(struct scpi_sim),
+	.dev_inst_new  = scpi_sim_dev_inst_new,
+	.open          = scpi_sim_open,
+	.connection_id = scpi_sim_connection_id,
+	.source_add    = scpi_sim_source_add,
+	.source_remove = scpi_sim_source_remove,
+	.send          = scpi_sim_send,
+	.read_begin    = scpi_sim_read_begin,
+	.read_data     = scpi_sim_read_data,
+	.write_data    = scpi_sim_write_data,
+	.read_complete = scpi_sim_read_complete,
+	.close         = scpi_sim_close,
+	.free          = scpi_sim_free,
+};
@@ -55,40 +55,146 @@
 
 #ifdef HAVE_SERIAL_COMM
 
-/* See if an (assumed opened) serial port is of any supported type. */
-static int dev_is_supported(struct sr_serial_dev_inst *serial)
-{
-	if (!serial || !serial->lib_funcs)
-		return 0;
+/*
+ * Per-port locking for concurrent scans. While at least one scan scope
+ * is active, serial_open() waits until no other serial_open() holds the
+ * same port, so that drivers probing in parallel never talk to a port
+ * at the same time. Outside of scans, ports are not locked (an opened
+ * device must not block a later scan which happens to name its port).
+ *
+ * A lock lasts until serial_close() or sr_serial_dev_inst_free(). Scans
+ * also drop the locks a driver still holds when its probe returns, so
+ * an error path which forgets to close the port can't block the port
+ * for good.
+ */
+static GMutex port_lock_mutex;
+static GCond port_lock_cond;
+static GHashTable *port_locks;
+static int port_lock_scopes;
 
-	return 1;
-}
+/** @private */
+struct port_lock {
+	struct sr_serial_dev_inst *serial;
+	GThread *owner;
+};
 
 /**
- * Open the specified serial port.
+ * Enter a scope in which serial_open() serializes accesses per port.
  *
- * @param serial Previously initialized serial port structure.
- * @param[in] flags Flags to use when opening the serial port. Possible flags
- *                  include SERIAL_RDWR, SERIAL_RDONLY.
+ * @private
+ */
+SR_PRIV void serial_port_locks_begin(void)
+{
+	g_mutex_lock(&port_lock_mutex);
+	if (!port_lock_scopes++ && !port_locks)
+		port_locks = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	g_mutex_unlock(&port_lock_mutex);
+}
+
+/**
+ * Leave a scope entered by serial_port_locks_begin().
  *
- * If the serial structure contains a serialcomm string, it will be
- * passed to serial_set_paramstr() after the port is opened.
+ * Ports which still are open keep their lock until serial_close().
  *
- * @retval SR_OK Success.
- * @retval SR_ERR Failure.
+ * @private
+ */
+SR_PRIV void serial_port_locks_end(void)
+{
+	g_mutex_lock(&port_lock_mutex);
+	if (port_lock_scopes > 0)
+		port_lock_scopes--;
+	g_mutex_unlock(&port_lock_mutex);
+}
+
+/**
+ * Release all port locks which the calling thread holds.
  *
  * @private
  */
-SR_PRIV int serial_open(struct sr_serial_dev_inst *serial, int flags)
+SR_PRIV void serial_port_locks_release(void)
 {
-	int ret;
+	GHashTableIter iter;
+	struct port_lock *lock;
+	GThread *self;
+	gboolean released;
+
+	self = g_thread_self();
+	released = FALSE;
+	g_mutex_lock(&port_lock_mutex);
+	if (port_locks) {
+		g_hash_table_iter_init(&iter, port_locks);
+		while (g_hash_table_iter_next(&iter, NULL, (void **)&lock)) {
+			if (lock->owner != self)
+				continue;
+			sr_dbg("Releasing lock of serial port '%s'.",
+				lock->serial->port);
+			lock->serial->port_locked = FALSE;
+			g_hash_table_iter_remove(&iter);
+			released = TRUE;
+		}
+	}
+	if (released)
+		g_cond_broadcast(&port_lock_cond);
+	g_mutex_unlock(&port_lock_mutex);
+}
 
-	if (!serial) {
-		sr_dbg("Invalid serial port.");
-		return SR_ERR;
+static void port_lock(struct sr_serial_dev_inst *serial)
+{
+	struct port_lock *lock;
+	gboolean waited;
+
+	g_mutex_lock(&port_lock_mutex);
+	if (!port_lock_scopes || serial->port_locked) {
+		g_mutex_unlock(&port_lock_mutex);
+		return;
 	}
+	waited = FALSE;
+	while (g_hash_table_contains(port_locks, serial->port)) {
+		if (!waited)
+			sr_spew("Waiting for serial port '%s'.", serial->port);
+		waited = TRUE;
+		g_cond_wait(&port_lock_cond, &port_lock_mutex);
+	}
+	lock = g_malloc(sizeof(*lock));
+	lock->serial = serial;
+	lock->owner = g_thread_self();
+	g_hash_table_insert(port_locks, g_strdup(serial->port), lock);
+	serial->port_locked = TRUE;
+	g_mutex_unlock(&port_lock_mutex);
+}
 
-	sr_spew("Opening serial port '%s' (flags %d).", serial->port, flags);
+/**
+ * Release the scan lock of a port, if serial_open() took one.
+ *
+ * @param serial Previously initialized serial port structure.
+ *
+ * @private
+ */
+SR_PRIV void serial_port_unlock(struct sr_serial_dev_inst *serial)
+{
+	if (!serial || !serial->port_locked)
+		return;
+
+	g_mutex_lock(&port_lock_mutex);
+	g_hash_table_remove(port_locks, serial->port);
+	serial->port_locked = FALSE;
+	g_cond_broadcast(&port_lock_cond);
+	g_mutex_unlock(&port_lock_mutex);
+}
+
+/* See if an (assumed opened) serial port is of any supported type. */
+static int dev_is_supported(struct sr_serial_dev_inst *serial)
+{
+	if (!serial || !serial->lib_funcs)
+		return 0;
+
+	return 1;
+}
+
+static int serial_open_port(struct sr_serial_dev_inst *serial, int flags)
+{
+	int ret;
 
 	/*
 	 * Determine which serial transport library to use. Derive the
@@ -142,6 +248,40 @@ SR_PRIV int serial_open(struct sr_serial_dev_inst *serial, int flags)
 	return SR_OK;
 }
 
+/**
+ * Open the specified serial port.
+ *
+ * @param serial Previously initialized serial port structure.
+ * @param[in] flags Flags to use when opening the serial port. Possible flags
+ *                  include SERIAL_RDWR, SERIAL_RDONLY.
+ *
+ * If the serial structure contains a serialcomm string, it will be
+ * passed to serial_set_paramstr() after the port is opened.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Failure.
+ *
+ * @private
+ */
+SR_PRIV int serial_open(struct sr_serial_dev_inst *serial, int flags)
+{
+	int ret;
+
+	if (!serial) {
+		sr_dbg("Invalid serial port.");
+		return SR_ERR;
+	}
+
+	sr_spew("Opening serial port '%s' (flags %d).", serial->port, flags);
+
+	port_lock(serial);
+	ret = serial_open_port(serial, flags);
+	if (ret != SR_OK)
+		serial_port_unlock(serial);
+
+	return ret;
+}
+
 /**
  * Close the specified serial port.
  *
@@ -163,6 +303,8 @@ SR_PRIV int serial_close(struct sr_serial_dev_inst *serial)
 
 	sr_spew("Closing serial port %s.", serial->port);
 
+	serial_port_unlock(serial);
+
 	if (!serial->lib_funcs || !serial->lib_funcs->close)
 		return SR_ERR_NA;
 
@@ -805,6 +947,13 @@ SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial,
  * packets of variable length (#is_valid_len parameter, minimum length
  * #packet_size required for first invocation).
  *
+ * Receive data is read in blocks of whatever is available. Each start
+ * offset gets checked once as soon as enough data was received for it
+ * (or again after more data arrived, when a variable length checker
+ * asked for it). Data which follows a valid packet is put back into the
+ * serial port's receive queue, so that callers see the same data as if
+ * reception had stopped right after the packet.
+ *
  * @retval SR_OK Valid packet was found within the given timeout.
  * @retval SR_ERR Failure.
  *
@@ -817,11 +966,11 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 	uint64_t timeout_ms)
 {
 	uint64_t start_us, elapsed_ms, byte_delay_us;
-	size_t fill_idx, check_idx, max_fill_idx;
+	size_t fill_idx, check_idx, max_fill_idx, end_idx;
 	ssize_t recv_len;
 	const uint8_t *check_ptr;
 	size_t check_len, pkt_len;
-	gboolean do_dump;
+	gboolean do_dump, found;
 	int ret;
 
 	sr_dbg("Detecting packets on %s (timeout = %" PRIu64 "ms).",
@@ -837,79 +986,84 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 		sr_err("Small stream detect RX buffer, want 2x packet size.");
 		return SR_ERR_ARG;
 	}
+	if (!is_valid && !is_valid_len)
+		return SR_ERR_ARG;
+
+	/* Have a queue to put back data which follows a valid packet. */
+	if (!serial->rcv_buffer)
+		serial->rcv_buffer = g_string_sized_new(max_fill_idx);
 
 	byte_delay_us = serial_timeout(serial, 1) * 1000;
 	start_us = g_get_monotonic_time();
 
+	found = FALSE;
+	pkt_len = packet_size;
 	check_idx = fill_idx = 0;
 	while (fill_idx < max_fill_idx) {
 		/*
-		 * Read bytes individually. Lets callers continue to
-		 * successfully process next RX data after first match.
-		 * Run full loop bodies for empty or failed reception
-		 * in an iteration, to have timeouts checked.
+		 * Read all available data at once. Run full loop bodies
+		 * for empty or failed reception in an iteration, to have
+		 * timeouts checked.
 		 */
-		recv_len = serial_read_nonblocking(serial, &buf[fill_idx], 1);
+		recv_len = serial_read_nonblocking(serial, &buf[fill_idx],
+			max_fill_idx - fill_idx);
 		if (recv_len > 0)
 			fill_idx += recv_len;
 
-		/* Dump receive data when (a minimum) size is reached. */
-		check_ptr = &buf[check_idx];
-		check_len = fill_idx - check_idx;
-		do_dump = check_len >= packet_size;
-		do_dump &= sr_log_loglevel_get() >= SR_LOG_SPEW;
-		if (do_dump) {
-			GString *text;
-
-			text = sr_hexdump_new(check_ptr, check_len);
-			sr_spew("Trying packet: len %zu, bytes %s",
-				check_len, text->str);
-			sr_hexdump_free(text);
-		}
-
-		/* A packet's (minimum) length was received, check its data. */
-		elapsed_ms = g_get_monotonic_time() - start_us;
-		elapsed_ms /= 1000;
-		if (is_valid_len && check_len >= packet_size) {
-			pkt_len = packet_size;
-			ret = is_valid_len(NULL, check_ptr, check_len, &pkt_len);
-			if (ret == SR_PACKET_VALID) {
-				/* Exact match. Terminate with success. */
-				sr_spew("Valid packet after %" PRIu64 "ms.",
-					elapsed_ms);
-				sr_spew("RX count %zu, packet len %zu.",
-					fill_idx, pkt_len);
-				*buflen = fill_idx;
-				if (return_size)
-					*return_size = pkt_len;
-				return SR_OK;
+		/* Check all offsets for which a (minimum) length was received. */
+		while (!found && fill_idx - check_idx >= packet_size) {
+			check_ptr = &buf[check_idx];
+			check_len = fill_idx - check_idx;
+			do_dump = sr_log_loglevel_get() >= SR_LOG_SPEW;
+			if (do_dump) {
+				GString *text;
+
+				text = sr_hexdump_new(check_ptr, check_len);
+				sr_spew("Trying packet: len %zu, bytes %s",
+					check_len, text->str);
+				sr_hexdump_free(text);
 			}
-			if (ret == SR_PACKET_NEED_RX) {
-				/* Incomplete, keep accumulating RX data. */
-				sr_spew("Checker needs more RX data.");
-			} else {
-				/* Not a valid packet. Continue searching. */
-				sr_spew("Invalid packet, advancing read pos.");
-				check_idx++;
-			}
-		}
-		if (is_valid && check_len >= packet_size) {
-			if (is_valid(check_ptr)) {
-				/* Exact match. Terminate with success. */
-				sr_spew("Valid packet after %" PRIu64 "ms.",
-					elapsed_ms);
-				sr_spew("RX count %zu, packet len %zu.",
-					fill_idx, packet_size);
-				*buflen = fill_idx;
-				if (return_size)
-					*return_size = packet_size;
-				return SR_OK;
+
+			if (is_valid_len) {
+				pkt_len = packet_size;
+				ret = is_valid_len(NULL, check_ptr, check_len,
+					&pkt_len);
+				if (ret == SR_PACKET_VALID) {
+					found = TRUE;
+					break;
+				}
+				if (ret == SR_PACKET_NEED_RX) {
+					/* Incomplete, keep accumulating RX data. */
+					sr_spew("Checker needs more RX data.");
+					break;
+				}
+			} else if (is_valid(check_ptr)) {
+				pkt_len = packet_size;
+				found = TRUE;
+				break;
 			}
 			/* Not a valid packet. Continue searching. */
-			sr_spew("Invalid packet, advancing read pointer.");
+			sr_spew("Invalid packet, advancing read pos.");
 			check_idx++;
 		}
 
+		elapsed_ms = g_get_monotonic_time() - start_us;
+		elapsed_ms /= 1000;
+		if (found) {
+			/* Exact match. Terminate with success. */
+			end_idx = check_idx + pkt_len;
+			if (end_idx > fill_idx)
+				end_idx = fill_idx;
+			sr_spew("Valid packet after %" PRIu64 "ms.", elapsed_ms);
+			sr_spew("RX count %zu, packet len %zu.", end_idx, pkt_len);
+			sr_ser_queue_rx_data(serial, &buf[end_idx],
+				fill_idx - end_idx);
+			*buflen = end_idx;
+			if (return_size)
+				*return_size = pkt_len;
+			return SR_OK;
+		}
+
 		/* Check for packet search timeout. */
 		if (elapsed_ms >= timeout_ms) {
 			sr_dbg("Detection timed out after %" PRIu64 "ms.",
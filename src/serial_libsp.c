@@ -203,6 +203,7 @@ static int sr_ser_libsp_read(struct sr_serial_dev_inst *serial,
 	int nonblocking, unsigned int timeout_ms)
 {
 	ssize_t ret;
+	size_t queued;
 	char *error;
 
 	if (!serial->sp_data) {
@@ -210,6 +211,13 @@ static int sr_ser_libsp_read(struct sr_serial_dev_inst *serial,
 		return SR_ERR;
 	}
 
+	/* Data which serial_stream_detect() put back comes first. */
+	queued = sr_ser_unqueue_rx_data(serial, buf, count);
+	if (queued == count)
+		return queued;
+	buf = (uint8_t *)buf + queued;
+	count -= queued;
+
 	if (nonblocking)
 		ret = sp_nonblocking_read(serial->sp_data, buf, count);
 	else
@@ -218,15 +226,15 @@ static int sr_ser_libsp_read(struct sr_serial_dev_inst *serial,
 	switch (ret) {
 	case SP_ERR_ARG:
 		sr_err("Attempted serial port read with invalid arguments.");
-		return SR_ERR_ARG;
+		return queued ? (int)queued : SR_ERR_ARG;
 	case SP_ERR_FAIL:
 		error = sp_last_error_message();
 		sr_err("Read error (%d): %s.", sp_last_error_code(), error);
 		sp_free_error_message(error);
-		return SR_ERR;
+		return queued ? (int)queued : SR_ERR;
 	}
 
-	return ret;
+	return ret + queued;
 }
 
 static int sr_ser_libsp_set_params(struct sr_serial_dev_inst *serial,
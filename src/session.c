@@ -49,6 +49,48 @@
 struct datafeed_callback {
 	sr_datafeed_callback cb;
 	void *cb_data;
+	struct sr_stats stats;
+};
+
+/** Event loop thread of one device in a threaded session run. */
+struct session_dev_thread {
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GMainContext *main_context;
+	GMainLoop *main_loop;
+	GThread *thread;
+};
+
+/* The device thread whose event sources the current thread handles. */
+static GPrivate current_dev_thread = G_PRIVATE_INIT(NULL);
+
+/*
+ * Set while the current thread runs the transforms and datafeed
+ * callbacks, i.e. holds the session's datafeed_mutex.
+ */
+static GPrivate in_datafeed = G_PRIVATE_INIT(NULL);
+
+/*
+ * Functions which wait for the device threads must not be called with
+ * the datafeed lock held: a device thread may be blocked on that lock.
+ */
+static int datafeed_lock_check(struct sr_session *session, const char *func)
+{
+	if (g_private_get(&in_datafeed) != session)
+		return SR_OK;
+	sr_err("%s: Must not be called from a datafeed callback.", func);
+
+	return SR_ERR_BUG;
+}
+
+/*
+ * An installed event source. Keys (file descriptors, libusb contexts,
+ * -1 for timers) are only unique per device thread: two devices of a
+ * threaded run may well use the same one.
+ */
+struct session_source {
+	void *key;
+	struct session_dev_thread *dt;
 };
 
 /** Custom GLib event source for generic descriptor I/O.
@@ -225,11 +267,16 @@ SR_API int sr_session_new(struct sr_context *ctx,
 	session->ctx = ctx;
 
 	g_mutex_init(&session->main_mutex);
+	g_mutex_init(&session->sources_mutex);
+	g_rec_mutex_init(&session->datafeed_mutex);
+	g_mutex_init(&session->stats_mutex);
 
 	/* To maintain API compatibility, we need a lookup table
-	 * which maps poll_object IDs to GSource* pointers.
+	 * which maps poll_object IDs to GSource* pointers. It is indexed
+	 * by the GSource, see struct session_source.
 	 */
-	session->event_sources = g_hash_table_new(NULL, NULL);
+	session->event_sources = g_hash_table_new_full(NULL, NULL,
+		NULL, g_free);
 
 	*new_session = session;
 
@@ -253,6 +300,8 @@ SR_API int sr_session_destroy(struct sr_session *session)
 		sr_err("%s: session was NULL", __func__);
 		return SR_ERR_ARG;
 	}
+	if (datafeed_lock_check(session, __func__) != SR_OK)
+		return SR_ERR_BUG;
 
 	sr_session_dev_remove_all(session);
 	g_slist_free_full(session->owned_devs, (GDestroyNotify)sr_dev_inst_free);
@@ -262,6 +311,9 @@ SR_API int sr_session_destroy(struct sr_session *session)
 	g_hash_table_unref(session->event_sources);
 
 	g_mutex_clear(&session->main_mutex);
+	g_mutex_clear(&session->sources_mutex);
+	g_rec_mutex_clear(&session->datafeed_mutex);
+	g_mutex_clear(&session->stats_mutex);
 
 	g_free(session);
 
@@ -302,6 +354,15 @@ SR_API int sr_session_dev_remove_all(struct sr_session *session)
 	return SR_OK;
 }
 
+/* Give the device fresh counters for its new session. */
+static void stats_attach(struct sr_dev_inst *sdi)
+{
+	if (!sdi->stats)
+		sdi->stats = g_malloc0(sizeof(struct sr_stats));
+	else
+		memset(sdi->stats, 0, sizeof(struct sr_stats));
+}
+
 /**
  * Add a device instance to a session.
  *
@@ -342,6 +403,7 @@ SR_API int sr_session_dev_add(struct sr_session *session,
 		/* Just add the device, don't run dev_open(). */
 		session->devs = g_slist_append(session->devs, sdi);
 		sdi->session = session;
+		stats_attach(sdi);
 		return SR_OK;
 	}
 
@@ -353,6 +415,7 @@ SR_API int sr_session_dev_add(struct sr_session *session,
 
 	session->devs = g_slist_append(session->devs, sdi);
 	sdi->session = session;
+	stats_attach(sdi);
 
 	/* TODO: This is invalid if the session runs in a different thread.
 	 * The usage semantics and restrictions need to be documented.
@@ -544,6 +607,77 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 	return SR_OK;
 }
 
+/**
+ * Set whether each device of the session runs in a thread of its own.
+ *
+ * In a threaded session run every device gets its own thread and GLib
+ * main context, which dispatch the event sources of that device. Slow
+ * devices then no longer delay the servicing of fast ones.
+ *
+ * Transforms and datafeed callbacks are invoked from the device threads,
+ * but never concurrently. Packets of one device are delivered in the
+ * order the device sent them, packets of different devices may be
+ * interleaved arbitrarily. The session stopped callback is still
+ * invoked in the thread which called sr_session_start().
+ *
+ * Datafeed callbacks run with a session lock held, which other device
+ * threads wait for. They must therefore not wait for another thread of
+ * the session (e.g. by dispatching the session main context), and not
+ * call sr_session_start(), sr_session_run() or sr_session_destroy().
+ * sr_session_stop() may be called, it does not wait.
+ *
+ * Note that event sources shared by several devices (such as the libusb
+ * event source of the context) are dispatched by the thread of the
+ * device which installed them. USB streams install a source of their
+ * own per device, but a completion may still be handled by whichever
+ * thread handles the context's events.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param threaded TRUE for one thread per device, FALSE (the default)
+ *                 to run all devices in the session thread.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_threaded_set(struct sr_session *session, gboolean threaded)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change threading while the session is running.");
+		return SR_ERR;
+	}
+	session->threaded = threaded;
+
+	return SR_OK;
+}
+
+/**
+ * Return whether each device of the session runs in a thread of its own.
+ *
+ * @param session The session to use. Must not be NULL.
+ *
+ * @retval TRUE One thread per device.
+ * @retval FALSE All devices run in the session thread.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_threaded_get(struct sr_session *session)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	return session->threaded;
+}
+
 static int verify_trigger(struct sr_trigger *trigger)
 {
 	struct sr_trigger_stage *stage;
@@ -654,14 +788,33 @@ static int unset_main_context(struct sr_session *session)
 	return ret;
 }
 
+/* The device thread of this session the current thread belongs to, if any. */
+static struct session_dev_thread *current_dev_thread_get(
+		struct sr_session *session)
+{
+	struct session_dev_thread *dt;
+
+	dt = g_private_get(&current_dev_thread);
+
+	return (dt && dt->session == session) ? dt : NULL;
+}
+
+/*
+ * Event sources installed while acquisition of a device in a threaded
+ * run is started, or by the device's thread itself, go to the device's
+ * main context. Everything else goes to the session main context.
+ */
 static unsigned int session_source_attach(struct sr_session *session,
 		GSource *source)
 {
+	struct session_dev_thread *dt;
 	unsigned int id = 0;
 
 	g_mutex_lock(&session->main_mutex);
 
-	if (session->main_context)
+	if ((dt = current_dev_thread_get(session)))
+		id = g_source_attach(source, dt->main_context);
+	else if (session->main_context)
 		id = g_source_attach(source, session->main_context);
 	else
 		sr_err("Cannot add event source without main context.");
@@ -671,6 +824,140 @@ static unsigned int session_source_attach(struct sr_session *session,
 	return id;
 }
 
+static unsigned int session_sources_count(struct sr_session *session)
+{
+	unsigned int count;
+
+	g_mutex_lock(&session->sources_mutex);
+	count = g_hash_table_size(session->event_sources);
+	g_mutex_unlock(&session->sources_mutex);
+
+	return count;
+}
+
+static gpointer dev_thread_run(gpointer data)
+{
+	struct session_dev_thread *dt;
+
+	dt = data;
+
+	g_private_set(&current_dev_thread, dt);
+	g_main_context_push_thread_default(dt->main_context);
+
+	g_main_loop_run(dt->main_loop);
+
+	g_main_context_pop_thread_default(dt->main_context);
+	g_private_set(&current_dev_thread, NULL);
+
+	return NULL;
+}
+
+static gboolean dev_thread_quit(void *data)
+{
+	struct session_dev_thread *dt;
+
+	dt = data;
+	g_main_loop_quit(dt->main_loop);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean dev_thread_acquisition_stop(void *data)
+{
+	struct session_dev_thread *dt;
+
+	dt = data;
+	sr_dev_acquisition_stop(dt->sdi);
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Run a function in the device thread. Unlike g_main_context_invoke()
+ * this never runs it in the calling thread, even if the device thread
+ * did not acquire its main context yet.
+ */
+static void dev_thread_invoke(struct session_dev_thread *dt, GSourceFunc func)
+{
+	GSource *source;
+
+	source = g_idle_source_new();
+	g_source_set_callback(source, func, dt, NULL);
+	g_source_attach(source, dt->main_context);
+	g_source_unref(source);
+}
+
+static struct session_dev_thread *dev_thread_find(struct sr_session *session,
+		const struct sr_dev_inst *sdi)
+{
+	struct session_dev_thread *dt;
+	GSList *l;
+
+	for (l = session->dev_threads; l; l = l->next) {
+		dt = l->data;
+		if (dt->sdi == sdi)
+			return dt;
+	}
+
+	return NULL;
+}
+
+/*
+ * Create the main contexts of the device threads. The threads are only
+ * started once all devices started acquisition, so that nothing of a
+ * device is dispatched before its acquisition start returned.
+ */
+static void dev_threads_create(struct sr_session *session)
+{
+	struct session_dev_thread *dt;
+	GSList *l;
+
+	for (l = session->devs; l; l = l->next) {
+		dt = g_malloc0(sizeof(*dt));
+		dt->session = session;
+		dt->sdi = l->data;
+		dt->main_context = g_main_context_new();
+		dt->main_loop = g_main_loop_new(dt->main_context, FALSE);
+		session->dev_threads = g_slist_append(session->dev_threads, dt);
+	}
+}
+
+static void dev_threads_start(struct sr_session *session)
+{
+	struct session_dev_thread *dt;
+	GSList *l;
+
+	for (l = session->dev_threads; l; l = l->next) {
+		dt = l->data;
+		dt->thread = g_thread_new(dt->sdi->driver->name,
+			dev_thread_run, dt);
+	}
+	sr_dbg("Started %u device threads.",
+		g_slist_length(session->dev_threads));
+}
+
+static void dev_threads_stop(struct sr_session *session)
+{
+	struct session_dev_thread *dt;
+	GSList *l;
+
+	for (l = session->dev_threads; l; l = l->next) {
+		dt = l->data;
+		if (dt->thread) {
+			dev_thread_invoke(dt, &dev_thread_quit);
+			g_thread_join(dt->thread);
+		}
+	}
+	for (l = session->dev_threads; l; l = l->next) {
+		dt = l->data;
+		g_main_loop_unref(dt->main_loop);
+		g_main_context_unref(dt->main_context);
+		g_free(dt);
+	}
+	g_slist_free(session->dev_threads);
+	session->dev_threads = NULL;
+}
+
 /* Idle handler; invoked when the number of registered event sources
  * for a running session drops to zero.
  */
@@ -679,16 +966,22 @@ static gboolean delayed_stop_check(void *data)
 	struct sr_session *session;
 
 	session = data;
+
+	g_mutex_lock(&session->main_mutex);
 	session->stop_check_id = 0;
+	g_mutex_unlock(&session->main_mutex);
 
 	/* Session already ended? */
 	if (!session->running)
 		return G_SOURCE_REMOVE;
 
 	/* New event sources may have been installed in the meantime. */
-	if (g_hash_table_size(session->event_sources) != 0)
+	if (session_sources_count(session) != 0)
 		return G_SOURCE_REMOVE;
 
+	/* Let the device threads finish their last dispatch. */
+	dev_threads_stop(session);
+
 	session->running = FALSE;
 	unset_main_context(session);
 
@@ -710,20 +1003,36 @@ static gboolean delayed_stop_check(void *data)
 	return G_SOURCE_REMOVE;
 }
 
+/*
+ * May be called from device threads, the stop check itself always runs
+ * in the session main context.
+ */
 static int stop_check_later(struct sr_session *session)
 {
 	GSource *source;
 	unsigned int source_id;
 
-	if (session->stop_check_id != 0)
-		return SR_OK; /* idle handler already installed */
+	g_mutex_lock(&session->main_mutex);
+
+	if (session->stop_check_id != 0) {
+		/* Idle handler already installed. */
+		g_mutex_unlock(&session->main_mutex);
+		return SR_OK;
+	}
+	if (!session->main_context) {
+		sr_err("Cannot add event source without main context.");
+		g_mutex_unlock(&session->main_mutex);
+		return SR_ERR;
+	}
 
 	source = g_idle_source_new();
 	g_source_set_callback(source, &delayed_stop_check, session, NULL);
 
-	source_id = session_source_attach(session, source);
+	source_id = g_source_attach(source, session->main_context);
 	session->stop_check_id = source_id;
 
+	g_mutex_unlock(&session->main_mutex);
+
 	g_source_unref(source);
 
 	return (source_id != 0) ? SR_OK : SR_ERR;
@@ -772,6 +1081,8 @@ SR_API int sr_session_start(struct sr_session *session)
 		sr_err("Cannot (re-)start session while it is still running.");
 		return SR_ERR;
 	}
+	if (datafeed_lock_check(session, __func__) != SR_OK)
+		return SR_ERR_BUG;
 
 	if (session->trigger) {
 		ret = verify_trigger(session->trigger);
@@ -810,6 +1121,9 @@ SR_API int sr_session_start(struct sr_session *session)
 
 	session->running = TRUE;
 
+	if (session->threaded)
+		dev_threads_create(session);
+
 	/* Have all devices start acquisition. */
 	for (l = session->devs; l; l = l->next) {
 		if (!(sdi = l->data)) {
@@ -817,7 +1131,11 @@ SR_API int sr_session_start(struct sr_session *session)
 			ret = SR_ERR;
 			break;
 		}
+		/* Route the device's event sources to its thread, if any. */
+		g_private_set(&current_dev_thread,
+			dev_thread_find(session, sdi));
 		ret = sr_dev_acquisition_start(sdi);
+		g_private_set(&current_dev_thread, NULL);
 		if (ret != SR_OK) {
 			sr_err("Could not start %s device %s acquisition.",
 				sdi->driver->name, sdi->connection_id);
@@ -835,13 +1153,17 @@ SR_API int sr_session_start(struct sr_session *session)
 		}
 		/* TODO: Handle delayed stops. Need to iterate the event
 		 * sources... */
+		dev_threads_stop(session);
 		session->running = FALSE;
 
 		unset_main_context(session);
 		return ret;
 	}
 
-	if (g_hash_table_size(session->event_sources) == 0)
+	if (session->dev_threads)
+		dev_threads_start(session);
+
+	if (session_sources_count(session) == 0)
 		stop_check_later(session);
 
 	return SR_OK;
@@ -879,6 +1201,8 @@ SR_API int sr_session_run(struct sr_session *session)
 		sr_err("Main loop already created.");
 		return SR_ERR;
 	}
+	if (datafeed_lock_check(session, __func__) != SR_OK)
+		return SR_ERR_BUG;
 
 	g_mutex_lock(&session->main_mutex);
 
@@ -903,6 +1227,7 @@ static gboolean session_stop_sync(void *user_data)
 {
 	struct sr_session *session;
 	struct sr_dev_inst *sdi;
+	struct session_dev_thread *dt;
 	GSList *node;
 
 	session = user_data;
@@ -914,7 +1239,11 @@ static gboolean session_stop_sync(void *user_data)
 
 	for (node = session->devs; node; node = node->next) {
 		sdi = node->data;
-		sr_dev_acquisition_stop(sdi);
+		/* Drivers expect to be stopped from their event thread. */
+		if ((dt = dev_thread_find(session, sdi)))
+			dev_thread_invoke(dt, &dev_thread_acquisition_stop);
+		else
+			sr_dev_acquisition_stop(sdi);
 	}
 
 	return G_SOURCE_REMOVE;
@@ -1035,6 +1364,7 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_timestamp *timestamp;
 
 	/* Please use the same order as in libsigrok.h. */
 	switch (packet->type) {
@@ -1066,6 +1396,12 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_TIMESTAMP:
+		timestamp = packet->payload;
+		sr_dbg("bus: Received SR_DF_TIMESTAMP packet (sample %" PRIu64
+		       " at %" PRId64 " ns).", timestamp->sample_num,
+		       timestamp->time_ns);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
@@ -1108,41 +1444,67 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
-/**
- * Send a packet to whatever is listening on the datafeed bus.
- *
- * Hardware drivers use this to send a data packet to the frontend.
- *
- * @param sdi TODO.
- * @param packet The datafeed packet to send to the session bus.
- *
- * @retval SR_OK Success.
- * @retval SR_ERR_ARG Invalid argument.
- *
- * @private
+static void stats_count(struct sr_stats *stats,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	stats->packets++;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		stats->bytes += logic->length;
+		if (logic->unitsize)
+			stats->samples += logic->length / logic->unitsize;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		stats->bytes += (uint64_t)analog->num_samples *
+			analog->encoding->unitsize;
+		stats->samples += analog->num_samples;
+		break;
+	default:
+		break;
+	}
+}
+
+static void stats_time(struct sr_stats *stats, int64_t time_us)
+{
+	unsigned int bucket;
+
+	if (time_us < 0)
+		time_us = 0;
+	stats->time_us += time_us;
+	bucket = time_us ? g_bit_storage(time_us) : 0;
+	stats->latency[MIN(bucket, SR_STATS_LATENCY_BUCKETS - 1)]++;
+}
+
+/*
+ * Called with datafeed_mutex held, which also protects the datafeed,
+ * transform and callback counters. The device's counters are shared
+ * with the driver's reports, see sr_session_stats_dropped().
  */
-SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+static int session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
 	GSList *l;
+	struct sr_session *session;
 	struct datafeed_callback *cb_struct;
 	struct sr_datafeed_packet *packet_in, *packet_out;
 	struct sr_transform *t;
+	gboolean timing;
+	int64_t start_us, t_us;
 	int ret;
 
-	if (!sdi) {
-		sr_err("%s: sdi was NULL", __func__);
-		return SR_ERR_ARG;
-	}
-
-	if (!packet) {
-		sr_err("%s: packet was NULL", __func__);
-		return SR_ERR_ARG;
-	}
-
-	if (!sdi->session) {
-		sr_err("%s: session was NULL", __func__);
-		return SR_ERR_BUG;
+	session = sdi->session;
+	timing = g_atomic_int_get(&session->stats_timing);
+	start_us = timing ? g_get_monotonic_time() : 0;
+	stats_count(&session->datafeed_stats, packet);
+	if (sdi->stats) {
+		g_mutex_lock(&session->stats_mutex);
+		stats_count(sdi->stats, packet);
+		g_mutex_unlock(&session->stats_mutex);
 	}
 
 	/*
@@ -1151,10 +1513,14 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	 * transform module in the list, and so on.
 	 */
 	packet_in = (struct sr_datafeed_packet *)packet;
-	for (l = sdi->session->transforms; l; l = l->next) {
+	for (l = session->transforms; l; l = l->next) {
 		t = l->data;
 		sr_spew("Running transform module '%s'.", t->module->id);
+		stats_count(&t->stats, packet_in);
+		t_us = timing ? g_get_monotonic_time() : 0;
 		ret = t->module->receive(t, packet_in, &packet_out);
+		if (timing)
+			stats_time(&t->stats, g_get_monotonic_time() - t_us);
 		if (ret < 0) {
 			sr_err("Error while running transform module: %d.", ret);
 			return SR_ERR;
@@ -1165,6 +1531,7 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 			 * packet, abort.
 			 */
 			sr_spew("Transform module didn't return a packet, aborting.");
+			t->stats.dropped++;
 			return SR_OK;
 		} else {
 			/*
@@ -1180,16 +1547,328 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	 * If the last transform did output a packet, pass it to all datafeed
 	 * callbacks.
 	 */
-	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+	for (l = session->datafeed_callbacks; l; l = l->next) {
 		if (sr_log_loglevel_get() >= SR_LOG_DBG)
 			datafeed_dump(packet);
 		cb_struct = l->data;
+		stats_count(&cb_struct->stats, packet);
+		t_us = timing ? g_get_monotonic_time() : 0;
 		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+		if (timing)
+			stats_time(&cb_struct->stats, g_get_monotonic_time() - t_us);
 	}
 
+	if (timing)
+		stats_time(&session->datafeed_stats,
+			g_get_monotonic_time() - start_us);
+
 	return SR_OK;
 }
 
+/**
+ * Send a packet to whatever is listening on the datafeed bus.
+ *
+ * Hardware drivers use this to send a data packet to the frontend.
+ *
+ * @param sdi TODO.
+ * @param packet The datafeed packet to send to the session bus.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct sr_session *session;
+	void *outer;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: sdi was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!packet) {
+		sr_err("%s: packet was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!sdi->session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	/*
+	 * Device threads take turns, each in its own packet order. The
+	 * lock also keeps sr_session_stats_get() from reading counters
+	 * while they are updated. It comes first in the lock order: the
+	 * source, main context and stats locks may be taken while it is
+	 * held, but nothing may wait for another thread of the session.
+	 */
+	session = sdi->session;
+	g_rec_mutex_lock(&session->datafeed_mutex);
+	outer = g_private_get(&in_datafeed);
+	g_private_set(&in_datafeed, session);
+	ret = session_send(sdi, packet);
+	g_private_set(&in_datafeed, outer);
+	g_rec_mutex_unlock(&session->datafeed_mutex);
+
+	return ret;
+}
+
+/**
+ * Count data a device had to drop, e.g. because the host fell behind.
+ *
+ * May be called from any thread.
+ *
+ * @param sdi The device which dropped data.
+ * @param bytes Number of bytes lost.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_stats_dropped(const struct sr_dev_inst *sdi,
+		uint64_t bytes)
+{
+	if (!sdi || !sdi->stats || !sdi->session)
+		return;
+
+	g_mutex_lock(&sdi->session->stats_mutex);
+	sdi->stats->dropped += bytes;
+	g_mutex_unlock(&sdi->session->stats_mutex);
+}
+
+/**
+ * Record a driver internal latency, such as the time it took to
+ * resubmit a completed USB transfer. May be called from any thread.
+ *
+ * @param sdi The device the latency was observed for.
+ * @param latency_us The latency in microseconds.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_stats_latency(const struct sr_dev_inst *sdi,
+		int64_t latency_us)
+{
+	if (!sdi || !sdi->stats || !sdi->session)
+		return;
+
+	g_mutex_lock(&sdi->session->stats_mutex);
+	stats_time(sdi->stats, latency_us);
+	g_mutex_unlock(&sdi->session->stats_mutex);
+}
+
+/**
+ * Count a frame the device has completed, and record the time it took
+ * like a latency. May be called from any thread.
+ *
+ * @param sdi The device which acquired the frame.
+ * @param frame_us The time from the start to the end of the frame in
+ *                 microseconds.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_stats_frame(const struct sr_dev_inst *sdi,
+		int64_t frame_us)
+{
+	if (!sdi || !sdi->stats || !sdi->session)
+		return;
+
+	g_mutex_lock(&sdi->session->stats_mutex);
+	sdi->stats->frames++;
+	stats_time(sdi->stats, frame_us);
+	g_mutex_unlock(&sdi->session->stats_mutex);
+}
+
+static struct sr_stats *stats_copy(const struct sr_stats *src, char *name)
+{
+	struct sr_stats *stats;
+
+	stats = g_malloc(sizeof(*stats));
+	*stats = *src;
+	stats->name = name;
+
+	return stats;
+}
+
+static void stats_free(struct sr_stats *stats)
+{
+	g_free(stats->name);
+	g_free(stats);
+}
+
+/**
+ * Get the performance counters of a session.
+ *
+ * Counters are kept for the session datafeed as a whole, for every
+ * device, transform and datafeed callback, since the session was
+ * created or the counters were last reset. Packet, byte and sample
+ * counts are always maintained. To keep sessions which nobody observes
+ * from reading the clock for every packet, times are only measured
+ * once this function or sr_session_stats_reset() has been called.
+ *
+ * The counters may be read while the session is running. Such a
+ * snapshot is not atomic, counters of different stages may be off by
+ * the packets in flight.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stats Pointer to store the counters in. Must not be NULL.
+ *              Free with sr_session_stats_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_stats_get(struct sr_session *session,
+		struct sr_session_stats **stats)
+{
+	struct sr_session_stats *st;
+	struct sr_dev_inst *sdi;
+	struct sr_transform *t;
+	struct datafeed_callback *cb_struct;
+	GSList *l;
+	unsigned int i;
+
+	if (!session || !stats) {
+		sr_err("%s: invalid argument", __func__);
+		return SR_ERR_ARG;
+	}
+	g_atomic_int_set(&session->stats_timing, TRUE);
+
+	st = g_malloc0(sizeof(*st));
+	g_rec_mutex_lock(&session->datafeed_mutex);
+	st->datafeed = session->datafeed_stats;
+	st->datafeed.name = g_strdup("datafeed");
+	g_mutex_lock(&session->stats_mutex);
+	for (l = session->devs; l; l = l->next) {
+		sdi = l->data;
+		if (!sdi->stats)
+			continue;
+		st->devices = g_slist_append(st->devices,
+			stats_copy(sdi->stats, g_strdup_printf("%s %s",
+				sdi->driver ? sdi->driver->name : "virtual",
+				sdi->connection_id ? sdi->connection_id : "")));
+	}
+	g_mutex_unlock(&session->stats_mutex);
+	for (l = session->transforms; l; l = l->next) {
+		if (!(t = l->data))
+			continue;
+		st->transforms = g_slist_append(st->transforms,
+			stats_copy(&t->stats, g_strdup(t->module->id)));
+	}
+	for (l = session->datafeed_callbacks, i = 0; l; l = l->next, i++) {
+		cb_struct = l->data;
+		st->callbacks = g_slist_append(st->callbacks,
+			stats_copy(&cb_struct->stats,
+				g_strdup_printf("callback %u", i)));
+	}
+	g_rec_mutex_unlock(&session->datafeed_mutex);
+	*stats = st;
+
+	return SR_OK;
+}
+
+/**
+ * Free performance counters returned by sr_session_stats_get().
+ *
+ * @param stats The counters to free. May be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_session_stats_free(struct sr_session_stats *stats)
+{
+	if (!stats)
+		return;
+
+	g_free(stats->datafeed.name);
+	g_slist_free_full(stats->devices, (GDestroyNotify)stats_free);
+	g_slist_free_full(stats->transforms, (GDestroyNotify)stats_free);
+	g_slist_free_full(stats->callbacks, (GDestroyNotify)stats_free);
+	g_free(stats);
+}
+
+/**
+ * Reset all performance counters of a session to zero, and start
+ * measuring times.
+ *
+ * May be called while the session is running.
+ *
+ * @param session The session to use. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_stats_reset(struct sr_session *session)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_transform *t;
+	struct datafeed_callback *cb_struct;
+	GSList *l;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	g_rec_mutex_lock(&session->datafeed_mutex);
+	memset(&session->datafeed_stats, 0, sizeof(struct sr_stats));
+	g_mutex_lock(&session->stats_mutex);
+	for (l = session->devs; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->stats)
+			memset(sdi->stats, 0, sizeof(struct sr_stats));
+	}
+	g_mutex_unlock(&session->stats_mutex);
+	for (l = session->transforms; l; l = l->next) {
+		if ((t = l->data))
+			memset(&t->stats, 0, sizeof(struct sr_stats));
+	}
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		memset(&cb_struct->stats, 0, sizeof(struct sr_stats));
+	}
+	g_rec_mutex_unlock(&session->datafeed_mutex);
+	g_atomic_int_set(&session->stats_timing, TRUE);
+
+	return SR_OK;
+}
+
+/*
+ * Find the source for a key of the current device thread. Sources may
+ * also be removed from other threads (the session thread, or a device
+ * thread which happened to handle another device's USB completion),
+ * then the key must be unique over all device threads. Keys of USB
+ * streams always are. Called with sources_mutex held.
+ */
+static GSource *session_source_find(struct sr_session *session, void *key,
+		gboolean any_thread)
+{
+	struct session_dev_thread *dt;
+	struct session_source *ssrc;
+	GHashTableIter iter;
+	GSource *source, *found;
+	unsigned int matches;
+
+	dt = current_dev_thread_get(session);
+	found = NULL;
+	matches = 0;
+	g_hash_table_iter_init(&iter, session->event_sources);
+	while (g_hash_table_iter_next(&iter, (gpointer *)&source, (gpointer *)&ssrc)) {
+		if (ssrc->key != key)
+			continue;
+		if (ssrc->dt == dt)
+			return source;
+		found = source;
+		matches++;
+	}
+
+	return (any_thread && matches == 1) ? found : NULL;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -1207,17 +1886,25 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
 		void *key, GSource *source)
 {
+	struct session_source *ssrc;
+
 	/*
 	 * This must not ever happen, since the source has already been
 	 * created and its finalize() method will remove the key for the
 	 * already installed source. (Well it would, if we did not have
 	 * another sanity check there.)
 	 */
-	if (g_hash_table_contains(session->event_sources, key)) {
+	g_mutex_lock(&session->sources_mutex);
+	if (session_source_find(session, key, FALSE)) {
+		g_mutex_unlock(&session->sources_mutex);
 		sr_err("Event source with key %p already exists.", key);
 		return SR_ERR_BUG;
 	}
-	g_hash_table_insert(session->event_sources, key, source);
+	ssrc = g_malloc(sizeof(*ssrc));
+	ssrc->key = key;
+	ssrc->dt = current_dev_thread_get(session);
+	g_hash_table_insert(session->event_sources, source, ssrc);
+	g_mutex_unlock(&session->sources_mutex);
 
 	if (session_source_attach(session, source) == 0)
 		return SR_ERR;
@@ -1357,7 +2044,12 @@ SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 {
 	GSource *source;
 
-	source = g_hash_table_lookup(session->event_sources, key);
+	g_mutex_lock(&session->sources_mutex);
+	source = session_source_find(session, key, TRUE);
+	/* Keep the source alive, finalize() takes the table lock. */
+	if (source)
+		g_source_ref(source);
+	g_mutex_unlock(&session->sources_mutex);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
@@ -1367,6 +2059,7 @@ SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 		return SR_ERR_BUG;
 	}
 	g_source_destroy(source);
+	g_source_unref(source);
 
 	return SR_OK;
 }
@@ -1452,25 +2145,31 @@ SR_PRIV int sr_session_source_remove_channel(struct sr_session *session,
 SR_PRIV int sr_session_source_destroyed(struct sr_session *session,
 		void *key, GSource *source)
 {
-	GSource *registered_source;
+	struct session_source *ssrc;
+	unsigned int remaining;
 
-	registered_source = g_hash_table_lookup(session->event_sources, key);
+	g_mutex_lock(&session->sources_mutex);
+	ssrc = g_hash_table_lookup(session->event_sources, source);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
 	 */
-	if (!registered_source) {
+	if (!ssrc) {
+		g_mutex_unlock(&session->sources_mutex);
 		sr_err("No event source for key %p found.", key);
 		return SR_ERR_BUG;
 	}
-	if (registered_source != source) {
+	if (ssrc->key != key) {
+		g_mutex_unlock(&session->sources_mutex);
 		sr_err("Event source for key %p does not match"
 			" destroyed source.", key);
 		return SR_ERR_BUG;
 	}
-	g_hash_table_remove(session->event_sources, key);
+	g_hash_table_remove(session->event_sources, source);
+	remaining = g_hash_table_size(session->event_sources);
+	g_mutex_unlock(&session->sources_mutex);
 
-	if (g_hash_table_size(session->event_sources) > 0)
+	if (remaining > 0)
 		return SR_OK;
 
 	/* If no event sources are left, consider the acquisition finished.
@@ -1507,6 +2206,7 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_analog_meaning *meaning_copy;
 	struct sr_analog_spec *spec_copy;
 	uint8_t *payload;
+	size_t size;
 
 	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
 	(*copy)->type = packet->type;
@@ -1514,6 +2214,8 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1521,10 +2223,15 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		memcpy(payload, packet->payload, sizeof(struct sr_datafeed_header));
 		(*copy)->payload = payload;
 		break;
+	case SR_DF_TIMESTAMP:
+		payload = g_malloc(sizeof(struct sr_datafeed_timestamp));
+		memcpy(payload, packet->payload, sizeof(struct sr_datafeed_timestamp));
+		(*copy)->payload = payload;
+		break;
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
@@ -1534,21 +2241,21 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 			return SR_ERR;
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
+		logic_copy->data = g_malloc(logic->length);
 		if (!logic_copy->data) {
 			g_free(logic_copy);
 			return SR_ERR;
 		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		memcpy(logic_copy->data, logic->data, logic->length);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
+		size = (size_t)analog->encoding->unitsize * analog->num_samples *
+			MAX(g_slist_length(analog->meaning->channels), 1);
+		analog_copy->data = g_malloc(size);
+		memcpy(analog_copy->data, analog->data, size);
 		analog_copy->num_samples = analog->num_samples;
 #if GLIB_CHECK_VERSION(2, 67, 3)
 		encoding_copy = g_memdup2(analog->encoding, sizeof(*analog->encoding));
@@ -1585,9 +2292,12 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
+	case SR_DF_TIMESTAMP:
 		/* Payload is a simple struct. */
 		g_free((void *)packet->payload);
 		break;
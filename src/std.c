@@ -284,6 +284,121 @@ SR_PRIV int std_session_send_df_frame_end(const struct sr_dev_inst *sdi)
 	return send_df_without_payload(sdi, SR_DF_FRAME_END);
 }
 
+/**
+ * Standard API helper for sending an SR_DF_TIMESTAMP packet.
+ *
+ * Drivers for devices with a clock of their own can use this to tell
+ * when a sample was taken, e.g. at the start of each frame or transfer.
+ *
+ * @param[in] sdi The device instance to use. Must not be NULL.
+ * @param[in] sample_num The number of the sample since SR_DF_HEADER.
+ * @param[in] time_ns The time of the sample in nanoseconds, relative to
+ *                    the starttime of the SR_DF_HEADER packet.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Other error.
+ */
+SR_PRIV int std_session_send_df_timestamp(const struct sr_dev_inst *sdi,
+		uint64_t sample_num, int64_t time_ns)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_timestamp timestamp;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: Invalid argument.", __func__);
+		return SR_ERR_ARG;
+	}
+
+	timestamp.sample_num = sample_num;
+	timestamp.time_ns = time_ns;
+	packet.type = SR_DF_TIMESTAMP;
+	packet.payload = &timestamp;
+
+	if ((ret = sr_session_send(sdi, &packet)) < 0) {
+		sr_err("%s: Failed to send SR_DF_TIMESTAMP packet: %d.",
+			sdi->driver ? sdi->driver->name : "unknown", ret);
+		return ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Reset frame rate statistics, e.g. at acquisition start.
+ *
+ * @param[out] stats The statistics. Must not be NULL.
+ */
+SR_PRIV void std_frame_stats_reset(struct std_frame_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->min_us = G_MAXUINT64;
+}
+
+/**
+ * Account the start of a frame.
+ *
+ * @param[in,out] stats The statistics. Must not be NULL.
+ */
+SR_PRIV void std_frame_stats_begin(struct std_frame_stats *stats)
+{
+	stats->begin_us = g_get_monotonic_time();
+	if (!stats->frames)
+		stats->first_us = stats->begin_us;
+}
+
+/**
+ * Account the end of a frame which was started by std_frame_stats_begin().
+ *
+ * The frame is also counted in the device's session statistics, see
+ * sr_session_stats_get().
+ *
+ * @param[in] sdi The device instance the statistics belong to.
+ * @param[in,out] stats The statistics. Must not be NULL.
+ */
+SR_PRIV void std_frame_stats_end(const struct sr_dev_inst *sdi,
+		struct std_frame_stats *stats)
+{
+	uint64_t elapsed_us;
+
+	if (!stats->begin_us)
+		return;
+
+	stats->end_us = g_get_monotonic_time();
+	elapsed_us = stats->end_us - stats->begin_us;
+	stats->frames++;
+	stats->total_us += elapsed_us;
+	stats->min_us = MIN(stats->min_us, elapsed_us);
+	stats->max_us = MAX(stats->max_us, elapsed_us);
+	stats->begin_us = 0;
+
+	sr_session_stats_frame(sdi, elapsed_us);
+}
+
+/**
+ * Log frame rate statistics, e.g. at acquisition stop.
+ *
+ * @param[in] sdi The device instance the statistics belong to.
+ * @param[in] stats The statistics. Must not be NULL.
+ */
+SR_PRIV void std_frame_stats_log(const struct sr_dev_inst *sdi,
+		const struct std_frame_stats *stats)
+{
+	double seconds;
+
+	if (!stats->frames)
+		return;
+
+	seconds = (stats->end_us - stats->first_us) / 1e6;
+	sr_info("%s: %" PRIu64 " frames in %.3f s (%.2f frames/s), frame "
+		"time min/avg/max %.1f/%.1f/%.1f ms.",
+		sdi->driver->name, stats->frames, seconds,
+		seconds > 0 ? stats->frames / seconds : 0.0,
+		stats->min_us / 1e3, stats->total_us / 1e3 / stats->frames,
+		stats->max_us / 1e3);
+}
+
 #ifdef HAVE_SERIAL_COMM
 
 /**
@@ -23,6 +23,7 @@
 /** @endcond */
 #include <config.h>
 #include <ctype.h>
+#include <float.h>
 #include <locale.h>
 #if defined(__FreeBSD__) || defined(__APPLE__)
 #include <xlocale.h>
@@ -35,6 +36,7 @@
 #include <string.h>
 #include <strings.h>
 #include <errno.h>
+#include <math.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -56,6 +58,37 @@
  * @{
  */
 
+#if defined(__APPLE__) || (defined(__FreeBSD__) && __FreeBSD_version >= 901000) || \
+	(defined(__linux__) && !defined(__ANDROID__))
+/* The "C" numeric locale, created once instead of for every conversion. */
+static locale_t c_numeric_locale(void)
+{
+	static gsize initialized;
+	static locale_t locale;
+
+	if (g_once_init_enter(&initialized)) {
+		locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+		g_once_init_leave(&initialized, 1);
+	}
+
+	return locale;
+}
+#endif
+
+/* Powers of ten which are exactly representable as a double. */
+static const double pow10_dbl[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const uint64_t pow10_u64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL,
+};
+
 /**
  * Convert a string representation of a numeric value (base 10) to a long integer. The
  * conversion is strict and will fail if the complete string does not represent
@@ -294,6 +327,130 @@ SR_PRIV int sr_atof(const char *str, float *ret)
 	return SR_OK;
 }
 
+/*
+ * Convert plain decimal text ("-12.5e-3") without calling into the C
+ * library. Only handles input where a single multiplication or division
+ * by an exact power of ten is correctly rounded: up to 19 significant
+ * digits, a mantissa that fits 53 bits and a decimal exponent within
+ * +/-22 (Clinger's fast path). Returns FALSE for everything else, e.g.
+ * leading whitespace, hex, "inf" or "nan", so that the caller can fall
+ * back to the generic conversion.
+ */
+static gboolean strtod_fast(const char *str, char **endptr, double *ret)
+{
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	const char *p, *digits_end;
+	uint64_t mantissa;
+	int num_digits, exp10, exp_val, exp_sign;
+	gboolean negative, seen_digit;
+	double value;
+
+	p = str;
+	negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+		p++;
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+		return FALSE;
+
+	mantissa = 0;
+	num_digits = 0;
+	exp10 = 0;
+	seen_digit = FALSE;
+	for (; g_ascii_isdigit(*p); p++) {
+		seen_digit = TRUE;
+		if (!mantissa && *p == '0')
+			continue;
+		if (++num_digits > 19)
+			return FALSE;
+		mantissa = mantissa * 10 + (*p - '0');
+	}
+	if (*p == '.') {
+		for (p++; g_ascii_isdigit(*p); p++) {
+			seen_digit = TRUE;
+			exp10--;
+			if (!mantissa && *p == '0')
+				continue;
+			if (++num_digits > 19)
+				return FALSE;
+			mantissa = mantissa * 10 + (*p - '0');
+		}
+	}
+	if (!seen_digit)
+		return FALSE;
+
+	/* An exponent needs at least one digit, else it's not consumed. */
+	digits_end = p;
+	if (*p == 'e' || *p == 'E') {
+		p++;
+		exp_sign = 1;
+		if (*p == '-' || *p == '+')
+			exp_sign = (*p++ == '-') ? -1 : 1;
+		if (!g_ascii_isdigit(*p)) {
+			p = digits_end;
+		} else {
+			for (exp_val = 0; g_ascii_isdigit(*p); p++) {
+				if (exp_val > 1000)
+					return FALSE;
+				exp_val = exp_val * 10 + (*p - '0');
+			}
+			exp10 += exp_sign * exp_val;
+		}
+	}
+
+	if (!mantissa) {
+		value = 0.0;
+	} else {
+		if (mantissa > (UINT64_C(1) << 53) || exp10 < -22 || exp10 > 22)
+			return FALSE;
+		value = (double)mantissa;
+		if (exp10 < 0)
+			value /= pow10_dbl[-exp10];
+		else
+			value *= pow10_dbl[exp10];
+	}
+
+	*ret = negative ? -value : value;
+	if (endptr)
+		*endptr = (char *)p;
+
+	return TRUE;
+#else
+	/* Intermediate results with excess precision would round twice. */
+	(void)str;
+	(void)endptr;
+	(void)ret;
+
+	return FALSE;
+#endif
+}
+
+/**
+ * Convert the initial part of a string to a double, like g_ascii_strtod().
+ *
+ * The result, the end pointer and errno are the same as those of
+ * g_ascii_strtod(). Plain decimal numbers, which is what instruments
+ * usually send, are converted without going through the C library.
+ *
+ * @param str The string to convert.
+ * @param endptr If not NULL, receives a pointer to the first character
+ *               after the converted number.
+ *
+ * @return The converted value.
+ *
+ * @since 0.6.0
+ */
+SR_API double sr_strtod_ascii(const char *str, char **endptr)
+{
+	double value;
+
+	if (strtod_fast(str, endptr, &value)) {
+		errno = 0;
+		return value;
+	}
+
+	return g_ascii_strtod(str, endptr);
+}
+
 /**
  * Convert a string representation of a numeric value to a double. The
  * conversion is strict and will fail if the complete string does not represent
@@ -314,7 +471,7 @@ SR_PRIV int sr_atod_ascii(const char *str, double *ret)
 	char *endptr = NULL;
 
 	errno = 0;
-	tmp = g_ascii_strtod(str, &endptr);
+	tmp = sr_strtod_ascii(str, &endptr);
 
 	if (!endptr || *endptr || errno) {
 		if (!errno)
@@ -417,7 +574,7 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret)
 	char *endptr = NULL;
 
 	errno = 0;
-	tmp = g_ascii_strtod(str, &endptr);
+	tmp = sr_strtod_ascii(str, &endptr);
 
 	if (!endptr || *endptr || errno) {
 		if (!errno)
@@ -536,9 +693,8 @@ SR_API int sr_vsprintf_ascii(char *buf, const char *format, va_list args)
 	int ret;
 	locale_t locale;
 
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
+	locale = c_numeric_locale();
 	ret = vsprintf_l(buf, locale, format, args);
-	freelocale(locale);
 
 	return ret;
 #elif defined(__FreeBSD__) && __FreeBSD_version >= 901000
@@ -550,9 +706,8 @@ SR_API int sr_vsprintf_ascii(char *buf, const char *format, va_list args)
 	int ret;
 	locale_t locale;
 
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
+	locale = c_numeric_locale();
 	ret = vsprintf_l(buf, locale, format, args);
-	freelocale(locale);
 
 	return ret;
 #elif defined(__ANDROID__)
@@ -568,17 +723,15 @@ SR_API int sr_vsprintf_ascii(char *buf, const char *format, va_list args)
 	return ret;
 #elif defined(__linux__)
 	int ret;
-	locale_t old_locale, temp_locale;
+	locale_t old_locale;
 
 	/* Switch to C locale for proper float/double conversion. */
-	temp_locale = newlocale(LC_NUMERIC, "C", NULL);
-	old_locale = uselocale(temp_locale);
+	old_locale = uselocale(c_numeric_locale());
 
 	ret = vsprintf(buf, format, args);
 
 	/* Switch back to original locale. */
 	uselocale(old_locale);
-	freelocale(temp_locale);
 
 	return ret;
 #elif defined(__unix__) || defined(__unix)
@@ -709,9 +862,8 @@ SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 	int ret;
 	locale_t locale;
 
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
+	locale = c_numeric_locale();
 	ret = vsnprintf_l(buf, buf_size, locale, format, args);
-	freelocale(locale);
 
 	return ret;
 #elif defined(__FreeBSD__) && __FreeBSD_version >= 901000
@@ -723,9 +875,8 @@ SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 	int ret;
 	locale_t locale;
 
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
+	locale = c_numeric_locale();
 	ret = vsnprintf_l(buf, buf_size, locale, format, args);
-	freelocale(locale);
 
 	return ret;
 #elif defined(__ANDROID__)
@@ -741,17 +892,15 @@ SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 	return ret;
 #elif defined(__linux__)
 	int ret;
-	locale_t old_locale, temp_locale;
+	locale_t old_locale;
 
 	/* Switch to C locale for proper float/double conversion. */
-	temp_locale = newlocale(LC_NUMERIC, "C", NULL);
-	old_locale = uselocale(temp_locale);
+	old_locale = uselocale(c_numeric_locale());
 
 	ret = vsnprintf(buf, buf_size, format, args);
 
 	/* Switch back to original locale. */
 	uselocale(old_locale);
-	freelocale(temp_locale);
 
 	return ret;
 #elif defined(__unix__) || defined(__unix)
@@ -771,6 +920,194 @@ SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 #endif
 }
 
+/* Write the decimal digits of n, return their count. */
+static int format_u64(char *buf, uint64_t n)
+{
+	char tmp[20];
+	int len, i;
+
+	len = 0;
+	do {
+		tmp[len++] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	for (i = 0; i < len; i++)
+		buf[i] = tmp[len - 1 - i];
+
+	return len;
+}
+
+/*
+ * Format like "%.*g" in the C locale, for values where the rounding to
+ * the requested number of digits is unambiguous in double arithmetic.
+ * Returns the length, or -1 when the caller must use printf().
+ */
+static int format_g_fast(char *out, double value, int precision)
+{
+	char digits[20];
+	uint64_t n;
+	double a, y, fl;
+	int len, num_digits, exp10, k, i;
+
+	if (!isfinite(value) || precision > 17)
+		return -1;
+
+	len = 0;
+	if (signbit(value))
+		out[len++] = '-';
+	a = fabs(value);
+
+	/* Integers that are printed in full. */
+	if (a == floor(a) && a < 9007199254740992.0) {
+		num_digits = format_u64(digits, (uint64_t)a);
+		if (num_digits <= precision) {
+			memcpy(out + len, digits, num_digits);
+			len += num_digits;
+			out[len] = '\0';
+			return len;
+		}
+	}
+	if (precision > 15)
+		return -1;
+
+	/*
+	 * Scale to an integer of 'precision' digits. The scaling is a single
+	 * correctly rounded operation, bail out if the result is too close
+	 * to a rounding boundary to be sure about the last digit. The
+	 * exponent estimate may be off by one, and rounding may carry into
+	 * another digit, so try successive exponents.
+	 */
+	exp10 = (int)floor(log10(a)) - 1;
+	n = 0;
+	for (i = 0; i < 4; i++, exp10++) {
+		k = precision - 1 - exp10;
+		if (k < -22 || k > 22)
+			return -1;
+		y = (k >= 0) ? a * pow10_dbl[k] : a / pow10_dbl[-k];
+		fl = floor(y);
+		if (fabs(y - fl - 0.5) <= y * (2 * DBL_EPSILON))
+			return -1;
+		n = (uint64_t)fl + (y - fl > 0.5);
+		if (n < pow10_u64[precision])
+			break;
+	}
+	if (i == 4 || n < pow10_u64[precision - 1])
+		return -1;
+
+	format_u64(digits, n);
+	num_digits = precision;
+	while (num_digits > 1 && digits[num_digits - 1] == '0')
+		num_digits--;
+
+	if (exp10 < -4 || exp10 >= precision) {
+		out[len++] = digits[0];
+		if (num_digits > 1) {
+			out[len++] = '.';
+			memcpy(out + len, digits + 1, num_digits - 1);
+			len += num_digits - 1;
+		}
+		out[len++] = 'e';
+		out[len++] = exp10 < 0 ? '-' : '+';
+		k = abs(exp10);
+		if (k < 10)
+			out[len++] = '0';
+		len += format_u64(out + len, k);
+	} else if (exp10 >= 0) {
+		memcpy(out + len, digits, exp10 + 1);
+		len += exp10 + 1;
+		if (num_digits > exp10 + 1) {
+			out[len++] = '.';
+			memcpy(out + len, digits + exp10 + 1,
+				num_digits - exp10 - 1);
+			len += num_digits - exp10 - 1;
+		}
+	} else {
+		out[len++] = '0';
+		out[len++] = '.';
+		for (k = -1; k > exp10; k--)
+			out[len++] = '0';
+		memcpy(out + len, digits, num_digits);
+		len += num_digits;
+	}
+	out[len] = '\0';
+
+	return len;
+}
+
+static int format_g(char *out, size_t size, double value, int precision)
+{
+	int len;
+
+	if ((len = format_g_fast(out, value, precision)) >= 0)
+		return len;
+
+	return sr_snprintf_ascii(out, size, "%.*g", precision, value);
+}
+
+/**
+ * Format a floating point number like "%.*g" in the "C" locale.
+ *
+ * The output is identical to that of sr_snprintf_ascii() with a "%.*g"
+ * format, but common values are converted without printf(). A negative
+ * precision selects the shortest representation which converts back to
+ * the same value with sr_strtod_ascii().
+ *
+ * @param buf Pointer to a buffer where the resulting C string is stored.
+ * @param buf_size Maximum number of bytes to be used in the buffer,
+ *        including the terminating NUL character.
+ * @param value The value to format.
+ * @param precision The number of significant digits (0 is treated as 1),
+ *        or a negative value for the shortest round-trip representation.
+ *
+ * @return The number of characters that would have been written if
+ *         buf_size had been sufficiently large, not counting the
+ *         terminating NUL character. Negative on failure.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_format_double_ascii(char *buf, size_t buf_size,
+	double value, int precision)
+{
+	char tmp[G_ASCII_DTOSTR_BUF_SIZE];
+	int len, lo, hi, mid;
+
+	if (precision == 0)
+		precision = 1;
+
+	if (precision < 0) {
+		/*
+		 * Rounding to more digits is never further away from the
+		 * value, so the shortest round-trip precision can be found
+		 * with a binary search. 17 digits always round-trip.
+		 */
+		if (!isfinite(value)) {
+			precision = 17;
+		} else {
+			lo = 1;
+			hi = 17;
+			while (lo < hi) {
+				mid = (lo + hi) / 2;
+				format_g(tmp, sizeof(tmp), value, mid);
+				if (sr_strtod_ascii(tmp, NULL) == value)
+					hi = mid;
+				else
+					lo = mid + 1;
+			}
+			precision = lo;
+		}
+	}
+
+	if (precision > 17 || (len = format_g_fast(tmp, value, precision)) < 0)
+		return sr_snprintf_ascii(buf, buf_size, "%.*g", precision, value);
+
+	if (buf_size) {
+		memcpy(buf, tmp, MIN((size_t)len, buf_size - 1));
+		buf[MIN((size_t)len, buf_size - 1)] = '\0';
+	}
+
+	return len;
+}
+
 /**
  * Convert a sequence of bytes to its textual representation ("hex dump").
  *
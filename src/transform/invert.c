@@ -24,29 +24,131 @@
 
 #define LOG_PREFIX "transform/invert"
 
+struct context {
+	/* Bit n selects logic channel index n, 0 selects all channels. */
+	uint64_t mask;
+	/* XOR pattern for the unitsize of the last logic packet. */
+	unsigned int unitsize;
+	uint64_t *pattern;
+	size_t num_words;
+	gboolean empty;
+};
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->mask = g_variant_get_uint64(g_hash_table_lookup(options, "mask"));
+
+	return SR_OK;
+}
+
+/*
+ * Expand the per-sample channel mask into a run of 64-bit words which
+ * covers a whole number of samples (lcm(unitsize, 8) bytes). Consecutive
+ * words of logic data can then be XOR-ed with consecutive pattern words,
+ * no matter how the samples straddle word boundaries.
+ */
+static void pattern_update(struct context *ctx, unsigned int unitsize)
+{
+	uint8_t *bytes;
+	size_t len, a, b, r, i;
+	unsigned int byte;
+
+	a = unitsize;
+	b = sizeof(uint64_t);
+	while (b) {
+		r = a % b;
+		a = b;
+		b = r;
+	}
+	len = unitsize * sizeof(uint64_t) / a;
+
+	g_free(ctx->pattern);
+	ctx->pattern = g_malloc(len);
+	ctx->num_words = len / sizeof(uint64_t);
+	ctx->unitsize = unitsize;
+	ctx->empty = TRUE;
+
+	bytes = (uint8_t *)ctx->pattern;
+	for (i = 0; i < len; i++) {
+		byte = i % unitsize;
+		if (!ctx->mask)
+			bytes[i] = 0xff;
+		else if (byte < sizeof(ctx->mask))
+			bytes[i] = (ctx->mask >> (8 * byte)) & 0xff;
+		else
+			bytes[i] = 0;
+		if (bytes[i])
+			ctx->empty = FALSE;
+	}
+}
+
+/*
+ * XOR the data with the pattern in place, one 64-bit word at a time.
+ * The memcpy() calls keep unaligned buffers legal and compile to plain
+ * loads and stores, the single word case is vectorized by the compiler.
+ */
+static void invert_logic(const struct context *ctx, uint8_t *data, size_t length)
+{
+	const uint8_t *tail;
+	uint64_t w, p;
+	size_t i, k;
+
+	i = 0;
+	k = 0;
+	if (ctx->num_words == 1) {
+		p = ctx->pattern[0];
+		for (; i + sizeof(w) <= length; i += sizeof(w)) {
+			memcpy(&w, data + i, sizeof(w));
+			w ^= p;
+			memcpy(data + i, &w, sizeof(w));
+		}
+	} else {
+		for (; i + sizeof(w) <= length; i += sizeof(w)) {
+			memcpy(&w, data + i, sizeof(w));
+			w ^= ctx->pattern[k];
+			memcpy(data + i, &w, sizeof(w));
+			if (++k == ctx->num_words)
+				k = 0;
+		}
+	}
+
+	tail = (const uint8_t *)&ctx->pattern[k];
+	for (; i < length; i++)
+		data[i] ^= *tail++;
+}
+
 static int receive(const struct sr_transform *t,
 		struct sr_datafeed_packet *packet_in,
 		struct sr_datafeed_packet **packet_out)
 {
+	struct context *ctx;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
-	uint8_t *b;
 	int64_t p;
-	uint64_t i, j, q;
+	uint64_t q;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
+	ctx = t->priv;
 
 	switch (packet_in->type) {
 	case SR_DF_LOGIC:
 		logic = packet_in->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < logic->unitsize; j++) {
-				/* For now invert every bit in every byte. */
-				b = (uint8_t *)logic->data + i + logic->unitsize - 1 - j;
-				*b = ~(*b);
-			}
-		}
+		if (!logic->unitsize)
+			break;
+		if (logic->unitsize != ctx->unitsize)
+			pattern_update(ctx, logic->unitsize);
+		if (ctx->empty)
+			break;
+		/* Only invert whole samples. */
+		invert_logic(ctx, logic->data,
+			logic->length - logic->length % logic->unitsize);
 		break;
 	case SR_DF_ANALOG:
 		analog = packet_in->payload;
@@ -68,12 +170,41 @@ static int receive(const struct sr_transform *t,
 	return SR_OK;
 }
 
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_free(ctx->pattern);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "mask", "Channel mask", "Logic channels to invert, bit n selects channel index n (0 = all channels)", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	/* Default to inverting all logic channels. */
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(0));
+
+	return options;
+}
+
 SR_PRIV struct sr_transform_module transform_invert = {
 	.id = "invert",
 	.name = "Invert",
 	.desc = "Invert values",
-	.options = NULL,
-	.init = NULL,
+	.options = get_options,
+	.init = init,
 	.receive = receive,
-	.cleanup = NULL,
+	.cleanup = cleanup,
 };
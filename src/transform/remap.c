@@ -0,0 +1,341 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/remap"
+
+/*
+ * Transforms cannot change the device's channel list, and outputs pick
+ * a channel's bit by its index. So the layout stays as it is: samples
+ * keep their unitsize, and the enabled logic channels keep their bits.
+ * The k-th selected channel is routed to the bit of the k-th enabled
+ * logic channel, all other bits are cleared.
+ */
+
+/* Output samples are assembled in one 64-bit word. */
+#define MAX_OUT_CHANNELS 64
+
+/*
+ * The shuffle plan has one entry per input byte which carries at least
+ * one selected channel. The entry's table maps every value of that byte
+ * to its selected bits already moved to their output positions, so an
+ * output sample is the OR of one table lookup per entry.
+ */
+struct plan_entry {
+	unsigned int byte;
+	uint64_t lut[256];
+};
+
+struct context {
+	char **names;
+	/* Input and output bit index of every routed channel. */
+	unsigned int src[MAX_OUT_CHANNELS];
+	unsigned int dst[MAX_OUT_CHANNELS];
+	unsigned int num_out;
+	unsigned int num_logic;
+	struct plan_entry *entries;
+	unsigned int num_entries;
+	/* Every routed channel keeps its bit. */
+	gboolean in_order;
+	uint8_t *buf;
+	size_t buf_size;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_packet packet;
+};
+
+static struct sr_channel *channel_find(const struct sr_dev_inst *sdi,
+		const char *name)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC && !strcmp(ch->name, name))
+			return ch;
+	}
+
+	return NULL;
+}
+
+/* Collect the input and output bit index of every routed channel. */
+static int select_channels(const struct sr_transform *t)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	GSList *l;
+	unsigned int num_dst, i;
+
+	ctx = t->priv;
+	ctx->num_out = 0;
+
+	/* Targets: the enabled logic channels, in index order. */
+	num_dst = 0;
+	ctx->num_logic = 0;
+	for (l = t->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			ctx->num_logic++;
+		if (ch->type != SR_CHANNEL_LOGIC || !ch->enabled)
+			continue;
+		if (ch->index >= MAX_OUT_CHANNELS) {
+			sr_err("Only the first %d logic channels are supported.",
+				MAX_OUT_CHANNELS);
+			return SR_ERR_ARG;
+		}
+		ctx->dst[num_dst++] = ch->index;
+	}
+
+	if (!ctx->names) {
+		/* Default: keep the enabled channels, clear the others. */
+		for (i = 0; i < num_dst; i++)
+			ctx->src[i] = ctx->dst[i];
+		ctx->num_out = num_dst;
+		return SR_OK;
+	}
+
+	/* Explicit list: reorder, drop everything else. */
+	for (i = 0; ctx->names[i]; i++) {
+		if (!(ch = channel_find(t->sdi, ctx->names[i]))) {
+			sr_err("Unknown logic channel '%s'.", ctx->names[i]);
+			return SR_ERR_ARG;
+		}
+		if (i == num_dst) {
+			sr_err("More channels listed than %u enabled.", num_dst);
+			return SR_ERR_ARG;
+		}
+		ctx->src[i] = ch->index;
+	}
+	ctx->num_out = i;
+
+	return SR_OK;
+}
+
+static int plan_build(const struct sr_transform *t)
+{
+	struct context *ctx;
+	struct plan_entry *e;
+	unsigned int i, j, k, byte, bit, max_byte;
+	int ret;
+
+	ctx = t->priv;
+
+	g_free(ctx->entries);
+	ctx->entries = NULL;
+	ctx->num_entries = 0;
+
+	if ((ret = select_channels(t)) != SR_OK)
+		return ret;
+
+	ctx->in_order = TRUE;
+	max_byte = 0;
+	for (k = 0; k < ctx->num_out; k++) {
+		if (ctx->src[k] != ctx->dst[k])
+			ctx->in_order = FALSE;
+		max_byte = MAX(max_byte, ctx->src[k] / 8);
+	}
+	if (!ctx->num_out)
+		return SR_OK;
+
+	/* One entry per used input byte, in ascending byte order. */
+	ctx->entries = g_malloc0((max_byte + 1) * sizeof(struct plan_entry));
+	for (byte = 0; byte <= max_byte; byte++) {
+		e = &ctx->entries[ctx->num_entries];
+		for (k = 0; k < ctx->num_out; k++) {
+			if (ctx->src[k] / 8 != byte)
+				continue;
+			bit = ctx->src[k] % 8;
+			for (i = 0; i < 256; i++) {
+				if (i & (1 << bit))
+					e->lut[i] |= UINT64_C(1) << ctx->dst[k];
+			}
+		}
+		for (j = 0; j < 256; j++) {
+			if (e->lut[j]) {
+				e->byte = byte;
+				ctx->num_entries++;
+				break;
+			}
+		}
+	}
+
+	sr_dbg("%u channels routed from %u input bytes.",
+		ctx->num_out, ctx->num_entries);
+
+	return SR_OK;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	const char *channels;
+	unsigned int i;
+	int ret;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	channels = g_variant_get_string(g_hash_table_lookup(options,
+		"channels"), NULL);
+	if (channels && *channels) {
+		ctx->names = g_strsplit(channels, ",", 0);
+		for (i = 0; ctx->names[i]; i++)
+			g_strstrip(ctx->names[i]);
+	}
+
+	if ((ret = plan_build(t)) != SR_OK) {
+		g_strfreev(ctx->names);
+		g_free(ctx);
+		t->priv = NULL;
+		return ret;
+	}
+
+	return SR_OK;
+}
+
+static void remap_logic(const struct context *ctx, const uint8_t *in,
+		unsigned int unitsize, uint8_t *out, size_t num_samples)
+{
+	const struct plan_entry *e, *end;
+	unsigned int num_entries, b;
+	uint64_t w;
+	size_t i;
+
+	/* Bytes beyond the input unitsize read as zero. */
+	num_entries = 0;
+	while (num_entries < ctx->num_entries &&
+			ctx->entries[num_entries].byte < unitsize)
+		num_entries++;
+	end = ctx->entries + num_entries;
+
+	for (i = 0; i < num_samples; i++) {
+		w = 0;
+		for (e = ctx->entries; e < end; e++)
+			w |= e->lut[in[e->byte]];
+		if (unitsize == 1) {
+			*out++ = w;
+		} else {
+			/* Bytes beyond the 64 routable channels are zero. */
+			for (b = 0; b < unitsize; b++)
+				*out++ = b < 8 ? w >> (8 * b) : 0;
+		}
+		in += unitsize;
+	}
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_logic *logic;
+	size_t num_samples, size;
+	int ret;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	switch (packet_in->type) {
+	case SR_DF_HEADER:
+		/* Channels may have been enabled or disabled since init. */
+		if ((ret = plan_build(t)) != SR_OK)
+			return ret;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet_in->payload;
+		if (!logic->unitsize)
+			break;
+		/* Every logic channel kept in place, pass the packet on. */
+		if (ctx->in_order && ctx->num_out == ctx->num_logic)
+			break;
+		num_samples = logic->length / logic->unitsize;
+		size = num_samples * logic->unitsize;
+		if (size > ctx->buf_size) {
+			g_free(ctx->buf);
+			ctx->buf = g_malloc(size);
+			ctx->buf_size = size;
+		}
+		remap_logic(ctx, logic->data, logic->unitsize, ctx->buf,
+			num_samples);
+		ctx->logic.length = size;
+		ctx->logic.unitsize = logic->unitsize;
+		ctx->logic.data = ctx->buf;
+		ctx->packet.type = SR_DF_LOGIC;
+		ctx->packet.payload = &ctx->logic;
+		*packet_out = &ctx->packet;
+		return SR_OK;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		break;
+	}
+
+	/* Return the unmodified packet. */
+	*packet_out = packet_in;
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_strfreev(ctx->names);
+	g_free(ctx->entries);
+	g_free(ctx->buf);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "channels", "Channels", "Comma separated logic channel names, routed to the enabled channels in index order (default: all enabled channels)", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	/* Default to keeping the enabled logic channels. */
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_string(""));
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_remap = {
+	.id = "remap",
+	.name = "Remap",
+	.desc = "Reorder and drop logic channels. The n-th selected "
+		"channel goes to the n-th enabled channel.",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
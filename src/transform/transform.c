@@ -45,12 +45,14 @@
 extern SR_PRIV struct sr_transform_module transform_nop;
 extern SR_PRIV struct sr_transform_module transform_scale;
 extern SR_PRIV struct sr_transform_module transform_invert;
+extern SR_PRIV struct sr_transform_module transform_remap;
 /** @endcond */
 
 static const struct sr_transform_module *transform_module_list[] = {
 	&transform_nop,
 	&transform_scale,
 	&transform_invert,
+	&transform_remap,
 	NULL,
 };
 
@@ -208,7 +210,7 @@ SR_API const struct sr_transform *sr_transform_new(const struct sr_transform_mod
 	gpointer key, value;
 	int i;
 
-	t = g_malloc(sizeof(struct sr_transform));
+	t = g_malloc0(sizeof(struct sr_transform));
 	t->module = tmod;
 	t->sdi = sdi;
 
@@ -23,6 +23,16 @@
 #include <stdlib.h>
 #include <memory.h>
 #include <glib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#if defined(_POSIX_THREAD_PRIORITY_SCHEDULING) && _POSIX_THREAD_PRIORITY_SCHEDULING > 0
+#define HAVE_THREAD_SCHEDPARAM 1
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
 #include <libusb.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -47,6 +57,7 @@ struct usb_source {
 
 	/* Needed to keep track of installed sources */
 	struct sr_session *session;
+	void *key;
 
 	struct libusb_context *usb_ctx;
 	GPtrArray *pollfds;
@@ -166,7 +177,7 @@ static void usb_source_finalize(GSource *source)
 	usource->pollfds = NULL;
 
 	sr_session_source_destroyed(usource->session,
-			usource->usb_ctx, source);
+			usource->key, source);
 }
 
 /** Callback invoked when a new libusb FD should be added to the poll set.
@@ -244,11 +255,12 @@ static void usb_source_free_pollfd(void *data)
  * event sources for their polling needs.
  *
  * @param session The session the event source belongs to.
+ * @param key The key used to identify this source.
  * @param usb_ctx The libusb context for which to handle events.
  * @param timeout_ms The timeout interval in ms, or -1 to wait indefinitely.
  * @return A new event source object, or NULL on failure.
  */
-static GSource *usb_source_new(struct sr_session *session,
+static GSource *usb_source_new(struct sr_session *session, void *key,
 		struct libusb_context *usb_ctx, int timeout_ms)
 {
 	static GSourceFuncs usb_source_funcs = {
@@ -279,6 +291,7 @@ static GSource *usb_source_new(struct sr_session *session,
 		usource->due_us = INT64_MAX;
 	}
 	usource->session = session;
+	usource->key = key;
 	usource->usb_ctx = usb_ctx;
 	usource->pollfds = g_ptr_array_new_full(8, &usb_source_free_pollfd);
 
@@ -451,7 +464,8 @@ SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 	GSource *source;
 	int ret;
 
-	source = usb_source_new(session, ctx->libusb_ctx, timeout);
+	source = usb_source_new(session, ctx->libusb_ctx, ctx->libusb_ctx,
+		timeout);
 	if (!source)
 		return SR_ERR;
 
@@ -550,3 +564,1035 @@ SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 
 	return ret;
 }
+
+
+/*
+ * USB bulk streaming engine.
+ *
+ * Drivers of streaming logic analyzers used to carry their own copies
+ * of the transfer pool management, with buffer sizes and queue depths
+ * derived from fixed heuristics. The engine below owns the pool, and
+ * adapts the buffer size to the observed throughput (so that a buffer
+ * takes USB_STREAM_PERIOD_US to fill) and the number of transfers in
+ * flight to the time the consumer spends in the receive callback.
+ *
+ * When the context has the USB event thread enabled, transfers complete
+ * on that thread instead. Completed buffers are swapped against spare
+ * ones and resubmitted right away, and the filled buffers are handed
+ * to the session's main context through a lock-free queue. A busy
+ * datafeed then no longer delays resubmission. The number of transfers
+ * in flight is not adapted in this mode: the consumer's lag is absorbed
+ * by the queue instead, and resubmission on the event thread takes
+ * about as long whatever the consumer does. When the session falls so
+ * far behind that the queue fills up, completed transfers are held back
+ * rather than resubmitted, until the session has caught up. The device
+ * then sees fewer transfers in flight, as it would without the thread.
+ */
+
+/* Fill time of a single transfer which the buffer size is tuned for. */
+#define USB_STREAM_PERIOD_US		(10 * 1000)
+/* Amount of data which is initially kept in flight. */
+#define USB_STREAM_INITIAL_DEPTH_US	(250 * 1000)
+#define USB_STREAM_MIN_TRANSFERS	2
+#define USB_STREAM_MAX_TRANSFERS	32
+#define USB_STREAM_MAX_EMPTY		(USB_STREAM_MAX_TRANSFERS * 2)
+/* Weight of a new observation in the moving averages, as a shift. */
+#define USB_STREAM_AVG_SHIFT		3
+/* Capacity of the queues between event thread and session, power of 2. */
+#define USB_STREAM_QUEUE_SIZE		256
+/* Interval at which the event thread checks for termination. */
+#define USB_EVENT_THREAD_TIMEOUT_US	(100 * 1000)
+
+/** Dedicated libusb event handling thread of a context. */
+struct sr_usb_event_thread {
+	libusb_context *usb_ctx;
+	GThread *thread;
+	unsigned int refcount;
+	int quit;
+};
+
+/*
+ * Protects the contexts' event threads and their reference counts.
+ * Streams of different devices may start and stop concurrently.
+ */
+static GMutex usb_thread_mutex;
+
+/* A data buffer travelling between event thread and session. */
+struct usb_stream_chunk {
+	uint8_t *buf;
+	size_t size;
+	size_t length;
+};
+
+/*
+ * Single producer, single consumer queue. The producer only writes
+ * 'head', the consumer only writes 'tail'. Since libusb only ever lets
+ * one thread at a time handle events, the completion callbacks form a
+ * single producer even when the handling thread changes.
+ */
+struct usb_stream_queue {
+	unsigned int head;
+	unsigned int tail;
+	struct usb_stream_chunk slots[USB_STREAM_QUEUE_SIZE];
+};
+
+struct sr_usb_stream {
+	struct sr_context *ctx;
+	const struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct libusb_device_handle *devhdl;
+	struct sr_usb_stream_config cfg;
+	void *cb_data;
+
+	int aborted;
+	size_t buffer_size;
+	unsigned int min_transfers;
+	unsigned int target_transfers;
+	unsigned int submitted;
+	unsigned int timeout;
+	unsigned int empty_count;
+	/* Protects the transfer pool against concurrent abort requests. */
+	GMutex mutex;
+	struct libusb_transfer **transfers;
+
+	/* The USB event source, which follows the timeout. Unthreaded mode only. */
+	struct usb_source *source;
+
+	/* Threaded mode only. */
+	struct sr_usb_event_thread *thread;
+	GMainContext *main_context;
+	int finished;
+	struct usb_stream_queue ready;
+	struct usb_stream_queue spare;
+	/*
+	 * Transfers held back while the ready queue was full, oldest first,
+	 * protected by the mutex. While 'stalled' is set, completions get
+	 * appended here, so that the data stays in order.
+	 */
+	GSList *parked;
+	int stalled;
+
+	/* Moving averages, used to adapt the pool. */
+	int64_t rate;
+	int64_t avg_period_us;
+	int64_t avg_lag_us;
+	int64_t last_complete_us;
+
+	int64_t start_us;
+	uint64_t resubmit_sum_us;
+	struct sr_usb_stream_stats stats;
+};
+
+/* Event source which delivers the buffers of a threaded stream. */
+struct usb_stream_source {
+	GSource base;
+
+	struct sr_usb_stream *stream;
+	/* Copies, the stream may be gone when the source is finalized. */
+	struct sr_session *session;
+	void *key;
+};
+
+static gboolean usb_stream_queue_push(struct usb_stream_queue *queue,
+		const struct usb_stream_chunk *chunk)
+{
+	unsigned int head, tail;
+
+	head = g_atomic_int_get(&queue->head);
+	tail = g_atomic_int_get(&queue->tail);
+	if (head - tail >= USB_STREAM_QUEUE_SIZE)
+		return FALSE;
+
+	queue->slots[head % USB_STREAM_QUEUE_SIZE] = *chunk;
+	g_atomic_int_set(&queue->head, head + 1);
+
+	return TRUE;
+}
+
+static gboolean usb_stream_queue_pop(struct usb_stream_queue *queue,
+		struct usb_stream_chunk *chunk)
+{
+	unsigned int head, tail;
+
+	head = g_atomic_int_get(&queue->head);
+	tail = g_atomic_int_get(&queue->tail);
+	if (head == tail)
+		return FALSE;
+
+	*chunk = queue->slots[tail % USB_STREAM_QUEUE_SIZE];
+	g_atomic_int_set(&queue->tail, tail + 1);
+
+	return TRUE;
+}
+
+static gboolean usb_stream_queue_empty(struct usb_stream_queue *queue)
+{
+	return g_atomic_int_get(&queue->head) == g_atomic_int_get(&queue->tail);
+}
+
+static void usb_stream_queue_clear(struct usb_stream_queue *queue)
+{
+	struct usb_stream_chunk chunk;
+
+	while (usb_stream_queue_pop(queue, &chunk))
+		g_free(chunk.buf);
+}
+
+/*
+ * Resubmission latency on the event thread decides whether the device
+ * overruns, so ask for a higher priority than the session's threads.
+ * Real-time scheduling usually takes privileges, without them the
+ * thread keeps the default priority. GLib has no portable API for this.
+ */
+static void usb_event_thread_set_priority(void)
+{
+#if defined(_WIN32)
+	if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+		sr_dbg("Cannot raise USB event thread priority.");
+#elif defined(HAVE_THREAD_SCHEDPARAM)
+	struct sched_param param;
+	int ret;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+	ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (ret != 0)
+		sr_dbg("Cannot raise USB event thread priority: %s.",
+			g_strerror(ret));
+#else
+	sr_dbg("Cannot raise USB event thread priority on this platform.");
+#endif
+}
+
+static gpointer usb_event_thread_run(gpointer data)
+{
+	struct sr_usb_event_thread *thread;
+	struct timeval tv;
+	int ret;
+
+	thread = data;
+	usb_event_thread_set_priority();
+
+	while (!g_atomic_int_get(&thread->quit)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = USB_EVENT_THREAD_TIMEOUT_US;
+		ret = libusb_handle_events_timeout_completed(thread->usb_ctx,
+			&tv, &thread->quit);
+		if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+			sr_err("Failed to handle USB events: %s.",
+				libusb_error_name(ret));
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static struct sr_usb_event_thread *usb_event_thread_acquire(
+		struct sr_context *ctx)
+{
+	struct sr_usb_event_thread *thread;
+	GError *error;
+
+	g_mutex_lock(&usb_thread_mutex);
+	if ((thread = ctx->usb_thread)) {
+		thread->refcount++;
+		g_mutex_unlock(&usb_thread_mutex);
+		return thread;
+	}
+
+	thread = g_malloc0(sizeof(*thread));
+	thread->usb_ctx = ctx->libusb_ctx;
+	thread->refcount = 1;
+
+	error = NULL;
+	thread->thread = g_thread_try_new("sr-usb-events",
+		usb_event_thread_run, thread, &error);
+	if (!thread->thread) {
+		sr_err("Failed to start USB event thread: %s.",
+			error->message);
+		g_error_free(error);
+		g_free(thread);
+		g_mutex_unlock(&usb_thread_mutex);
+		return NULL;
+	}
+	sr_dbg("Started USB event thread.");
+	ctx->usb_thread = thread;
+	g_mutex_unlock(&usb_thread_mutex);
+
+	return thread;
+}
+
+static void usb_event_thread_release(struct sr_context *ctx,
+		struct sr_usb_event_thread *thread)
+{
+	g_mutex_lock(&usb_thread_mutex);
+	if (--thread->refcount > 0) {
+		g_mutex_unlock(&usb_thread_mutex);
+		return;
+	}
+
+	g_atomic_int_set(&thread->quit, TRUE);
+#if (LIBUSB_API_VERSION >= 0x01000105)
+	libusb_interrupt_event_handler(thread->usb_ctx);
+#endif
+	g_thread_join(thread->thread);
+	sr_dbg("Stopped USB event thread.");
+
+	ctx->usb_thread = NULL;
+	g_mutex_unlock(&usb_thread_mutex);
+	g_free(thread);
+}
+
+static size_t usb_stream_size_for_rate(const struct sr_usb_stream *stream,
+		uint64_t bytes_per_sec)
+{
+	size_t atom, size;
+
+	atom = stream->cfg.atom_size;
+	size = bytes_per_sec * USB_STREAM_PERIOD_US / G_USEC_PER_SEC;
+	size = ((size + atom - 1) / atom) * atom;
+	if (size < atom)
+		size = atom;
+	if (stream->cfg.max_buffer_size && size > stream->cfg.max_buffer_size)
+		size = stream->cfg.max_buffer_size;
+
+	return size;
+}
+
+static void usb_stream_update_timeout(struct sr_usb_stream *stream)
+{
+	uint64_t rate, total;
+
+	rate = stream->rate > 0 ? (uint64_t)stream->rate : stream->cfg.bytes_per_sec;
+	if (!rate) {
+		stream->timeout = 0;
+		return;
+	}
+	total = (uint64_t)stream->buffer_size * stream->target_transfers;
+	stream->timeout = total * 1000 / rate;
+	/* Leave a headroom of 25%, and never use 0 ("no timeout"). */
+	stream->timeout += stream->timeout / 4;
+	if (!stream->timeout)
+		stream->timeout = 1;
+}
+
+/**
+ * Create a USB bulk streaming engine for a device's acquisition.
+ *
+ * The engine does not submit any transfers before sr_usb_stream_start()
+ * is called. Once started, the stream must be aborted, and it may only
+ * be freed from (or after) the finish callback.
+ *
+ * @param sdi The device instance to stream from, with an opened
+ *            USB connection and a session.
+ * @param cfg Stream parameters, copied into the engine.
+ * @param cb_data Passed to the receive and finish callbacks.
+ *
+ * @return A new stream, or NULL on failure.
+ *
+ * @private
+ */
+SR_PRIV struct sr_usb_stream *sr_usb_stream_new(const struct sr_dev_inst *sdi,
+		const struct sr_usb_stream_config *cfg, void *cb_data)
+{
+	struct sr_usb_stream *stream;
+	struct drv_context *drvc;
+	struct sr_usb_dev_inst *usb;
+	size_t size;
+	uint64_t depth;
+
+	if (!sdi || !cfg || !cfg->receive_cb || !cfg->finish_cb)
+		return NULL;
+	drvc = sdi->driver->context;
+	usb = sdi->conn;
+
+	stream = g_malloc0(sizeof(*stream));
+	stream->ctx = drvc->sr_ctx;
+	stream->sdi = sdi;
+	stream->session = sdi->session;
+	stream->devhdl = usb->devhdl;
+	stream->cfg = *cfg;
+	stream->cb_data = cb_data;
+	g_mutex_init(&stream->mutex);
+
+	if (!stream->cfg.atom_size)
+		stream->cfg.atom_size = 512;
+	if (!stream->cfg.max_transfers)
+		stream->cfg.max_transfers = USB_STREAM_MAX_TRANSFERS;
+	if (!stream->cfg.max_empty_transfers)
+		stream->cfg.max_empty_transfers = USB_STREAM_MAX_EMPTY;
+
+	size = usb_stream_size_for_rate(stream, stream->cfg.bytes_per_sec);
+	if (!stream->cfg.max_buffer_size)
+		stream->cfg.max_buffer_size = 4 * size;
+	stream->buffer_size = size;
+
+	/* Start with enough transfers to cover the initial depth. */
+	depth = stream->cfg.bytes_per_sec * USB_STREAM_INITIAL_DEPTH_US
+		/ G_USEC_PER_SEC;
+	depth = (depth + size - 1) / size;
+	depth = CLAMP(depth, USB_STREAM_MIN_TRANSFERS, stream->cfg.max_transfers);
+	stream->min_transfers = depth;
+	stream->target_transfers = depth;
+
+	stream->transfers = g_malloc0(stream->cfg.max_transfers
+		* sizeof(stream->transfers[0]));
+
+	usb_stream_update_timeout(stream);
+
+	if (stream->ctx->usb_thread_enabled) {
+		stream->thread = usb_event_thread_acquire(stream->ctx);
+		if (!stream->thread) {
+			sr_usb_stream_free(stream);
+			return NULL;
+		}
+	}
+
+	return stream;
+}
+
+/** @private */
+SR_PRIV void sr_usb_stream_free(struct sr_usb_stream *stream)
+{
+	if (!stream)
+		return;
+
+	if (stream->source)
+		g_source_unref(&stream->source->base);
+	if (stream->thread)
+		usb_event_thread_release(stream->ctx, stream->thread);
+	usb_stream_queue_clear(&stream->ready);
+	usb_stream_queue_clear(&stream->spare);
+	g_mutex_clear(&stream->mutex);
+	g_free(stream->transfers);
+	g_free(stream);
+}
+
+/**
+ * Return the largest buffer a receive callback can possibly be handed.
+ * Drivers size their post-processing buffers from this.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_usb_stream_max_buffer_size(const struct sr_usb_stream *stream)
+{
+	return stream->cfg.max_buffer_size;
+}
+
+/**
+ * Return the current transfer timeout in ms.
+ *
+ * @private
+ */
+SR_PRIV unsigned int sr_usb_stream_timeout(const struct sr_usb_stream *stream)
+{
+	return stream->timeout;
+}
+
+/** @private */
+SR_PRIV void sr_usb_stream_get_stats(const struct sr_usb_stream *stream,
+		struct sr_usb_stream_stats *stats)
+{
+	int64_t elapsed_us;
+
+	*stats = stream->stats;
+	elapsed_us = g_get_monotonic_time() - stream->start_us;
+	if (stream->start_us && elapsed_us > 0)
+		stats->bytes_per_sec = stats->bytes * G_USEC_PER_SEC / elapsed_us;
+	if (stats->transfers)
+		stats->avg_resubmit_us = stream->resubmit_sum_us / stats->transfers;
+	stats->buffer_size = stream->buffer_size;
+	stats->num_transfers = stream->submitted;
+}
+
+static void usb_stream_finish(struct sr_usb_stream *stream)
+{
+	struct sr_usb_stream_stats stats;
+
+	sr_usb_stream_get_stats(stream, &stats);
+	sr_dbg("Stream done: %" PRIu64 " bytes (%" PRIu64 " B/s) in %"
+		PRIu64 " transfers, %" PRIu64 " empty, %" PRIu64 " held back, "
+		"resubmit latency avg %" PRIu64 " us, max %" PRIu64 " us.",
+		stats.bytes, stats.bytes_per_sec, stats.transfers,
+		stats.empty_transfers, stats.stalled_transfers,
+		stats.avg_resubmit_us, stats.max_resubmit_us);
+
+	/* This may free the stream, don't touch it afterwards. */
+	stream->cfg.finish_cb(stream->cb_data);
+}
+
+static void usb_stream_free_transfer(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer)
+{
+	GMainContext *main_context;
+	unsigned int i, remaining;
+
+	/* Unregister first, an abort must not cancel a freed transfer. */
+	g_mutex_lock(&stream->mutex);
+	for (i = 0; i < stream->cfg.max_transfers; i++) {
+		if (stream->transfers[i] == transfer) {
+			stream->transfers[i] = NULL;
+			break;
+		}
+	}
+	remaining = --stream->submitted;
+	g_mutex_unlock(&stream->mutex);
+
+	g_free(transfer->buffer);
+	transfer->buffer = NULL;
+	libusb_free_transfer(transfer);
+
+	if (remaining > 0)
+		return;
+
+	if (stream->thread) {
+		/* The session finishes up once it drained the queue. */
+		main_context = stream->main_context;
+		g_atomic_int_set(&stream->finished, TRUE);
+		if (main_context)
+			g_main_context_wakeup(main_context);
+		return;
+	}
+
+	usb_stream_finish(stream);
+}
+
+static void LIBUSB_CALL usb_stream_receive(struct libusb_transfer *transfer);
+
+static int usb_stream_submit_new(struct sr_usb_stream *stream)
+{
+	struct libusb_transfer *transfer;
+	unsigned char *buf;
+	unsigned int i;
+	int ret;
+
+	g_mutex_lock(&stream->mutex);
+	for (i = 0; i < stream->cfg.max_transfers; i++) {
+		if (!stream->transfers[i])
+			break;
+	}
+	g_mutex_unlock(&stream->mutex);
+	if (i == stream->cfg.max_transfers)
+		return SR_ERR;
+
+	if (!(buf = g_try_malloc(stream->buffer_size))) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(transfer, stream->devhdl,
+		stream->cfg.endpoint, buf, stream->buffer_size,
+		usb_stream_receive, stream, stream->timeout);
+
+	/* Register first, the transfer may complete on the event thread. */
+	g_mutex_lock(&stream->mutex);
+	stream->transfers[i] = transfer;
+	stream->submitted++;
+	g_mutex_unlock(&stream->mutex);
+
+	if ((ret = libusb_submit_transfer(transfer)) != 0) {
+		sr_err("Failed to submit transfer: %s.",
+			libusb_error_name(ret));
+		g_mutex_lock(&stream->mutex);
+		stream->transfers[i] = NULL;
+		stream->submitted--;
+		g_mutex_unlock(&stream->mutex);
+		libusb_free_transfer(transfer);
+		g_free(buf);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/* Returns FALSE when the transfer had to be released. */
+static gboolean usb_stream_resubmit(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer)
+{
+	unsigned char *buf;
+	int ret;
+
+	/* Pick up a changed buffer size as transfers come back. */
+	if ((size_t)transfer->length != stream->buffer_size) {
+		if (!(buf = g_try_malloc(stream->buffer_size))) {
+			sr_err("USB transfer buffer malloc failed.");
+			usb_stream_free_transfer(stream, transfer);
+			return FALSE;
+		}
+		g_free(transfer->buffer);
+		transfer->buffer = buf;
+		transfer->length = stream->buffer_size;
+	}
+	transfer->timeout = stream->timeout;
+
+	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+		return TRUE;
+
+	sr_err("%s: %s", __func__, libusb_error_name(ret));
+	usb_stream_free_transfer(stream, transfer);
+
+	return FALSE;
+}
+
+/*
+ * The device can keep streaming for roughly the fill time of all
+ * transfers in flight while the consumer is busy. Add transfers when
+ * the consumer eats into a quarter of that slack, and give back the
+ * extra ones when it has become negligible.
+ */
+static gboolean usb_stream_adapt_depth(struct sr_usb_stream *stream,
+		int64_t lag_us)
+{
+	int64_t slack_us;
+
+	stream->avg_lag_us += (lag_us - stream->avg_lag_us)
+		>> USB_STREAM_AVG_SHIFT;
+
+	slack_us = stream->avg_period_us * stream->submitted;
+	if (stream->avg_lag_us * 4 > slack_us
+			&& stream->target_transfers < stream->cfg.max_transfers) {
+		stream->target_transfers++;
+		return TRUE;
+	}
+	if (stream->avg_lag_us * 32 < slack_us
+			&& stream->target_transfers > stream->min_transfers) {
+		stream->target_transfers--;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Follow the observed throughput, so that low rates don't suffer from
+ * excessive latency and high rates from too many completions. Only
+ * react to substantial deviations, as rates measured right after a
+ * stall are skewed.
+ */
+static gboolean usb_stream_adapt_size(struct sr_usb_stream *stream,
+		size_t length, int64_t period_us)
+{
+	int64_t rate;
+	size_t size;
+
+	stream->avg_period_us += (period_us - stream->avg_period_us)
+		>> USB_STREAM_AVG_SHIFT;
+	if (period_us > 0) {
+		rate = (int64_t)length * G_USEC_PER_SEC / period_us;
+		stream->rate += (rate - stream->rate) >> USB_STREAM_AVG_SHIFT;
+	}
+	if (stream->rate <= 0)
+		return FALSE;
+
+	size = usb_stream_size_for_rate(stream, stream->rate);
+	if (size < 2 * stream->buffer_size && 2 * size > stream->buffer_size)
+		return FALSE;
+	stream->buffer_size = size;
+
+	return TRUE;
+}
+
+static void usb_stream_adapted(struct sr_usb_stream *stream)
+{
+	usb_stream_update_timeout(stream);
+	/* Takes effect when the source gets dispatched next. */
+	if (stream->source)
+		stream->source->timeout_us = 1000 * (int64_t)stream->timeout;
+	sr_dbg("Stream adapted to %u transfers of %zu bytes, timeout %u ms.",
+		stream->target_transfers, stream->buffer_size, stream->timeout);
+}
+
+static void usb_stream_account_resubmit(struct sr_usb_stream *stream,
+		int64_t complete_us)
+{
+	int64_t latency_us;
+
+	latency_us = g_get_monotonic_time() - complete_us;
+	stream->resubmit_sum_us += latency_us;
+	if ((uint64_t)latency_us > stream->stats.max_resubmit_us)
+		stream->stats.max_resubmit_us = latency_us;
+	sr_session_stats_latency(stream->sdi, latency_us);
+}
+
+/* Threaded mode: queue the filled buffer, resubmit with a spare one. */
+static void usb_stream_hand_over(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer, int64_t now_us,
+		int64_t period_us)
+{
+	struct usb_stream_chunk chunk, spare;
+	GMainContext *main_context;
+	gboolean queued;
+
+	if (usb_stream_adapt_size(stream, transfer->actual_length, period_us))
+		usb_stream_adapted(stream);
+
+	chunk.buf = transfer->buffer;
+	chunk.size = transfer->length;
+	chunk.length = transfer->actual_length;
+	main_context = stream->main_context;
+
+	/* Hold the transfer back while the session can't keep up. */
+	g_mutex_lock(&stream->mutex);
+	queued = !stream->stalled && usb_stream_queue_push(&stream->ready, &chunk);
+	if (!queued) {
+		if (!stream->stalled)
+			sr_dbg("Session falls behind the USB stream, holding back transfers.");
+		stream->parked = g_slist_append(stream->parked, transfer);
+		g_atomic_int_set(&stream->stalled, TRUE);
+		stream->stats.stalled_transfers++;
+	}
+	g_mutex_unlock(&stream->mutex);
+	if (!queued) {
+		if (main_context)
+			g_main_context_wakeup(main_context);
+		return;
+	}
+
+	spare.buf = NULL;
+	while (usb_stream_queue_pop(&stream->spare, &spare)) {
+		if (spare.size == stream->buffer_size)
+			break;
+		g_free(spare.buf);
+		spare.buf = NULL;
+	}
+	if (!spare.buf && !(spare.buf = g_try_malloc(stream->buffer_size))) {
+		sr_err("USB transfer buffer malloc failed.");
+		/* The buffer was queued, it's no longer the transfer's. */
+		transfer->buffer = NULL;
+		sr_usb_stream_abort(stream);
+		usb_stream_free_transfer(stream, transfer);
+		if (main_context)
+			g_main_context_wakeup(main_context);
+		return;
+	}
+
+	transfer->buffer = spare.buf;
+	transfer->length = stream->buffer_size;
+	if (usb_stream_resubmit(stream, transfer))
+		usb_stream_account_resubmit(stream, now_us);
+
+	if (main_context)
+		g_main_context_wakeup(main_context);
+}
+
+static void LIBUSB_CALL usb_stream_receive(struct libusb_transfer *transfer)
+{
+	struct sr_usb_stream *stream;
+	gboolean has_error, keep, changed;
+	int64_t now_us, period_us, lag_us;
+
+	stream = transfer->user_data;
+
+	/*
+	 * If acquisition has already ended, just free any queued up
+	 * transfer that come in.
+	 */
+	if (g_atomic_int_get(&stream->aborted)) {
+		usb_stream_free_transfer(stream, transfer);
+		return;
+	}
+
+	sr_spew("%s(): status %s received %d bytes.", __func__,
+		libusb_error_name(transfer->status), transfer->actual_length);
+
+	has_error = FALSE;
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		sr_usb_stream_abort(stream);
+		usb_stream_free_transfer(stream, transfer);
+		return;
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
+		break;
+	default:
+		has_error = TRUE;
+		break;
+	}
+
+	if (transfer->actual_length == 0 || has_error) {
+		stream->stats.empty_transfers++;
+		if (++stream->empty_count > stream->cfg.max_empty_transfers) {
+			/*
+			 * The device gave up. End the acquisition, the
+			 * frontend will work out that the samplecount is short.
+			 */
+			sr_usb_stream_abort(stream);
+			usb_stream_free_transfer(stream, transfer);
+		} else {
+			usb_stream_resubmit(stream, transfer);
+		}
+		return;
+	}
+	stream->empty_count = 0;
+
+	now_us = g_get_monotonic_time();
+	period_us = now_us - stream->last_complete_us;
+	stream->last_complete_us = now_us;
+	stream->stats.bytes += transfer->actual_length;
+	stream->stats.transfers++;
+
+	if (stream->thread) {
+		usb_stream_hand_over(stream, transfer, now_us, period_us);
+		return;
+	}
+
+	keep = stream->cfg.receive_cb(transfer->buffer,
+		transfer->actual_length, stream->cb_data);
+	lag_us = g_get_monotonic_time() - now_us;
+
+	if (!keep || stream->aborted) {
+		sr_usb_stream_abort(stream);
+		usb_stream_free_transfer(stream, transfer);
+		return;
+	}
+
+	changed = usb_stream_adapt_size(stream, transfer->actual_length,
+		period_us);
+	changed |= usb_stream_adapt_depth(stream, lag_us);
+	if (changed)
+		usb_stream_adapted(stream);
+
+	if (stream->submitted > stream->target_transfers) {
+		usb_stream_free_transfer(stream, transfer);
+		return;
+	}
+	if (!usb_stream_resubmit(stream, transfer))
+		return;
+	usb_stream_account_resubmit(stream, now_us);
+
+	while (stream->submitted < stream->target_transfers) {
+		if (usb_stream_submit_new(stream) != SR_OK) {
+			stream->target_transfers = stream->submitted;
+			break;
+		}
+	}
+}
+
+/*
+ * Session side: deliver the data of held back transfers, which follows
+ * everything in the ready queue, and resubmit them. The event thread
+ * queues again once none are left.
+ */
+static void usb_stream_resume(struct sr_usb_stream *stream)
+{
+	struct libusb_transfer *transfer;
+	GSList *l;
+
+	while (g_atomic_int_get(&stream->stalled)) {
+		g_mutex_lock(&stream->mutex);
+		if (!(l = stream->parked)) {
+			g_atomic_int_set(&stream->stalled, FALSE);
+			g_mutex_unlock(&stream->mutex);
+			break;
+		}
+		transfer = l->data;
+		stream->parked = g_slist_delete_link(l, l);
+		g_mutex_unlock(&stream->mutex);
+
+		if (!g_atomic_int_get(&stream->aborted)
+				&& !stream->cfg.receive_cb(transfer->buffer,
+					transfer->actual_length, stream->cb_data))
+			sr_usb_stream_abort(stream);
+		/* Aborting didn't cancel it, it wasn't submitted. */
+		if (g_atomic_int_get(&stream->aborted))
+			usb_stream_free_transfer(stream, transfer);
+		else
+			usb_stream_resubmit(stream, transfer);
+	}
+}
+
+static gboolean usb_stream_source_prepare(GSource *source, int *timeout)
+{
+	struct sr_usb_stream *stream;
+
+	stream = ((struct usb_stream_source *)source)->stream;
+	*timeout = -1;
+
+	return !usb_stream_queue_empty(&stream->ready)
+		|| g_atomic_int_get(&stream->stalled)
+		|| g_atomic_int_get(&stream->finished);
+}
+
+static gboolean usb_stream_source_check(GSource *source)
+{
+	int timeout;
+
+	return usb_stream_source_prepare(source, &timeout);
+}
+
+static gboolean usb_stream_source_dispatch(GSource *source,
+		GSourceFunc callback, void *user_data)
+{
+	struct sr_usb_stream *stream;
+	struct usb_stream_chunk chunk;
+	gboolean finished;
+
+	(void)callback;
+	(void)user_data;
+
+	stream = ((struct usb_stream_source *)source)->stream;
+
+	/*
+	 * Nothing gets queued after the stream finished, so once that was
+	 * seen, draining the queue delivers all remaining data.
+	 */
+	finished = g_atomic_int_get(&stream->finished);
+	while (usb_stream_queue_pop(&stream->ready, &chunk)) {
+		if (!g_atomic_int_get(&stream->aborted)
+				&& !stream->cfg.receive_cb(chunk.buf,
+					chunk.length, stream->cb_data))
+			sr_usb_stream_abort(stream);
+		if (!usb_stream_queue_push(&stream->spare, &chunk))
+			g_free(chunk.buf);
+	}
+	usb_stream_resume(stream);
+	if (!finished)
+		return G_SOURCE_CONTINUE;
+
+	usb_stream_finish(stream);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void usb_stream_source_finalize(GSource *source)
+{
+	struct usb_stream_source *ssource;
+
+	ssource = (struct usb_stream_source *)source;
+
+	sr_session_source_destroyed(ssource->session, ssource->key, source);
+}
+
+/**
+ * Install the event source which drives a USB stream.
+ *
+ * Without the USB event thread, this is a regular USB event source,
+ * see usb_source_add(), whose timeout follows the stream's transfer
+ * timeout as the stream adapts. With the thread, the source delivers
+ * completed buffers instead, and @a cb is not used. In both cases, the
+ * source is keyed on the stream rather than the shared libusb context,
+ * so that several devices on one context each remove their own source.
+ *
+ * @see sr_usb_stream_source_remove()
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_source_add(struct sr_usb_stream *stream,
+		sr_receive_data_callback cb, void *cb_data)
+{
+	static GSourceFuncs usb_stream_source_funcs = {
+		.prepare  = &usb_stream_source_prepare,
+		.check    = &usb_stream_source_check,
+		.dispatch = &usb_stream_source_dispatch,
+		.finalize = &usb_stream_source_finalize
+	};
+	GSource *source;
+	struct usb_stream_source *ssource;
+	int ret;
+
+	if (!stream->thread) {
+		source = usb_source_new(stream->session, stream,
+			stream->ctx->libusb_ctx, stream->timeout);
+		if (!source)
+			return SR_ERR;
+		g_source_set_callback(source, G_SOURCE_FUNC(cb), cb_data, NULL);
+		ret = sr_session_source_add_internal(stream->session,
+			stream, source);
+		/* Keep the reference, the stream updates the timeout. */
+		if (stream->source)
+			g_source_unref(&stream->source->base);
+		stream->source = (struct usb_source *)source;
+		return ret;
+	}
+
+	source = g_source_new(&usb_stream_source_funcs,
+		sizeof(struct usb_stream_source));
+	ssource = (struct usb_stream_source *)source;
+	g_source_set_name(source, "usb-stream");
+	ssource->stream = stream;
+	ssource->session = stream->session;
+	ssource->key = stream;
+
+	ret = sr_session_source_add_internal(stream->session,
+		ssource->key, source);
+	stream->main_context = g_source_get_context(source);
+	g_source_unref(source);
+
+	return ret;
+}
+
+/**
+ * Remove the event source installed by sr_usb_stream_source_add().
+ * May be called from the finish callback, and from any thread.
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_source_remove(struct sr_usb_stream *stream)
+{
+	return sr_session_source_remove_internal(stream->session, stream);
+}
+
+/**
+ * Allocate and submit the initial set of transfers of a USB stream.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR No transfer could be submitted. The finish callback
+ *                will not be invoked.
+ * @retval SR_ERR_IO Some transfers were submitted before an error
+ *                   occurred. The stream was aborted, and the finish
+ *                   callback runs after the submitted transfers were
+ *                   released.
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_start(struct sr_usb_stream *stream)
+{
+	unsigned int i;
+
+	g_atomic_int_set(&stream->aborted, FALSE);
+	g_atomic_int_set(&stream->finished, FALSE);
+	stream->empty_count = 0;
+	stream->start_us = g_get_monotonic_time();
+	stream->last_complete_us = stream->start_us;
+	stream->avg_period_us = USB_STREAM_PERIOD_US;
+	stream->rate = stream->cfg.bytes_per_sec;
+
+	for (i = 0; i < stream->target_transfers; i++) {
+		sr_spew("Submitting transfer: %u.", i);
+		if (usb_stream_submit_new(stream) == SR_OK)
+			continue;
+		if (!stream->submitted)
+			return SR_ERR;
+		sr_usb_stream_abort(stream);
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Cancel all transfers of a USB stream. The finish callback runs once
+ * all of them have been released. May be called from any thread.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_stream_abort(struct sr_usb_stream *stream)
+{
+	GMainContext *main_context;
+	unsigned int i;
+
+	g_atomic_int_set(&stream->aborted, TRUE);
+
+	g_mutex_lock(&stream->mutex);
+	for (i = stream->cfg.max_transfers; i > 0; i--) {
+		if (stream->transfers[i - 1])
+			libusb_cancel_transfer(stream->transfers[i - 1]);
+	}
+	main_context = stream->main_context;
+	g_mutex_unlock(&stream->mutex);
+
+	/* Held back transfers get released by the session. */
+	if (main_context)
+		g_main_context_wakeup(main_context);
+}
@@ -0,0 +1,253 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define MAX_ROWS 64
+
+/* The rows handed out by an aligner, in order. */
+struct rows {
+	size_t count;
+	size_t max_block;
+	uint8_t logic[MAX_ROWS];
+	float analog[2][MAX_ROWS];
+};
+
+static int collect(const struct sr_aligned_block *block, void *cb_data)
+{
+	struct rows *rows;
+	size_t i, col;
+
+	rows = cb_data;
+	fail_unless(block->first_sample == rows->count,
+		"Block starts at %" PRIu64 ", expected %zu.",
+		block->first_sample, rows->count);
+	fail_unless(rows->count + block->num_samples <= MAX_ROWS, "Too many rows.");
+	rows->max_block = MAX(rows->max_block, block->num_samples);
+	for (i = 0; i < block->num_samples; i++) {
+		if (block->logic)
+			rows->logic[rows->count + i] = block->logic[i];
+		for (col = 0; col < block->num_analog; col++)
+			rows->analog[col][rows->count + i] = block->analog[col][i];
+	}
+	rows->count += block->num_samples;
+
+	return SR_OK;
+}
+
+static struct sr_dev_inst *create_device(unsigned int num_analog)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	unsigned int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	for (i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	for (i = 0; i < num_analog; i++) {
+		snprintf(name, sizeof(name), "A%u", i);
+		sr_dev_inst_channel_add(sdi, 8 + i, SR_CHANNEL_ANALOG, name);
+	}
+
+	return sdi;
+}
+
+static void feed_logic(struct sr_aligner *al, const uint8_t *data, size_t count)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+
+	logic.length = count;
+	logic.unitsize = 1;
+	logic.data = (void *)data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	fail_unless(sr_aligner_feed(al, &packet) == SR_OK, "Logic feed failed.");
+}
+
+static void feed_analog(struct sr_aligner *al, GSList *channels,
+		const float *data, size_t count)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	analog.data = (void *)data;
+	analog.num_samples = count;
+	meaning.channels = channels;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	fail_unless(sr_aligner_feed(al, &packet) == SR_OK, "Analog feed failed.");
+}
+
+static void feed_end(struct sr_aligner *al)
+{
+	struct sr_datafeed_packet packet;
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_aligner_feed(al, &packet) == SR_OK, "End feed failed.");
+}
+
+/*
+ * Check that logic, interleaved analog and single channel analog packets
+ * of different lengths come out as rows, and that the end of the
+ * acquisition fills the missing analog samples with NAN.
+ */
+START_TEST(test_aligner_interleave)
+{
+	static const float both[] = { 0, 100, 1, 101, 2, 102 };
+	static const float a0[] = { 3, 4, 5, 6, 7 };
+	static const float a1[] = { 103, 104, 105, 106 };
+	struct sr_dev_inst *sdi;
+	struct sr_aligner *al;
+	struct rows rows;
+	GSList *channels, *l;
+	uint8_t logic[10];
+	unsigned int i;
+
+	sdi = create_device(2);
+	channels = g_slist_nth(sr_dev_inst_channels_get(sdi), 8);
+	memset(&rows, 0, sizeof(rows));
+	fail_unless(sr_aligner_new(&al, sdi, 4, 0, collect, &rows) == SR_OK,
+		"sr_aligner_new() failed.");
+
+	for (i = 0; i < sizeof(logic); i++)
+		logic[i] = i;
+	feed_logic(al, logic, sizeof(logic));
+	fail_unless(rows.count == 0, "Rows without analog data.");
+	feed_analog(al, channels, both, 3);
+	fail_unless(rows.count == 3, "Got %zu rows, expected 3.", rows.count);
+	l = g_slist_append(NULL, channels->data);
+	feed_analog(al, l, a0, G_N_ELEMENTS(a0));
+	g_slist_free(l);
+	l = g_slist_append(NULL, channels->next->data);
+	feed_analog(al, l, a1, G_N_ELEMENTS(a1));
+	g_slist_free(l);
+	fail_unless(rows.count == 7, "Got %zu rows, expected 7.", rows.count);
+	feed_end(al);
+	fail_unless(rows.count == 10, "Got %zu rows, expected 10.", rows.count);
+	fail_unless(rows.max_block <= 4, "Block of %zu rows.", rows.max_block);
+
+	for (i = 0; i < 10; i++) {
+		fail_unless(rows.logic[i] == i, "Wrong logic in row %u.", i);
+		if (i < 8)
+			fail_unless(rows.analog[0][i] == i, "Wrong A0 in row %u.", i);
+		else
+			fail_unless(isnan(rows.analog[0][i]), "A0 row %u not NAN.", i);
+		if (i < 7)
+			fail_unless(rows.analog[1][i] == 100 + i,
+				"Wrong A1 in row %u.", i);
+		else
+			fail_unless(isnan(rows.analog[1][i]), "A1 row %u not NAN.", i);
+	}
+
+	sr_aligner_free(al);
+}
+END_TEST
+
+/*
+ * Check that a stream which runs too far ahead hands out gaps for the
+ * others, and that their late data for those samples is dropped.
+ */
+START_TEST(test_aligner_max_lag)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_aligner *al;
+	struct rows rows;
+	GSList *channels;
+	uint8_t logic[20];
+	float a0[18];
+	unsigned int i;
+
+	sdi = create_device(1);
+	channels = g_slist_nth(sr_dev_inst_channels_get(sdi), 8);
+	memset(&rows, 0, sizeof(rows));
+	fail_unless(sr_aligner_new(&al, sdi, 4, 8, collect, &rows) == SR_OK,
+		"sr_aligner_new() failed.");
+
+	for (i = 0; i < sizeof(logic); i++)
+		logic[i] = i;
+	for (i = 0; i < G_N_ELEMENTS(a0); i++)
+		a0[i] = i;
+	feed_logic(al, logic, sizeof(logic));
+	fail_unless(rows.count == 16, "Got %zu rows, expected 16.", rows.count);
+	feed_analog(al, channels, a0, G_N_ELEMENTS(a0));
+	fail_unless(rows.count == 18, "Got %zu rows, expected 18.", rows.count);
+	feed_end(al);
+	fail_unless(rows.count == 20, "Got %zu rows, expected 20.", rows.count);
+
+	for (i = 0; i < 20; i++) {
+		fail_unless(rows.logic[i] == i, "Wrong logic in row %u.", i);
+		if (i == 16 || i == 17)
+			fail_unless(rows.analog[0][i] == i, "Wrong A0 in row %u.", i);
+		else
+			fail_unless(isnan(rows.analog[0][i]), "A0 row %u not NAN.", i);
+	}
+
+	/* The next acquisition starts at sample 0 again. */
+	rows.count = 0;
+	feed_logic(al, logic, 2);
+	feed_analog(al, channels, a0, 2);
+	fail_unless(rows.count == 2, "Got %zu rows, expected 2.", rows.count);
+
+	sr_aligner_free(al);
+}
+END_TEST
+
+Suite *suite_aligner(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("aligner");
+
+	tc = tcase_create("align");
+	tcase_add_test(tc, test_aligner_interleave);
+	tcase_add_test(tc, test_aligner_max_lag);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,691 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput benchmark suite, run by "make bench".
+ *
+ * Microbenchmarks (analog conversion) and end-to-end scenarios: the
+ * demo driver through the session datafeed, soft triggers, transforms
+ * and every output module, every input module which can read back what
+ * its output module wrote, and srzip files. All data is generated from
+ * a fixed seed. Every benchmark runs several times, the median is
+ * printed as one tab separated line per benchmark:
+ *
+ *   <name>	<value>	<unit>
+ *
+ * A benchmark which failed reports "nan".
+ *
+ * Usage: bench [runs [name pattern]]
+ */
+
+#include <config.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+
+#define DEFAULT_RUNS 5
+#define SEED 4711
+
+#define DEMO_SAMPLES (8 * 1024 * 1024)
+#define ANALOG_SAMPLES (1024 * 1024)
+#define FILE_SAMPLES (1024 * 1024)
+#define NUM_LOGIC_CHANNELS 8
+#define PACKET_SIZE (64 * 1024)
+
+struct bench {
+	struct sr_context *ctx;
+	unsigned int runs;
+	const char *pattern;
+	int null_fd;
+	/* Demo device, logic channels only. */
+	struct sr_dev_inst *demo;
+	/* User device and synthetic logic data for the file formats. */
+	struct sr_dev_inst *user;
+	uint8_t *logic;
+	size_t logic_size;
+};
+
+/* Returns the rate of one run, or a negative value on failure. */
+typedef double (*bench_func)(struct bench *b, const void *arg);
+
+static int compare_double(const void *a, const void *b)
+{
+	double x, y;
+
+	x = *(const double *)a;
+	y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void bench_run(struct bench *b, const char *name, const char *unit,
+		bench_func func, const void *arg)
+{
+	double *values;
+	unsigned int i;
+
+	if (b->pattern && !g_pattern_match_simple(b->pattern, name))
+		return;
+
+	values = g_malloc(b->runs * sizeof(double));
+	for (i = 0; i < b->runs; i++) {
+		if ((values[i] = func(b, arg)) < 0)
+			break;
+	}
+	if (i < b->runs) {
+		printf("%s\tnan\t%s\n", name, unit);
+	} else {
+		qsort(values, b->runs, sizeof(double), compare_double);
+		printf("%s\t%.3f\t%s\n", name, values[b->runs / 2], unit);
+	}
+	fflush(stdout);
+	g_free(values);
+}
+
+/*--- Analog conversion -----------------------------------------------------*/
+
+struct analog_case {
+	const char *name;
+	uint8_t unitsize;
+	gboolean is_signed;
+	gboolean is_float;
+	gboolean is_bigendian;
+};
+
+static const struct analog_case analog_cases[] = {
+	{ "u8", 1, FALSE, FALSE, FALSE },
+	{ "s16le", 2, TRUE, FALSE, FALSE },
+	{ "s32be", 4, TRUE, FALSE, TRUE },
+	{ "f32le", 4, TRUE, TRUE, FALSE },
+	{ "f32be", 4, TRUE, TRUE, TRUE },
+	{ "f64le", 8, TRUE, TRUE, FALSE },
+};
+
+static void analog_fill(const struct analog_case *ac, uint8_t *data,
+		size_t num_samples, GRand *rand)
+{
+	union {
+		float f;
+		double d;
+		uint8_t b[8];
+	} v;
+	unsigned int j;
+	size_t i;
+
+	for (i = 0; i < num_samples; i++) {
+		if (ac->is_float && ac->unitsize == 4)
+			v.f = g_rand_double_range(rand, -10, 10);
+		else if (ac->is_float)
+			v.d = g_rand_double_range(rand, -10, 10);
+		else
+			for (j = 0; j < ac->unitsize; j++)
+				v.b[j] = g_rand_int(rand);
+		/* Generated in host order, swap if that's not the target. */
+		for (j = 0; j < ac->unitsize; j++) {
+#ifdef WORDS_BIGENDIAN
+			if (!ac->is_bigendian)
+#else
+			if (ac->is_bigendian)
+#endif
+				data[j] = v.b[ac->unitsize - 1 - j];
+			else
+				data[j] = v.b[j];
+		}
+		data += ac->unitsize;
+	}
+}
+
+static double bench_analog_to_float(struct bench *b, const void *arg)
+{
+	const struct analog_case *ac;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GRand *rand;
+	float *out;
+	gint64 start;
+	double elapsed;
+	int ret;
+
+	(void)b;
+
+	ac = arg;
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = ac->unitsize;
+	encoding.is_signed = ac->is_signed;
+	encoding.is_float = ac->is_float;
+	encoding.is_bigendian = ac->is_bigendian;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.p = 0;
+	encoding.offset.q = 1;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	analog.num_samples = ANALOG_SAMPLES;
+	analog.data = g_malloc(ANALOG_SAMPLES * ac->unitsize);
+	out = g_malloc(ANALOG_SAMPLES * sizeof(float));
+
+	rand = g_rand_new_with_seed(SEED);
+	analog_fill(ac, analog.data, ANALOG_SAMPLES, rand);
+	g_rand_free(rand);
+
+	start = g_get_monotonic_time();
+	ret = sr_analog_to_float(&analog, out);
+	elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+
+	g_free(analog.data);
+	g_free(out);
+
+	if (ret != SR_OK)
+		return -1;
+
+	return ANALOG_SAMPLES / MAX(elapsed, 1e-9) / 1e6;
+}
+
+/*--- Demo driver through the session ---------------------------------------*/
+
+struct demo_case {
+	const char *transform;
+	const struct sr_output_module *omod;
+	gboolean trigger;
+};
+
+struct demo_feed {
+	const struct sr_output *o;
+	int fd;
+	uint64_t samples;
+	gboolean failed;
+};
+
+static void demo_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct demo_feed *feed;
+
+	(void)sdi;
+
+	feed = cb_data;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		feed->samples += logic->length / logic->unitsize;
+	}
+	if (feed->o && sr_output_send_fd(feed->o, packet, feed->fd) != SR_OK)
+		feed->failed = TRUE;
+}
+
+static const struct sr_channel_group *logic_group(const struct sr_dev_inst *sdi)
+{
+	const struct sr_channel_group *cg;
+	GSList *l;
+
+	for (l = sr_dev_inst_channel_groups_get(sdi); l; l = l->next) {
+		cg = l->data;
+		if (!strcmp(cg->name, "Logic"))
+			return cg;
+	}
+
+	return NULL;
+}
+
+static struct sr_dev_inst *demo_open(struct sr_context *ctx)
+{
+	struct sr_dev_driver **drivers;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GSList *devices, *l;
+	int i;
+
+	drivers = sr_driver_list(ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			break;
+	}
+	if (!drivers || !drivers[i])
+		return NULL;
+	if (sr_driver_init(ctx, drivers[i]) != SR_OK)
+		return NULL;
+	if (!(devices = sr_driver_scan(drivers[i], NULL)))
+		return NULL;
+	sdi = devices->data;
+	g_slist_free(devices);
+	if (sr_dev_open(sdi) != SR_OK)
+		return NULL;
+
+	/* Logic data only, with the demo as fast as it can go. */
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC)
+			sr_dev_channel_enable(ch, FALSE);
+	}
+	/* Unpaced, so that the results don't measure the demo's timer. */
+	sr_config_set(sdi, NULL, SR_CONF_TEST_MODE,
+		g_variant_new_string("max-rate"));
+	sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(SR_GHZ(1)));
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(DEMO_SAMPLES));
+
+	return sdi;
+}
+
+/* Soft trigger on D0 high, which an all-low pattern never satisfies. */
+static struct sr_trigger *demo_trigger(const struct sr_dev_inst *sdi)
+{
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_channel *ch;
+	GSList *l;
+
+	trigger = sr_trigger_new("bench");
+	stage = sr_trigger_stage_add(trigger);
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC) {
+			sr_trigger_match_add(stage, ch, SR_TRIGGER_ONE, 0);
+			break;
+		}
+	}
+
+	return trigger;
+}
+
+static double bench_demo(struct bench *b, const void *arg)
+{
+	const struct demo_case *dc;
+	const struct sr_transform *t;
+	struct sr_session *session;
+	struct sr_trigger *trigger;
+	struct demo_feed feed;
+	const char *pattern;
+	gint64 start;
+	double elapsed;
+
+	dc = arg;
+	memset(&feed, 0, sizeof(feed));
+	feed.fd = b->null_fd;
+	t = NULL;
+	trigger = NULL;
+	pattern = dc->trigger ? "all-low" : "sigrok";
+	sr_config_set(b->demo, logic_group(b->demo), SR_CONF_PATTERN_MODE,
+		g_variant_new_string(pattern));
+
+	if (sr_session_new(b->ctx, &session) != SR_OK)
+		return -1;
+	elapsed = -1;
+	if (sr_session_dev_add(session, b->demo) != SR_OK)
+		goto out;
+	if (dc->transform && !(t = sr_transform_new(
+			sr_transform_find(dc->transform), NULL, b->demo)))
+		goto out;
+	if (dc->trigger) {
+		trigger = demo_trigger(b->demo);
+		sr_session_trigger_set(session, trigger);
+	}
+	if (dc->omod && !(feed.o = sr_output_new(dc->omod, NULL, b->demo, NULL)))
+		goto out;
+	sr_session_datafeed_callback_add(session, demo_datafeed_in, &feed);
+
+	start = g_get_monotonic_time();
+	if (sr_session_start(session) != SR_OK)
+		goto out;
+	sr_session_run(session);
+	elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+
+out:
+	sr_session_destroy(session);
+	if (t)
+		sr_transform_free(t);
+	if (trigger)
+		sr_trigger_free(trigger);
+	if (feed.o)
+		sr_output_free(feed.o);
+
+	if (elapsed < 0 || feed.failed)
+		return -1;
+
+	return DEMO_SAMPLES / MAX(elapsed, 1e-9) / 1e6;
+}
+
+static void run_demo(struct bench *b)
+{
+	const struct sr_transform_module **transforms;
+	const struct sr_output_module **outputs;
+	struct demo_case dc;
+	char *name;
+	int i;
+
+	if (!b->demo)
+		return;
+
+	memset(&dc, 0, sizeof(dc));
+	bench_run(b, "demo/null", "Msamples/s", bench_demo, &dc);
+
+	dc.trigger = TRUE;
+	bench_run(b, "demo/soft-trigger", "Msamples/s", bench_demo, &dc);
+	dc.trigger = FALSE;
+
+	transforms = sr_transform_list();
+	for (i = 0; transforms[i]; i++) {
+		dc.transform = sr_transform_id_get(transforms[i]);
+		name = g_strdup_printf("demo/transform/%s", dc.transform);
+		bench_run(b, name, "Msamples/s", bench_demo, &dc);
+		g_free(name);
+	}
+	dc.transform = NULL;
+
+	outputs = sr_output_list();
+	for (i = 0; outputs[i]; i++) {
+		/* Modules which write files themselves are covered below. */
+		if (sr_output_test_flag(outputs[i], SR_OUTPUT_INTERNAL_IO_HANDLING))
+			continue;
+		dc.omod = outputs[i];
+		name = g_strdup_printf("demo/output/%s",
+			sr_output_id_get(outputs[i]));
+		bench_run(b, name, "Msamples/s", bench_demo, &dc);
+		g_free(name);
+	}
+}
+
+/*--- File formats ----------------------------------------------------------*/
+
+static struct sr_dev_inst *user_device(void)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("sigrok", "bench", NULL);
+	for (i = 0; i < NUM_LOGIC_CHANNELS; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+/* A random walk, every channel toggles with a probability of 1/16. */
+static void logic_fill(uint8_t *data, size_t size, GRand *rand)
+{
+	uint8_t value, toggle;
+	size_t i;
+	int bit;
+
+	value = 0;
+	for (i = 0; i < size; i++) {
+		toggle = 0;
+		for (bit = 0; bit < NUM_LOGIC_CHANNELS; bit++) {
+			if (g_rand_int_range(rand, 0, 16) == 0)
+				toggle |= 1 << bit;
+		}
+		value ^= toggle;
+		data[i] = value;
+	}
+}
+
+/* Feed the synthetic logic data through an output module. */
+static int render(struct bench *b, const struct sr_output *o, GString *out)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_logic logic;
+	size_t offset;
+	int ret;
+
+	header.feed_version = 1;
+	header.starttime.tv_sec = 0;
+	header.starttime.tv_usec = 0;
+	packet.type = SR_DF_HEADER;
+	packet.payload = &header;
+	ret = sr_output_send_append(o, &packet, out);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	for (offset = 0; ret == SR_OK && offset < b->logic_size;
+			offset += PACKET_SIZE) {
+		logic.length = MIN(PACKET_SIZE, b->logic_size - offset);
+		logic.data = b->logic + offset;
+		ret = sr_output_send_append(o, &packet, out);
+	}
+
+	if (ret == SR_OK) {
+		packet.type = SR_DF_END;
+		packet.payload = NULL;
+		ret = sr_output_send_append(o, &packet, out);
+	}
+
+	return ret;
+}
+
+struct input_case {
+	const struct sr_input_module *imod;
+	GString *data;
+};
+
+static void null_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	(void)sdi;
+	(void)packet;
+	(void)cb_data;
+}
+
+static double bench_input(struct bench *b, const void *arg)
+{
+	const struct input_case *ic;
+	struct sr_session *session;
+	struct sr_input *in;
+	struct sr_dev_inst *sdi;
+	GString *chunk;
+	gint64 start;
+	double elapsed;
+	size_t offset, len;
+	int ret;
+
+	ic = arg;
+	if (sr_session_new(b->ctx, &session) != SR_OK)
+		return -1;
+	sr_session_datafeed_callback_add(session, null_datafeed_in, NULL);
+	if (!(in = sr_input_new(ic->imod, NULL))) {
+		sr_session_destroy(session);
+		return -1;
+	}
+
+	ret = SR_OK;
+	sdi = NULL;
+	start = g_get_monotonic_time();
+	for (offset = 0; ret == SR_OK && offset < ic->data->len;
+			offset += len) {
+		len = MIN(PACKET_SIZE, ic->data->len - offset);
+		chunk = g_string_new_len(ic->data->str + offset, len);
+		ret = sr_input_send(in, chunk);
+		g_string_free(chunk, TRUE);
+		/* Like sigrok-cli: add the device once the module made one. */
+		if (!sdi && (sdi = sr_input_dev_inst_get(in)))
+			sr_session_dev_add(session, sdi);
+	}
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+	elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+
+	sr_session_destroy(session);
+	sr_input_free(in);
+
+	if (ret != SR_OK)
+		return -1;
+
+	return ic->data->len / MAX(elapsed, 1e-9) / 1e6;
+}
+
+static void run_inputs(struct bench *b)
+{
+	const struct sr_output_module **outputs;
+	const struct sr_output *o;
+	struct input_case ic;
+	char *id, *name;
+	int i, ret;
+
+	/* Read back what the output module of the same name wrote. */
+	outputs = sr_output_list();
+	for (i = 0; outputs[i]; i++) {
+		id = (char *)sr_output_id_get(outputs[i]);
+		if (sr_output_test_flag(outputs[i], SR_OUTPUT_INTERNAL_IO_HANDLING))
+			continue;
+		if (!(ic.imod = sr_input_find(id)))
+			continue;
+		if (!(o = sr_output_new(outputs[i], NULL, b->user, NULL)))
+			continue;
+		ic.data = g_string_sized_new(b->logic_size);
+		ret = render(b, o, ic.data);
+		sr_output_free(o);
+		if (ret == SR_OK && ic.data->len > 0) {
+			name = g_strdup_printf("input/%s", id);
+			bench_run(b, name, "MB/s", bench_input, &ic);
+			g_free(name);
+		}
+		g_string_free(ic.data, TRUE);
+	}
+}
+
+static double bench_srzip_write(struct bench *b, const void *arg)
+{
+	const struct sr_output *o;
+	GString *out;
+	gint64 start;
+	double elapsed;
+	int ret;
+
+	if (!(o = sr_output_new(sr_output_find("srzip"), NULL, b->user, arg)))
+		return -1;
+	out = g_string_new(NULL);
+	start = g_get_monotonic_time();
+	ret = render(b, o, out);
+	ret |= sr_output_free(o);
+	elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+	g_string_free(out, TRUE);
+
+	if (ret != SR_OK)
+		return -1;
+
+	return b->logic_size / MAX(elapsed, 1e-9) / 1e6;
+}
+
+static double bench_srzip_read(struct bench *b, const void *arg)
+{
+	struct sr_session *session;
+	struct demo_feed feed;
+	gint64 start;
+	double elapsed;
+
+	memset(&feed, 0, sizeof(feed));
+	start = g_get_monotonic_time();
+	if (sr_session_load(b->ctx, arg, &session) != SR_OK)
+		return -1;
+	sr_session_datafeed_callback_add(session, demo_datafeed_in, &feed);
+	elapsed = -1;
+	if (sr_session_start(session) == SR_OK) {
+		sr_session_run(session);
+		elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+	}
+	sr_session_destroy(session);
+
+	if (elapsed < 0 || feed.samples != b->logic_size)
+		return -1;
+
+	return b->logic_size / MAX(elapsed, 1e-9) / 1e6;
+}
+
+static void run_srzip(struct bench *b)
+{
+	char *filename;
+	int fd;
+
+	if (!sr_output_find("srzip"))
+		return;
+	if ((fd = g_file_open_tmp("bench-XXXXXX.sr", &filename, NULL)) < 0)
+		return;
+	close(fd);
+
+	bench_run(b, "srzip/write", "MB/s", bench_srzip_write, filename);
+	/* The read benchmark needs the file, write it once more. */
+	if (bench_srzip_write(b, filename) >= 0)
+		bench_run(b, "srzip/read", "MB/s", bench_srzip_read, filename);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench b;
+	GRand *rand;
+	char *name;
+	unsigned int i;
+
+	memset(&b, 0, sizeof(b));
+	b.runs = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_RUNS;
+	b.pattern = argc > 2 ? argv[2] : NULL;
+	if (!b.runs)
+		b.runs = 1;
+
+	if (sr_init(&b.ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_WARN);
+	if ((b.null_fd = open("/dev/null", O_WRONLY)) < 0) {
+		sr_exit(b.ctx);
+		return 1;
+	}
+
+	rand = g_rand_new_with_seed(SEED);
+	b.logic_size = FILE_SAMPLES;
+	b.logic = g_malloc(b.logic_size);
+	logic_fill(b.logic, b.logic_size, rand);
+	g_rand_free(rand);
+	b.user = user_device();
+	b.demo = demo_open(b.ctx);
+
+	printf("name\tvalue\tunit\n");
+	for (i = 0; i < G_N_ELEMENTS(analog_cases); i++) {
+		name = g_strdup_printf("analog_to_float/%s", analog_cases[i].name);
+		bench_run(&b, name, "Msamples/s", bench_analog_to_float,
+			&analog_cases[i]);
+		g_free(name);
+	}
+	run_demo(&b);
+	run_inputs(&b);
+	run_srzip(&b);
+
+	if (b.demo)
+		sr_dev_close(b.demo);
+	g_free(b.logic);
+	close(b.null_fd);
+	sr_exit(b.ctx);
+
+	return 0;
+}
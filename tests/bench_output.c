@@ -0,0 +1,150 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compare the two ways of exporting a logic stream through an output
+ * module: sr_output_send() (one GString per packet, written and freed
+ * by the caller) versus sr_output_send_fd() (reused buffer, written by
+ * libsigrok). Synthetic logic packets are rendered to /dev/null.
+ *
+ * Usage: bench_output [packets [packet size [module...]]]
+ */
+
+#include <config.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+
+#define NUM_CHANNELS 8
+
+static const char *default_modules[] = {
+	"bits", "hex", "ascii", "csv", "vcd", NULL,
+};
+
+static struct sr_dev_inst *create_device(void)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("sigrok", "bench", NULL);
+	for (i = 0; i < NUM_CHANNELS; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+static double run(const struct sr_output_module *omod,
+		const struct sr_dev_inst *sdi, int fd, gboolean direct,
+		unsigned long packets, const uint8_t *data, size_t size)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *out;
+	gint64 start;
+	unsigned long i;
+	int ret;
+
+	o = sr_output_new(omod, NULL, sdi, NULL);
+	if (!o)
+		return -1;
+
+	logic.length = size;
+	logic.unitsize = 1;
+	logic.data = (void *)data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < packets; i++) {
+		if (direct) {
+			ret = sr_output_send_fd(o, &packet, fd);
+		} else {
+			out = NULL;
+			ret = sr_output_send(o, &packet, &out);
+			if (out) {
+				if (write(fd, out->str, out->len) < 0)
+					ret = SR_ERR_IO;
+				g_string_free(out, TRUE);
+			}
+		}
+		if (ret != SR_OK)
+			break;
+	}
+	sr_output_free(o);
+
+	return (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+	struct sr_context *ctx;
+	struct sr_dev_inst *sdi;
+	const struct sr_output_module *omod;
+	const char **modules;
+	unsigned long packets;
+	size_t size, i;
+	uint8_t *data;
+	double t_send, t_fd;
+	int fd;
+
+	packets = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000;
+	size = argc > 2 ? strtoul(argv[2], NULL, 0) : 4096;
+	modules = argc > 3 ? (const char **)&argv[3] : default_modules;
+
+	if (sr_init(&ctx) != SR_OK)
+		return 1;
+	if ((fd = open("/dev/null", O_WRONLY)) < 0) {
+		sr_exit(ctx);
+		return 1;
+	}
+
+	data = g_malloc(size);
+	for (i = 0; i < size; i++)
+		data[i] = g_random_int();
+	sdi = create_device();
+
+	printf("%-8s %12s %12s %10s\n", "module", "send [MB/s]",
+		"fd [MB/s]", "speedup");
+	for (i = 0; modules[i]; i++) {
+		if (!(omod = sr_output_find((char *)modules[i]))) {
+			fprintf(stderr, "Unknown output module '%s'.\n", modules[i]);
+			continue;
+		}
+		t_send = run(omod, sdi, fd, FALSE, packets, data, size);
+		t_fd = run(omod, sdi, fd, TRUE, packets, data, size);
+		if (t_send < 0 || t_fd < 0)
+			continue;
+		printf("%-8s %12.1f %12.1f %9.2fx\n", modules[i],
+			packets * size / t_send / 1e6,
+			packets * size / t_fd / 1e6, t_send / t_fd);
+	}
+
+	g_free(data);
+	close(fd);
+	sr_exit(ctx);
+
+	return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Run SCPI drivers against the simulated instruments in tests/scpi-sim/
+ * and measure the config query rate and the acquisition throughput.
+ * Latency and bandwidth of the simulated link are set in the transcripts.
+ *
+ * Usage: bench_scpi [transcript dir [seconds]]
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+
+#define DEFAULT_DIR "tests/scpi-sim"
+
+struct bench_target {
+	const char *driver;
+	const char *transcript;
+	/* Acquisition limit, or 0 for no acquisition benchmark. */
+	uint32_t limit_key;
+	uint64_t limit;
+};
+
+static const struct bench_target targets[] = {
+	{ "rigol-ds", "rigol-ds1054z.txt", SR_CONF_LIMIT_FRAMES, 100 },
+	{ "scpi-pps", "rigol-dp832.txt", SR_CONF_LIMIT_SAMPLES, 100 },
+	/* Waveform download needs a recorded binary header, probe only. */
+	{ "siglent-sds", "siglent-sds1104x-e.txt", 0, 0 },
+};
+
+struct acq_stats {
+	uint64_t bytes;
+	uint64_t frames;
+};
+
+static struct sr_dev_driver *driver_find(struct sr_context *ctx,
+		const char *name)
+{
+	struct sr_dev_driver **drivers;
+	int i;
+
+	drivers = sr_driver_list(ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, name))
+			return drivers[i];
+	}
+
+	return NULL;
+}
+
+static struct sr_dev_inst *device_open(struct sr_context *ctx,
+		struct sr_dev_driver *driver, const char *conn)
+{
+	struct sr_config *src;
+	struct sr_dev_inst *sdi;
+	GSList *options, *devices;
+
+	if (sr_driver_init(ctx, driver) != SR_OK)
+		return NULL;
+
+	src = g_new(struct sr_config, 1);
+	src->key = SR_CONF_CONN;
+	src->data = g_variant_ref_sink(g_variant_new_string(conn));
+	options = g_slist_append(NULL, src);
+	devices = sr_driver_scan(driver, options);
+	g_variant_unref(src->data);
+	g_slist_free_full(options, g_free);
+
+	if (!devices)
+		return NULL;
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	if (sr_dev_open(sdi) != SR_OK)
+		return NULL;
+
+	return sdi;
+}
+
+/* Returns config queries per second over all gettable keys. */
+static double bench_queries(struct sr_dev_driver *driver,
+		struct sr_dev_inst *sdi, double seconds)
+{
+	const struct sr_channel_group *cg;
+	GSList *cgs, *l;
+	GArray *keys;
+	GVariant *data;
+	gint64 start, end;
+	uint64_t count;
+	uint32_t key;
+	unsigned int i;
+
+	cgs = g_slist_prepend(g_slist_copy(sr_dev_inst_channel_groups_get(sdi)),
+		NULL);
+	count = 0;
+	start = g_get_monotonic_time();
+	end = start + seconds * G_USEC_PER_SEC;
+	while (g_get_monotonic_time() < end) {
+		for (l = cgs; l; l = l->next) {
+			cg = l->data;
+			if (!(keys = sr_dev_options(driver, sdi, cg)))
+				continue;
+			for (i = 0; i < keys->len; i++) {
+				key = g_array_index(keys, uint32_t, i);
+				if (!(sr_dev_config_capabilities_list(sdi, cg, key) & SR_CONF_GET))
+					continue;
+				if (sr_config_get(driver, sdi, cg, key, &data) != SR_OK)
+					continue;
+				g_variant_unref(data);
+				count++;
+			}
+			g_array_free(keys, TRUE);
+		}
+	}
+	g_slist_free(cgs);
+
+	return count / ((g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC);
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct acq_stats *stats;
+
+	(void)sdi;
+
+	stats = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		stats->bytes += logic->length;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		stats->bytes += analog->num_samples * analog->encoding->unitsize;
+		break;
+	case SR_DF_FRAME_END:
+		stats->frames++;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Returns the acquisition time in seconds, or a negative value. */
+static double bench_acquisition(struct sr_context *ctx,
+		struct sr_dev_inst *sdi, const struct bench_target *target,
+		struct acq_stats *stats)
+{
+	struct sr_session *session;
+	gint64 start;
+	double elapsed;
+
+	if (sr_session_new(ctx, &session) != SR_OK)
+		return -1;
+	elapsed = -1;
+	if (sr_session_dev_add(session, sdi) != SR_OK)
+		goto out;
+	if (sr_config_set(sdi, NULL, target->limit_key,
+			g_variant_new_uint64(target->limit)) != SR_OK)
+		goto out;
+	sr_session_datafeed_callback_add(session, datafeed_in, stats);
+
+	start = g_get_monotonic_time();
+	if (sr_session_start(session) != SR_OK)
+		goto out;
+	sr_session_run(session);
+	elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+
+out:
+	sr_session_destroy(session);
+
+	return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+	const struct bench_target *target;
+	struct sr_context *ctx;
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct acq_stats stats;
+	const char *dir;
+	char *conn;
+	double seconds, queries, elapsed;
+	unsigned int i;
+
+	dir = argc > 1 ? argv[1] : DEFAULT_DIR;
+	seconds = argc > 2 ? strtod(argv[2], NULL) : 1.0;
+
+	if (sr_init(&ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_WARN);
+
+	printf("%-12s %12s %12s %10s\n", "driver", "queries/s",
+		"acq [MB/s]", "frames/s");
+	for (i = 0; i < G_N_ELEMENTS(targets); i++) {
+		target = &targets[i];
+		if (!(driver = driver_find(ctx, target->driver))) {
+			printf("%-12s (not built)\n", target->driver);
+			continue;
+		}
+		conn = g_strdup_printf("sim/%s/%s", dir, target->transcript);
+		sdi = device_open(ctx, driver, conn);
+		g_free(conn);
+		if (!sdi) {
+			printf("%-12s (no device)\n", target->driver);
+			continue;
+		}
+
+		queries = bench_queries(driver, sdi, seconds);
+		memset(&stats, 0, sizeof(stats));
+		elapsed = target->limit_key ?
+			bench_acquisition(ctx, sdi, target, &stats) : -1;
+		if (elapsed > 0)
+			printf("%-12s %12.0f %12.2f %10.1f\n", target->driver,
+				queries, stats.bytes / elapsed / 1e6,
+				stats.frames / elapsed);
+		else
+			printf("%-12s %12.0f %12s %10s\n", target->driver,
+				queries, "-", "-");
+		sr_dev_close(sdi);
+	}
+
+	sr_exit(ctx);
+
+	return 0;
+}
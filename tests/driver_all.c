@@ -17,9 +17,17 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+/* Needed for posix_openpt() and friends. */
+#define _XOPEN_SOURCE 700
+
 #include <config.h>
+#include <fcntl.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <check.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -40,6 +48,669 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+/* Check whether key info lookups by key and by name agree. */
+START_TEST(test_key_info)
+{
+	const struct sr_key_info *info;
+
+	info = sr_key_info_get(SR_KEY_CONFIG, SR_CONF_SAMPLERATE);
+	fail_unless(info != NULL, "No info for SR_CONF_SAMPLERATE.");
+	fail_unless(!strcmp(info->id, "samplerate"), "Wrong key info found.");
+	fail_unless(sr_key_info_name_get(SR_KEY_CONFIG, "samplerate") == info,
+		"Lookup by name found different key info.");
+	fail_unless(sr_key_info_get(SR_KEY_CONFIG, 0xffffffff) == NULL,
+		"Found key info for invalid key.");
+	fail_unless(sr_key_info_name_get(SR_KEY_CONFIG, "nonexistent") == NULL,
+		"Found key info for invalid name.");
+}
+END_TEST
+
+/* Write a transcript for the simulated SCPI instrument to a file. */
+static char *sim_transcript_new(const char *transcript)
+{
+	char *path;
+	int fd;
+
+	fd = g_file_open_tmp("sigrok-scpi-sim-XXXXXX", &path, NULL);
+	fail_unless(fd >= 0, "Cannot create transcript.");
+	fail_unless(write(fd, transcript, strlen(transcript)) ==
+		(ssize_t)strlen(transcript));
+	close(fd);
+
+	return path;
+}
+
+static GSList *sim_scan(struct sr_dev_driver *driver, const char *path)
+{
+	struct sr_config src;
+	GSList *options, *devices;
+
+	src.key = SR_CONF_CONN;
+	src.data = g_variant_ref_sink(g_variant_new_printf("sim/%s", path));
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+
+	return devices;
+}
+
+/* Check whether an SCPI driver probes a simulated instrument. */
+START_TEST(test_scpi_sim_probe)
+{
+	static const char transcript[] =
+		"!default 0\n"
+		"*IDN?\tRIGOL TECHNOLOGIES,DS1054Z,DS1ZA000000001,00.04.04\n"
+		"*OPC?\t1\n"
+		"!match :CHAN?:DISP?\t1\n"
+		"!match :CHAN?:PROB?\t10.00\n"
+		"!match :CHAN?:COUP?\tDC\n"
+		":TRIG:EDGE:SOUR?\tCHAN1\n"
+		":TRIG:EDGE:SLOP?\tPOS\n";
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	char *path;
+	int i, ret;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "rigol-ds"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	srtest_driver_init(srtest_ctx, driver);
+
+	path = sim_transcript_new(hmo_transcript);
+	devices = sim_scan(driver, path);
+	fail_unless(g_slist_length(devices) == 1, "Simulated device not found.");
+	sdi = devices->data;
+	fail_unless(!strcmp(sr_dev_inst_model_get(sdi), "DS1054Z"));
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open simulated device: %d.", ret);
+	sr_dev_close(sdi);
+	g_slist_free(devices);
+
+	g_unlink(path);
+	g_free(path);
+}
+END_TEST
+
+struct sim_block_feed {
+	unsigned int packets[2];
+	size_t samples[2];
+};
+
+static void sim_block_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	const struct sr_channel *ch;
+	struct sim_block_feed *feed;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_ANALOG)
+		return;
+	feed = cb_data;
+	analog = packet->payload;
+	ch = analog->meaning->channels->data;
+	fail_unless(ch->index < 2, "Data for channel %d.", ch->index);
+	feed->packets[ch->index]++;
+	feed->samples[ch->index] += analog->num_samples;
+}
+
+/* A Hameg HMO1002 with two analog channels. */
+static const char hmo_transcript[] =
+	"!default 0\n"
+	"*IDN?\tHAMEG,HMO1002,000000000,05.886\n"
+	"!match :CHAN?:STAT?\t1\n"
+	"!match :CHAN?:SCAL?\t1.000E+00\n"
+	"!match :CHAN?:COUP?\tDC\n"
+	"!match :PROB?:SET:ATT:UNIT?\tV\n"
+	"!match :CHAN?:DATA?\t@block 400\n"
+	":POD1:THR?\tTTL\n"
+	":TIM:SCAL?\t1.000E-03\n"
+	":TIM:DIV?\t12\n"
+	":TRIG:A:SOUR?\tCH1\n"
+	":TRIG:A:EDGE:SLOP?\tPOS\n"
+	":ACQ:HRES?\tOFF\n"
+	":ACQ:PEAK?\tOFF\n"
+	":ACQ:SRAT?\t1.000E+09\n";
+
+/*
+ * Check consecutive SCPI block reads: two channels of two frames, each
+ * block followed by a terminator which must not precede the next one.
+ */
+START_TEST(test_scpi_sim_blocks)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct sim_block_feed feed;
+	GSList *devices;
+	char *path;
+	int i, ret;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "hameg-hmo"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	srtest_driver_init(srtest_ctx, driver);
+
+	path = sim_transcript_new(hmo_transcript);
+	devices = sim_scan(driver, path);
+	fail_unless(g_slist_length(devices) == 1, "Simulated device not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "Failed to open simulated device: %d.", ret);
+	fail_unless(sr_config_set(sdi, NULL, SR_CONF_LIMIT_FRAMES,
+		g_variant_new_uint64(2)) == SR_OK);
+	fail_unless(sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(1000)) == SR_OK);
+
+	memset(&feed, 0, sizeof(feed));
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, sim_block_in, &feed);
+	fail_unless(sr_session_start(sess) == SR_OK);
+	sr_session_run(sess);
+	sr_session_destroy(sess);
+	sr_dev_close(sdi);
+
+	for (i = 0; i < 2; i++) {
+		fail_unless(feed.packets[i] == 2, "CH%d: %u blocks, expected 2.",
+			i + 1, feed.packets[i]);
+		fail_unless(feed.samples[i] == 200, "CH%d: %zu samples, "
+			"expected 200.", i + 1, feed.samples[i]);
+	}
+
+	g_unlink(path);
+	g_free(path);
+}
+END_TEST
+
+/* Check two simulated instruments acquiring in the same session. */
+START_TEST(test_scpi_sim_two_devices)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_dev_inst *sdi[2];
+	struct sr_session *sess;
+	struct sim_block_feed feed;
+	GSList *devices;
+	char *path[2];
+	int i, ret;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "hameg-hmo"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	srtest_driver_init(srtest_ctx, driver);
+
+	memset(&feed, 0, sizeof(feed));
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_datafeed_callback_add(sess, sim_block_in, &feed);
+	for (i = 0; i < 2; i++) {
+		path[i] = sim_transcript_new(hmo_transcript);
+		devices = sim_scan(driver, path[i]);
+		fail_unless(g_slist_length(devices) == 1,
+			"Simulated device %d not found.", i);
+		sdi[i] = devices->data;
+		g_slist_free(devices);
+		ret = sr_dev_open(sdi[i]);
+		fail_unless(ret == SR_OK, "Failed to open simulated device "
+			"%d: %d.", i, ret);
+		fail_unless(sr_config_set(sdi[i], NULL, SR_CONF_LIMIT_FRAMES,
+			g_variant_new_uint64(2)) == SR_OK);
+		fail_unless(sr_config_set(sdi[i], NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(1000)) == SR_OK);
+		sr_session_dev_add(sess, sdi[i]);
+	}
+	fail_unless(sr_session_start(sess) == SR_OK);
+	sr_session_run(sess);
+	sr_session_destroy(sess);
+
+	/* Both devices deliver all of their blocks. */
+	for (i = 0; i < 2; i++) {
+		fail_unless(feed.packets[i] == 4, "CH%d: %u blocks, expected 4.",
+			i + 1, feed.packets[i]);
+		fail_unless(feed.samples[i] == 400, "CH%d: %zu samples, "
+			"expected 400.", i + 1, feed.samples[i]);
+	}
+
+	for (i = 0; i < 2; i++) {
+		sr_dev_close(sdi[i]);
+		g_unlink(path[i]);
+		g_free(path[i]);
+	}
+}
+END_TEST
+
+/*
+ * The agilent-dmm driver probes a serial port by sending *IDN?. Behind
+ * a pseudo terminal nothing answers, so nothing gets found.
+ */
+static struct sr_dev_driver *pty_driver_get(void)
+{
+	struct sr_dev_driver **drivers, *driver;
+	int i;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "agilent-dmm"))
+			driver = drivers[i];
+	}
+	if (driver)
+		srtest_driver_init(srtest_ctx, driver);
+
+	return driver;
+}
+
+/* Open a pseudo terminal, return the master and the slave's name. */
+static int pty_open(char **name)
+{
+	int fd;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	fail_unless(fd >= 0, "Cannot open pseudo terminal.");
+	fail_unless(grantpt(fd) == 0 && unlockpt(fd) == 0,
+		"Cannot unlock pseudo terminal.");
+	*name = g_strdup(ptsname(fd));
+
+	return fd;
+}
+
+static GSList *pty_scan(struct sr_dev_driver *driver, const char *name)
+{
+	struct sr_dev_driver *drivers[2];
+	GSList *conns, *devices;
+
+	drivers[0] = driver;
+	drivers[1] = NULL;
+	conns = g_slist_append(NULL, (void *)name);
+	devices = sr_driver_scan_multi(srtest_ctx, drivers, NULL, conns, 0);
+	g_slist_free(conns);
+
+	return devices;
+}
+
+/* Counts the log messages which contain a string. */
+struct log_count {
+	const char *text;
+	int count;
+};
+
+static int count_messages(void *cb_data, int loglevel, const char *format,
+		va_list args)
+{
+	struct log_count *lc;
+	char *msg;
+
+	(void)loglevel;
+
+	lc = cb_data;
+	msg = g_strdup_vprintf(format, args);
+	if (strstr(msg, lc->text))
+		g_atomic_int_inc(&lc->count);
+	g_free(msg);
+
+	return SR_OK;
+}
+
+static int log_count_start(struct log_count *lc, const char *text)
+{
+	int loglevel;
+
+	lc->text = text;
+	lc->count = 0;
+	loglevel = sr_log_loglevel_get();
+	sr_log_loglevel_set(SR_LOG_SPEW);
+	sr_log_callback_set(count_messages, lc);
+
+	return loglevel;
+}
+
+static void log_count_stop(int loglevel)
+{
+	sr_log_callback_set_default();
+	sr_log_loglevel_set(loglevel);
+}
+
+/* Check that a scan which found nothing is skipped until the cache is cleared. */
+START_TEST(test_scan_multi_cache)
+{
+	struct sr_dev_driver *driver;
+	struct log_count skips;
+	char *name;
+	int fd, loglevel;
+
+	if (!(driver = pty_driver_get()))
+		return;
+	fd = pty_open(&name);
+	loglevel = log_count_start(&skips, "Skipping unchanged resource");
+
+	fail_unless(pty_scan(driver, name) == NULL, "Found a device.");
+	fail_unless(g_atomic_int_get(&skips.count) == 0,
+		"First scan was skipped.");
+	fail_unless(pty_scan(driver, name) == NULL, "Found a device.");
+	fail_unless(g_atomic_int_get(&skips.count) == 1,
+		"Second scan not skipped.");
+	sr_driver_scan_cache_clear(srtest_ctx);
+	fail_unless(pty_scan(driver, name) == NULL, "Found a device.");
+	fail_unless(g_atomic_int_get(&skips.count) == 1,
+		"Scan skipped after clearing the cache.");
+
+	log_count_stop(loglevel);
+	close(fd);
+	g_free(name);
+}
+END_TEST
+
+/*
+ * Check that a port stays usable for later scans after a driver's probe
+ * returned without closing it (agilent-dmm does so when nothing answers).
+ * A leaked port lock makes the second scan wait forever.
+ */
+START_TEST(test_scan_multi_port_lock)
+{
+	struct sr_dev_driver *driver;
+	char *name;
+	int fd;
+
+	if (!(driver = pty_driver_get()))
+		return;
+	fd = pty_open(&name);
+
+	fail_unless(pty_scan(driver, name) == NULL, "Found a device.");
+	sr_driver_scan_cache_clear(srtest_ctx);
+	fail_unless(pty_scan(driver, name) == NULL, "Found a device.");
+
+	close(fd);
+	g_free(name);
+}
+END_TEST
+
+/*
+ * Check that an open device's capabilities are collected once, and
+ * again after a change of the configuration.
+ */
+START_TEST(test_config_caps)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct log_count updates;
+	GSList *devices;
+	GVariant *gvar;
+	int loglevel, opened;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	/* Once for the device, once per channel group. */
+	loglevel = log_count_start(&updates,
+		"Collected configuration capabilities");
+	fail_unless(sr_dev_open(sdi) == SR_OK);
+	opened = 1 + g_slist_length(sr_dev_inst_channel_groups_get(sdi));
+	fail_unless(updates.count == opened,
+		"Capabilities collected %d times on open.", updates.count);
+
+	fail_unless(sr_config_get(driver, sdi, NULL, SR_CONF_SAMPLERATE,
+		&gvar) == SR_OK);
+	g_variant_unref(gvar);
+	fail_unless(updates.count == opened, "Capabilities collected on get.");
+
+	/* A set drops them, the next get only collects its group's. */
+	fail_unless(sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(SR_KHZ(200))) == SR_OK);
+	fail_unless(sr_config_get(driver, sdi, NULL, SR_CONF_SAMPLERATE,
+		&gvar) == SR_OK);
+	fail_unless(g_variant_get_uint64(gvar) == SR_KHZ(200));
+	g_variant_unref(gvar);
+	fail_unless(sr_config_get(driver, sdi, NULL, SR_CONF_SAMPLERATE,
+		&gvar) == SR_OK);
+	g_variant_unref(gvar);
+	fail_unless(updates.count == opened + 1,
+		"Capabilities collected %d times after set.",
+		updates.count - opened);
+
+	log_count_stop(loglevel);
+	sr_dev_close(sdi);
+}
+END_TEST
+
+static void demo_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	g_byte_array_append(cb_data, logic->data, logic->length);
+}
+
+static GByteArray *demo_acquire(struct sr_dev_driver *driver,
+		const char *test_mode, uint64_t samplerate, uint64_t samples)
+{
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_config src;
+	GSList *options, *devices;
+	GByteArray *data;
+	GVariant *gvar;
+
+	src.key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src.data = g_variant_ref_sink(g_variant_new_int32(0));
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(sr_dev_open(sdi) == SR_OK);
+
+	fail_unless(sr_config_set(sdi, NULL, SR_CONF_TEST_MODE,
+		g_variant_new_string(test_mode)) == SR_OK);
+	fail_unless(sr_config_get(driver, sdi, NULL, SR_CONF_TEST_MODE,
+		&gvar) == SR_OK);
+	fail_unless(!strcmp(g_variant_get_string(gvar, NULL), test_mode));
+	g_variant_unref(gvar);
+	sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(samplerate));
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(samples));
+
+	data = g_byte_array_new();
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, demo_datafeed_in, data);
+	fail_unless(sr_session_start(sess) == SR_OK);
+	sr_session_run(sess);
+	sr_session_destroy(sess);
+	sr_dev_close(sdi);
+
+	return data;
+}
+
+/* Check whether the unpaced demo mode generates the same data. */
+START_TEST(test_demo_max_rate)
+{
+	struct sr_dev_driver **drivers, *driver;
+	GByteArray *paced, *max_rate;
+	const uint64_t samples = 1000000;
+	/* The demo's chunk size in max-rate mode. */
+	const uint64_t samples_chunk = 256 * 1024;
+	int64_t start_us, elapsed_us;
+	int i;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	srtest_driver_init(srtest_ctx, driver);
+
+	paced = demo_acquire(driver, "none", SR_GHZ(1), samples);
+	max_rate = demo_acquire(driver, "max-rate", SR_GHZ(1), samples);
+	fail_unless(paced->len == samples, "Paced: %u bytes.", paced->len);
+	fail_unless(max_rate->len == samples, "Max rate: %u bytes.",
+		max_rate->len);
+	fail_unless(!memcmp(paced->data, max_rate->data, samples),
+		"Max rate mode generated different data.");
+	g_byte_array_free(paced, TRUE);
+	g_byte_array_free(max_rate, TRUE);
+
+	/*
+	 * Paced at 1 kHz this would take hours. Unpaced it must not wait
+	 * for a timer between chunks either (64 chunks).
+	 */
+	start_us = g_get_monotonic_time();
+	max_rate = demo_acquire(driver, "max-rate", SR_KHZ(1),
+		64 * samples_chunk);
+	elapsed_us = g_get_monotonic_time() - start_us;
+	fail_unless(max_rate->len == 64 * samples_chunk, "Max rate: %u bytes.",
+		max_rate->len);
+	fail_unless(elapsed_us < 2 * G_USEC_PER_SEC,
+		"Max rate mode took %" PRId64 " us.", elapsed_us);
+	g_byte_array_free(max_rate, TRUE);
+}
+END_TEST
+
+struct demo_analog_feed {
+	GArray *samples[2];
+};
+
+static void demo_analog_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	const struct sr_channel *ch;
+	struct demo_analog_feed *feed;
+	float *data;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_ANALOG)
+		return;
+	feed = cb_data;
+	analog = packet->payload;
+	ch = analog->meaning->channels->data;
+	fail_unless(analog->meaning->unit == SR_UNIT_VOLT);
+	data = g_malloc(analog->num_samples * sizeof(float));
+	fail_unless(sr_analog_to_float(analog, data) == SR_OK);
+	g_array_append_vals(feed->samples[!strcmp(ch->name, "A1")], data,
+		analog->num_samples);
+	g_free(data);
+}
+
+/* Check the demo's analog waveforms, at integer and fractional periods. */
+START_TEST(test_demo_analog)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_channel_group *cg;
+	struct sr_session *sess;
+	struct sr_config src[2];
+	struct demo_analog_feed feed;
+	GSList *options, *devices, *l;
+	const uint64_t samplerate = SR_MHZ(1), samples = 100000;
+	const double frequency = 3000;
+	double expected;
+	float *a0, *a1;
+	unsigned int n;
+	int i;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	srtest_driver_init(srtest_ctx, driver);
+
+	/* A0 is a square wave, A1 a sine. */
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_ref_sink(g_variant_new_int32(0));
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_ref_sink(g_variant_new_int32(2));
+	options = g_slist_append(g_slist_append(NULL, &src[0]), &src[1]);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src[0].data);
+	g_variant_unref(src[1].data);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(sr_dev_open(sdi) == SR_OK);
+
+	sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(samplerate));
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(samples));
+	/* Not an integer number of samples per period. */
+	for (l = sr_dev_inst_channel_groups_get(sdi); l; l = l->next) {
+		cg = l->data;
+		if (!strcmp(cg->name, "A1"))
+			fail_unless(sr_config_set(sdi, cg, SR_CONF_OUTPUT_FREQUENCY,
+				g_variant_new_double(frequency)) == SR_OK);
+	}
+
+	feed.samples[0] = g_array_new(FALSE, FALSE, sizeof(float));
+	feed.samples[1] = g_array_new(FALSE, FALSE, sizeof(float));
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, demo_analog_in, &feed);
+	fail_unless(sr_session_start(sess) == SR_OK);
+	sr_session_run(sess);
+	sr_session_destroy(sess);
+	sr_dev_close(sdi);
+
+	fail_unless(feed.samples[0]->len == samples);
+	fail_unless(feed.samples[1]->len == samples);
+
+	/* Default frequency: 20 samples per period, sampled exactly. */
+	a0 = (float *)feed.samples[0]->data;
+	for (n = 0; n < samples; n++) {
+		expected = (n % 20) < 10 ? -10 : 10;
+		fail_unless(fabs(a0[n] - expected) < 1e-4,
+			"A0 sample %u: %f, expected %f.", n, a0[n], expected);
+	}
+	a1 = (float *)feed.samples[1]->data;
+	for (n = 0; n < samples; n++) {
+		expected = 10 * sin(2 * G_PI * frequency * n / samplerate);
+		fail_unless(fabs(a1[n] - expected) < 1e-3,
+			"A1 sample %u: %f, expected %f.", n, a1[n], expected);
+	}
+
+	g_array_free(feed.samples[0], TRUE);
+	g_array_free(feed.samples[1], TRUE);
+}
+END_TEST
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -70,6 +741,15 @@ Suite *suite_driver_all(void)
 	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
 	tcase_add_test(tc, test_driver_available);
 	tcase_add_test(tc, test_driver_init_all);
+	tcase_add_test(tc, test_key_info);
+	tcase_add_test(tc, test_scpi_sim_probe);
+	tcase_add_test(tc, test_scpi_sim_blocks);
+	tcase_add_test(tc, test_scpi_sim_two_devices);
+	tcase_add_test(tc, test_scan_multi_cache);
+	tcase_add_test(tc, test_scan_multi_port_lock);
+	tcase_add_test(tc, test_config_caps);
+	tcase_add_test(tc, test_demo_max_rate);
+	tcase_add_test(tc, test_demo_analog);
 	// TODO: Currently broken.
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
@@ -53,6 +53,8 @@ Suite *suite_version(void);
 Suite *suite_device(void);
 Suite *suite_trigger(void);
 Suite *suite_analog(void);
+Suite *suite_aligner(void);
+Suite *suite_merger(void);
 Suite *suite_conv(void);
 
 #endif
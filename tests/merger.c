@@ -0,0 +1,252 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define MAX_PACKETS 32
+/* The starttime of all acquisitions, 1 s after the epoch. */
+#define START_NS 1000000000
+
+/* The packets passed on by a merger, in order. */
+struct passed {
+	unsigned int count;
+	const struct sr_dev_inst *sdi[MAX_PACKETS];
+	uint16_t type[MAX_PACKETS];
+	int64_t time_ns[MAX_PACKETS];
+};
+
+static void collect(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, int64_t time_ns,
+		void *cb_data)
+{
+	struct passed *passed;
+
+	passed = cb_data;
+	fail_unless(passed->count < MAX_PACKETS, "Too many packets.");
+	passed->sdi[passed->count] = sdi;
+	passed->type[passed->count] = packet->type;
+	passed->time_ns[passed->count] = time_ns;
+	passed->count++;
+}
+
+static void feed(struct sr_merger *merger, const struct sr_dev_inst *sdi,
+		uint16_t type, const void *payload)
+{
+	struct sr_datafeed_packet packet;
+
+	packet.type = type;
+	packet.payload = payload;
+	fail_unless(sr_merger_feed(merger, sdi, &packet) == SR_OK,
+		"sr_merger_feed() failed.");
+}
+
+static void feed_header(struct sr_merger *merger, const struct sr_dev_inst *sdi)
+{
+	struct sr_datafeed_header header;
+
+	header.feed_version = 1;
+	header.starttime.tv_sec = START_NS / 1000000000;
+	header.starttime.tv_usec = 0;
+	feed(merger, sdi, SR_DF_HEADER, &header);
+}
+
+static void feed_samplerate(struct sr_merger *merger,
+		const struct sr_dev_inst *sdi, uint64_t samplerate)
+{
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(samplerate));
+	meta.config = g_slist_append(NULL, &src);
+	feed(merger, sdi, SR_DF_META, &meta);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+
+static void feed_logic(struct sr_merger *merger, const struct sr_dev_inst *sdi,
+		size_t count)
+{
+	struct sr_datafeed_logic logic;
+	uint8_t data[16];
+
+	memset(data, 0, sizeof(data));
+	logic.length = count;
+	logic.unitsize = 1;
+	logic.data = data;
+	feed(merger, sdi, SR_DF_LOGIC, &logic);
+}
+
+static void feed_stamped_analog(struct sr_merger *merger,
+		const struct sr_dev_inst *sdi, uint64_t sample_num, int64_t time_ns)
+{
+	struct sr_datafeed_timestamp timestamp;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	float value;
+
+	timestamp.sample_num = sample_num;
+	timestamp.time_ns = time_ns;
+	feed(merger, sdi, SR_DF_TIMESTAMP, &timestamp);
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_float = TRUE;
+	value = 1.5;
+	analog.data = &value;
+	analog.num_samples = 1;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	meaning.channels = sr_dev_inst_channels_get(sdi);
+	feed(merger, sdi, SR_DF_ANALOG, &analog);
+}
+
+/*
+ * Check that the packets of a logic analyzer (placed by samplerate) and
+ * a meter (placed by timestamps) come out in order of time, whatever
+ * order they arrive in.
+ */
+START_TEST(test_merger_order)
+{
+	static const struct {
+		int dev;
+		uint16_t type;
+		int64_t time_ms;
+	} expected[] = {
+		{ 0, SR_DF_HEADER, 0 },
+		{ 1, SR_DF_HEADER, 0 },
+		{ 0, SR_DF_META, 0 },
+		{ 0, SR_DF_LOGIC, 0 },
+		{ 1, SR_DF_TIMESTAMP, 5 },
+		{ 1, SR_DF_ANALOG, 5 },
+		{ 0, SR_DF_LOGIC, 10 },
+		{ 0, SR_DF_LOGIC, 20 },
+		{ 1, SR_DF_TIMESTAMP, 25 },
+		{ 1, SR_DF_ANALOG, 25 },
+		{ 0, SR_DF_END, 30 },
+		/* Not stamped, placed at the time it arrives. */
+		{ 1, SR_DF_END, -1 },
+	};
+	struct sr_dev_inst *sdi[2];
+	struct sr_merger *merger;
+	struct passed passed;
+	unsigned int i;
+
+	sdi[0] = sr_dev_inst_user_new("Vendor", "Logic", "Version");
+	sr_dev_inst_channel_add(sdi[0], 0, SR_CHANNEL_LOGIC, "D0");
+	sdi[1] = sr_dev_inst_user_new("Vendor", "Meter", "Version");
+	sr_dev_inst_channel_add(sdi[1], 0, SR_CHANNEL_ANALOG, "P1");
+
+	memset(&passed, 0, sizeof(passed));
+	fail_unless(sr_merger_new(&merger, NULL, 0, collect, &passed) == SR_OK,
+		"sr_merger_new() failed.");
+
+	feed_header(merger, sdi[0]);
+	feed_header(merger, sdi[1]);
+	feed_samplerate(merger, sdi[0], 1000);
+	feed_logic(merger, sdi[0], 10);
+	feed_logic(merger, sdi[0], 10);
+	feed_logic(merger, sdi[0], 10);
+	fail_unless(passed.count == 4, "Logic did not wait for the meter.");
+	feed_stamped_analog(merger, sdi[1], 0, 5000000);
+	feed_stamped_analog(merger, sdi[1], 1, 25000000);
+	feed(merger, sdi[0], SR_DF_END, NULL);
+	feed(merger, sdi[1], SR_DF_END, NULL);
+
+	fail_unless(passed.count == G_N_ELEMENTS(expected),
+		"Got %u packets, expected %u.", passed.count,
+		(unsigned int)G_N_ELEMENTS(expected));
+	for (i = 0; i < G_N_ELEMENTS(expected); i++) {
+		fail_unless(passed.sdi[i] == sdi[expected[i].dev] &&
+			passed.type[i] == expected[i].type,
+			"Wrong packet %u.", i);
+		if (expected[i].time_ms >= 0)
+			fail_unless(passed.time_ns[i] ==
+				START_NS + expected[i].time_ms * 1000000,
+				"Wrong time of packet %u.", i);
+	}
+
+	sr_merger_free(merger);
+}
+END_TEST
+
+/*
+ * Check that packets wait for a silent device no longer than the window,
+ * and that flushing passes on the rest.
+ */
+START_TEST(test_merger_window)
+{
+	struct sr_dev_inst *sdi[2];
+	struct sr_merger *merger;
+	struct passed passed;
+	unsigned int i;
+
+	sdi[0] = sr_dev_inst_user_new("Vendor", "Logic", "Version");
+	sdi[1] = sr_dev_inst_user_new("Vendor", "Silent", "Version");
+
+	memset(&passed, 0, sizeof(passed));
+	fail_unless(sr_merger_new(&merger, NULL, 50000, collect, &passed) == SR_OK,
+		"sr_merger_new() failed.");
+
+	feed_header(merger, sdi[0]);
+	feed_header(merger, sdi[1]);
+	feed_samplerate(merger, sdi[0], 1000);
+	/* Packets at 0, 10, ..., 70 ms. Those up to 10 ms are over 50 ms old. */
+	for (i = 0; i < 8; i++)
+		feed_logic(merger, sdi[0], 10);
+	fail_unless(passed.count == 5, "Got %u packets, expected 5.",
+		passed.count);
+	fail_unless(passed.time_ns[4] == START_NS + 10000000,
+		"Wrong packet passed on.");
+
+	fail_unless(sr_merger_flush(merger) == SR_OK, "sr_merger_flush() failed.");
+	fail_unless(passed.count == 11, "Got %u packets, expected 11.",
+		passed.count);
+	for (i = 1; i < passed.count; i++)
+		fail_unless(passed.time_ns[i] >= passed.time_ns[i - 1],
+			"Packet %u out of order.", i);
+
+	sr_merger_free(merger);
+}
+END_TEST
+
+Suite *suite_merger(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("merger");
+
+	tc = tcase_create("merge");
+	tcase_add_test(tc, test_merger_order);
+	tcase_add_test(tc, test_merger_window);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
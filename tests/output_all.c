@@ -18,7 +18,10 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +99,563 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+/*
+ * Check whether sr_output_send_append() produces the same text as
+ * sr_output_send(), appended after any existing buffer content.
+ */
+START_TEST(test_output_send_append)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output_module *omod;
+	const struct sr_output *o1, *o2;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t data[64];
+	GString *out, *buf;
+	char name[8];
+	unsigned int i;
+	int ret;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	for (i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	omod = sr_output_find("bits");
+	o1 = sr_output_new(omod, NULL, sdi, NULL);
+	o2 = sr_output_new(omod, NULL, sdi, NULL);
+	fail_unless(o1 != NULL && o2 != NULL, "sr_output_new() failed.");
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 37;
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	out = NULL;
+	ret = sr_output_send(o1, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed.");
+	fail_unless(out != NULL, "sr_output_send() returned no text.");
+
+	buf = g_string_new("prefix");
+	ret = sr_output_send_append(o2, &packet, buf);
+	fail_unless(ret == SR_OK, "sr_output_send_append() failed.");
+	fail_unless(!strncmp(buf->str, "prefix", 6), "Existing text lost.");
+	fail_unless(!strcmp(buf->str + 6, out->str), "Output text differs.");
+
+	g_string_free(out, TRUE);
+	g_string_free(buf, TRUE);
+	sr_output_free(o1);
+	sr_output_free(o2);
+}
+END_TEST
+
+#define NUM_SAMPLES 300
+
+/*
+ * Check whether the text modules render the same lines no matter how
+ * the logic data is split into packets.
+ */
+START_TEST(test_output_text_split)
+{
+	static const char *modules[] = { "bits", "hex", "ascii" };
+	static const char *golden[] = {
+		"D0:00001111 00001111 \n"
+		"D1:01010101 10101010 \n"
+		"D2:00110011 01100110 \n"
+		"D3:01011010 01001011 \n"
+		"D4:00110110 11011001 \n"
+		"D5:00001110 00111000 \n"
+		"D6:01010100 10101101 \n"
+		"D7:00110010 01100100 \n"
+		"D8:11110000 11110000 \n"
+		"D9:01011010 10100101 \n"
+		"D10:11001001 10010011 \n"
+		"D11:01101101 00100101 \n",
+
+		"D0:0f 0f \n"
+		"D1:55 aa \n"
+		"D2:33 66 \n"
+		"D3:5a 4b \n"
+		"D4:36 d9 \n"
+		"D5:0e 38 \n"
+		"D6:54 ad \n"
+		"D7:32 64 \n"
+		"D8:f0 f0 \n"
+		"D9:5a a5 \n"
+		"D10:c9 93 \n"
+		"D11:6d 25 \n",
+
+		" D0:..../\"\"\"\\.../\"\"\"\n"
+		" D1:./\\/\\/\\/\"\\/\\/\\/\\\n"
+		" D2:../\"\\./\"\\/\"\\./\"\\\n"
+		" D3:./\\/\"\\/\\./\\./\\/\"\n"
+		" D4:../\"\\/\"\\/\"\\/\"\\./\n"
+		" D5:..../\"\"\\../\"\"\\..\n"
+		" D6:./\\/\\/\\./\\/\\/\"\\/\n"
+		" D7:../\"\\./\\./\"\\./\\.\n"
+		" D8:\"\"\"\"\\.../\"\"\"\\...\n"
+		" D9:./\\/\"\\/\\/\\/\\./\\/\n"
+		"D10:\"\"\\./\\./\"\\./\\./\"\n"
+		"D11:./\"\\/\"\\/\\./\\./\\/\n",
+	};
+	struct sr_dev_inst *sdi;
+	const struct sr_output_module *omod;
+	const struct sr_output *o1, *o2;
+	struct sr_datafeed_packet packet, end;
+	struct sr_datafeed_logic logic;
+	uint8_t data[2 * NUM_SAMPLES];
+	GString *out1, *out2;
+	char name[8];
+	unsigned int i, m;
+	size_t pos, len;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	for (i = 0; i < 12; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 37 + (i >> 3);
+
+	logic.unitsize = 2;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	end.type = SR_DF_END;
+	end.payload = NULL;
+	for (m = 0; m < G_N_ELEMENTS(modules); m++) {
+		omod = sr_output_find((char *)modules[m]);
+		o1 = sr_output_new(omod, NULL, sdi, NULL);
+		o2 = sr_output_new(omod, NULL, sdi, NULL);
+		fail_unless(o1 != NULL && o2 != NULL, "sr_output_new() failed.");
+
+		out1 = g_string_new(NULL);
+		logic.length = sizeof(data);
+		logic.data = data;
+		sr_output_send_append(o1, &packet, out1);
+		sr_output_send_append(o1, &end, out1);
+
+		/* Odd sample counts, which straddle bytes and lines. */
+		out2 = g_string_new(NULL);
+		for (pos = 0, len = 1; pos < NUM_SAMPLES; pos += len, len += 6) {
+			len = MIN(len, NUM_SAMPLES - pos);
+			logic.length = len * logic.unitsize;
+			logic.data = data + pos * logic.unitsize;
+			sr_output_send_append(o2, &packet, out2);
+		}
+		sr_output_send_append(o2, &end, out2);
+
+		fail_unless(out1->len > 0, "No %s output.", modules[m]);
+		fail_unless(!strcmp(out1->str, out2->str),
+			"%s output depends on packet sizes.", modules[m]);
+
+		g_string_free(out1, TRUE);
+		g_string_free(out2, TRUE);
+		sr_output_free(o1);
+		sr_output_free(o2);
+	}
+
+	/*
+	 * The first 16 samples, as the modules rendered them before they
+	 * were converted to bit planes. Only the lines after the header
+	 * are compared.
+	 */
+	for (m = 0; m < G_N_ELEMENTS(modules); m++) {
+		omod = sr_output_find((char *)modules[m]);
+		o1 = sr_output_new(omod, NULL, sdi, NULL);
+		out1 = g_string_new(NULL);
+		logic.length = 16 * 2;
+		logic.data = data;
+		sr_output_send_append(o1, &packet, out1);
+		sr_output_send_append(o1, &end, out1);
+		fail_unless(g_str_has_suffix(out1->str, golden[m]),
+			"Wrong %s output:\n%s", modules[m], out1->str);
+		g_string_free(out1, TRUE);
+		sr_output_free(o1);
+	}
+}
+END_TEST
+
+/*
+ * Check the WAV module's PCM conversion and that channels which come
+ * in separate packets get interleaved.
+ */
+START_TEST(test_output_wav_pcm16)
+{
+	static const float both[] = { 0.5, -0.5, 1.0, -2.0 };
+	static const float a0[] = { 0.25 }, a1[] = { 0.0 };
+	static const int16_t expected[] = { 16384, -16384, 32767, -32767, 8192, 0 };
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GHashTable *options;
+	GSList *channels;
+	GString *out;
+	const uint8_t *p;
+	unsigned int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_ANALOG, "A1");
+	channels = sr_dev_inst_channels_get(sdi);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "format",
+		g_variant_ref_sink(g_variant_new_string("pcm16")));
+	o = sr_output_new(sr_output_find("wav"), options, sdi, NULL);
+	g_hash_table_destroy(options);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	out = g_string_new(NULL);
+	meaning.channels = channels;
+	analog.data = (void *)both;
+	analog.num_samples = 2;
+	sr_output_send_append(o, &packet, out);
+	meaning.channels = g_slist_nth(channels, 1);
+	analog.data = (void *)a1;
+	analog.num_samples = 1;
+	sr_output_send_append(o, &packet, out);
+	meaning.channels = g_slist_append(NULL, channels->data);
+	analog.data = (void *)a0;
+	sr_output_send_append(o, &packet, out);
+	g_slist_free(meaning.channels);
+
+	fail_unless(out->len == 46 + sizeof(expected), "Wrong WAV size.");
+	fail_unless(!memcmp(out->str, "RIFF", 4), "No RIFF header.");
+	/* Format code 1 (PCM), two channels, 16 bits per sample. */
+	p = (const uint8_t *)out->str;
+	fail_unless(p[20] == 1 && p[22] == 2 && p[34] == 16, "Wrong format.");
+	for (i = 0; i < G_N_ELEMENTS(expected); i++) {
+		p = (const uint8_t *)out->str + 46 + 2 * i;
+		fail_unless((int16_t)(p[0] | p[1] << 8) == expected[i],
+			"Wrong sample %u.", i);
+	}
+
+	g_string_free(out, TRUE);
+	sr_output_free(o);
+}
+END_TEST
+
+/*
+ * Check that the WAV module fills in the RIFF and data chunk sizes
+ * of a file written through sr_output_send_fd().
+ */
+/*
+ * Check that the WAV module lines up analog channels with each other
+ * and with logic data, and writes a sample which one channel missed
+ * as silence at the end.
+ */
+START_TEST(test_output_wav_aligned)
+{
+	static const float a0[] = { 0.5, -0.5, 0.25, 1.0 };
+	static const float a1[] = { 0.125, 0.0, -1.0 };
+	static const uint8_t logic_data[] = { 1, 0, 1, 0 };
+	static const int16_t expected[] = {
+		16384, 4096, -16384, 0, 8192, -32767, 32767, 0,
+	};
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GHashTable *options;
+	GSList *channels;
+	GString *out;
+	const uint8_t *p;
+	unsigned int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_ANALOG, "A0");
+	sr_dev_inst_channel_add(sdi, 2, SR_CHANNEL_ANALOG, "A1");
+	channels = sr_dev_inst_channels_get(sdi);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "format",
+		g_variant_ref_sink(g_variant_new_string("pcm16")));
+	o = sr_output_new(sr_output_find("wav"), options, sdi, NULL);
+	g_hash_table_destroy(options);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+
+	out = g_string_new(NULL);
+	logic.unitsize = 1;
+	logic.length = sizeof(logic_data);
+	logic.data = (void *)logic_data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	sr_output_send_append(o, &packet, out);
+
+	/* A1 in two parts, A0 in one, the last sample of A1 is missing. */
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	meaning.channels = g_slist_append(NULL, g_slist_nth_data(channels, 2));
+	analog.data = (void *)a1;
+	analog.num_samples = 2;
+	sr_output_send_append(o, &packet, out);
+	fail_unless(out->len == 46, "Samples of one channel were written.");
+	analog.data = (void *)(a1 + 2);
+	analog.num_samples = 1;
+	sr_output_send_append(o, &packet, out);
+	g_slist_free(meaning.channels);
+	meaning.channels = g_slist_append(NULL, g_slist_nth_data(channels, 1));
+	analog.data = (void *)a0;
+	analog.num_samples = G_N_ELEMENTS(a0);
+	sr_output_send_append(o, &packet, out);
+	g_slist_free(meaning.channels);
+	fail_unless(out->len == 46 + 3 * 4, "Wrong number of frames.");
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	sr_output_send_append(o, &packet, out);
+
+	fail_unless(out->len == 46 + sizeof(expected), "Wrong WAV size.");
+	for (i = 0; i < G_N_ELEMENTS(expected); i++) {
+		p = (const uint8_t *)out->str + 46 + 2 * i;
+		fail_unless((int16_t)(p[0] | p[1] << 8) == expected[i],
+			"Wrong sample %u.", i);
+	}
+
+	g_string_free(out, TRUE);
+	sr_output_free(o);
+}
+END_TEST
+
+START_TEST(test_output_wav_fd)
+{
+	static const float samples[] = { 0.5, -0.5, 0.25 };
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GHashTable *options;
+	char *path, *buf;
+	const uint8_t *p;
+	gsize len;
+	int fd;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+
+	fd = g_file_open_tmp("sr-wav-XXXXXX.wav", &path, NULL);
+	fail_unless(fd >= 0, "g_file_open_tmp() failed.");
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "format",
+		g_variant_ref_sink(g_variant_new_string("pcm16")));
+	o = sr_output_new(sr_output_find("wav"), options, sdi, path);
+	g_hash_table_destroy(options);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.channels = sr_dev_inst_channels_get(sdi);
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	analog.data = (void *)samples;
+	analog.num_samples = G_N_ELEMENTS(samples);
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	fail_unless(sr_output_send_fd(o, &packet, fd) == SR_OK,
+		"sr_output_send_fd() failed.");
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_send_fd(o, &packet, fd) == SR_OK,
+		"sr_output_send_fd() failed.");
+	close(fd);
+	sr_output_free(o);
+
+	fail_unless(g_file_get_contents(path, &buf, &len, NULL),
+		"Cannot read back the WAV file.");
+	/* Six bytes of samples, no pad byte. */
+	fail_unless(len == 46 + 6, "Wrong WAV size %u.", (unsigned int)len);
+	p = (const uint8_t *)buf;
+	fail_unless(!memcmp(p, "RIFF", 4), "No RIFF header.");
+	fail_unless((p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24) ==
+		len - 8, "Wrong RIFF size.");
+	fail_unless(!memcmp(p + 38, "data", 4), "No data chunk.");
+	fail_unless((p[42] | p[43] << 8 | p[44] << 16 | (uint32_t)p[45] << 24) ==
+		6, "Wrong data size.");
+
+	g_free(buf);
+	unlink(path);
+	g_free(path);
+}
+END_TEST
+
+/*
+ * Check that the CSV module emits the rows of every logic packet right
+ * away, also when the device has (disabled) analog channels.
+ */
+START_TEST(test_output_csv_stream)
+{
+	static const uint8_t data1[] = { 0x01, 0x02, 0x03, 0x80 };
+	static const uint8_t data2[] = { 0x00, 0xff };
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GHashTable *options;
+	GSList *l;
+	GString *out;
+	char name[8];
+	unsigned int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	for (i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	sr_dev_inst_channel_add(sdi, 8, SR_CHANNEL_ANALOG, "A0");
+	l = g_slist_last(sr_dev_inst_channels_get(sdi));
+	sr_dev_channel_enable(l->data, FALSE);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "label",
+		g_variant_ref_sink(g_variant_new_string("off")));
+	o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	g_hash_table_destroy(options);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+
+	logic.unitsize = 1;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	out = g_string_new(NULL);
+
+	logic.length = sizeof(data1);
+	logic.data = (void *)data1;
+	sr_output_send_append(o, &packet, out);
+	fail_unless(!strcmp(out->str,
+		"1,0,0,0,0,0,0,0\n"
+		"0,1,0,0,0,0,0,0\n"
+		"1,1,0,0,0,0,0,0\n"
+		"0,0,0,0,0,0,0,1\n"), "Wrong CSV rows.");
+
+	/* A packet of another size starts a new set. */
+	g_string_truncate(out, 0);
+	logic.length = sizeof(data2);
+	logic.data = (void *)data2;
+	sr_output_send_append(o, &packet, out);
+	fail_unless(!strcmp(out->str,
+		"0,0,0,0,0,0,0,0\n"
+		"1,1,1,1,1,1,1,1\n"), "Wrong CSV rows.");
+
+	g_string_free(out, TRUE);
+	sr_output_free(o);
+}
+END_TEST
+
+/* Check that WaveDrom waves continue across packets. */
+START_TEST(test_output_wavedrom)
+{
+	static const uint8_t data1[] = { 0x01, 0x01, 0x02 };
+	static const uint8_t data2[] = { 0x02, 0x02, 0x03 };
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *out;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_LOGIC, "D1");
+	o = sr_output_new(sr_output_find("wavedrom"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+
+	logic.unitsize = 1;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	out = g_string_new(NULL);
+	logic.length = sizeof(data1);
+	logic.data = (void *)data1;
+	sr_output_send_append(o, &packet, out);
+	logic.length = sizeof(data2);
+	logic.data = (void *)data2;
+	sr_output_send_append(o, &packet, out);
+	fail_unless(out->len == 0, "Unexpected output before the end.");
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	sr_output_send_append(o, &packet, out);
+	fail_unless(!strcmp(out->str, "{ \"signal\": ["
+		"{ \"name\": \"D0\", \"wave\": \"1.0..1\" },"
+		"{ \"name\": \"D1\", \"wave\": \"0.1...\" }"
+		"], \"config\": { \"skin\": \"narrow\" }}"),
+		"Wrong WaveDrom output.");
+
+	g_string_free(out, TRUE);
+	sr_output_free(o);
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -110,6 +670,13 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_desc);
 	tcase_add_test(tc, test_output_find);
 	tcase_add_test(tc, test_output_options);
+	tcase_add_test(tc, test_output_send_append);
+	tcase_add_test(tc, test_output_text_split);
+	tcase_add_test(tc, test_output_wav_pcm16);
+	tcase_add_test(tc, test_output_wav_aligned);
+	tcase_add_test(tc, test_output_wav_fd);
+	tcase_add_test(tc, test_output_csv_stream);
+	tcase_add_test(tc, test_output_wavedrom);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -185,6 +186,373 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+START_TEST(test_session_threaded_set_get)
+{
+	int ret;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	/* Sessions are not threaded by default. */
+	fail_unless(sr_session_threaded_get(sess) == FALSE);
+	ret = sr_session_threaded_set(sess, TRUE);
+	fail_unless(ret == SR_OK);
+	fail_unless(sr_session_threaded_get(sess) == TRUE);
+
+	/* NULL session, must not segfault. */
+	ret = sr_session_threaded_set(NULL, TRUE);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+START_TEST(test_session_stats_get)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_stats *stats;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	/* A new session has no counts. */
+	ret = sr_session_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK);
+	fail_unless(stats->datafeed.packets == 0);
+	fail_unless(stats->devices == NULL);
+	fail_unless(stats->callbacks == NULL);
+	sr_session_stats_free(stats);
+
+	/* NULL arguments, must not segfault. */
+	fail_unless(sr_session_stats_get(NULL, &stats) == SR_ERR_ARG);
+	fail_unless(sr_session_stats_get(sess, NULL) == SR_ERR_ARG);
+	fail_unless(sr_session_stats_reset(NULL) == SR_ERR_ARG);
+	sr_session_stats_free(NULL);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+struct stats_feed {
+	uint64_t packets;
+	uint64_t samples;
+};
+
+static void stats_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct stats_feed *feed;
+
+	(void)sdi;
+
+	feed = cb_data;
+	feed->packets++;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		feed->samples += logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		feed->samples += analog->num_samples;
+	}
+}
+
+/* Run a demo device in a regular session, check the counters. */
+START_TEST(test_session_stats_run)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_session_stats *stats;
+	struct sr_stats *dev, *cb;
+	struct stats_feed feed;
+	GSList *devices;
+	uint64_t timed;
+	int i, ret;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	sr_driver_init(srtest_ctx, driver);
+
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(sr_dev_open(sdi) == SR_OK);
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(10000));
+
+	memset(&feed, 0, sizeof(feed));
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, stats_datafeed_in, &feed);
+	/* Measure times from the first packet on. */
+	fail_unless(sr_session_stats_reset(sess) == SR_OK);
+
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	sr_session_run(sess);
+	sr_dev_close(sdi);
+
+	fail_unless(sr_session_stats_get(sess, &stats) == SR_OK);
+	fail_unless(g_slist_length(stats->devices) == 1);
+	fail_unless(g_slist_length(stats->callbacks) == 1);
+	dev = stats->devices->data;
+	cb = stats->callbacks->data;
+	fail_unless(feed.packets > 0, "No packets received.");
+	fail_unless(stats->datafeed.packets == feed.packets);
+	fail_unless(dev->packets == feed.packets);
+	fail_unless(cb->packets == feed.packets);
+	fail_unless(cb->samples == feed.samples);
+	fail_unless(stats->datafeed.samples == feed.samples);
+	/* Every packet was timed once. */
+	timed = 0;
+	for (i = 0; i < SR_STATS_LATENCY_BUCKETS; i++)
+		timed += stats->datafeed.latency[i];
+	fail_unless(timed == feed.packets, "%" PRIu64 " of %" PRIu64
+		" packets timed.", timed, feed.packets);
+	sr_session_stats_free(stats);
+
+	/* A reset clears all counters. */
+	fail_unless(sr_session_stats_reset(sess) == SR_OK);
+	fail_unless(sr_session_stats_get(sess, &stats) == SR_OK);
+	fail_unless(stats->datafeed.packets == 0);
+	fail_unless(((struct sr_stats *)stats->devices->data)->packets == 0);
+	fail_unless(((struct sr_stats *)stats->callbacks->data)->packets == 0);
+	sr_session_stats_free(stats);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+struct timestamp_feed {
+	struct sr_merger *merger;
+	int data_packets;
+	int count;
+	uint64_t sample_num[4];
+	int64_t time_ns[4];
+	/* Times the merger assigned to the header and the timestamps. */
+	int64_t merged_header_ns;
+	int merged;
+	int64_t merged_ns[4];
+};
+
+static void timestamp_merged(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, int64_t time_ns,
+		void *cb_data)
+{
+	struct timestamp_feed *feed;
+
+	(void)sdi;
+
+	feed = cb_data;
+	if (packet->type == SR_DF_HEADER)
+		feed->merged_header_ns = time_ns;
+	else if (packet->type == SR_DF_TIMESTAMP && feed->merged < 4)
+		feed->merged_ns[feed->merged++] = time_ns;
+}
+
+static void timestamp_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_timestamp *timestamp;
+	struct timestamp_feed *feed;
+
+	feed = cb_data;
+	if (packet->type == SR_DF_LOGIC || packet->type == SR_DF_ANALOG)
+		feed->data_packets++;
+	if (packet->type == SR_DF_TIMESTAMP) {
+		timestamp = packet->payload;
+		/* The first one comes before any data. */
+		fail_unless(feed->count || !feed->data_packets,
+			"Timestamp after the data.");
+		if (feed->count < 4) {
+			feed->sample_num[feed->count] = timestamp->sample_num;
+			feed->time_ns[feed->count] = timestamp->time_ns;
+		}
+		feed->count++;
+	}
+	sr_merger_feed(feed->merger, sdi, packet);
+}
+
+/*
+ * Run a demo device for two frames, check that it tells when each frame
+ * started, and that a merger places the timestamps on its timeline.
+ */
+START_TEST(test_session_timestamp_run)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct timestamp_feed feed;
+	GSList *devices;
+	int i, ret;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	sr_driver_init(srtest_ctx, driver);
+
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(sr_dev_open(sdi) == SR_OK);
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_FRAMES,
+		g_variant_new_uint64(2));
+
+	memset(&feed, 0, sizeof(feed));
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	fail_unless(sr_merger_new(&feed.merger, sess, 0, timestamp_merged,
+		&feed) == SR_OK, "sr_merger_new() failed.");
+	sr_session_datafeed_callback_add(sess, timestamp_datafeed_in, &feed);
+
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	sr_session_run(sess);
+	sr_dev_close(sdi);
+	sr_merger_flush(feed.merger);
+
+	/* One per frame, frames have 1000 samples. */
+	fail_unless(feed.count == 2, "Got %d timestamps.", feed.count);
+	fail_unless(feed.sample_num[0] == 0 && feed.time_ns[0] == 0,
+		"Wrong first timestamp.");
+	fail_unless(feed.sample_num[1] == 1000 && feed.time_ns[1] > 0,
+		"Wrong second timestamp.");
+
+	fail_unless(feed.merged == 2, "Merger passed %d timestamps.",
+		feed.merged);
+	for (i = 0; i < 2; i++)
+		fail_unless(feed.merged_ns[i] ==
+			feed.merged_header_ns + feed.time_ns[i],
+			"Timestamp %d not on the device's timeline.", i);
+
+	sr_merger_free(feed.merger);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+#define THREADED_NUM_DEVS 2
+
+struct threaded_feed {
+	const struct sr_dev_inst *sdi[THREADED_NUM_DEVS];
+	int header[THREADED_NUM_DEVS];
+	int end[THREADED_NUM_DEVS];
+	int out_of_order;
+	struct sr_session *session;
+	int blocking_calls;
+};
+
+static void threaded_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct threaded_feed *feed;
+	int i;
+
+	feed = cb_data;
+	for (i = 0; i < THREADED_NUM_DEVS; i++) {
+		if (feed->sdi[i] == sdi)
+			break;
+	}
+	fail_unless(i < THREADED_NUM_DEVS, "Packet from unknown device.");
+
+	/* Per device: header first, end last. */
+	if (packet->type == SR_DF_HEADER) {
+		feed->header[i]++;
+		/* Would wait for the other device, which waits for us. */
+		if (sr_session_destroy(feed->session) != SR_ERR_BUG)
+			feed->blocking_calls++;
+	}
+	else if (!feed->header[i] || feed->end[i])
+		feed->out_of_order++;
+	if (packet->type == SR_DF_END)
+		feed->end[i]++;
+}
+
+/* Run two demo devices in a threaded session. */
+START_TEST(test_session_threaded_run)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct threaded_feed feed;
+	struct sr_session_stats *stats;
+	GSList *devices, *l;
+	uint64_t packets;
+	int i, ret;
+
+	driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			driver = drivers[i];
+	}
+	if (!driver)
+		return;
+	sr_driver_init(srtest_ctx, driver);
+
+	memset(&feed, 0, sizeof(feed));
+	sr_session_new(srtest_ctx, &sess);
+	feed.session = sess;
+	for (i = 0; i < THREADED_NUM_DEVS; i++) {
+		devices = sr_driver_scan(driver, NULL);
+		fail_unless(devices != NULL, "No demo device found.");
+		sdi = devices->data;
+		g_slist_free(devices);
+		fail_unless(sr_dev_open(sdi) == SR_OK);
+		sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(10000));
+		sr_session_dev_add(sess, sdi);
+		feed.sdi[i] = sdi;
+	}
+	sr_session_threaded_set(sess, TRUE);
+	sr_session_datafeed_callback_add(sess, threaded_datafeed_in, &feed);
+
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	sr_session_run(sess);
+
+	for (i = 0; i < THREADED_NUM_DEVS; i++) {
+		fail_unless(feed.header[i] == 1, "Device %d: %d headers.",
+			i, feed.header[i]);
+		fail_unless(feed.end[i] == 1, "Device %d: %d ends.",
+			i, feed.end[i]);
+		sr_dev_close((struct sr_dev_inst *)feed.sdi[i]);
+	}
+	fail_unless(feed.out_of_order == 0, "%d packets out of order.",
+		feed.out_of_order);
+	fail_unless(feed.blocking_calls == 0,
+		"Session destroyed from a datafeed callback.");
+
+	/* Every packet of every device reached the callback. */
+	fail_unless(sr_session_stats_get(sess, &stats) == SR_OK);
+	fail_unless(g_slist_length(stats->devices) == THREADED_NUM_DEVS);
+	fail_unless(g_slist_length(stats->callbacks) == 1);
+	packets = 0;
+	for (l = stats->devices; l; l = l->next)
+		packets += ((struct sr_stats *)l->data)->packets;
+	fail_unless(packets == stats->datafeed.packets);
+	fail_unless(packets ==
+		((struct sr_stats *)stats->callbacks->data)->packets);
+	sr_session_stats_free(stats);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +577,22 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("stats");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_stats_get);
+	tcase_add_test(tc, test_session_stats_run);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("timestamp");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_timestamp_run);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("threaded");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_threaded_set_get);
+	tcase_add_test(tc, test_session_threaded_run);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
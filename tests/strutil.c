@@ -21,6 +21,8 @@
 #include <check.h>
 #include <errno.h>
 #include <locale.h>
+#include <math.h>
+#include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -430,6 +432,108 @@ START_TEST(test_exponent)
 }
 END_TEST
 
+/* Random doubles: raw bit patterns, decimal fractions and integers. */
+static double random_double(GRand *rand, unsigned int kind)
+{
+	uint64_t bits;
+	double v;
+
+	switch (kind % 4) {
+	case 0:
+		bits = ((uint64_t)g_rand_int(rand) << 32) | g_rand_int(rand);
+		memcpy(&v, &bits, sizeof(v));
+		return v;
+	case 1:
+		return g_rand_int_range(rand, -1000000, 1000000) /
+			pow(10, g_rand_int_range(rand, 0, 12));
+	case 2:
+		return g_rand_int_range(rand, 0, 100000);
+	default:
+		return g_rand_double_range(rand, -1, 1) *
+			pow(10, g_rand_int_range(rand, -20, 20));
+	}
+}
+
+/*
+ * Check that sr_format_double_ascii() matches "%.*g" and that its
+ * shortest representation converts back to the same value.
+ */
+START_TEST(test_format_double)
+{
+	static const int precisions[] = { 1, 2, 3, 6, 10, 15, 16, 17 };
+	char expected[64], s[64];
+	GRand *rand;
+	unsigned int i, j;
+	double v;
+
+	rand = g_rand_new_with_seed(4711);
+	for (i = 0; i < 200000; i++) {
+		v = random_double(rand, i);
+		for (j = 0; j < ARRAY_SIZE(precisions); j++) {
+			sr_snprintf_ascii(expected, sizeof(expected), "%.*g",
+				precisions[j], v);
+			sr_format_double_ascii(s, sizeof(s), v, precisions[j]);
+			fail_unless(!strcmp(s, expected),
+				"%%.%dg of %.17g: %s, expected %s.",
+				precisions[j], v, s, expected);
+		}
+		if (!isfinite(v))
+			continue;
+		sr_format_double_ascii(s, sizeof(s), v, -1);
+		fail_unless(sr_strtod_ascii(s, NULL) == v,
+			"Shortest form of %.17g doesn't round-trip: %s.", v, s);
+	}
+	g_rand_free(rand);
+
+	sr_format_double_ascii(s, sizeof(s), 0.1, -1);
+	fail_unless(!strcmp(s, "0.1"), "Shortest form of 0.1: %s.", s);
+	sr_format_double_ascii(s, 4, 123.456, 6);
+	fail_unless(!strcmp(s, "123"), "Truncated output: %s.", s);
+}
+END_TEST
+
+/* Check that sr_strtod_ascii() matches g_ascii_strtod(). */
+START_TEST(test_strtod)
+{
+	static const char *inputs[] = {
+		"1.", "-0", ".5", "0x10", "1e", "1e+", "  3", "inf", "nan",
+		"00012.5000e-2", "123456789012345678901", "9007199254740993",
+		"1e22", "1e23", "-.e1", "", "1,5", "2.5V", "1e-400", "1e400",
+	};
+	char s[64], *end, *expected_end;
+	double v, expected;
+	int err, expected_err;
+	GRand *rand;
+	unsigned int i;
+
+	rand = g_rand_new_with_seed(4711);
+	for (i = 0; i < 200000 + ARRAY_SIZE(inputs); i++) {
+		if (i < ARRAY_SIZE(inputs)) {
+			g_strlcpy(s, inputs[i], sizeof(s));
+		} else {
+			sr_snprintf_ascii(s, sizeof(s), (i & 1) ? "%.*g" : "%.*e",
+				g_rand_int_range(rand, 0, 19), random_double(rand, i));
+			if (!g_rand_int_range(rand, 0, 5))
+				g_strlcat(s, (i & 2) ? "x" : "e", sizeof(s));
+		}
+		errno = 0;
+		expected = g_ascii_strtod(s, &expected_end);
+		expected_err = errno;
+		errno = 0;
+		v = sr_strtod_ascii(s, &end);
+		err = errno;
+		fail_unless(!memcmp(&v, &expected, sizeof(v)) || (isnan(v) && isnan(expected)),
+			"'%s': %.17g, expected %.17g.", s, v, expected);
+		fail_unless(end == expected_end,
+			"'%s': end at %d, expected %d.", s,
+			(int)(end - s), (int)(expected_end - s));
+		fail_unless(err == expected_err,
+			"'%s': errno %d, expected %d.", s, err, expected_err);
+	}
+	g_rand_free(rand);
+}
+END_TEST
+
 Suite *suite_strutil(void)
 {
 	Suite *s;
@@ -452,5 +556,11 @@ Suite *suite_strutil(void)
 	tcase_add_test(tc, test_exponent);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("sr_format_double_ascii");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_format_double);
+	tcase_add_test(tc, test_strtod);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
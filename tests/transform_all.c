@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +97,276 @@ START_TEST(test_transform_options)
 }
 END_TEST
 
+/* Check the options of the logic channel transforms. */
+START_TEST(test_transform_logic_options)
+{
+	const struct sr_option **opt;
+	const char *ids[] = { "invert", "remap" };
+	const char *keys[] = { "mask", "channels" };
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(ids); i++) {
+		opt = sr_transform_options_get(sr_transform_find(ids[i]));
+		fail_unless(opt != NULL, "No options for '%s'.", ids[i]);
+		fail_unless(!strcmp(opt[0]->id, keys[i]),
+			"Unexpected option '%s' for '%s'.", opt[0]->id, ids[i]);
+		fail_unless(opt[0]->def != NULL, "No default for '%s'.", keys[i]);
+		sr_transform_options_free(opt);
+	}
+}
+END_TEST
+
+/* The logic data passed on by the transforms of a session. */
+struct logic_out {
+	GByteArray *data;
+	unsigned int unitsize;
+};
+
+static void logic_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct logic_out *out;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	out = cb_data;
+	logic = packet->payload;
+	fail_unless(!out->unitsize || out->unitsize == logic->unitsize,
+		"Unitsize changed from %u to %u.", out->unitsize,
+		logic->unitsize);
+	out->unitsize = logic->unitsize;
+	g_byte_array_append(out->data, logic->data, logic->length);
+}
+
+/*
+ * Feed logic data of the given number of channels (named "0", "1", ...)
+ * through a transform, using the binary input module.
+ */
+static void transform_logic(const char *id, const char *key, GVariant *value,
+		int num_channels, const uint8_t *data, size_t len,
+		struct logic_out *out)
+{
+	const struct sr_transform *t;
+	struct sr_session *session;
+	struct sr_input *in;
+	GHashTable *options;
+	GString *buf;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+		g_variant_ref_sink(g_variant_new_int32(num_channels)));
+	in = sr_input_new(sr_input_find("binary"), options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	g_hash_table_remove_all(options);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	g_hash_table_insert(options, g_strdup(key), g_variant_ref_sink(value));
+	t = sr_transform_new(sr_transform_find(id), options,
+		sr_input_dev_inst_get(in));
+	fail_unless(t != NULL, "Failed to create '%s' transform.", id);
+	g_hash_table_destroy(options);
+
+	out->data = g_byte_array_new();
+	out->unitsize = 0;
+	sr_session_datafeed_callback_add(session, logic_in, out);
+	buf = g_string_new_len((const gchar *)data, len);
+	fail_unless(sr_input_send(in, buf) == SR_OK, "sr_input_send() failed.");
+	fail_unless(sr_input_end(in) == SR_OK, "sr_input_end() failed.");
+	g_string_free(buf, TRUE);
+
+	sr_session_destroy(session);
+	sr_transform_free(t);
+	sr_input_free(in);
+}
+
+/*
+ * Check a remap of up to 16 channels, all enabled: output bit k of every
+ * sample must be input bit src[k], the bits after the listed channels
+ * must be clear.
+ */
+static void check_remap(const char *channels, const unsigned int *src,
+		unsigned int num_src, int num_channels, unsigned int out_unitsize)
+{
+	struct logic_out out;
+	uint8_t data[64 * 2];
+	unsigned int in_unitsize, num_samples, i, k, bit, expected, got;
+
+	in_unitsize = (num_channels + 7) / 8;
+	num_samples = sizeof(data) / 2;
+	for (i = 0; i < num_samples * in_unitsize; i++)
+		data[i] = i * 37 + (i >> 3);
+
+	transform_logic("remap", "channels", g_variant_new_string(channels),
+		num_channels, data, num_samples * in_unitsize, &out);
+
+	fail_unless(out.unitsize == out_unitsize, "'%s': unitsize %u, "
+		"expected %u.", channels, out.unitsize, out_unitsize);
+	fail_unless(out.data->len == num_samples * out_unitsize,
+		"'%s': %u bytes, expected %u.", channels, out.data->len,
+		num_samples * out_unitsize);
+	for (i = 0; i < num_samples; i++) {
+		expected = got = 0;
+		for (k = 0; k < num_src; k++) {
+			bit = src[k];
+			if (data[i * in_unitsize + bit / 8] & (1 << (bit % 8)))
+				expected |= 1 << k;
+		}
+		for (k = 0; k < out_unitsize; k++)
+			got |= out.data->data[i * out_unitsize + k] << (8 * k);
+		fail_unless(got == expected, "'%s': sample %u is 0x%x, "
+			"expected 0x%x.", channels, i, got, expected);
+	}
+	g_byte_array_free(out.data, TRUE);
+}
+
+/* Check that invert only flips the masked channels, at unitsize 3. */
+START_TEST(test_transform_invert)
+{
+	struct logic_out out;
+	uint8_t data[11 * 3], mask[3] = { 0x01, 0x01, 0x80 };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 37;
+
+	/* Channels 0, 8 and 23. */
+	transform_logic("invert", "mask", g_variant_new_uint64(0x800101),
+		24, data, sizeof(data), &out);
+
+	fail_unless(out.unitsize == 3, "Unitsize %u, expected 3.", out.unitsize);
+	fail_unless(out.data->len == sizeof(data), "Got %u bytes.",
+		out.data->len);
+	for (i = 0; i < sizeof(data); i++)
+		fail_unless(out.data->data[i] == (uint8_t)(data[i] ^ mask[i % 3]),
+			"Wrong byte %u.", i);
+	g_byte_array_free(out.data, TRUE);
+}
+END_TEST
+
+/* Check that remap reorders channels. */
+START_TEST(test_transform_remap_reorder)
+{
+	static const unsigned int src[] = { 2, 0, 1, 7, 6, 5, 4, 3 };
+
+	check_remap("2,0,1,7,6,5,4,3", src, G_N_ELEMENTS(src), 8, 1);
+}
+END_TEST
+
+/* Check that remap drops the channels which are not selected. */
+START_TEST(test_transform_remap_drop)
+{
+	static const unsigned int prefix[] = { 0, 1, 2 };
+	static const unsigned int gaps[] = { 1, 4, 6 };
+	static const unsigned int all[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+	/* A prefix of the channels keeps them at their bit positions. */
+	check_remap("0,1,2", prefix, G_N_ELEMENTS(prefix), 8, 1);
+	check_remap("1,4,6", gaps, G_N_ELEMENTS(gaps), 8, 1);
+	check_remap("0,1,2,3,4,5,6,7", all, G_N_ELEMENTS(all), 8, 1);
+}
+END_TEST
+
+/* Check that remap keeps the unitsize of 16 channels. */
+START_TEST(test_transform_remap_unitsize)
+{
+	static const unsigned int low[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+	static const unsigned int mixed[] = { 9, 1, 15, 0, 8 };
+
+	check_remap("0,1,2,3,4,5,6,7", low, G_N_ELEMENTS(low), 16, 2);
+	check_remap("9,1,15,0,8", mixed, G_N_ELEMENTS(mixed), 16, 2);
+}
+END_TEST
+
+struct output_feed {
+	const struct sr_output *o;
+	GString *out;
+};
+
+static void output_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct output_feed *feed;
+
+	(void)sdi;
+
+	feed = cb_data;
+	sr_output_send_append(feed->o, packet, feed->out);
+}
+
+/*
+ * Check that outputs which take a channel's bit by its index see the
+ * remapped channels under the enabled channels' names.
+ */
+START_TEST(test_transform_remap_output)
+{
+	static const uint8_t data[] = { 0x08, 0x04, 0x0c, 0x01, 0xf0 };
+	const struct sr_transform *t;
+	struct sr_session *session;
+	struct sr_input *in;
+	struct sr_dev_inst *sdi;
+	struct output_feed feed;
+	GHashTable *options;
+	GSList *l;
+	GString *buf;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+		g_variant_ref_sink(g_variant_new_int32(8)));
+	in = sr_input_new(sr_input_find("binary"), options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	g_hash_table_remove_all(options);
+	sdi = sr_input_dev_inst_get(in);
+
+	/* Only channels 0 to 3 are enabled. */
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		if (((struct sr_channel *)l->data)->index >= 4)
+			sr_dev_channel_enable(l->data, FALSE);
+	}
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	g_hash_table_insert(options, g_strdup("channels"),
+		g_variant_ref_sink(g_variant_new_string("3,2")));
+	t = sr_transform_new(sr_transform_find("remap"), options, sdi);
+	fail_unless(t != NULL, "Failed to create 'remap' transform.");
+	g_hash_table_remove_all(options);
+	g_hash_table_insert(options, g_strdup("label"),
+		g_variant_ref_sink(g_variant_new_string("off")));
+	g_hash_table_insert(options, g_strdup("header"),
+		g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	feed.o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	fail_unless(feed.o != NULL, "sr_output_new() failed.");
+	g_hash_table_destroy(options);
+
+	feed.out = g_string_new(NULL);
+	sr_session_datafeed_callback_add(session, output_in, &feed);
+	buf = g_string_new_len((const gchar *)data, sizeof(data));
+	fail_unless(sr_input_send(in, buf) == SR_OK, "sr_input_send() failed.");
+	fail_unless(sr_input_end(in) == SR_OK, "sr_input_end() failed.");
+	g_string_free(buf, TRUE);
+
+	/* Channel 0 shows input channel 3, channel 1 input channel 2. */
+	fail_unless(!strcmp(feed.out->str,
+		"1,0,0,0\n"
+		"0,1,0,0\n"
+		"1,1,0,0\n"
+		"0,0,0,0\n"
+		"0,0,0,0\n"), "Wrong CSV rows:\n%s", feed.out->str);
+
+	g_string_free(feed.out, TRUE);
+	sr_session_destroy(session);
+	sr_output_free(feed.o);
+	sr_transform_free(t);
+	sr_input_free(in);
+}
+END_TEST
+
 Suite *suite_transform_all(void)
 {
 	Suite *s;
@@ -110,6 +381,15 @@ Suite *suite_transform_all(void)
 	tcase_add_test(tc, test_transform_desc);
 	tcase_add_test(tc, test_transform_find);
 	tcase_add_test(tc, test_transform_options);
+	tcase_add_test(tc, test_transform_logic_options);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("logic");
+	tcase_add_test(tc, test_transform_invert);
+	tcase_add_test(tc, test_transform_remap_reorder);
+	tcase_add_test(tc, test_transform_remap_drop);
+	tcase_add_test(tc, test_transform_remap_unitsize);
+	tcase_add_test(tc, test_transform_remap_output);
 	suite_add_tcase(s, tc);
 
 	return s;